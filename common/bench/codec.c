@@ -0,0 +1,478 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../includes/ip.h"
+#include "../includes/icmp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define BENCH_TSC		1
+# define BENCH_UNIT		"cycles"
+#else
+# define BENCH_TSC		0
+# define BENCH_UNIT		"ns"
+#endif
+
+#define BENCH_SAMPLES		101		/**< default timed batches per case */
+#define BENCH_WARMUP		8		/**< untimed batches before sampling */
+#define BENCH_BATCH_TICKS	20000	/**< a batch runs at least this long */
+#define BENCH_BUF_SIZE		(64 << 10)
+#define BENCH_PKT_SIZE		128
+#define BENCH_MAX_CASES		64
+
+/**
+ * @brief One measured function / input combination
+ * - func / variant / bytes: what is measured, bytes processed per call
+ * - run: calls the function iters times, returns a value to keep alive
+ * - len: input length given to the function
+ * - pkt: header bytes for the parser cases
+ */
+typedef struct sBenchCase
+{
+	const char	*func;
+	char		variant[32];
+	uint32_t	bytes;
+	uint64_t	(*run)(const struct sBenchCase *bc, uint32_t iters);
+	uint32_t	len;
+	uint8_t		pkt[BENCH_PKT_SIZE];
+} tBenchCase;
+
+/**
+ * @brief Per-call statistics of a case, in timer ticks
+ */
+typedef struct sBenchStats
+{
+	double	min;
+	double	median;
+	double	p90;
+	double	stddev;
+} tBenchStats;
+
+static uint8_t			gPayload[BENCH_BUF_SIZE] __attribute__((aligned(64)));
+static uint8_t			gOut[BENCH_BUF_SIZE + 64] __attribute__((aligned(64)));
+static struct in6_addr	gSrc6;
+static struct in6_addr	gDst6;
+static volatile uint64_t	gSink;
+
+/* ----------------- Timer ----------------- */
+
+/**
+ * @brief Timer read before the measured code
+ * lfence keeps rdtsc from being executed ahead of earlier instructions.
+ */
+static inline uint64_t
+benchStart(void)
+{
+#if BENCH_TSC
+	_mm_lfence();
+	return (__rdtsc());
+#else
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+/**
+ * @brief Timer read after the measured code
+ * rdtscp waits for the measured instructions to retire, lfence keeps later
+ * ones from starting before the read.
+ */
+static inline uint64_t
+benchStop(void)
+{
+#if BENCH_TSC
+	unsigned int	aux;
+	uint64_t		tsc = __rdtscp(&aux);
+
+	_mm_lfence();
+	return (tsc);
+#else
+	return (benchStart());
+#endif
+}
+
+static uint64_t
+monotonicNs(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+/**
+ * @brief Timer ticks per nanosecond
+ * The TSC runs at a constant rate, not at the current core clock: the
+ * ns column is what users see, cycles are what to compare between builds.
+ */
+static double
+benchTicksPerNs(void)
+{
+	uint64_t	t0 = monotonicNs();
+	uint64_t	c0 = benchStart();
+	uint64_t	t1;
+	uint64_t	c1;
+
+	do
+		t1 = monotonicNs();
+	while (t1 - t0 < 50000000ULL);
+	c1 = benchStop();
+	return ((double)(c1 - c0) / (double)(t1 - t0));
+}
+
+/* ----------------- Statistics ----------------- */
+
+static int
+cmpDouble(const void *a, const void *b)
+{
+	double	x = *(const double *)a;
+	double	y = *(const double *)b;
+
+	return ((x > y) - (x < y));
+}
+
+/**
+ * @brief Ticks of an empty batch, subtracted from every sample
+ */
+static double
+benchOverhead(void)
+{
+	double	samples[BENCH_SAMPLES];
+
+	for (int i = 0; i < BENCH_SAMPLES; i++)
+	{
+		uint64_t	start = benchStart();
+
+		samples[i] = (double)(benchStop() - start);
+	}
+	qsort(samples, BENCH_SAMPLES, sizeof(*samples), cmpDouble);
+	return (samples[BENCH_SAMPLES / 2]);
+}
+
+/**
+ * @brief Time one case
+ * The batch size doubles until a batch lasts BENCH_BATCH_TICKS, so timer
+ * resolution and overhead are amortized; every sample is then one batch
+ * divided by its call count.
+ * @param bc - case
+ * @param samples - number of timed batches
+ * @param overhead - ticks of an empty batch
+ * @param buf - room for samples per-call values
+ * @param stats - per-call statistics
+ */
+static void
+benchRun(const tBenchCase *bc, int samples, double overhead, double *buf,
+	tBenchStats *stats)
+{
+	uint32_t	iters = 1;
+	uint64_t	start;
+	uint64_t	ticks;
+	double		sum = 0;
+	double		sq = 0;
+
+	for (;;)
+	{
+		start = benchStart();
+		gSink += bc->run(bc, iters);
+		ticks = benchStop() - start;
+		if (ticks >= BENCH_BATCH_TICKS || iters >= (1U << 24))
+			break;
+		iters *= 2;
+	}
+	for (int i = 0; i < BENCH_WARMUP; i++)
+		gSink += bc->run(bc, iters);
+	for (int i = 0; i < samples; i++)
+	{
+		double	perCall;
+
+		start = benchStart();
+		gSink += bc->run(bc, iters);
+		ticks = benchStop() - start;
+		perCall = ((double)ticks - overhead) / iters;
+		buf[i] = perCall > 0 ? perCall : 0;
+		sum += buf[i];
+		sq += buf[i] * buf[i];
+	}
+	qsort(buf, (size_t)samples, sizeof(*buf), cmpDouble);
+	stats->min = buf[0];
+	stats->median = buf[samples / 2];
+	stats->p90 = buf[samples * 9 / 10];
+	sq = sq / samples - (sum / samples) * (sum / samples);
+	stats->stddev = sq > 0 ? sqrt(sq) : 0;
+}
+
+/* ----------------- Measured calls ----------------- */
+
+static uint64_t
+runIcmpChecksum(const tBenchCase *bc, uint32_t iters)
+{
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+		acc += icmpChecksum(gPayload, bc->len);
+	return (acc);
+}
+
+static uint64_t
+runIcmpv6Checksum(const tBenchCase *bc, uint32_t iters)
+{
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+		acc += icmpv6Checksum(&gSrc6, &gDst6, gPayload, bc->len);
+	return (acc);
+}
+
+static uint64_t
+runBuildIcmpv4Echo(const tBenchCase *bc, uint32_t iters)
+{
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+		acc += buildIcmpv4EchoRequest((tIcmp4Echo *)gOut, sizeof(gOut), 0x4242,
+			(uint16_t)i, gPayload, bc->len);
+	return (acc);
+}
+
+static uint64_t
+runBuildIcmpv6Echo(const tBenchCase *bc, uint32_t iters)
+{
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+		acc += buildIcmpv6EchoRequest((tIcmp6Echo *)gOut, sizeof(gOut), 0x4242,
+			(uint16_t)i, gPayload, bc->len, &gSrc6, &gDst6, 1);
+	return (acc);
+}
+
+static uint64_t
+runParseIpHeader(const tBenchCase *bc, uint32_t iters)
+{
+	tIpHdr		hdr;
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+		acc += parseIpHeaderFromBuffer(bc->pkt, bc->len, &hdr);
+	return (acc + hdr.ttl);
+}
+
+static uint64_t
+runParseIp4Opts(const tBenchCase *bc, uint32_t iters)
+{
+	tIpHdr		hdr;
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+	{
+		parseIp4Opts(bc->pkt, bc->len, &hdr);
+		acc += hdr.options[0].length;
+	}
+	return (acc);
+}
+
+static uint64_t
+runParseIp6Header(const tBenchCase *bc, uint32_t iters)
+{
+	tIp6Hdr		hdr;
+	uint64_t	acc = 0;
+
+	for (uint32_t i = 0; i < iters; i++)
+		acc += parseIp6HeaderFromBuffer(bc->pkt, bc->len, &hdr);
+	return (acc + hdr.hop_limit);
+}
+
+/* ----------------- Cases ----------------- */
+
+/**
+ * @brief Append a case
+ * @return the new case, NULL when the table is full
+ */
+static tBenchCase *
+addCase(tBenchCase *cases, int *count, const char *func, const char *variant,
+	uint64_t (*run)(const tBenchCase *, uint32_t), uint32_t len, uint32_t bytes)
+{
+	tBenchCase	*bc;
+
+	if (*count >= BENCH_MAX_CASES)
+		return (NULL);
+	bc = &cases[(*count)++];
+	memset(bc, 0, sizeof(*bc));
+	bc->func = func;
+	snprintf(bc->variant, sizeof(bc->variant), "%s", variant);
+	bc->run = run;
+	bc->len = len;
+	bc->bytes = bytes;
+	return (bc);
+}
+
+/**
+ * @brief IPv4 header with the given options, padded with EOL
+ * @param pkt - header storage
+ * @param opts - option bytes
+ * @param optLen - length of opts (at most 40)
+ * @return header length
+ */
+static uint32_t
+makeIp4(uint8_t *pkt, const uint8_t *opts, uint32_t optLen)
+{
+	uint32_t	ihl = (20 + optLen + 3) / 4;
+
+	memset(pkt, 0, ihl * 4);
+	pkt[0] = (uint8_t)(0x40 | ihl);
+	pkt[2] = 0;
+	pkt[3] = 84;
+	pkt[8] = 64;
+	pkt[9] = IP_PROTO_ICMP;
+	memcpy(pkt + 12, "\x7f\x00\x00\x01\x7f\x00\x00\x01", 8);
+	memcpy(pkt + 20, opts, optLen);
+	return (ihl * 4);
+}
+
+/**
+ * @brief Fill the case table
+ * Payload sizes go from an empty echo to a jumbo-ish one, with an odd
+ * length for the trailing byte path; option mixes cover the parser's
+ * single byte, record route, timestamp and mixed multi-option loops.
+ */
+static int
+buildCases(tBenchCase *cases)
+{
+	static const uint32_t	sizes[] = {0, 56, 57, 512, 1472, 8184};
+	static const struct
+	{
+		const char	*name;
+		uint32_t	len;
+		uint8_t		opts[40];
+	}	ip4Opts[] = {
+		{"none", 0, {0}},
+		{"nop x3 + eol", 4, {1, 1, 1, 0}},
+		{"record route 9", 39, {7, 39, 4}},
+		{"timestamp 9", 40, {68, 40, 5, 0}},
+		{"nop+rr+ts+lsrr", 40, {1, 7, 11, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+			1, 68, 12, 5, 0, 0, 0, 0, 0, 0, 0, 0,
+			131, 11, 4, 10, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0}},
+	};
+	tBenchCase	*bc;
+	int			count = 0;
+	char		name[32];
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++)
+	{
+		snprintf(name, sizeof(name), "%u B", sizes[i] + ICMP4_HDR_LEN);
+		addCase(cases, &count, "icmpChecksum", name, runIcmpChecksum,
+			sizes[i] + ICMP4_HDR_LEN, sizes[i] + ICMP4_HDR_LEN);
+		addCase(cases, &count, "icmpv6Checksum", name, runIcmpv6Checksum,
+			sizes[i] + ICMP6_HDR_LEN, sizes[i] + ICMP6_HDR_LEN);
+	}
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); i++)
+	{
+		snprintf(name, sizeof(name), "%u B payload", sizes[i]);
+		addCase(cases, &count, "buildIcmpv4EchoRequest", name,
+			runBuildIcmpv4Echo, sizes[i], sizes[i] + ICMP4_HDR_LEN);
+		addCase(cases, &count, "buildIcmpv6EchoRequest", name,
+			runBuildIcmpv6Echo, sizes[i], sizes[i] + ICMP6_HDR_LEN);
+	}
+	for (size_t i = 0; i < sizeof(ip4Opts) / sizeof(*ip4Opts); i++)
+	{
+		bc = addCase(cases, &count, "parseIpHeaderFromBuffer", ip4Opts[i].name,
+			runParseIpHeader, 0, 0);
+		bc->len = makeIp4(bc->pkt, ip4Opts[i].opts, ip4Opts[i].len);
+		bc->bytes = bc->len;
+		if (ip4Opts[i].len == 0)
+			continue;
+		bc = addCase(cases, &count, "parseIp4Opts", ip4Opts[i].name,
+			runParseIp4Opts, 0, 0);
+		bc->len = makeIp4(bc->pkt, ip4Opts[i].opts, ip4Opts[i].len);
+		bc->bytes = bc->len - 20;
+	}
+	/* base header straight to ICMPv6, then hop-by-hop + destination
+	   options + fragment before it */
+	bc = addCase(cases, &count, "parseIp6HeaderFromBuffer", "icmpv6",
+		runParseIp6Header, 48, 40);
+	bc->pkt[0] = 0x60;
+	bc->pkt[5] = 8;
+	bc->pkt[6] = IP_PROTO_ICMPV6;
+	bc->pkt[7] = 64;
+	bc = addCase(cases, &count, "parseIp6HeaderFromBuffer", "hbh+dst+frag",
+		runParseIp6Header, 40 + 8 + 16 + 8 + 8, 40 + 8 + 16 + 8);
+	bc->pkt[0] = 0x60;
+	bc->pkt[5] = 8 + 16 + 8 + 8;
+	bc->pkt[6] = 0;
+	bc->pkt[7] = 64;
+	bc->pkt[40] = 60;
+	bc->pkt[41] = 0;
+	bc->pkt[48] = 44;
+	bc->pkt[49] = 1;
+	bc->pkt[64] = IP_PROTO_ICMPV6;
+	return (count);
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-n samples] [function-filter]\n", prog);
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	static tBenchCase	cases[BENCH_MAX_CASES];
+	const char			*filter = NULL;
+	double				*buf;
+	double				ticksPerNs;
+	double				overhead;
+	int					samples = BENCH_SAMPLES;
+	int					count;
+	int					opt;
+
+	while ((opt = getopt(argc, argv, "n:")) != -1)
+	{
+		if (opt != 'n' || (samples = atoi(optarg)) < 3)
+			usage(argv[0]);
+	}
+	if (optind + 1 < argc)
+		usage(argv[0]);
+	if (optind < argc)
+		filter = argv[optind];
+	buf = malloc((size_t)samples * sizeof(*buf));
+	if (!buf)
+		return (1);
+	srand(42);
+	for (size_t i = 0; i < sizeof(gPayload); i++)
+		gPayload[i] = (uint8_t)rand();
+	memcpy(&gSrc6, "\xfd\x42\x00\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01", 16);
+	memcpy(&gDst6, "\xfd\x42\x00\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x02", 16);
+	count = buildCases(cases);
+	ticksPerNs = benchTicksPerNs();
+	overhead = benchOverhead();
+	printf("# timer %s, %.3f per ns, %.0f timer overhead, %d samples per case\n",
+		BENCH_UNIT, ticksPerNs, overhead, samples);
+	printf("%-26s %-16s %6s %10s %10s %10s %8s %9s %8s\n", "function", "case",
+		"bytes", "min", "median", "p90", "stddev", "ns", "GB/s");
+	for (int i = 0; i < count; i++)
+	{
+		tBenchStats	stats;
+		double		ns;
+
+		if (filter && !strstr(cases[i].func, filter))
+			continue;
+		benchRun(&cases[i], samples, overhead, buf, &stats);
+		ns = stats.median / ticksPerNs;
+		printf("%-26s %-16s %6u %10.1f %10.1f %10.1f %8.1f %9.1f",
+			cases[i].func, cases[i].variant, cases[i].bytes, stats.min,
+			stats.median, stats.p90, stats.stddev, ns);
+		if (cases[i].bytes && ns > 0)
+			printf(" %8.2f\n", cases[i].bytes / ns);
+		else
+			printf(" %8s\n", "-");
+	}
+	free(buf);
+	return (0);
+}
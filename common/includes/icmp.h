@@ -300,6 +300,24 @@ typedef struct sIcmp6RouterAdvert
 
 /* ----------------- ICMP Functions ----------------- */
 
+/**
+ * @brief Add a buffer to a partial Internet checksum
+ * Chunks may be summed separately and combined with further calls as long
+ * as every chunk but the last starts at an even offset of the message.
+ * @param sum - partial sum so far (0 to start)
+ * @param data - bytes to add
+ * @param len - length in bytes
+ * @return folded 16-bit partial sum (not complemented)
+ */
+uint32_t icmpChecksumAdd(uint32_t sum, const void *data, uint32_t len);
+
+/**
+ * @brief Fold and complement a partial sum into a checksum field value
+ * @param sum - partial sum from icmpChecksumAdd (partial sums may be added)
+ * @return checksum
+ */
+uint16_t icmpChecksumFinish(uint32_t sum);
+
 /**
  * @brief Compute ICMP checksum (v4 / v6 payload only)
  * @param data - pointer to ICMP message
@@ -308,6 +326,16 @@ typedef struct sIcmp6RouterAdvert
  */
 uint16_t icmpChecksum(const void *data, uint32_t len);
 
+/**
+ * @brief Find the first byte where a received payload differs from the expected one
+ * Compares 16 bytes per step with SSE2 when the target has it.
+ * @param got - received payload
+ * @param expected - payload that was sent
+ * @param len - number of bytes to compare
+ * @return offset of the first difference, or len if both match
+ */
+uint32_t icmpPayloadDiff(const void *got, const void *expected, uint32_t len);
+
 /**
  * @brief Build ICMPv4 Echo Request packet
  * @param req - pointer to ICMPv4 Echo structure to fill
@@ -368,6 +396,18 @@ const tIcmp4Timestamp *icmp4ParseTimestamp(const void *data, uint32_t len);
 
 /* ----------------- ICMPv6 Functions ----------------- */
 
+/**
+ * @brief Partial checksum of the ICMPv6 pseudo-header
+ * @param src - pointer to source IPv6 address
+ * @param dst - pointer to destination IPv6 address
+ * @param icmpLen - ICMPv6 message length in bytes
+ * @return folded partial sum, to combine with icmpChecksumAdd
+ */
+uint32_t icmpv6PseudoSum(
+	const struct in6_addr	*src,
+	const struct in6_addr	*dst,
+	uint32_t				icmpLen);
+
 /**
  * @brief Compute ICMPv6 checksum
  * @param src - pointer to source IPv6 address
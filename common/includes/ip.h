@@ -328,6 +328,14 @@ static inline uint32_t ipNtohl(uint32_t x)
  */
 void printIpv4Header(const tIpHdr *hdr);
 
+/**
+ * @brief Print IPv6 header information in a human-readable format
+ * next_header is the protocol after the extension headers, as left by
+ * parseIp6HeaderFromBuffer
+ * @param hdr - pointer to IPv6 header
+ */
+void printIpv6Header(const tIp6Hdr *hdr);
+
 /* ------------------ IP Header Parsing ------------------ */
 
 /**
@@ -0,0 +1,109 @@
+#ifndef HAJ_PROBE_H
+#define HAJ_PROBE_H
+
+#include <stddef.h>
+
+#include "stdint.h"
+
+/* ----------------- Probe Header ----------------- */
+
+#define PROBE_MAGIC				0x484A5031u	/**< "HJP1" */
+#define PROBE_KEY_LEN			16			/**< SipHash key size */
+#define PROBE_HDR_LEN			24			/**< magic, extended seq, send time, tag */
+#define PROBE_HDR_COMPACT_LEN	8			/**< send time (us, 32-bit), tag (32-bit) */
+
+/**
+ * @brief Probe header carried at the start of the echo payload
+ * All fields are big-endian on the wire.
+ *
+ * Full form (payload >= PROBE_HDR_LEN):
+ *   0  magic    (4)  PROBE_MAGIC, rejects foreign payloads before hashing
+ *   4  seq      (4)  extended sequence, low 16 bits equal the ICMP sequence
+ *   8  sendNs   (8)  CLOCK_MONOTONIC send time in nanoseconds
+ *   16 tag      (8)  SipHash-2-4 of magic, seq, sendNs and the peer address
+ *
+ * Compact form (PROBE_HDR_COMPACT_LEN <= payload < PROBE_HDR_LEN):
+ *   0  sendUs   (4)  CLOCK_MONOTONIC send time in microseconds, truncated
+ *   4  tag      (4)  low half of SipHash-2-4 of the ICMP seq, sendUs and peer
+ */
+
+/**
+ * @brief Authenticated probe fields
+ * - seq: extended sequence number (ICMP sequence for the compact form)
+ * - rttNs: round-trip time in nanoseconds
+ */
+typedef struct sProbeInfo
+{
+	uint32_t	seq;
+	uint64_t	rttNs;
+} tProbeInfo;
+
+/**
+ * @brief SipHash-2-4
+ * @param key - 16-byte key
+ * @param data - message
+ * @param len - message length in bytes
+ * @return 64-bit tag
+ */
+uint64_t	sipHash24(const uint8_t *key, const void *data, size_t len);
+
+/**
+ * @brief Fill key with random bytes (getrandom, /dev/urandom as fallback)
+ * @param key - PROBE_KEY_LEN bytes to fill
+ * @return 0 on success, -1 on failure
+ */
+int			probeKeyGenerate(uint8_t *key);
+
+/**
+ * @brief Header size that fits in a payload of payloadLen bytes
+ * @param payloadLen - ICMP payload length
+ * @return PROBE_HDR_LEN, PROBE_HDR_COMPACT_LEN or 0 if no header fits
+ */
+uint32_t	probeHeaderLen(uint32_t payloadLen);
+
+/**
+ * @brief Write a probe header
+ * @param dst - payload start
+ * @param hdrLen - PROBE_HDR_LEN or PROBE_HDR_COMPACT_LEN
+ * @param key - PROBE_KEY_LEN bytes
+ * @param seq - extended sequence number
+ * @param sendNs - monotonic send time in nanoseconds
+ * @param peer - peer address bytes (4 or 16), binds the tag to the target
+ * @param peerLen - length of peer
+ * @return hdrLen, or 0 on error
+ */
+uint32_t	probeHeaderWrite(
+	void			*dst,
+	uint32_t		hdrLen,
+	const uint8_t	*key,
+	uint32_t		seq,
+	uint64_t		sendNs,
+	const void		*peer,
+	uint32_t		peerLen);
+
+/**
+ * @brief Authenticate a probe header and compute the RTT
+ * The magic is checked first so foreign payloads cost a single compare.
+ * @param src - reply payload start
+ * @param len - reply payload length
+ * @param hdrLen - header form expected (PROBE_HDR_LEN or PROBE_HDR_COMPACT_LEN)
+ * @param key - PROBE_KEY_LEN bytes
+ * @param wireSeq - ICMP sequence of the reply
+ * @param peer - peer address bytes the probe was sent to
+ * @param peerLen - length of peer
+ * @param nowNs - monotonic receive time in nanoseconds
+ * @param out - authenticated fields
+ * @return 0 if the header is ours, -1 otherwise
+ */
+int			probeHeaderRead(
+	const void		*src,
+	uint32_t		len,
+	uint32_t		hdrLen,
+	const uint8_t	*key,
+	uint16_t		wireSeq,
+	const void		*peer,
+	uint32_t		peerLen,
+	uint64_t		nowNs,
+	tProbeInfo		*out);
+
+#endif /* HAJ_PROBE_H */
@@ -2,8 +2,16 @@ COMMON_BUILD = build
 COMMON_DIR   = src
 
 COMMON_SRC = $(COMMON_DIR)/ip/print4.c \
+			 $(COMMON_DIR)/ip/print6.c \
 			 $(COMMON_DIR)/ip/utils.c \
 			 $(COMMON_DIR)/icmp/print.c \
 			 $(COMMON_DIR)/icmp/utils.c \
+			 $(COMMON_DIR)/icmp/verify.c \
+			 $(COMMON_DIR)/probe/header.c \
+			 $(COMMON_DIR)/probe/siphash.c \
 
 COMMON_OBJ = $(COMMON_SRC:$(COMMON_DIR)/%.c=$(COMMON_BUILD)/%.o)
+
+BENCH_DIR  = bench
+BENCH_SRC  = $(BENCH_DIR)/codec.c
+BENCH_NAME = bench_common
@@ -3,24 +3,51 @@
 #include "../../includes/ip.h"
 #include "../../includes/icmp.h"
 
-uint16_t icmpChecksum(const void *data, uint32_t len) {
-	uint32_t sum = 0;
-	const uint16_t *ptr = (const uint16_t *)data;
+uint32_t
+icmpChecksumAdd(uint32_t sum, const void *data, uint32_t len)
+{
+	const unsigned char	*ptr = (const unsigned char *)data;
+	uint64_t			acc = sum;
+	uint32_t			word;
+	uint16_t			last;
 
-	while (len > 1) {
-		sum += *ptr++;	/* Add 16-bit words */
+	/* 32-bit loads into a 64-bit accumulator, folded once at the end */
+	while (len >= 4)
+	{
+		memcpy(&word, ptr, sizeof(word));
+		acc += word;
+		ptr += 4;
+		len -= 4;
+	}
+	if (len >= 2)
+	{
+		memcpy(&last, ptr, sizeof(last));
+		acc += last;
+		ptr += 2;
 		len -= 2;
 	}
-
 	if (len == 1)
-		sum += *(const uint8_t *)ptr << 8;	/* Add remaining byte */
+	{
+		/* pad the trailing byte with zero in memory order */
+		last = 0;
+		memcpy(&last, ptr, 1);
+		acc += last;
+	}
+	while (acc >> 16)
+		acc = (acc & 0xFFFF) + (acc >> 16);
+	return ((uint32_t)acc);
+}
 
-	// Fold 32-bit sum to 16 bits
-	while (sum >> 16) {
+uint16_t
+icmpChecksumFinish(uint32_t sum)
+{
+	while (sum >> 16)
 		sum = (sum & 0xFFFF) + (sum >> 16);
-	}
+	return ((uint16_t)(~sum));
+}
 
-	return (uint16_t)(~sum);
+uint16_t icmpChecksum(const void *data, uint32_t len) {
+	return (icmpChecksumFinish(icmpChecksumAdd(0, data, len)));
 }
 
 /**
@@ -134,20 +161,16 @@ icmp4ParseTimestamp(const void *data, uint32_t len)
 
 /* ----------------- ICMP V6 ----------------- */
 
-uint16_t
-icmpv6Checksum(
+uint32_t
+icmpv6PseudoSum(
 	const struct in6_addr	*src,
 	const struct in6_addr	*dst,
-	const void				*icmp,
 	uint32_t				icmpLen)
 {
-	uint32_t		sum;
-	uint32_t		len;
-	const uint16_t	*ptr;
-	uint32_t		tmp;
-	uint8_t			buf[40]; /* pseudo-header */
+	uint8_t		buf[40]; /* pseudo-header */
+	uint32_t	tmp;
 
-	if (!src || !dst || !icmp)
+	if (!src || !dst)
 		return (0);
 
 	memset(buf, 0, sizeof(buf));
@@ -158,32 +181,21 @@ icmpv6Checksum(
 	memcpy(buf + 32, &tmp, 4);
 	buf[39] = IP_PROTO_ICMPV6;
 
-	sum = 0;
-	ptr = (const uint16_t *)buf;
-	len = sizeof(buf);
-
-	while (len > 1)
-	{
-		sum += *ptr++;
-		len -= 2;
-	}
-
-	ptr = (const uint16_t *)icmp;
-	len = icmpLen;
-
-	while (len > 1)
-	{
-		sum += *ptr++;
-		len -= 2;
-	}
-
-	if (len == 1)
-		sum += (*(const uint8_t *)ptr << 8);
+	return (icmpChecksumAdd(0, buf, sizeof(buf)));
+}
 
-	while (sum >> 16)
-		sum = (sum & 0xFFFF) + (sum >> 16);
+uint16_t
+icmpv6Checksum(
+	const struct in6_addr	*src,
+	const struct in6_addr	*dst,
+	const void				*icmp,
+	uint32_t				icmpLen)
+{
+	if (!src || !dst || !icmp)
+		return (0);
 
-	return ((uint16_t)(~sum));
+	return (icmpChecksumFinish(
+		icmpChecksumAdd(icmpv6PseudoSum(src, dst, icmpLen), icmp, icmpLen)));
 }
 
 static void
@@ -0,0 +1,47 @@
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+#include "../../includes/icmp.h"
+
+uint32_t
+icmpPayloadDiff(const void *got, const void *expected, uint32_t len)
+{
+	const unsigned char	*a = (const unsigned char *)got;
+	const unsigned char	*b = (const unsigned char *)expected;
+	uint32_t			i = 0;
+
+	if (!got || !expected)
+		return (0);
+#if defined(__SSE2__)
+	/* 16 bytes per step: compare, then locate the first zero bit of the mask */
+	while (i + 16 <= len)
+	{
+		__m128i		va = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i		vb = _mm_loadu_si128((const __m128i *)(b + i));
+		unsigned	mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+
+		if (mask != 0xFFFF)
+			return (i + (uint32_t)__builtin_ctz(~mask));
+		i += 16;
+	}
+#else
+	/* word at a time, the byte scan below finds the exact offset */
+	while (i + sizeof(uint64_t) <= len)
+	{
+		uint64_t	wa;
+		uint64_t	wb;
+
+		memcpy(&wa, a + i, sizeof(wa));
+		memcpy(&wb, b + i, sizeof(wb));
+		if (wa != wb)
+			break;
+		i += sizeof(uint64_t);
+	}
+#endif
+	while (i < len && a[i] == b[i])
+		i++;
+	return (i);
+}
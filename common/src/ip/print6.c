@@ -0,0 +1,68 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+
+#include "../../includes/ip.h"
+
+#define IP6_TAB_HEADER "\n\
+Oct - Bits 0                       1                      2                       3\n\
+           0  1  2  3  4  5  6  7  8  9 10 11 12 13 14 15 16 17 18 19 20 21 22 23 24 25 26 27 28 29 30 31\n\
+          ┌───────────┬───────────────────────┬───────────────────────────────────────────────────────────┐\n"
+
+static const char *
+ip6NextHdrToStr(uint8_t next)
+{
+	switch (next)
+	{
+		case 0:  return "Hop-by-Hop";
+		case IP_PROTO_TCP: return "TCP";
+		case IP_PROTO_UDP: return "UDP";
+		case 43: return "Routing";
+		case 44: return "Fragment";
+		case 50: return "ESP";
+		case 51: return "AH";
+		case 60: return "Dest Opts";
+		case IP_PROTO_ICMPV6: return "ICMPv6";
+		default: return "UNKNOWN";
+	}
+}
+
+static const char *
+ipV6ToStr(const uint8_t addr[16])
+{
+	static char	str[INET6_ADDRSTRLEN];
+
+	if (!inet_ntop(AF_INET6, addr, str, sizeof(str)))
+		return ("?");
+	return (str);
+}
+
+void printIpv6Header(const tIp6Hdr *hdr)
+{
+	printf("IPv6 Header:\n%s", IP6_TAB_HEADER);
+	printf("          │  Version  │     Traffic Class     │                        Flow Label                         │\n");
+	printf("  0 -   0 ├───────────┼───────────────────────┼───────────────────────────────────────────────────────────┤\n");
+	printf("          │     %-3u   │ DSCP:0x%02X  ECN:0x%02X   │                         0x%05X                           │\n",
+		hdr->version,
+		hdr->traffic_class >> 2,
+		hdr->traffic_class & 0x03,
+		hdr->flow_label);
+	printf("          ├───────────┴───────────────────────┴───────────┬───────────────────────┬───────────────────────┤\n");
+	printf("          │                Payload Length                 │      Next Header      │       Hop Limit       │\n");
+	printf("  4 -  32 ├───────────────────────────────────────────────┼───────────────────────┼───────────────────────┤\n");
+	printf("          │                 %-5u bytes                   │   0x%02X - %-10s   │         %-3u           │\n",
+		hdr->payload_len,
+		hdr->next_header,
+		ip6NextHdrToStr(hdr->next_header),
+		hdr->hop_limit);
+	printf("          ├───────────────────────────────────────────────┴───────────────────────┴───────────────────────┤\n");
+	printf("          │                                        Source Address                                         │\n");
+	printf("  8 -  64 ├───────────────────────────────────────────────────────────────────────────────────────────────┤\n");
+	printf("          │                          %-39s                              │\n",
+		ipV6ToStr(hdr->saddr));
+	printf("          ├───────────────────────────────────────────────────────────────────────────────────────────────┤\n");
+	printf("          │                                     Destination Address                                       │\n");
+	printf(" 24 - 192 ├───────────────────────────────────────────────────────────────────────────────────────────────┤\n");
+	printf("          │                          %-39s                              │\n",
+		ipV6ToStr(hdr->daddr));
+	printf("          └───────────────────────────────────────────────────────────────────────────────────────────────┘\n");
+}
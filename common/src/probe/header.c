@@ -0,0 +1,174 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+#include "../../includes/probe.h"
+
+#define PROBE_PEER_MAX	16	/**< IPv6 address */
+
+static void
+putBe32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static uint32_t
+getBe32(const uint8_t *p)
+{
+	return (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+		| ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+static void
+putBe64(uint8_t *p, uint64_t v)
+{
+	putBe32(p, (uint32_t)(v >> 32));
+	putBe32(p + 4, (uint32_t)v);
+}
+
+static uint64_t
+getBe64(const uint8_t *p)
+{
+	return (((uint64_t)getBe32(p) << 32) | getBe32(p + 4));
+}
+
+/**
+ * @brief Tag the authenticated bytes of a header followed by the peer address
+ * @param key - PROBE_KEY_LEN bytes
+ * @param hdr - header bytes covered by the tag
+ * @param hdrLen - length of hdr
+ * @param peer - peer address bytes
+ * @param peerLen - length of peer (at most PROBE_PEER_MAX)
+ * @return 64-bit tag
+ */
+static uint64_t
+probeTag(const uint8_t *key, const uint8_t *hdr, uint32_t hdrLen,
+	const void *peer, uint32_t peerLen)
+{
+	uint8_t	msg[PROBE_HDR_LEN + PROBE_PEER_MAX];
+
+	if (peerLen > PROBE_PEER_MAX)
+		peerLen = PROBE_PEER_MAX;
+	memcpy(msg, hdr, hdrLen);
+	if (peer && peerLen)
+		memcpy(msg + hdrLen, peer, peerLen);
+	else
+		peerLen = 0;
+	return (sipHash24(key, msg, hdrLen + peerLen));
+}
+
+int
+probeKeyGenerate(uint8_t *key)
+{
+	ssize_t	n;
+	int		fd;
+
+	if (!key)
+		return (-1);
+	n = getrandom(key, PROBE_KEY_LEN, 0);
+	if (n == PROBE_KEY_LEN)
+		return (0);
+	fd = open("/dev/urandom", O_RDONLY);
+	if (fd < 0)
+		return (-1);
+	n = read(fd, key, PROBE_KEY_LEN);
+	close(fd);
+	return (n == PROBE_KEY_LEN ? 0 : -1);
+}
+
+uint32_t
+probeHeaderLen(uint32_t payloadLen)
+{
+	if (payloadLen >= PROBE_HDR_LEN)
+		return (PROBE_HDR_LEN);
+	if (payloadLen >= PROBE_HDR_COMPACT_LEN)
+		return (PROBE_HDR_COMPACT_LEN);
+	return (0);
+}
+
+uint32_t
+probeHeaderWrite(
+	void			*dst,
+	uint32_t		hdrLen,
+	const uint8_t	*key,
+	uint32_t		seq,
+	uint64_t		sendNs,
+	const void		*peer,
+	uint32_t		peerLen)
+{
+	uint8_t		*p = (uint8_t *)dst;
+	uint8_t		covered[8];
+
+	if (!dst || !key)
+		return (0);
+	if (hdrLen == PROBE_HDR_LEN)
+	{
+		putBe32(p, PROBE_MAGIC);
+		putBe32(p + 4, seq);
+		putBe64(p + 8, sendNs);
+		putBe64(p + 16, probeTag(key, p, 16, peer, peerLen));
+		return (hdrLen);
+	}
+	if (hdrLen == PROBE_HDR_COMPACT_LEN)
+	{
+		/* the tag also covers the ICMP sequence, which is not in the header */
+		putBe32(p, (uint32_t)(sendNs / 1000));
+		putBe32(covered, seq & 0xFFFF);
+		memcpy(covered + 4, p, 4);
+		putBe32(p + 4, (uint32_t)probeTag(key, covered, 8, peer, peerLen));
+		return (hdrLen);
+	}
+	return (0);
+}
+
+int
+probeHeaderRead(
+	const void		*src,
+	uint32_t		len,
+	uint32_t		hdrLen,
+	const uint8_t	*key,
+	uint16_t		wireSeq,
+	const void		*peer,
+	uint32_t		peerLen,
+	uint64_t		nowNs,
+	tProbeInfo		*out)
+{
+	const uint8_t	*p = (const uint8_t *)src;
+	uint8_t			covered[8];
+	uint64_t		sendNs;
+	uint32_t		sendUs;
+
+	if (!src || !key || !out || len < hdrLen)
+		return (-1);
+	if (hdrLen == PROBE_HDR_LEN)
+	{
+		if (getBe32(p) != PROBE_MAGIC)
+			return (-1);
+		out->seq = getBe32(p + 4);
+		if ((out->seq & 0xFFFF) != wireSeq)
+			return (-1);
+		if (getBe64(p + 16) != probeTag(key, p, 16, peer, peerLen))
+			return (-1);
+		sendNs = getBe64(p + 8);
+		out->rttNs = nowNs >= sendNs ? nowNs - sendNs : 0;
+		return (0);
+	}
+	if (hdrLen == PROBE_HDR_COMPACT_LEN)
+	{
+		putBe32(covered, wireSeq);
+		memcpy(covered + 4, p, 4);
+		if (getBe32(p + 4) != (uint32_t)probeTag(key, covered, 8, peer, peerLen))
+			return (-1);
+		/* 32-bit microseconds wrap every ~71 minutes, far above any RTT */
+		sendUs = getBe32(p);
+		out->seq = wireSeq;
+		out->rttNs = (uint64_t)(uint32_t)((uint32_t)(nowNs / 1000) - sendUs) * 1000;
+		return (0);
+	}
+	return (-1);
+}
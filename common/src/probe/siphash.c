@@ -0,0 +1,67 @@
+#include <string.h>
+
+#include "../../includes/probe.h"
+
+#define ROTL64(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3)				\
+	do {										\
+		v0 += v1; v1 = ROTL64(v1, 13);			\
+		v1 ^= v0; v0 = ROTL64(v0, 32);			\
+		v2 += v3; v3 = ROTL64(v3, 16);			\
+		v3 ^= v2;								\
+		v0 += v3; v3 = ROTL64(v3, 21);			\
+		v3 ^= v0;								\
+		v2 += v1; v1 = ROTL64(v1, 17);			\
+		v1 ^= v2; v2 = ROTL64(v2, 32);			\
+	} while (0)
+
+/**
+ * @brief Load 8 little-endian bytes
+ */
+static uint64_t
+loadLe64(const uint8_t *p)
+{
+	return ((uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16)
+		| ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40)
+		| ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56));
+}
+
+uint64_t
+sipHash24(const uint8_t *key, const void *data, size_t len)
+{
+	const uint8_t	*in = (const uint8_t *)data;
+	uint64_t		k0 = loadLe64(key);
+	uint64_t		k1 = loadLe64(key + 8);
+	uint64_t		v0 = 0x736f6d6570736575ULL ^ k0;
+	uint64_t		v1 = 0x646f72616e646f6dULL ^ k1;
+	uint64_t		v2 = 0x6c7967656e657261ULL ^ k0;
+	uint64_t		v3 = 0x7465646279746573ULL ^ k1;
+	uint64_t		m;
+	uint8_t			last[8];
+	size_t			left;
+
+	for (left = len; left >= 8; left -= 8, in += 8)
+	{
+		m = loadLe64(in);
+		v3 ^= m;
+		SIPROUND(v0, v1, v2, v3);
+		SIPROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+	memset(last, 0, sizeof(last));
+	memcpy(last, in, left);
+	last[7] = (uint8_t)len;
+	m = loadLe64(last);
+	v3 ^= m;
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	v0 ^= m;
+
+	v2 ^= 0xff;
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	return (v0 ^ v1 ^ v2 ^ v3);
+}
@@ -0,0 +1,278 @@
+#!/usr/bin/env bash
+# Measurement accuracy suite of hajping.
+# Known impairments (delay, jitter, loss, duplication, reordering) are
+# injected on the reply path, either with tc netem in a network namespace
+# or with the hajsim TUN responder when netem is not available. Each run
+# compares what hajping reports (RTT percentiles from the per-reply times,
+# loss, duplicates, out of order replies) with what was injected, then
+# checks hajping's own summary (the text statistics and the --output jsonl
+# summary record: received, duplicates, p90 and jitter) the same way. A
+# rate sweep shows how the RTT error grows with the probing rate.
+
+set -u
+
+GREEN="\033[32m"; RED="\033[31m"; YELLOW="\033[33m"; CYAN="\033[36m"; RESET="\033[0m"
+
+usage()
+{
+	printf "${RED}Usage: %s [-B auto|netem|sim] [-s hajsim] [-o results.tsv] [-n probes] [-t rtt-tolerance-ms] <hajping>${RESET}\n" "$0"
+	exit 1
+}
+
+BACKEND="auto"
+SIM=""
+OUT="accuracy-results.tsv"
+PROBES=1000
+RTT_TOL=1.0
+while getopts "B:s:o:n:t:" opt; do
+	case "$opt" in
+		B) BACKEND="$OPTARG" ;;
+		s) SIM="$(realpath "$OPTARG")" ;;
+		o) OUT="$OPTARG" ;;
+		n) PROBES="$OPTARG" ;;
+		t) RTT_TOL="$OPTARG" ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 1 ] || usage
+EXE="$(realpath "$1")"
+[ -x "$EXE" ] || usage
+[ "$(id -u)" -eq 0 ] || { printf "${RED}needs root (namespaces, TUN, sub-200ms intervals)${RESET}\n"; exit 1; }
+
+TMP="$(mktemp -d)"
+NS="hajacc$$"
+DEV="hja$$"
+HAVE_NS=0
+SIM_PID=""
+FAILED=0
+
+teardown_ns()
+{
+	[ "$HAVE_NS" -eq 1 ] && ip netns del "$NS" 2>/dev/null
+	ip link del "$DEV" 2>/dev/null
+	HAVE_NS=0
+}
+
+cleanup()
+{
+	[ -n "$SIM_PID" ] && kill -INT "$SIM_PID" 2>/dev/null && wait "$SIM_PID"
+	teardown_ns
+	rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+# profiles: name delay_ms jitter_ms loss% dup% reorder% interval_s
+# jitter stays below interval / 2 so that the spread alone never reorders;
+# reorder needs interval < delay < 2 * interval: an early reply then
+# overtakes exactly the previous one, so p(1 - p) of the replies are out of order
+PROFILES="delay 10 0 0 0 0 0.005
+jitter 10 2 0 0 0 0.005
+loss 1 0 10 0 0 0.005
+dup 1 0 0 10 0 0.005
+reorder 8 0 0 0 25 0.005"
+# rate sweep of the delay profile: probing interval in seconds
+SWEEP="0.05 0.005 0.001 0.0002"
+
+# veth to a namespace, netem on its egress delays the replies
+setup_netem()
+{
+	command -v tc >/dev/null || return 1
+	ip netns add "$NS" 2>/dev/null || return 1
+	HAVE_NS=1
+	ip link add "$DEV" type veth peer name eth0 netns "$NS" || return 1
+	ip addr add 198.18.2.1/30 dev "$DEV"
+	ip link set "$DEV" up
+	ip -n "$NS" link set lo up
+	ip -n "$NS" link set eth0 up
+	ip -n "$NS" addr add 198.18.2.2/30 dev eth0
+	tc -n "$NS" qdisc add dev eth0 root netem delay 1ms 2>/dev/null
+}
+
+# one hajsim prefix per profile, 198.18.(128 + i).0/24
+setup_sim()
+{
+	local -a rules=()
+	local i=0 name delay jitter loss dup reorder interval
+
+	[ -n "$SIM" ] && [ -x "$SIM" ] || return 1
+	while read -r name delay jitter loss dup reorder interval; do
+		rules+=("198.18.$((128 + i)).0/24,delay=${delay}ms,jitter=${jitter}ms,loss=$loss,dup=$dup,reorder=$reorder")
+		i=$((i + 1))
+	done <<< "$PROFILES"
+	"$SIM" -d "$DEV" "${rules[@]}" > "$TMP/sim.out" 2>&1 &
+	SIM_PID=$!
+	for _ in 1 2 3 4 5 6 7 8 9 10; do
+		ip link show "$DEV" 2>/dev/null | grep -q UP && break
+		sleep 0.1
+	done
+	ip route add 198.18.128.0/17 dev "$DEV"
+}
+
+# target of a profile, after netem has been set for it
+# $1 - profile index, $2... - profile fields
+prepare()
+{
+	local idx="$1" delay="$3" jitter="$4" loss="$5" dup="$6" reorder="$7"
+	local -a args=(delay "${delay}ms")
+
+	if [ "$BACKEND" = "sim" ]; then
+		echo "198.18.$((128 + idx)).1"
+		return
+	fi
+	[ "$jitter" != 0 ] && args+=("${jitter}ms")
+	[ "$reorder" != 0 ] && args+=(reorder "$reorder%")
+	[ "$loss" != 0 ] && args+=(loss "$loss%")
+	[ "$dup" != 0 ] && args+=(duplicate "$dup%")
+	tc -n "$NS" qdisc replace dev eth0 root netem "${args[@]}"
+	echo "198.18.2.2"
+}
+
+# measured values of one hajping run, from its reply lines:
+# sent received (without duplicates) dups reordered, then p10 p50 p90 (ms)
+measure()
+{
+	local out="$1"
+
+	awk '/icmp_seq=/ {
+			for (i = 1; i <= NF; i++) {
+				if ($i ~ /^icmp_seq=/) seq = substr($i, 10) + 0
+				if ($i ~ /^time=/) t = substr($i, 6) + 0
+			}
+			if (/DUP!/) { dup++; next }
+			if (n++ && seq < max) reord++
+			if (seq > max) max = seq
+			print t > "/dev/stderr"
+		}
+		/packets transmitted/ { sent = $1 }
+		END { print sent + 0, n + 0, dup + 0, reord + 0 }' "$out" 2> "$TMP/rtt"
+	sort -n "$TMP/rtt" | awk '{ v[NR] = $1 }
+		function pct(p,  i) { i = int(NR * p / 100 + 0.5); if (i < 1) i = 1; return v[i] }
+		END { if (NR) printf "%.3f %.3f %.3f\n", pct(10), pct(50), pct(90); else print "NA NA NA" }'
+}
+
+# hajping's own accounting of one run: sent, received and duplicates of the
+# text statistics, then received, duplicates, p90 and jitter (ms) of the
+# jsonl summary record
+summary()
+{
+	local out="$1" records="$2"
+
+	awk '/packets transmitted/ {
+			sent = $1; recv = $4; dups = 0
+			for (i = 1; i < NF; i++)
+				if ($(i + 1) ~ /^duplicates/) { dups = $i; gsub(/\+/, "", dups) }
+		}
+		END { print sent + 0, recv + 0, dups + 0 }' "$out"
+	awk 'function field(k,  m) {
+			if (!match($0, "\"" k "\":[0-9.]+")) return "NA"
+			return substr($0, RSTART + length(k) + 3, RLENGTH - length(k) - 3)
+		}
+		/"type":"summary"/ {
+			r = field("received"); d = field("duplicates")
+			p90 = field("rtt_p90_ns"); jit = field("jitter_ns")
+		}
+		END {
+			if (r == "") { print "NA NA NA NA"; exit }
+			printf "%s %s %s %s\n", r, d, p90 == "NA" ? p90 : sprintf("%.3f", p90 / 1e6),
+				jit == "NA" ? jit : sprintf("%.3f", jit / 1e6)
+		}' "$records"
+}
+
+# check one run against the profile, append its row
+# $1 - label, $2 - probes, $3... - profile fields
+check()
+{
+	local label="$1" count="$2" name="$3" delay="$4" jitter="$5" loss="$6" dup="$7" reorder="$8"
+	local sent recv dups reord p10 p50 p90 tsent trecv tdups srecv sdups sp90 sjit
+
+	{ read -r sent recv dups reord; read -r p10 p50 p90; } < <(measure "$TMP/out")
+	{ read -r tsent trecv tdups; read -r srecv sdups sp90 sjit; } < <(summary "$TMP/out" "$TMP/records")
+	awk -v label="$label" -v be="$BACKEND" -v n="$count" -v s="$sent" -v r="$recv" -v d="$dups" -v o="$reord" \
+		-v p10="$p10" -v p50="$p50" -v p90="$p90" -v delay="$delay" -v jitter="$jitter" \
+		-v ts="$tsent" -v tr="$trecv" -v td="$tdups" -v sr="$srecv" -v sd="$sdups" -v sp90="$sp90" -v sjit="$sjit" \
+		-v loss="$loss" -v dup="$dup" -v reorder="$reorder" -v tol="$RTT_TOL" 'BEGIN {
+		ok = 1; why = ""
+		# binomial tolerance: 3 sigma plus half a point
+		el = loss / 100; ml = s ? 1 - r / s : 1
+		if (abs(ml - el) > 3 * sqrt(el * (1 - el) / s) + 0.005) { ok = 0; why = why " loss" }
+		ed = dup / 100; md = r ? d / r : 0
+		if (abs(md - ed) > 3 * sqrt(ed * (1 - ed) / (r ? r : 1)) + 0.005) { ok = 0; why = why " dup" }
+		eo = reorder / 100 * (1 - reorder / 100); mo = r ? o / r : 0
+		if (abs(mo - eo) > 3 * sqrt(eo * (1 - eo) / (r ? r : 1)) + 0.005) { ok = 0; why = why " reorder" }
+		# uniform jitter: p-th percentile at delay - jitter + 2 * jitter * p
+		e10 = delay - jitter * 0.8; e50 = delay; e90 = delay + jitter * 0.8
+		err = 0
+		if (reorder == 0 && p50 != "NA") {
+			err = max3(abs(p10 - e10), abs(p50 - e50), abs(p90 - e90))
+			if (err > tol) { ok = 0; why = why " rtt" }
+		}
+		# the summary: text and record agree, and with the reply lines
+		# (received counts the duplicates)
+		if (sr == "NA" || ts != s || tr != sr || td != sd || sr != r + d || sd != d) {
+			ok = 0; why = why " summary"
+		}
+		sa = sr - sd; sl = ts ? 1 - sa / ts : 1
+		if (abs(sl - el) > 3 * sqrt(el * (1 - el) / (ts ? ts : 1)) + 0.005) { ok = 0; why = why " summary-loss" }
+		sdr = sa ? sd / sa : 0
+		if (abs(sdr - ed) > 3 * sqrt(ed * (1 - ed) / (sa ? sa : 1)) + 0.005) { ok = 0; why = why " summary-dup" }
+		# p90 is the upper bound of a power of two microseconds bucket;
+		# RFC 3550 jitter of a uniform +- jitter spread averages 2 / 3 of it
+		ej = jitter * 2 / 3
+		if (reorder == 0) {
+			if (sp90 == "NA" || e90 <= sp90 / 2 - tol || e90 > sp90 + tol) { ok = 0; why = why " summary-p90" }
+			if (sjit == "NA" || abs(sjit - ej) > tol) { ok = 0; why = why " summary-jitter" }
+		}
+		printf "%s\t%s\t%d\t%d\t%.2f\t%.2f\t%d\t%.2f\t%d\t%.2f\t%s/%s/%s\t%.1f/%.1f/%.1f\t%.3f\t%s/%s\t%s\t%s\t%.3f\t%s\n",
+			label, be, s, r, ml * 100, el * 100, d, ed * r, o, eo * r, p10, p50, p90, e10, e50, e90, err,
+			sr, sd, sp90, sjit, ej, ok ? "PASS" : "FAIL" why
+	}
+	function abs(x) { return x < 0 ? -x : x }
+	function max3(a, b, c) { return a > b ? (a > c ? a : c) : (b > c ? b : c) }' >> "$OUT"
+	if tail -1 "$OUT" | grep -q "PASS$"; then
+		printf "${GREEN}%-22s${RESET} %s\n" "$label" "$(tail -1 "$OUT" | cut -f3- | tr '\t' ' ')"
+	else
+		FAILED=1
+		printf "${RED}%-22s${RESET} %s\n" "$label" "$(tail -1 "$OUT" | cut -f3- | tr '\t' ' ')"
+	fi
+}
+
+# $1 - label, $2 - profile index, $3 - interval, $4 - probes, $5... - profile fields
+run()
+{
+	local label="$1" idx="$2" interval="$3" count="$4" target
+	shift 4
+
+	target="$(prepare "$idx" "$@")"
+	# not -q: the percentiles and the order come from the reply lines;
+	# with --output the text goes to stderr, the records to stdout
+	"$EXE" -n -W 1 -i "$interval" -c "$count" --output jsonl "$target" > "$TMP/records" 2> "$TMP/out"
+	check "$label" "$count" "$@"
+}
+
+case "$BACKEND" in
+	auto) if setup_netem; then BACKEND=netem; elif teardown_ns; setup_sim; then BACKEND=sim; else BACKEND=none; fi ;;
+	netem) setup_netem || BACKEND=none ;;
+	sim) setup_sim || BACKEND=none ;;
+	*) usage ;;
+esac
+if [ "$BACKEND" = "none" ]; then
+	printf "${RED}no impairment backend: tc netem is missing and no usable -s hajsim was given${RESET}\n"
+	exit 1
+fi
+
+printf "${CYAN}hajping accuracy: %s, %s backend, %d probes, rtt tolerance %s ms${RESET}\n" "$EXE" "$BACKEND" "$PROBES" "$RTT_TOL"
+printf "run\tbackend\tsent\treceived\tloss_pct\texp_loss_pct\tdups\texp_dups\treordered\texp_reordered\tp10/p50/p90_ms\texp_p10/p50/p90_ms\trtt_err_ms\tsummary_received/dups\tsummary_p90_ms\tsummary_jitter_ms\texp_jitter_ms\tverdict\n" > "$OUT"
+idx=0
+while read -r name delay jitter loss dup reorder interval; do
+	run "$name" "$idx" "$interval" "$PROBES" "$name" "$delay" "$jitter" "$loss" "$dup" "$reorder"
+	idx=$((idx + 1))
+done <<< "$PROFILES"
+for interval in $SWEEP; do
+	count="$PROBES"
+	# keep slow runs around five seconds
+	awk -v i="$interval" -v n="$count" 'BEGIN { exit !(n * i > 5) }' && count=$(awk -v i="$interval" 'BEGIN { print int(5 / i) }')
+	run "rate-$(awk -v i="$interval" 'BEGIN { print int(1 / i + 0.5) }')pps" 0 "$interval" "$count" $(head -1 <<< "$PROFILES")
+done
+printf "${CYAN}results written to %s${RESET}\n" "$OUT"
+exit "$FAILED"
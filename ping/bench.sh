@@ -0,0 +1,181 @@
+#!/usr/bin/env bash
+# Loopback / network namespace throughput benchmark of hajping.
+# Every case reports achieved send / receive rates, CPU and syscalls per
+# probe and the average RTT (the probing overhead on loopback) as one TSV
+# row; with -b the rows are compared to a stored baseline. With -s the
+# hajsim TUN responder answers for thousands of simulated hosts.
+
+set -u
+
+GREEN="\033[32m"; RED="\033[31m"; YELLOW="\033[33m"; CYAN="\033[36m"; RESET="\033[0m"
+
+usage()
+{
+	printf "${RED}Usage: %s [-o results.tsv] [-b baseline.tsv] [-t tolerance%%] [-n probes] [-s hajsim] <hajping>${RESET}\n" "$0"
+	exit 1
+}
+
+OUT="bench-results.tsv"
+BASELINE=""
+TOLERANCE=20
+PROBES=10000
+SIM=""
+while getopts "o:b:t:n:s:" opt; do
+	case "$opt" in
+		o) OUT="$OPTARG" ;;
+		b) BASELINE="$OPTARG" ;;
+		t) TOLERANCE="$OPTARG" ;;
+		n) PROBES="$OPTARG" ;;
+		s) SIM="$(realpath "$OPTARG")" ;;
+		*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -eq 1 ] || usage
+EXE="$(realpath "$1")"
+[ -x "$EXE" ] || usage
+
+COLUMNS_TSV="case\tsent\treceived\tseconds\tsend_pps\trecv_pps\tcpu_us_per_probe\tsyscalls_per_probe\trtt_avg_ms"
+TMP="$(mktemp -d)"
+chmod 755 "$TMP"
+NS="hajbench$$"
+HAVE_NS=0
+SIM_PID=""
+
+cleanup()
+{
+	[ -n "$SIM_PID" ] && kill -INT "$SIM_PID" 2>/dev/null && wait "$SIM_PID"
+	[ "$HAVE_NS" -eq 1 ] && ip netns del "$NS" 2>/dev/null
+	ip link del "hjb$$" 2>/dev/null
+	rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+# target lists: consecutive addresses of a /16
+# $1 - file, $2 - first two octets, $3 - count, $4 - first third octet (1)
+make_list()
+{
+	awk -v p="$2" -v n="$3" -v o="${4:-1}" 'BEGIN { for (i = 0; i < n; i++) printf "%s.%d.%d\n", p, o + int(i / 250), 1 + i % 250 }' > "$1"
+}
+
+# veth pair to a namespace answering for 198.18.0.2, 198.19.0.0/16 and
+# 2001:2::2 (RFC 2544 / RFC 5180 benchmarking ranges)
+setup_ns()
+{
+	[ "$(id -u)" -eq 0 ] && command -v ip >/dev/null || return 1
+	ip netns add "$NS" 2>/dev/null || return 1
+	HAVE_NS=1
+	ip link add "hjb$$" type veth peer name eth0 netns "$NS" || return 1
+	ip addr add 198.18.0.1/30 dev "hjb$$"
+	ip addr add 2001:2::1/64 dev "hjb$$" nodad
+	ip link set "hjb$$" up
+	ip route add 198.19.0.0/16 via 198.18.0.2
+	ip -n "$NS" link set lo up
+	ip -n "$NS" link set eth0 up
+	ip -n "$NS" addr add 198.18.0.2/30 dev eth0
+	ip -n "$NS" addr add 2001:2::2/64 dev eth0 nodad
+	ip -n "$NS" route add local 198.19.0.0/16 dev lo
+	ping -c 1 -W 1 198.18.0.2 >/dev/null 2>&1 || "$EXE" -c 1 -W 1 198.18.0.2 >/dev/null 2>&1
+}
+
+# hajsim on its own TUN device answering 198.18.64.0/18 and 2001:2:0:1::/64
+setup_sim()
+{
+	local dev="hjs$$"
+
+	[ -n "$SIM" ] && [ -x "$SIM" ] && [ "$(id -u)" -eq 0 ] || return 1
+	"$SIM" -d "$dev" 198.18.64.0/18 2001:2:0:1::/64 > "$TMP/sim.out" 2>&1 &
+	SIM_PID=$!
+	for _ in 1 2 3 4 5 6 7 8 9 10; do
+		ip link show "$dev" 2>/dev/null | grep -q UP && break
+		sleep 0.1
+	done
+	ip route add 198.18.64.0/18 dev "$dev" && ip -6 route add 2001:2:0:1::/64 dev "$dev"
+}
+
+# syscalls of one run, NA without strace
+# $@ - command
+count_syscalls()
+{
+	command -v strace >/dev/null || { echo NA; return; }
+	strace -f -c -o "$TMP/strace" "$@" >/dev/null 2>&1
+	awk '$NF == "total" { print $(NF - 2) }' "$TMP/strace"
+}
+
+# run one case and append its row
+# $1 - case name, $2... - hajping arguments (may start with "user" to drop privileges)
+run_case()
+{
+	local name="$1"; shift
+	local -a cmd=("$EXE")
+	local times sent recv rtt secs cpu sys
+
+	if [ "$1" = "user" ]; then
+		shift
+		command -v setpriv >/dev/null && [ "$(id -u)" -eq 0 ] || { printf "${YELLOW}%-20s skipped (needs root and setpriv)${RESET}\n" "$name"; return; }
+		cmd=(setpriv --reuid=65534 --regid=65534 --clear-groups "$EXE")
+	fi
+	TIMEFORMAT="%R %U %S"
+	times=$( { time "${cmd[@]}" "$@" > "$TMP/out" 2>&1; } 2>&1 )
+	read -r secs cpu sys <<< "$times"
+	read -r sent recv <<< "$(awk '/packets transmitted/ {
+			for (i = 1; i <= NF; i++) { if ($(i + 1) ~ /^packets/) s += $i; if ($(i + 1) ~ /^received/) r += $i }
+		} END { print s + 0, r + 0 }' "$TMP/out")"
+	rtt=$(awk -F'[/ ]+' '/round-trip/ && !/^ / { print $(NF - 3) } /^IPv[46]: .*avg/ { n++; a += $(NF - 1) } END { if (n) printf "%.3f\n", a / n }' "$TMP/out" | tail -1)
+	if [ "${sent:-0}" -eq 0 ]; then
+		printf "${RED}%-20s failed:${RESET} %s\n" "$name" "$(head -1 "$TMP/out")"
+		return
+	fi
+	local calls
+	calls=$(count_syscalls "${cmd[@]}" "$@")
+	awk -v c="$name" -v s="$sent" -v r="$recv" -v t="$secs" -v u="$cpu" -v k="$sys" -v n="$calls" -v rtt="${rtt:-NA}" 'BEGIN {
+		printf "%s\t%d\t%d\t%.3f\t%.0f\t%.0f\t%.2f\t%s\t%s\n", c, s, r, t, s / t, r / t, (u + k) * 1e6 / s,
+			n == "NA" ? "NA" : sprintf("%.2f", n / s), rtt
+	}' >> "$OUT"
+	printf "${GREEN}%-20s${RESET} %s\n" "$name" "$(tail -1 "$OUT" | cut -f2- | tr '\t' ' ')"
+}
+
+printf "${CYAN}hajping benchmark: %s, %d probes per single-target case${RESET}\n" "$EXE" "$PROBES"
+printf "$COLUMNS_TSV\n" > "$OUT"
+make_list "$TMP/lo.list" 127.1 2000
+make_list "$TMP/ns.list" 198.19 2000
+make_list "$TMP/sim.list" 198.18 10000 64
+
+run_case lo4-interval -q -i 0.0001 -c "$PROBES" 127.0.0.1
+run_case lo6-interval -q -i 0.0001 -c "$PROBES" ::1
+run_case lo4-preload -q -l 64 -i 0.0001 -c "$PROBES" 127.0.0.1
+run_case lo4-flood -q -f -c 300 127.0.0.1
+run_case lo4-multi-flood -q -f -c 50 --target-list "$TMP/lo.list"
+run_case lo4-multi-user user -q -f -c 10 --rate 20000 --target-list "$TMP/lo.list"
+if setup_ns; then
+	run_case ns4-interval -q -i 0.0001 -c "$PROBES" 198.18.0.2
+	run_case ns6-interval -q -i 0.0001 -c "$PROBES" 2001:2::2
+	run_case ns4-multi-flood -q -f -c 50 --target-list "$TMP/ns.list"
+else
+	printf "${YELLOW}network namespace cases skipped (needs root and iproute2)${RESET}\n"
+fi
+if setup_sim; then
+	run_case sim4-multi-flood -q -f -c 20 --target-list "$TMP/sim.list"
+	run_case sim6-interval -q -i 0.0001 -c "$PROBES" 2001:2:0:1::1
+else
+	printf "${YELLOW}simulated host cases skipped (needs root and -s hajsim)${RESET}\n"
+fi
+printf "${CYAN}results written to %s${RESET}\n" "$OUT"
+
+[ -n "$BASELINE" ] || exit 0
+# rates must not drop, costs must not grow, by more than the tolerance
+awk -F'\t' -v tol="$TOLERANCE" '
+	FNR == 1 { for (i = 1; i <= NF; i++) col[FILENAME, i] = $i; next }
+	NR == FNR { for (i = 2; i <= NF; i++) base[$1, col[FILENAME, i]] = $i; next }
+	{
+		for (i = 2; i <= NF; i++) {
+			m = col[FILENAME, i]
+			if (m !~ /_pps$|_per_probe$|^rtt/ || !(($1, m) in base)) continue
+			b = base[$1, m]; v = $i
+			if (b == "NA" || v == "NA" || b + 0 == 0) continue
+			worse = (m ~ /_pps$/) ? (b - v) / b * 100 : (v - b) / b * 100
+			if (worse > tol) { printf "REGRESSION\t%s\t%s\t%s -> %s (%.0f%% worse)\n", $1, m, b, v, worse; bad++ }
+		}
+	}
+	END { if (bad) exit 1; print "no regression beyond " tol "%" }
+' "$BASELINE" "$OUT"
@@ -0,0 +1,131 @@
+#ifndef HAJPING_ARENA_H
+# define HAJPING_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE	(64 << 10)	/**< default block of a bump arena */
+#define ARENA_ALIGN			16			/**< alignment of every arena allocation */
+
+/**
+ * @brief Block of arena storage, allocations never move once made
+ */
+typedef struct sArenaChunk
+{
+	struct sArenaChunk	*next;
+	size_t				size;
+	size_t				used;
+	unsigned char		data[] __attribute__((aligned(ARENA_ALIGN)));
+} tArenaChunk;
+
+/**
+ * @brief Bump allocator: memory is only given back all at once
+ * Holds per-target state whose lifetime is the run (names, addresses).
+ * - chunks: blocks, newest first
+ * - reserved: bytes obtained from malloc
+ * - used: bytes handed out
+ */
+typedef struct sArena
+{
+	tArenaChunk	*chunks;
+	size_t		reserved;
+	size_t		used;
+} tArena;
+
+/**
+ * @brief Free list of a pool, threaded through the released objects
+ */
+typedef struct sPoolFree
+{
+	struct sPoolFree	*next;
+} tPoolFree;
+
+/**
+ * @brief Block of pool objects
+ */
+typedef struct sPoolSlab
+{
+	struct sPoolSlab	*next;
+	unsigned char		data[] __attribute__((aligned(ARENA_ALIGN)));
+} tPoolSlab;
+
+/**
+ * @brief Fixed-size object pool: O(1) alloc / release, memory kept for reuse
+ * Only a new slab goes through malloc, so records created and retired at
+ * the probe rate cost no allocation once the pool has warmed up.
+ * - objSize: object size rounded up to a pointer
+ * - perSlab: objects per slab
+ * - slabs / slabCount: every slab
+ * - freeList: released objects
+ * - live / peak: objects in use, highest live count
+ */
+typedef struct sPool
+{
+	size_t		objSize;
+	size_t		perSlab;
+	tPoolSlab	*slabs;
+	size_t		slabCount;
+	tPoolFree	*freeList;
+	size_t		live;
+	size_t		peak;
+} tPool;
+
+/**
+ * @brief Start an empty arena
+ * @param arena - arena to initialize
+ */
+void	arenaInit(tArena *arena);
+
+/**
+ * @brief Allocate from the arena
+ * @param arena - arena
+ * @param size - bytes, aligned to ARENA_ALIGN
+ * @return storage, NULL on allocation failure
+ */
+void	*arenaAlloc(tArena *arena, size_t size);
+
+/**
+ * @brief Copy a string into the arena
+ * @param arena - arena
+ * @param str - string, not necessarily NUL terminated
+ * @param len - length of str
+ * @return NUL terminated copy, NULL on allocation failure
+ */
+char	*arenaStrndup(tArena *arena, const char *str, size_t len);
+
+/**
+ * @brief Release every block of the arena
+ * @param arena - arena
+ */
+void	arenaFree(tArena *arena);
+
+/**
+ * @brief Start an empty pool
+ * @param pool - pool to initialize
+ * @param objSize - size of one object
+ * @param perSlab - objects allocated at once
+ */
+void	poolInit(tPool *pool, size_t objSize, size_t perSlab);
+
+/**
+ * @brief Take an object from the pool
+ * @return object (not cleared), NULL on allocation failure
+ */
+void	*poolAlloc(tPool *pool);
+
+/**
+ * @brief Give an object back to the pool
+ */
+void	poolRelease(tPool *pool, void *obj);
+
+/**
+ * @brief Bytes held by the slabs of a pool
+ */
+size_t	poolReserved(const tPool *pool);
+
+/**
+ * @brief Release every slab of the pool
+ * @param pool - pool
+ */
+void	poolFree(tPool *pool);
+
+#endif /* HAJPING_ARENA_H */
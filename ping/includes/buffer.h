@@ -0,0 +1,82 @@
+#ifndef HAJPING_BUFFER_H
+# define HAJPING_BUFFER_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <sys/time.h>
+
+#include "../../common/includes/icmp.h"
+#include "parser.h"
+
+#define PING_BUF_ALIGN		64				/**< cache line alignment of each buffer */
+#define PING_BUF_IP_MAX		60				/**< largest IPv4 header, options included */
+#define PING_HUGEPAGE_SIZE	(2UL << 20)		/**< MAP_HUGETLB granularity */
+
+/**
+ * @brief Per-target packet buffers, allocated once from -s
+ * Both buffers live in a single mapping so a target costs one mmap. The
+ * echo payload is filled with the pattern at setup; sending a probe only
+ * rewrites the ICMP header and the leading stamp and finishes the
+ * checksum from the precomputed sum of the untouched tail.
+ * - base / mapLen: mapping backing both buffers
+ * - huge: mapping uses explicit huge pages
+ * - send: ICMP message (header + payload), pattern prefilled
+ * - sendSize: capacity of send
+ * - payloadLen: user payload length (-s)
+ * - stampLen: leading payload bytes rewritten per probe: the probe header
+ *   (hajping) or a struct timeval (ft_ping), 0 when it does not fit
+ * - tailSum: partial checksum of payload bytes after stampLen
+ * - recv: receive buffer (IP header + ICMP message)
+ * - recvSize: capacity of recv
+ */
+typedef struct sPingBuffers
+{
+	unsigned char	*base;
+	size_t			mapLen;
+	tBool			huge;
+	unsigned char	*send;
+	size_t			sendSize;
+	uint32_t		payloadLen;
+	uint32_t		stampLen;
+	uint32_t		tailSum;
+	unsigned char	*recv;
+	size_t			recvSize;
+} tPingBuffers;
+
+/**
+ * @brief Allocate and prefill the buffers for the payload size in opts
+ * Tries MAP_HUGETLB first when opts->hugepages is set (hajping) and falls
+ * back to regular pages with MADV_HUGEPAGE.
+ * @param bufs - buffers to initialize
+ * @param opts - parsed options (packet size, pattern)
+ * @return 0 on success, -1 on failure
+ */
+int			pingBuffersInit(tPingBuffers *bufs, const tPingOptions *opts);
+
+/**
+ * @brief Release the buffers mapping
+ * @param bufs - buffers to release
+ */
+void		pingBuffersFree(tPingBuffers *bufs);
+
+/**
+ * @brief Finish an echo request in bufs->send for one probe
+ * @param bufs - initialized buffers
+ * @param type - ICMP type (ICMP4_ECHO_REQUEST or ICMP6_ECHO_REQUEST)
+ * @param id - identifier
+ * @param seq - sequence number
+ * @param stamp - stampLen bytes written at the payload start (may be NULL)
+ * @param pseudoSum - partial sum of the IPv6 pseudo-header, 0 for IPv4
+ * @param doChecksum - fill the checksum field (the kernel does it otherwise)
+ * @return ICMP message length
+ */
+uint32_t	pingBuffersBuildEcho(
+	tPingBuffers			*bufs,
+	uint8_t					type,
+	uint16_t				id,
+	uint16_t				seq,
+	const void				*stamp,
+	uint32_t				pseudoSum,
+	int						doChecksum);
+
+#endif /* HAJPING_BUFFER_H */
@@ -0,0 +1,109 @@
+#ifndef HAJPING_CAPTURE_H
+# define HAJPING_CAPTURE_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "../../common/includes/utils.h"
+
+#define CAPTURE_RING_SIZE	(8U << 20)	/**< bytes of blocks waiting for the writer, power of two */
+#define CAPTURE_FLUSH_MS	20			/**< writer wakeup period */
+#define CAPTURE_SNAPLEN		65575		/**< largest IPv6 header + ICMP message */
+#define CAPTURE_IFACE_V4	0			/**< pcapng interface of the IPv4 packets */
+#define CAPTURE_IFACE_V6	1			/**< pcapng interface of the IPv6 packets */
+
+/**
+ * @brief pcapng capture of the probes sent and the replies received (--capture)
+ * The send and receive paths append finished blocks to a preallocated
+ * ring and never block: a block that does not fit is dropped and counted.
+ * A background thread writes the ring out and starts a new file, FILE.1,
+ * FILE.2 and so on, when the current one would exceed rotateBytes.
+ * producer (probing thread):
+ * - ring / head: block bytes, head is the end of the last finished block
+ * - packets / dropped: blocks appended, blocks lost on a full ring
+ * writer thread (on its own cache line):
+ * - tail: end of what has been written out
+ * - fd / path / fileIndex / fileBytes: current file, its number and size
+ * - rotateBytes: size limit of a file, 0 for none
+ * - files / failed: files written, a write failed (the rest is discarded)
+ * shared:
+ * - lock / wake / stop: wake the writer early and end it
+ */
+typedef struct sCapture
+{
+	uint8_t				*ring;
+	_Atomic uint64_t	head;
+	uint64_t			packets;
+	uint64_t			dropped;
+	_Alignas(64) _Atomic uint64_t	tail;
+	int					fd;
+	char				path[PATH_MAX];
+	unsigned int		fileIndex;
+	uint64_t			fileBytes;
+	uint64_t			rotateBytes;
+	unsigned int		files;
+	tBool				failed;
+	pthread_t			thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		wake;
+	tBool				stop;
+} tCapture;
+
+/**
+ * @brief Create the first file and start the writer thread
+ * @param cap - capture to initialize
+ * @param path - pcapng file, rotated files get a .N suffix
+ * @param rotateBytes - start a new file past this size, 0 for one file
+ * @return 0 on success, -1 with a message on error
+ */
+int		captureOpen(tCapture *cap, const char *path, uint64_t rotateBytes);
+
+/**
+ * @brief Record a probe that left (outbound block)
+ * @param cap - capture, NULL when capture is off
+ * @param dst - destination of the probe
+ * @param ttl - TTL / hop limit it was sent with
+ * @param icmp - ICMP message as sent (the kernel adds the IP header)
+ * @param len - length of icmp
+ */
+void	captureSent(
+	tCapture						*cap,
+	const struct sockaddr_storage	*dst,
+	uint8_t							ttl,
+	const void						*icmp,
+	size_t							len);
+
+/**
+ * @brief Record a packet read from a probing socket (inbound block)
+ * Packets without their IP header get one rebuilt from the sender
+ * address and TTL; the local address is recorded as unspecified.
+ * @param cap - capture, NULL when capture is off
+ * @param from - sender
+ * @param ttl - TTL / hop limit it arrived with
+ * @param pkt - packet as read
+ * @param len - length of pkt
+ * @param ipLen - bytes of IP header at the start of pkt (raw IPv4 socket,
+ *   packet ring), 0 if none
+ * @param reject - why the packet was not accounted, NULL if it was
+ */
+void	captureReceived(
+	tCapture						*cap,
+	const struct sockaddr_storage	*from,
+	uint8_t							ttl,
+	const void						*pkt,
+	size_t							len,
+	size_t							ipLen,
+	const char						*reject);
+
+/**
+ * @brief Write out what is left, stop the writer and close the file
+ * @param cap - capture, NULL when capture is off
+ * @param verbose - print the packet and file counts
+ */
+void	captureClose(tCapture *cap, int verbose);
+
+#endif /* HAJPING_CAPTURE_H */
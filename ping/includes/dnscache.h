@@ -0,0 +1,212 @@
+#ifndef HAJPING_DNSCACHE_H
+# define HAJPING_DNSCACHE_H
+
+#include <netdb.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "ping.h"
+
+#define DNS_CACHE_MAGIC			0x43444A48	/**< "HJDC" */
+#define DNS_CACHE_VERSION		1
+#define DNS_CACHE_SLOTS			1024		/**< entries in the file, power of two */
+#define DNS_CACHE_PROBE			16			/**< slots searched from the hash position */
+#define DNS_CACHE_NAME_LEN		256
+#define DNS_CACHE_ADDRS			8			/**< addresses kept per forward entry */
+#define DNS_CACHE_DEFAULT_TTL	300			/**< seconds an entry is fresh */
+#define DNS_CACHE_STALE_SEC		86400		/**< seconds a stale entry is still served */
+
+/**
+ * @brief Kind of a cache entry
+ * - DNS_CACHE_EMPTY: free slot
+ * - DNS_CACHE_FORWARD: host name to addresses (resolveHost)
+ * - DNS_CACHE_REVERSE: address to PTR name (resolvePeerName), an empty
+ *   name records that the address has no PTR
+ */
+typedef enum eDnsCacheKind
+{
+	DNS_CACHE_EMPTY = 0,
+	DNS_CACHE_FORWARD,
+	DNS_CACHE_REVERSE
+} tDnsCacheKind;
+
+/**
+ * @brief Result of a cache lookup
+ * - DNS_CACHE_MISS: nothing usable, resolve normally
+ * - DNS_CACHE_FRESH: entry within its TTL
+ * - DNS_CACHE_STALE: expired entry served while a refresh runs
+ */
+typedef enum eDnsCacheHit
+{
+	DNS_CACHE_MISS = 0,
+	DNS_CACHE_FRESH,
+	DNS_CACHE_STALE
+} tDnsCacheHit;
+
+/**
+ * @brief File header, first 64 bytes of the file
+ * - magic / version / slots / entrySize: layout check, a file that does
+ *   not match is reinitialized
+ */
+typedef struct sDnsCacheHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	slots;
+	uint32_t	entrySize;
+	uint8_t		reserved[48];
+} tDnsCacheHeader;
+
+/**
+ * @brief One cached address, sockaddr independent
+ */
+typedef struct sDnsCacheAddr
+{
+	uint16_t	family;
+	uint16_t	reserved;
+	uint32_t	scope;		/* IPv6 scope id */
+	uint8_t		addr[16];
+} tDnsCacheAddr;
+
+/**
+ * @brief One slot of the mapped table, read in place
+ * - seq: write sequence, odd while a writer updates the slot; readers
+ *   retry when it changes under them
+ * - kind / family: entry kind and address family (forward: family asked
+ *   for, AF_UNSPEC included)
+ * - count: addresses used in addrs
+ * - hash: key hash
+ * - storedAt / expiresAt: wall clock seconds
+ * - name: forward key, or reverse PTR result
+ * - canon: canonical name of a forward entry
+ * - addrs: forward results, or the reverse key in addrs[0]
+ */
+typedef struct sDnsCacheEntry
+{
+	uint32_t		seq;
+	uint8_t			kind;
+	uint8_t			family;
+	uint8_t			count;
+	uint8_t			reserved0;
+	uint64_t		hash;
+	int64_t			storedAt;
+	int64_t			expiresAt;
+	char			name[DNS_CACHE_NAME_LEN];
+	char			canon[DNS_CACHE_NAME_LEN];
+	tDnsCacheAddr	addrs[DNS_CACHE_ADDRS];
+	uint8_t			reserved1[32];
+} tDnsCacheEntry;
+
+/**
+ * @brief Lookup queued for the background refresh
+ */
+typedef struct sDnsRefresh
+{
+	tDnsCacheKind			kind;
+	tIpType					ipMode;
+	char					host[DNS_CACHE_NAME_LEN];
+	struct sockaddr_storage	addr;
+	socklen_t				addrLen;
+} tDnsRefresh;
+
+/**
+ * @brief Persistent resolution cache (--dns-cache)
+ * The file is a header followed by a fixed open-addressing table mapped
+ * shared, so a lookup is a hash and a few slot reads. Writers serialize
+ * with flock() so concurrent runs can share one file.
+ * - hdr / entries / mapLen / fd: mapping of the cache file (fd -1 if closed)
+ * - ttl: seconds a new entry stays fresh
+ * - lock / wake: protect and signal the refresh queue
+ * - worker / workerStarted / stop: background refresh thread
+ * - queue / queued / queueCap: stale entries waiting for a refresh
+ */
+typedef struct sDnsCache
+{
+	tDnsCacheHeader	*hdr;
+	tDnsCacheEntry	*entries;
+	size_t			mapLen;
+	int				fd;
+	int				ttl;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wake;
+	pthread_t		worker;
+	tBool			workerStarted;
+	tBool			stop;
+	tDnsRefresh		*queue;
+	size_t			queued;
+	size_t			queueCap;
+} tDnsCache;
+
+/**
+ * @brief Open or create the cache file
+ * @param cache - cache to initialize
+ * @param path - cache file
+ * @param ttlSec - freshness of new entries in seconds (0 for the default)
+ * @return 0 on success, -1 on failure (cache left closed, lookups bypass it)
+ */
+int				dnsCacheOpen(tDnsCache *cache, const char *path, int ttlSec);
+
+/**
+ * @brief Look up a host, scheduling a refresh when the entry is stale
+ * @param cache - open cache
+ * @param host - host name
+ * @param ipMode - address family restriction
+ * @param outList - addrinfo list rebuilt from the entry (freeaddrinfo)
+ * @return hit kind, *outList is only set on a hit
+ */
+tDnsCacheHit	dnsCacheGetHost(
+	tDnsCache		*cache,
+	const char		*host,
+	tIpType			ipMode,
+	struct addrinfo	**outList);
+
+/**
+ * @brief Store the result of a forward lookup
+ * IP literals and names longer than the key are not cached.
+ * @param cache - open cache
+ * @param host - host name
+ * @param ipMode - address family restriction used for the lookup
+ * @param list - getaddrinfo result
+ */
+void			dnsCachePutHost(
+	tDnsCache				*cache,
+	const char				*host,
+	tIpType					ipMode,
+	const struct addrinfo	*list);
+
+/**
+ * @brief resolveHost() going through the cache
+ * Same contract as resolveHost(); a NULL or closed cache resolves directly.
+ */
+int				dnsCacheResolveHost(
+	tDnsCache				*cache,
+	const char				*host,
+	struct sockaddr_storage	*outAddr,
+	socklen_t				*outLen,
+	struct addrinfo			**outList,
+	tIpType					ipMode);
+
+/**
+ * @brief resolvePeerName() going through the cache
+ * Same contract as resolvePeerName(); the PTR answer (or its absence) is
+ * cached, the canonical name fallback is applied afterwards.
+ */
+int				dnsCacheResolvePeer(
+	tDnsCache						*cache,
+	const struct sockaddr_storage	*addr,
+	socklen_t						addrLen,
+	const char						*canonName,
+	char							*out,
+	size_t							outSize);
+
+/**
+ * @brief Finish pending refreshes and unmap the file
+ * Waits for the refresh thread, so a run that served stale entries
+ * leaves them fresh for the next one.
+ * @param cache - cache (open or not)
+ */
+void			dnsCacheClose(tDnsCache *cache);
+
+#endif /* HAJPING_DNSCACHE_H */
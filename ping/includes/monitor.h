@@ -0,0 +1,102 @@
+#ifndef HAJPING_MONITOR_H
+# define HAJPING_MONITOR_H
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "ping.h"
+#include "stats.h"
+
+#define MONITOR_DEFAULT_HOPS	30
+#define MONITOR_MAX_HOPS		64
+#define MONITOR_INFLIGHT		4096	/**< in-flight probe slots, indexed by seq (must divide MAX_SEQ) */
+#define MONITOR_NAMES			128		/**< hop names remembered, the oldest is replaced first */
+
+/**
+ * @brief Rolling statistics of one hop
+ * - stats: loss / RTT accumulators, same semantics as the single target summary
+ * - hist: bounded RTT histogram (percentiles)
+ * - jitter: RFC 3550 jitter estimator
+ * - lastRtt: most recent RTT sample (ms)
+ * - addr: last address that answered for this TTL
+ * - haveAddr: whether addr is valid
+ * - host: printable name of addr (reverse DNS unless -n)
+ */
+typedef struct sHopStats
+{
+	tPingStats				stats;
+	tRttHistogram			hist;
+	tRttJitter				jitter;
+	double					lastRtt;
+	struct sockaddr_storage	addr;
+	tBool					haveAddr;
+	char					ip[INET6_ADDRSTRLEN];
+	char					host[256];
+} tHopStats;
+
+/**
+ * @brief Reverse DNS name of a hop address, looked up once
+ * Equal-cost paths alternate the address of a hop every round; the names
+ * are kept so that no lookup stalls the probing loop after the first.
+ * - addr: the address
+ * - host: its name, the address text when it has none
+ */
+typedef struct sMonitorName
+{
+	struct sockaddr_storage	addr;
+	char					host[256];
+} tMonitorName;
+
+/**
+ * @brief One probe slot of the in-flight ring
+ * - seq: ICMP sequence number of the probe
+ * - hop: TTL the probe was sent with
+ * - pending: TRUE until a reply or error is matched
+ * - sentAt: send time
+ */
+typedef struct sMonitorProbe
+{
+	uint16_t		seq;
+	uint8_t			hop;
+	tBool			pending;
+	struct timeval	sentAt;
+} tMonitorProbe;
+
+/**
+ * @brief Monitor state: one socket, one loop, every hop
+ * - ctx: ping context (socket, target, options)
+ * - hops: per-hop statistics, hops[0] is TTL 1
+ * - probes: in-flight ring
+ * - maxHops: highest TTL probed
+ * - destHop: lowest TTL that reached the target, 0 while unknown
+ * - rounds: number of completed rounds
+ * - names / nameCount / nameNext: hop names looked up, nameNext the slot
+ *   replaced next once the cache is full
+ */
+typedef struct sMonitor
+{
+	tPingContext	*ctx;
+	tHopStats		hops[MONITOR_MAX_HOPS];
+	tMonitorProbe	probes[MONITOR_INFLIGHT];
+	int				maxHops;
+	int				destHop;
+	unsigned int	rounds;
+	tMonitorName	names[MONITOR_NAMES];
+	unsigned int	nameCount;
+	unsigned int	nameNext;
+} tMonitor;
+
+/**
+ * @brief Probe every TTL of the path continuously and keep per-hop statistics
+ * Prints a refreshed table after each round and a per-hop summary at the end.
+ * @param ctx - initialized ping context (socket created for the target family)
+ */
+void	runMonitorLoop(tPingContext *ctx);
+
+/**
+ * @brief Print the per-hop version of printPingSummary
+ * @param mon - monitor state
+ */
+void	printMonitorSummary(const tMonitor *mon);
+
+#endif /* HAJPING_MONITOR_H */
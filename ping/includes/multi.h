@@ -0,0 +1,187 @@
+#ifndef HAJPING_MULTI_H
+# define HAJPING_MULTI_H
+
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include "capture.h"
+#include "dnscache.h"
+#include "output.h"
+#include "plog.h"
+#include "ping.h"
+#include "resolver.h"
+#include "rxpool.h"
+#include "stats.h"
+#include "table.h"
+#include "wheel.h"
+
+#define MULTI_BATCH			256		/**< timers expired / packets read per wakeup */
+#define MULTI_RCVBUF		(1 << 20)	/**< receive buffer of the shared sockets */
+#define MULTI_RX_CHECK_MS	10		/**< replies of the receive workers are counted this often */
+#define MULTI_TIMER_SEND	0		/**< timer kind: next probe of a target */
+#define MULTI_TIMER_WAIT	1		/**< timer kind: oldest probe of a target times out */
+#define MULTI_TIMER_PACED	2		/**< timer kind: probe slot reserved under --rate */
+#define MULTI_TIMERS		3		/**< timers per target */
+#define MULTI_TIMER(i, kind)	((uint32_t)((i) * MULTI_TIMERS + (kind)))
+
+/**
+ * @brief Concurrent engine: one socket per family, every address in one loop
+ * - opts: options shared by every target
+ * - socks: shared sockets, socks[0] IPv4 and socks[1] IPv6 (fd -1 if unused)
+ * - bufs: shared send / receive buffers
+ * - probeKey: probe header key shared by every target
+ * - pid: ICMP identifier
+ * - label: name printed in the headers and summary
+ * - table: probed addresses in resolution order, replies are matched to
+ *   them by (family, address, ICMP identifier)
+ * - pending: targets with probes left to send
+ * - inflight: probes sent and neither answered nor timed out
+ * - wheel: send and timeout timers of every target (MULTI_TIMER)
+ * - ivNs / waitNs: probe interval and reply timeout
+ * - ratePeriodNs / rateNextNs: spacing imposed by the rate ceiling (0 for
+ *   none) and first time a probe may leave without a reserved slot
+ * - resolver: lookups still feeding targets while probing (NULL if none)
+ * - unresolved: hosts whose lookup failed or timed out
+ * - dnsCache: stores the resolver results (NULL if none)
+ * - capture: records the probes and replies (NULL if none)
+ * - output: machine-readable records (NULL if none)
+ * - plog: binary log of the probe outcomes (NULL if none)
+ * - rxPool: receive workers accounting the replies (NULL if the loop
+ *   reads the shared sockets itself)
+ * - sentTotal / lastSendNs: probes sent and time of the last one, settle
+ *   the probes when the workers account the replies
+ * - running: the loop has started, new targets are announced
+ */
+typedef struct sMulti
+{
+	tPingOptions	opts;
+	tPingSocket		socks[2];
+	tPingBuffers	bufs;
+	uint8_t			probeKey[PROBE_KEY_LEN];
+	pid_t			pid;
+	char			label[256];
+	tTargetTable	table;
+	size_t			pending;
+	size_t			inflight;
+	tWheel			wheel;
+	uint64_t		ivNs;
+	uint64_t		waitNs;
+	uint64_t		ratePeriodNs;
+	uint64_t		rateNextNs;
+	tResolver		*resolver;
+	size_t			unresolved;
+	tDnsCache		*dnsCache;
+	tCapture		*capture;
+	tOutput			*output;
+	tPlog			*plog;
+	tRxPool			*rxPool;
+	uint64_t		sentTotal;
+	uint64_t		lastSendNs;
+	tBool			running;
+} tMulti;
+
+/**
+ * @brief Prepare an engine with no target yet
+ * @param multi - engine to initialize
+ * @param opts - parsed options
+ * @param label - name printed in the headers and summary
+ * @return 0 on success, -1 on failure
+ */
+int		multiInit(tMulti *multi, const tPingOptions *opts, const char *label);
+
+/**
+ * @brief Add one address to probe, opening the socket of its family on first use
+ * An address already probed only records host as one more of its names.
+ * @param multi - initialized engine
+ * @param host - name the address was resolved from, must outlive the engine
+ * @param addr - address to probe
+ * @param addrLen - length of addr
+ * @return 0 on success (or duplicate), -1 on failure
+ */
+int		multiAddTarget(
+	tMulti							*multi,
+	const char						*host,
+	const struct sockaddr_storage	*addr,
+	socklen_t						addrLen);
+
+/**
+ * @brief Add the addresses of a getaddrinfo result
+ * Every usable address with --all-addresses, the first one otherwise.
+ * @param multi - initialized engine
+ * @param host - name the list was resolved from
+ * @param list - getaddrinfo result
+ * @return number of targets added
+ */
+size_t	multiAddHost(tMulti *multi, const char *host, const struct addrinfo *list);
+
+/**
+ * @brief Probe every target concurrently until each sent -c probes, -w or SIGINT
+ * Each target is probed once per interval, probes are spread evenly over
+ * the interval, -l probes leave back to back first. Above the rate ceiling
+ * (--rate, unprivileged sockets) probes wait for a reserved slot instead of
+ * being dropped. A probe unanswered after max(linger, interval) counts as
+ * lost; the loop ends once every probe is answered or timed out. Sends and
+ * timeouts are timers of multi->wheel, the loop sleeps until its next
+ * non-empty slot. Targets delivered by multi->resolver join as soon as
+ * their lookup completes. With receive workers (--rx-workers) the loop
+ * only sends: replies are not printed and the statistics of the workers
+ * are merged into the table at the end.
+ * @param multi - engine with targets or a resolver
+ */
+void	runMultiLoop(tMulti *multi);
+
+/**
+ * @brief Print per-address statistics, per-family totals and the best address
+ * The best address has the lowest loss, ties broken by the lowest average RTT.
+ * A summary record per address goes to multi->output.
+ * @param multi - engine
+ */
+void	printMultiSummary(const tMulti *multi);
+
+/**
+ * @brief Close the sockets and release targets and buffers
+ * @param multi - engine
+ */
+void	multiFree(tMulti *multi);
+
+/**
+ * @brief Probe every usable address of a resolved host (--all-addresses)
+ * @param opts - parsed options
+ * @param host - host name as given on the command line
+ * @param list - getaddrinfo result for host
+ * @param capture - records the probes and replies (NULL if none)
+ * @param output - machine-readable records (NULL if none)
+ * @param plog - binary log of the probe outcomes (NULL if none)
+ * @return 0 on success, -1 if no address could be probed
+ */
+int		runMultiHost(
+	const tPingOptions		*opts,
+	const char				*host,
+	const struct addrinfo	*list,
+	tCapture				*capture,
+	tOutput					*output,
+	tPlog					*plog);
+
+/**
+ * @brief Resolve every host concurrently and probe them in one loop (--parallel)
+ * Probing of a host starts as soon as its lookup completes. Hosts found in
+ * the cache are probed from the start and never reach the resolver.
+ * @param opts - parsed options
+ * @param hosts - host names from the command line
+ * @param count - number of hosts
+ * @param cache - resolution cache (NULL if none)
+ * @param capture - records the probes and replies (NULL if none)
+ * @param output - machine-readable records (NULL if none)
+ * @param plog - binary log of the probe outcomes (NULL if none)
+ * @return 0 if at least one host was probed, -1 otherwise
+ */
+int		runParallelHosts(
+	const tPingOptions	*opts,
+	char				**hosts,
+	size_t				count,
+	tDnsCache			*cache,
+	tCapture			*capture,
+	tOutput				*output,
+	tPlog				*plog);
+
+#endif /* HAJPING_MULTI_H */
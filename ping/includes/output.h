@@ -0,0 +1,133 @@
+#ifndef HAJPING_OUTPUT_H
+# define HAJPING_OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/utils.h"
+#include "stats.h"
+
+#define OUTPUT_BUF_SIZE		(64U << 10)	/**< records buffered before a write */
+#define OUTPUT_LINE_MAX		(4U << 10)	/**< room kept free for one record */
+#define OUTPUT_NAME_MAX		255			/**< bytes of a name written, longer ones are cut */
+#define OUTPUT_FLUSH_MS		100			/**< a record waits at most this long in the buffer */
+
+/**
+ * @brief Machine-readable output (--output)
+ * - OUTPUT_TEXT: none, the text output only
+ * - OUTPUT_JSONL: one JSON object per line
+ * - OUTPUT_CSV: a header line, then one row per record
+ */
+typedef enum eOutputFormat
+{
+	OUTPUT_TEXT = 0,
+	OUTPUT_JSONL,
+	OUTPUT_CSV
+} tOutputFormat;
+
+/**
+ * @brief Outcome of a probe
+ * - OUTPUT_REPLY: first reply to the probe
+ * - OUTPUT_DUPLICATE: reply to a probe already answered
+ * - OUTPUT_LOST: no reply before the timeout (or the end of the run)
+ * - OUTPUT_ERROR: ICMP error about the probe (err_type / err_code)
+ */
+typedef enum eOutputStatus
+{
+	OUTPUT_REPLY = 0,
+	OUTPUT_DUPLICATE,
+	OUTPUT_LOST,
+	OUTPUT_ERROR
+} tOutputStatus;
+
+/**
+ * @brief One probe record, absent numbers are negative
+ * - target / addr: name and address probed
+ * - seq: ICMP sequence of the probe
+ * - status: outcome
+ * - ttl: TTL / hop limit of the reply or error
+ * - rttNs: round-trip time in nanoseconds
+ * - size: bytes of the ICMP reply
+ * - errType / errCode: ICMP type and code of an error
+ */
+typedef struct sOutputProbe
+{
+	const char		*target;
+	const char		*addr;
+	uint32_t		seq;
+	tOutputStatus	status;
+	int				ttl;
+	int64_t			rttNs;
+	int64_t			size;
+	int				errType;
+	int				errCode;
+} tOutputProbe;
+
+/**
+ * @brief Buffered record writer, the buffer is part of the structure so
+ * writing a record never allocates
+ * - fd: where records go
+ * - format: OUTPUT_JSONL or OUTPUT_CSV
+ * - len: bytes waiting in buf
+ * - fields: fields of the record being written
+ * - flushNs: monotonic time of the last write
+ * - records: records written
+ * - failed: a write failed, later records are discarded
+ */
+typedef struct sOutput
+{
+	int				fd;
+	tOutputFormat	format;
+	size_t			len;
+	unsigned int	fields;
+	uint64_t		flushNs;
+	uint64_t		records;
+	tBool			failed;
+	char			buf[OUTPUT_BUF_SIZE];
+} tOutput;
+
+/**
+ * @brief Start writing records, the CSV header first
+ * @param out - writer to initialize
+ * @param format - OUTPUT_JSONL or OUTPUT_CSV
+ * @param fd - descriptor the writer takes over
+ * @return 0 on success, -1 with a message on error
+ */
+int		outputOpen(tOutput *out, tOutputFormat format, int fd);
+
+/**
+ * @brief Write the record of one probe outcome
+ * @param out - writer, NULL when the output is off
+ * @param probe - the outcome
+ */
+void	outputProbe(tOutput *out, const tOutputProbe *probe);
+
+/**
+ * @brief Write the summary record of one target and flush
+ * @param out - writer, NULL when the output is off
+ * @param target / addr - name and address probed
+ * @param stats - counters and RTT sums
+ * @param hist - RTT histogram for the p90, NULL if none
+ * @param jitter - jitter estimator, NULL if none
+ */
+void	outputSummary(
+	tOutput					*out,
+	const char				*target,
+	const char				*addr,
+	const tPingStats		*stats,
+	const tRttHistogram		*hist,
+	const tRttJitter		*jitter);
+
+/**
+ * @brief Write out the buffered records
+ * @param out - writer, NULL when the output is off
+ */
+void	outputFlush(tOutput *out);
+
+/**
+ * @brief Flush and close the descriptor
+ * @param out - writer, NULL when the output is off
+ */
+void	outputClose(tOutput *out);
+
+#endif /* HAJPING_OUTPUT_H */
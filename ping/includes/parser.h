@@ -45,6 +45,25 @@ typedef struct sPingOptions
 #if defined(HAJ)
 	tBool		 	v4;			/* force IPv4 */
 	tBool		 	v6;			/* force IPv6 */
+	tBool			monitor;	/* continuous per-hop monitor (mtr-style) */
+	int				maxHops;	/* highest TTL probed by the monitor */
+	tBool			pmtu;		/* path MTU discovery instead of echo */
+	tBool			hugepages;	/* back packet buffers with huge pages */
+	tBool			allAddresses;	/* probe every resolved address at once */
+	tBool			parallel;	/* resolve and probe every host at once */
+	int				dnsLimit;	/* lookups in flight with --parallel */
+	int				dnsTimeout;	/* seconds per lookup with --parallel */
+	const char		*dnsCache;	/* persistent resolution cache file */
+	const char		*targetList;	/* file of hosts, "-" for stdin */
+	int				dnsCacheTtl;	/* seconds a cached resolution is fresh */
+	int				rate;		/* probes per second ceiling, 0 = default */
+	const char		*replay;	/* capture file analysed instead of probing */
+	const char		*capture;	/* pcapng file of the probes and replies */
+	int				captureSize;	/* MB per capture file, 0 = no rotation */
+	tBool			packetRing;	/* receive through a TPACKET_V3 ring */
+	int				rxWorkers;	/* receive threads of the concurrent engine */
+	int				outputFormat;	/* records on stdout (tOutputFormat), 0 = text */
+	const char		*probeLog;	/* binary log of the probe outcomes */
 #endif
 
 	/* Options for ICMP_ECHO only */
@@ -61,7 +80,7 @@ typedef struct sPingOptions
 /**
  * @brief Structure to hold the result of argument parsing
  * - options: parsed ping options
- * - positionals: array of positional arguments
+ * - positionals: positional arguments (points into argv)
  * - posCount: count of positional arguments
  * - badOpt: invalid option character, if any
  * - badOptArg: argument for the invalid option, if any
@@ -69,7 +88,7 @@ typedef struct sPingOptions
 typedef struct sParseResult
 {
 	tPingOptions	options;
-	char			*positionals[16];
+	char			**positionals;
 	int				posCount;
 	char			badOpt;
 	char			*badOptArg;
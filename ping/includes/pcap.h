@@ -0,0 +1,116 @@
+#ifndef HAJPING_PCAP_H
+# define HAJPING_PCAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/utils.h"
+
+#define PCAP_MAGIC_US		0xA1B2C3D4	/**< classic pcap, microsecond timestamps */
+#define PCAP_MAGIC_NS		0xA1B23C4D	/**< classic pcap, nanosecond timestamps */
+#define PCAP_HDR_LEN		24			/**< classic file header */
+#define PCAP_REC_LEN		16			/**< classic record header */
+#define PCAPNG_SHB			0x0A0D0D0A	/**< section header block */
+#define PCAPNG_IDB			1			/**< interface description block */
+#define PCAPNG_SPB			3			/**< simple packet block */
+#define PCAPNG_EPB			6			/**< enhanced packet block */
+#define PCAPNG_BOM			0x1A2B3C4D	/**< byte order magic of a section */
+#define PCAPNG_OPT_TSRESOL	9			/**< if_tsresol interface option */
+#define PCAPNG_OPT_TSOFFSET	14			/**< if_tsoffset interface option */
+#define PCAP_MAX_IFACES		64			/**< interfaces kept per pcapng section */
+
+#define LINKTYPE_NULL		0			/**< BSD loopback, family in host order */
+#define LINKTYPE_ETHERNET	1
+#define LINKTYPE_RAW		101			/**< bare IPv4 or IPv6 */
+#define LINKTYPE_LOOP		108			/**< OpenBSD loopback, family in network order */
+#define LINKTYPE_LINUX_SLL	113			/**< Linux "any" device, 16-byte header */
+#define LINKTYPE_IPV4		228
+#define LINKTYPE_IPV6		229
+#define LINKTYPE_LINUX_SLL2	276			/**< Linux "any" device, 20-byte header */
+
+/**
+ * @brief Capture interface of a pcapng section
+ * - linkType: LINKTYPE_* of its packets
+ * - tsResol: if_tsresol, 10^-n seconds per unit or 2^-n with the top bit
+ * - tsOffsetNs: if_tsoffset, added to every timestamp
+ */
+typedef struct sPcapIface
+{
+	uint16_t	linkType;
+	uint8_t		tsResol;
+	uint64_t	tsOffsetNs;
+} tPcapIface;
+
+/**
+ * @brief One captured packet, pointing into the mapped file
+ * - data / capLen: bytes captured, from the link-layer header on
+ * - origLen: length on the wire (more than capLen when truncated)
+ * - tsNs: capture time in nanoseconds since the epoch
+ * - linkType: LINKTYPE_* of data
+ */
+typedef struct sPcapPacket
+{
+	const uint8_t	*data;
+	uint32_t		capLen;
+	uint32_t		origLen;
+	uint64_t		tsNs;
+	uint16_t		linkType;
+} tPcapPacket;
+
+/**
+ * @brief Capture file mapped read-only, classic pcap or pcapng
+ * - map / size / off: the file and the next record
+ * - ng: pcapng, otherwise classic pcap
+ * - swap: the file (or current section) was written with the other byte order
+ * - nanos: classic pcap with nanosecond timestamps
+ * - linkType: link type of a classic file
+ * - snapLen: largest packet of a classic file
+ * - ifaces / ifaceCount: interfaces of the current pcapng section
+ */
+typedef struct sPcapReader
+{
+	const uint8_t	*map;
+	size_t			size;
+	size_t			off;
+	tBool			ng;
+	tBool			swap;
+	tBool			nanos;
+	uint16_t		linkType;
+	uint32_t		snapLen;
+	tPcapIface		ifaces[PCAP_MAX_IFACES];
+	uint32_t		ifaceCount;
+} tPcapReader;
+
+/**
+ * @brief Map a capture file and read its header
+ * @param rd - reader to initialize
+ * @param path - regular file, classic pcap (either byte order and
+ *   timestamp resolution) or pcapng
+ * @return 0 on success, -1 with a message on error
+ */
+int			pcapOpen(tPcapReader *rd, const char *path);
+
+/**
+ * @brief Next packet of the file, skipping blocks without one
+ * @param rd - open reader
+ * @param pkt - packet to fill, valid until pcapClose
+ * @return 1 for a packet, 0 at the end of the file, -1 for a malformed record
+ */
+int			pcapNext(tPcapReader *rd, tPcapPacket *pkt);
+
+/**
+ * @brief Network layer of a packet, after the link-layer header
+ * Ethernet (with 802.1Q / 802.1ad tags), Linux cooked, BSD loopback and
+ * raw IP link types are understood.
+ * @param pkt - captured packet
+ * @param len - filled with the bytes left
+ * @return start of the IPv4 or IPv6 header, NULL for another protocol
+ */
+const uint8_t	*pcapNetwork(const tPcapPacket *pkt, uint32_t *len);
+
+/**
+ * @brief Unmap the file
+ */
+void		pcapClose(tPcapReader *rd);
+
+#endif /* HAJPING_PCAP_H */
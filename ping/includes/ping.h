@@ -6,8 +6,17 @@
 
 #include "../../common/includes/icmp.h"
 #include "../../common/includes/ip.h"
+#include "../../common/includes/probe.h"
+#include "buffer.h"
+#if defined(HAJ)
+# include "capture.h"
+# include "output.h"
+# include "plog.h"
+# include "rxring.h"
+#endif
 #include "parser.h"
 #include "socket.h"
+#include "stats.h"
 
 # define EXIT_SUCCESS 0
 # define EXIT_FAILURE 1
@@ -16,7 +25,14 @@
 #define PING_DEFAULT_INTERVAL	1.0	/**< seconds */
 #define PING_MAX_PATTERN_LEN	256
 #define PING_MAX_POSITIONALS	16
-#define PING_MAX_PACKET_SIZE	1024
+#define PING_MAX_PACKET_SIZE	1024	/**< minimum receive buffer, fits any error message */
+#if defined(HAJ)
+# define PING_MAX_PAYLOAD		65507	/**< 65535 - IPv4 header - ICMP header */
+#else
+# define PING_MAX_PAYLOAD		65399	/**< inetutils limit */
+#endif
+#define PING_IP6_HDR_LEN		40		/**< fixed IPv6 header */
+#define PING_CMSG_SPACE			512		/**< ancillary data: TTL, pktinfo, IPv6 extensions */
 #define MAX_SEQ 65536
 #define ICMP_DATA_OFFSET sizeof(struct tIcmp4Hdr)
 
@@ -49,29 +65,6 @@ typedef enum eIpType
 #endif
 } tIpType;
 
-/**
- * @brief Ping statistics
- * - sent: number of packets sent
- * - received: number of packets received
- * - lost: number of lost packets
- * - rttMin: minimum round-trip time (ms)
- * - rttMax: maximum round-trip time (ms)
- * - rttSum: sum of RTTs (for average)
- * - rttSumSq: sum of squares of RTTs (for stddev)
- */
-typedef struct sPingStats
-{
-	unsigned int	sent;		/* number of packets sent */
-	unsigned int	received;	/* number of packets received */
-	unsigned int	lost;		/* number of lost packets */
-	unsigned int	errors;		/* number of errors (e.g., invalid ICMP replies) */
-	unsigned int	duplicates;	/* number of duplicate replies */
-	double			rttMin;		/* minimum round-trip time (ms) */
-	double			rttMax;		/* maximum round-trip time (ms) */
-	double			rttSum;		/* sum of RTTs (for average) */
-	double			rttSumSq;	/* sum of squares of RTTs (for stddev) */
-} tPingStats;
-
 /**
  * @brief Ping context holding all state
  */
@@ -83,6 +76,7 @@ typedef struct sPingContext
 	struct sockaddr_storage	targetAddr;			/* target address */
 	socklen_t				addrLen;			/* length of targetAddr */
 
+	tPingBuffers			bufs;				/* per-target send / receive buffers */
 	tPingStats				stats;				/* ping statistics */
 	unsigned int			seq;				/* current ICMP sequence number */
 	pid_t					pid;				/* identifier for ICMP */
@@ -91,6 +85,18 @@ typedef struct sPingContext
 	char					targetHost[256];	/* target hostname */
 	char					canonicalName[256];	/* canonical name */
 	char					resolvedIp[INET6_ADDRSTRLEN];	/* resolved IP address */
+#if defined(HAJ)
+	uint8_t					probeKey[PROBE_KEY_LEN];	/* probe header SipHash key */
+	tCapture				*capture;			/* --capture, NULL if off */
+	tRxRing					*ring;				/* --packet-ring, NULL if off */
+	tOutput					*output;			/* --output, NULL if off */
+	tPlog					*plog;				/* --probe-log, NULL if off */
+	uint64_t				*sentNs;			/* send time of each sequence slot, 0 if not sent (records on) */
+	unsigned int			settled;			/* oldest sequence without its record yet */
+	uint64_t				waitNs;				/* wait for a reply before a probe is lost */
+	tRttHistogram			rttHist;			/* RTT percentiles of the --output summary */
+	tRttJitter				rttJitter;			/* RTT jitter of the --output summary */
+#endif
 
 	tBool			seqReceived[MAX_SEQ];
 } tPingContext;
@@ -102,6 +108,10 @@ typedef struct sPingContext
  * - rtt: round-trip time
  * - type: ICMP type
  * - code: ICMP code
+ * - haveRtt: rtt is valid (the payload carried a send time)
+ * - rttNs: rtt in nanoseconds (hajping)
+ * - badOffset: payload offset of the first corrupted byte, -1 if intact
+ * - badWant / badGot: expected and received byte at badOffset
  */
 typedef struct sIcmpReplyInfo
 {
@@ -110,9 +120,22 @@ typedef struct sIcmpReplyInfo
 	struct timeval	rtt;	/* round-trip time */
 	uint8_t			type;	/* ICMP type */
 	uint8_t			code;	/* ICMP code */
+	tBool			haveRtt;	/* rtt holds a measured value */
+#if defined(HAJ)
+	uint64_t		rttNs;		/* rtt in nanoseconds */
+#endif
+	int32_t			badOffset;	/* first corrupted payload byte, -1 if none */
+	uint8_t			badWant;	/* byte that was sent at badOffset */
+	uint8_t			badGot;		/* byte that came back at badOffset */
 } tIcmpReplyInfo;
 
 
+/**
+ * @brief SIGINT handler, sets g_pingInterrupted
+ * @param sig - signal number (unused)
+ */
+void	handleSigInt(int sig);
+
 /**
  * @brief Run the main ping loop according to options
  * @param ctx - initialized ping context
@@ -6,6 +6,7 @@
 
 #include "../../common/includes/ip.h"
 #include "../../common/includes/icmp.h"
+#include "../../common/includes/probe.h"
 #include "../includes/parser.h"
 #include "ping.h"
 
@@ -29,6 +30,39 @@ void normalizeTimeval(struct timeval *tv);
  */
 uint32_t computeUserPayloadSize(const tPingOptions *opts);
 
+/**
+ * @brief Monotonic clock in nanoseconds (CLOCK_MONOTONIC)
+ * @return nanoseconds since an arbitrary start
+ */
+uint64_t monotonicNs(void);
+
+#if defined(HAJ)
+/**
+ * @brief Write the authenticated probe header for seq into hdr
+ * @param ctx - ping context (key, target, header size)
+ * @param seq - extended sequence number
+ * @param hdr - PROBE_HDR_LEN bytes
+ * @return header length written (0 when the payload has no room for one)
+ */
+uint32_t probeStamp(const tPingContext *ctx, uint32_t seq, uint8_t *hdr);
+
+/**
+ * @brief Authenticate the probe header of an echo reply
+ * @param ctx - ping context
+ * @param icmp - ICMP echo reply
+ * @param icmpLen - length of icmp
+ * @param arrivalNs - monotonic arrival time (kernel timestamp), 0 for now
+ * @param out - sequence and RTT of the authenticated probe
+ * @return 0 if the reply answers one of our probes, -1 otherwise
+ */
+int probeCheck(
+	const tPingContext *ctx,
+	const unsigned char *icmp,
+	size_t icmpLen,
+	uint64_t arrivalNs,
+	tProbeInfo *out);
+#endif
+
 /**
  * @brief Get milliseconds since midnight UTC
  * @return milliseconds since midnight
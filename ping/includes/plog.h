@@ -0,0 +1,297 @@
+#ifndef HAJPING_PLOG_H
+# define HAJPING_PLOG_H
+
+#include <endian.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "../../common/includes/utils.h"
+#include "output.h"
+
+#define PLOG_MAGIC			0x4C504A48	/**< "HJPL" */
+#define PLOG_BLOCK_MAGIC	0x42504A48	/**< "HJPB" */
+#define PLOG_VERSION		1
+#define PLOG_HEADER_SIZE	4096		/**< file header, one page so blocks stay page aligned */
+#define PLOG_BLOCK_SIZE		(1U << 20)	/**< bytes of a block, header included */
+#define PLOG_BLOCK_HDR_SIZE	64
+#define PLOG_NAME_LEN		256			/**< target name kept in the dictionary, NUL included */
+#define PLOG_ADDR_LEN		48			/**< address text kept in the dictionary, NUL included */
+#define PLOG_COMMIT			0xA5		/**< commit byte of a complete record or entry */
+#define PLOG_KEYS_INITIAL	64			/**< first allocation of the dictionary index, power of two */
+
+/**
+ * @brief Kind of a block
+ * - PLOG_BLOCK_DICT: target dictionary entries
+ * - PLOG_BLOCK_RECORDS: probe records
+ */
+typedef enum ePlogBlockType
+{
+	PLOG_BLOCK_DICT = 1,
+	PLOG_BLOCK_RECORDS
+} tPlogBlockType;
+
+/**
+ * @brief Flags of a probe record
+ * - PLOG_HAVE_RTT: rttNs is set
+ * - PLOG_HAVE_TTL: ttl is set
+ * - PLOG_HAVE_SIZE: size is set
+ * - PLOG_HAVE_ERROR: errType / errCode are set
+ */
+enum ePlogFlags
+{
+	PLOG_HAVE_RTT = 1 << 0,
+	PLOG_HAVE_TTL = 1 << 1,
+	PLOG_HAVE_SIZE = 1 << 2,
+	PLOG_HAVE_ERROR = 1 << 3
+};
+
+/**
+ * @brief File header, at offset 0 of a probe log (--probe-log)
+ * Every multi-byte field of the file is little-endian.
+ * - magic / version / headerSize / blockSize / recordSize / entrySize:
+ *   layout check, a reader rejects a file that does not match
+ * - blocks: blocks started, stored after the block header is written
+ * - createdNs: wall clock time the file was created (ns since the epoch)
+ */
+typedef struct sPlogHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	headerSize;
+	uint32_t	blockSize;
+	uint32_t	recordSize;
+	uint32_t	entrySize;
+	uint32_t	blocks;
+	uint32_t	reserved0;
+	uint64_t	createdNs;
+	uint8_t		reserved1[24];
+} tPlogHeader;
+
+/**
+ * @brief Block header, first PLOG_BLOCK_HDR_SIZE bytes of every block
+ * Block b starts at PLOG_HEADER_SIZE + b * PLOG_BLOCK_SIZE; its items
+ * follow the header back to back.
+ * - magic / type / index: block check, index is b
+ * - count: items committed, stored (release) after the item is complete
+ * - firstNs / lastNs: timestamps of the first and last records of a
+ *   records block, so a reader can skip a block out of its time range
+ */
+typedef struct sPlogBlock
+{
+	uint32_t	magic;
+	uint8_t		type;
+	uint8_t		reserved0[3];
+	uint32_t	index;
+	uint32_t	count;
+	uint64_t	firstNs;
+	uint64_t	lastNs;
+	uint8_t		reserved1[32];
+} tPlogBlock;
+
+/**
+ * @brief Dictionary entry, a target is its index among all entries of
+ * the file in block order
+ * - index: that index, as a check
+ * - commit: PLOG_COMMIT once the entry is complete
+ * - name / addr: target as given and its address, NUL terminated (a
+ *   longer name is cut)
+ */
+typedef struct sPlogEntry
+{
+	uint32_t	index;
+	uint8_t		commit;
+	uint8_t		reserved0[3];
+	char		name[PLOG_NAME_LEN];
+	char		addr[PLOG_ADDR_LEN];
+	uint8_t		reserved1[8];
+} tPlogEntry;
+
+/**
+ * @brief Probe record, one per probe outcome (as the --output records)
+ * - tsNs: wall clock time the outcome was seen (ns since the epoch)
+ * - rttNs: round-trip time in nanoseconds
+ * - target: dictionary index
+ * - seq: ICMP sequence of the probe
+ * - size: bytes of the ICMP reply or error
+ * - status: tOutputStatus
+ * - ttl: TTL / hop limit of the reply or error
+ * - errType / errCode: ICMP type and code of an error
+ * - flags: which of the fields above are set (ePlogFlags)
+ * - commit: PLOG_COMMIT once the record is complete
+ */
+typedef struct sPlogRecord
+{
+	uint64_t	tsNs;
+	uint64_t	rttNs;
+	uint32_t	target;
+	uint16_t	seq;
+	uint16_t	size;
+	uint8_t		status;
+	uint8_t		ttl;
+	uint8_t		errType;
+	uint8_t		errCode;
+	uint8_t		flags;
+	uint8_t		reserved[2];
+	uint8_t		commit;
+} tPlogRecord;
+
+#define PLOG_RECORDS_PER_BLOCK	((PLOG_BLOCK_SIZE - PLOG_BLOCK_HDR_SIZE) / sizeof(tPlogRecord))
+#define PLOG_ENTRIES_PER_BLOCK	((PLOG_BLOCK_SIZE - PLOG_BLOCK_HDR_SIZE) / sizeof(tPlogEntry))
+
+/*
+ * Layout helpers shared by the writer and the readers (hajstat), so both
+ * sides of the format stay the same code.
+ */
+
+/**
+ * @brief File offset of block b
+ */
+static inline off_t
+plogBlockOffset(uint32_t b)
+{
+	return ((off_t)PLOG_HEADER_SIZE + (off_t)b * PLOG_BLOCK_SIZE);
+}
+
+/**
+ * @brief Whether a header describes the layout of this build
+ */
+static inline tBool
+plogHeaderMatches(const tPlogHeader *hdr)
+{
+	return (le32toh(hdr->magic) == PLOG_MAGIC && le32toh(hdr->version) == PLOG_VERSION
+		&& le32toh(hdr->headerSize) == PLOG_HEADER_SIZE && le32toh(hdr->blockSize) == PLOG_BLOCK_SIZE
+		&& le32toh(hdr->recordSize) == sizeof(tPlogRecord)
+		&& le32toh(hdr->entrySize) == sizeof(tPlogEntry));
+}
+
+/**
+ * @brief Whether a mapped block is block b of the file
+ */
+static inline tBool
+plogBlockValid(const tPlogBlock *blk, uint32_t b)
+{
+	return (le32toh(blk->magic) == PLOG_BLOCK_MAGIC && le32toh(blk->index) == b);
+}
+
+/**
+ * @brief Items committed in a block, loaded (acquire) before the items
+ * are read and capped to what the block holds
+ */
+static inline uint32_t
+plogBlockCount(const tPlogBlock *blk)
+{
+	uint32_t	count = le32toh(__atomic_load_n(&blk->count, __ATOMIC_ACQUIRE));
+	uint32_t	max = blk->type == PLOG_BLOCK_DICT ? PLOG_ENTRIES_PER_BLOCK : PLOG_RECORDS_PER_BLOCK;
+
+	return (count > max ? max : count);
+}
+
+/**
+ * @brief Items of a block, right after its header
+ */
+static inline const tPlogEntry *
+plogBlockEntries(const tPlogBlock *blk)
+{
+	return ((const tPlogEntry *)((const uint8_t *)blk + PLOG_BLOCK_HDR_SIZE));
+}
+
+static inline const tPlogRecord *
+plogBlockRecords(const tPlogBlock *blk)
+{
+	return ((const tPlogRecord *)((const uint8_t *)blk + PLOG_BLOCK_HDR_SIZE));
+}
+
+/**
+ * @brief Whether a record or entry is complete, from its commit byte
+ */
+static inline tBool
+plogCommitted(const uint8_t *commit)
+{
+	return (__atomic_load_n(commit, __ATOMIC_ACQUIRE) == PLOG_COMMIT);
+}
+
+/**
+ * @brief FNV-1a of the name, a NUL and the address
+ */
+static inline uint64_t
+plogHash(const char *name, size_t nameLen, const char *addr, size_t addrLen)
+{
+	uint64_t	h = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < nameLen; i++)
+		h = (h ^ (uint8_t)name[i]) * 0x100000001b3ULL;
+	h *= 0x100000001b3ULL;
+	for (size_t i = 0; i < addrLen; i++)
+		h = (h ^ (uint8_t)addr[i]) * 0x100000001b3ULL;
+	return (h);
+}
+
+/**
+ * @brief Dictionary index of the writer, open addressing on the name and
+ * address (key NULL for a free slot)
+ */
+typedef struct sPlogKey
+{
+	uint64_t	hash;
+	uint32_t	index;
+	char		*key;
+} tPlogKey;
+
+/**
+ * @brief Append-only writer of a probe log
+ * The file is a header page followed by fixed-size blocks of dictionary
+ * entries or probe records. The header and the block being filled of
+ * each kind are mapped shared: a record is written in place, then its
+ * commit byte, then the block count, so a reader mapping the same file
+ * sees only complete records while the run goes on. Blocks are allocated
+ * on disk (posix_fallocate) before they are mapped, a full disk fails the
+ * log instead of faulting the writes. Running again on the same file
+ * appends after its last block and reuses its dictionary.
+ * - fd: log file, locked (flock) against a second writer
+ * - hdr: mapped header page
+ * - dict / recs: blocks being filled, NULL before the first one
+ * - entries: dictionary entries in the file, the index of the next one
+ * - keys / keyCount / keyCap: dictionary index, keyCap a power of two
+ *   kept at least twice keyCount
+ * - records: records written by this run
+ * - failed: a block could not be added, later records are discarded
+ */
+typedef struct sPlog
+{
+	int				fd;
+	tPlogHeader		*hdr;
+	tPlogBlock		*dict;
+	tPlogBlock		*recs;
+	uint32_t		entries;
+	tPlogKey		*keys;
+	size_t			keyCount;
+	size_t			keyCap;
+	uint64_t		records;
+	tBool			failed;
+} tPlog;
+
+/**
+ * @brief Open or create a probe log and load its dictionary
+ * @param log - writer to initialize
+ * @param path - log file
+ * @return 0 on success, -1 with a message on error
+ */
+int		plogOpen(tPlog *log, const char *path);
+
+/**
+ * @brief Append the record of one probe outcome
+ * A target seen for the first time gets a dictionary entry first.
+ * @param log - writer, NULL when the log is off
+ * @param probe - the outcome
+ */
+void	plogProbe(tPlog *log, const tOutputProbe *probe);
+
+/**
+ * @brief Write the mapped blocks out, unmap them and close the file
+ * @param log - writer, NULL when the log is off
+ * @param verbose - print the record and target counts
+ */
+void	plogClose(tPlog *log, int verbose);
+
+#endif /* HAJPING_PLOG_H */
@@ -0,0 +1,79 @@
+#ifndef HAJPING_PMTU_H
+# define HAJPING_PMTU_H
+
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "ping.h"
+
+#define PMTU_PROBES_PER_ROUND	4		/**< probes in flight per search round */
+#define PMTU_MAX_ROUNDS			16		/**< give up after this many rounds */
+#define PMTU_MAX_SIZE			65535	/**< largest IP packet we may build */
+#define PMTU_MIN_V4				68		/**< RFC 791 minimum IPv4 MTU */
+#define PMTU_MIN_V6				1280	/**< RFC 8200 minimum IPv6 MTU */
+#define PMTU_MIN_WAIT_MS		50		/**< lower bound of a round wait */
+
+/**
+ * @brief State of one PMTU probe
+ * - PMTU_PROBE_PENDING: sent, no answer yet
+ * - PMTU_PROBE_OK: echo reply received, the size fits
+ * - PMTU_PROBE_TOO_BIG: local EMSGSIZE or remote frag-needed / packet-too-big
+ * - PMTU_PROBE_LOST: no answer before the round deadline
+ */
+typedef enum ePmtuProbeState
+{
+	PMTU_PROBE_PENDING = 0,
+	PMTU_PROBE_OK,
+	PMTU_PROBE_TOO_BIG,
+	PMTU_PROBE_LOST
+} tPmtuProbeState;
+
+/**
+ * @brief One in-flight PMTU probe
+ * - seq: ICMP sequence number
+ * - size: IP packet size probed (header included)
+ * - state: probe outcome
+ * - reportedMtu: MTU reported by the error (0 if none)
+ * - sentAt: send time
+ */
+typedef struct sPmtuProbe
+{
+	uint16_t		seq;
+	uint32_t		size;
+	tPmtuProbeState	state;
+	uint32_t		reportedMtu;
+	struct timeval	sentAt;
+} tPmtuProbe;
+
+/**
+ * @brief Result of a path MTU search
+ * - mtu: largest packet size confirmed by an echo reply (0 if none)
+ * - lo / hi: final search bounds
+ * - rounds: number of rounds used
+ * - probes: number of probes sent
+ * - reporter: last router that sent frag-needed / packet-too-big
+ * - haveReporter: whether reporter is valid
+ * - blackHole: an upper bound came from silent loss, not from an ICMP error
+ */
+typedef struct sPmtuResult
+{
+	uint32_t				mtu;
+	uint32_t				lo;
+	uint32_t				hi;
+	unsigned int			rounds;
+	unsigned int			probes;
+	struct sockaddr_storage	reporter;
+	tBool					haveReporter;
+	tBool					blackHole;
+} tPmtuResult;
+
+/**
+ * @brief Discover the path MTU towards ctx->targetAddr
+ * Sends DF probes of several sizes per round and binary-searches
+ * between the largest size that got a reply and the smallest size
+ * rejected (EMSGSIZE, frag-needed, packet-too-big or silent loss).
+ * @param ctx - initialized ping context
+ */
+void	runPmtuDiscovery(tPingContext *ctx);
+
+#endif /* HAJPING_PMTU_H */
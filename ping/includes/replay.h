@@ -0,0 +1,54 @@
+#ifndef HAJPING_REPLAY_H
+# define HAJPING_REPLAY_H
+
+#include <stdint.h>
+
+#include "parser.h"
+#include "pcap.h"
+#include "table.h"
+
+#define REPLAY_WAIT_DEFAULT	10	/**< seconds a request waits for its reply without -W */
+
+/**
+ * @brief Offline run over a capture file
+ * - opts: parsed options (-q, -v, -W, -4 / -6)
+ * - path: capture file
+ * - table: responders, keyed by (address, ICMP identifier) like live
+ *   targets; probe records hold the capture time of each request
+ * - waitNs: capture time after which an unanswered request is lost
+ * - firstNs / lastNs: capture time of the first and last packet
+ * - packets / bytes: records read and their captured bytes
+ * - icmp: echo requests, replies and errors handed to the pipeline
+ * - skipped: packets that are not ICMP, fragments, truncated headers
+ * - unmatched: replies and errors without a captured request
+ * - inflight: requests neither answered nor timed out yet
+ */
+typedef struct sReplay
+{
+	const tPingOptions	*opts;
+	const char			*path;
+	tTargetTable		table;
+	uint64_t			waitNs;
+	uint64_t			firstNs;
+	uint64_t			lastNs;
+	uint64_t			packets;
+	uint64_t			bytes;
+	uint64_t			icmp;
+	uint64_t			skipped;
+	uint64_t			unmatched;
+	uint64_t			inflight;
+} tReplay;
+
+/**
+ * @brief Feed the ICMP packets of a capture through the receive path (--replay)
+ * Echo requests stand for the probes sent, the capture timestamps are
+ * the clock: a reply is timed against its request, a request unanswered
+ * after -W seconds of capture time is lost. Packets are read from a
+ * read-only mapping as fast as they can be parsed.
+ * @param opts - parsed options
+ * @param path - classic pcap or pcapng file
+ * @return 0 on success, -1 if the file cannot be read
+ */
+int		runReplay(const tPingOptions *opts, const char *path);
+
+#endif /* HAJPING_REPLAY_H */
@@ -0,0 +1,124 @@
+#ifndef HAJPING_RESOLVER_H
+# define HAJPING_RESOLVER_H
+
+#include <netdb.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ping.h"
+
+#define RESOLVER_DEFAULT_LIMIT		64	/**< lookups in flight */
+#define RESOLVER_DEFAULT_TIMEOUT	5	/**< seconds per lookup */
+#define RESOLVE_ERR_TIMEOUT			1	/**< lookup gave up, EAI_* codes are negative */
+
+/**
+ * @brief Life cycle of one lookup
+ * - RESOLVE_QUEUED: not submitted yet
+ * - RESOLVE_RUNNING: submitted to getaddrinfo_a
+ * - RESOLVE_DONE: reported to the caller, result released
+ * - RESOLVE_ABANDONED: reported as timed out but still owned by the
+ *   resolver thread (gai_cancel refused), released once it completes
+ */
+typedef enum eResolveState
+{
+	RESOLVE_QUEUED = 0,
+	RESOLVE_RUNNING,
+	RESOLVE_DONE,
+	RESOLVE_ABANDONED
+} tResolveState;
+
+/**
+ * @brief One asynchronous lookup, defined in resolver.c so that users of
+ * this header do not need _GNU_SOURCE for struct gaicb
+ */
+typedef struct sResolveJob	tResolveJob;
+
+/**
+ * @brief Called once per host, in completion order
+ * @param arg - caller data given to resolverPoll
+ * @param host - name that was resolved
+ * @param list - addresses, NULL on failure (freed after the call)
+ * @param err - 0, a getaddrinfo error code or RESOLVE_ERR_TIMEOUT
+ */
+typedef void	(*tResolveCb)(void *arg, const char *host, const struct addrinfo *list, int err);
+
+/**
+ * @brief Concurrent resolver built on getaddrinfo_a
+ * Every completion writes one byte to a pipe so the caller can select()
+ * on resolverFd() next to its sockets.
+ * - jobs / count: one lookup per host
+ * - names: copies of the hosts handed to getaddrinfo_a, so a lookup left
+ *   running by resolverFree never reads the caller's strings
+ * - next: first job not submitted yet
+ * - active / running: indexes of the submitted jobs still pending
+ * - reported: number of hosts handed to the callback
+ * - limit: maximum number of lookups in flight
+ * - timeoutNs: per lookup timeout
+ * - notify: completion pipe, notify[0] is polled by the caller
+ */
+typedef struct sResolver
+{
+	tResolveJob	*jobs;
+	size_t		count;
+	char		*names;
+	size_t		next;
+	size_t		*active;
+	size_t		running;
+	size_t		reported;
+	int			limit;
+	uint64_t	timeoutNs;
+	int			notify[2];
+} tResolver;
+
+/**
+ * @brief Prepare lookups for hosts (nothing is submitted yet)
+ * @param res - resolver to initialize
+ * @param hosts - names to resolve, passed back to the callback
+ * @param count - number of names
+ * @param ipMode - address family restriction
+ * @param limit - maximum lookups in flight (0 for the default)
+ * @param timeoutSec - per lookup timeout in seconds (0 for the default)
+ * @return 0 on success, -1 on failure
+ */
+int		resolverInit(
+	tResolver	*res,
+	char		**hosts,
+	size_t		count,
+	tIpType		ipMode,
+	int			limit,
+	int			timeoutSec);
+
+/**
+ * @brief Report finished lookups, cancel expired ones and submit queued ones
+ * Never blocks.
+ * @param res - resolver
+ * @param cb - called for every host that finished since the last call
+ * @param arg - passed to cb
+ * @return number of hosts reported
+ */
+size_t	resolverPoll(tResolver *res, tResolveCb cb, void *arg);
+
+/**
+ * @brief File descriptor that becomes readable when a lookup completes
+ */
+int		resolverFd(const tResolver *res);
+
+/**
+ * @brief Nanoseconds until the earliest pending lookup times out
+ * @return delay, UINT64_MAX when nothing is pending
+ */
+uint64_t	resolverNextDeadline(const tResolver *res);
+
+/**
+ * @brief Whether every host has been reported
+ */
+tBool	resolverFinished(const tResolver *res);
+
+/**
+ * @brief Release the resolver
+ * Lookups still owned by a getaddrinfo_a thread keep their memory.
+ * @param res - resolver
+ */
+void	resolverFree(tResolver *res);
+
+#endif /* HAJPING_RESOLVER_H */
@@ -0,0 +1,137 @@
+#ifndef HAJPING_RXPOOL_H
+# define HAJPING_RXPOOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/probe.h"
+#include "../../common/includes/utils.h"
+#include "rxring.h"
+#include "stats.h"
+#include "table.h"
+
+#define RXPOOL_MAX_WORKERS	64		/**< highest --rx-workers */
+#define RXPOOL_SHARD_INITIAL	256		/**< first allocation of a shard, power of two */
+#define RXPOOL_BATCH		256		/**< packets read from one ring before turning to the other */
+#define RXPOOL_POLL_MS		50		/**< a worker with nothing to read checks for the end this often */
+
+/**
+ * @brief What one worker learnt about one address
+ * - key: address the replies came from (family 0 for a free slot)
+ * - stats: received, duplicates, errors and RTT sums (sent stays 0)
+ * - hist / jitter: RTT percentiles and jitter
+ * - top / window: duplicate window, as in the target table
+ */
+typedef struct sRxShardEntry
+{
+	tTargetKey		key;
+	tPingStats		stats;
+	tRttHistogram	hist;
+	tRttJitter		jitter;
+	uint32_t		top;
+	uint64_t		window;
+} tRxShardEntry;
+
+/**
+ * @brief Receive thread owning one member ring of each fanout group
+ * Only the worker writes its shard, the probing thread reads it once the
+ * worker has been joined.
+ * - pool: pool the worker belongs to
+ * - thread / started: the thread, started until joined
+ * - rings: rings[0] IPv4 and rings[1] IPv6 (fd -1 if unused)
+ * - entries / count / cap: open-addressing shard, cap a power of two kept
+ *   at least twice count
+ * - rejected: replies that failed authentication or came too late
+ * - dropped: replies lost to a failed shard allocation
+ * - replies: first replies accounted, read while the worker runs (on its
+ *   own cache line)
+ */
+typedef struct sRxWorker
+{
+	struct sRxPool		*pool;
+	pthread_t			thread;
+	tBool				started;
+	tRxRing				rings[2];
+	tRxShardEntry		*entries;
+	size_t				count;
+	size_t				cap;
+	uint64_t			rejected;
+	uint64_t			dropped;
+	_Alignas(64) _Atomic uint64_t	replies;
+} tRxWorker;
+
+/**
+ * @brief Receive workers of the concurrent engine (--rx-workers)
+ * Every worker opens a packet ring per family and joins it to the
+ * family's PACKET_FANOUT group, so the kernel spreads the replies over the
+ * workers by flow hash instead of queueing them all on one socket: every
+ * reply of an address reaches the same worker. Workers authenticate
+ * and account replies in their own shard with no lock; the shards are
+ * merged into the target table once the workers are stopped.
+ * - workers / count: the workers
+ * - groups: fanout group id of each family (0 if unused)
+ * - probeKey / stampLen: probe header key and size, as in the engine
+ * - ident: ICMP identifier of the probes
+ * - stop: set to end the workers
+ */
+typedef struct sRxPool
+{
+	tRxWorker		*workers;
+	unsigned int	count;
+	uint16_t		groups[2];
+	uint8_t			probeKey[PROBE_KEY_LEN];
+	uint32_t		stampLen;
+	uint16_t		ident;
+	_Atomic int		stop;
+} tRxPool;
+
+/**
+ * @brief Open the rings of every worker and start the workers
+ * @param pool - pool to initialize
+ * @param count - number of workers, 1 to RXPOOL_MAX_WORKERS
+ * @param families - bit 0 IPv4, bit 1 IPv6
+ * @param ident - ICMP identifier of the probes
+ * @param probeKey - probe header key (PROBE_KEY_LEN bytes)
+ * @param stampLen - probe header size, 0 when the payload holds none
+ * @return 0 on success, -1 with a message on error
+ */
+int			rxPoolStart(
+	tRxPool			*pool,
+	unsigned int	count,
+	unsigned int	families,
+	uint16_t		ident,
+	const uint8_t	*probeKey,
+	uint32_t		stampLen);
+
+/**
+ * @brief First replies accounted so far by every worker, without a lock
+ * @param pool - started pool
+ */
+uint64_t	rxPoolReplies(const tRxPool *pool);
+
+/**
+ * @brief End and join the workers, their shards stay readable
+ * @param pool - pool, may be stopped already
+ */
+void		rxPoolStop(tRxPool *pool);
+
+/**
+ * @brief Add the shards of stopped workers to the target statistics
+ * Replies from an address that is not a target are left out. Probes
+ * never answered are counted lost.
+ * @param pool - stopped pool
+ * @param table - targets, stats sent already filled
+ * @param verbose - print per-worker counts
+ */
+void		rxPoolMerge(const tRxPool *pool, tTargetTable *table, int verbose);
+
+/**
+ * @brief Stop the workers, close their rings and release the shards
+ * @param pool - pool, may be partly started
+ * @param verbose - print the packet and kernel drop counts of every ring
+ */
+void		rxPoolClose(tRxPool *pool, int verbose);
+
+#endif /* HAJPING_RXPOOL_H */
@@ -0,0 +1,105 @@
+#ifndef HAJPING_RXRING_H
+# define HAJPING_RXRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/utils.h"
+
+#define RXRING_BLOCK_SIZE	(1U << 18)	/**< bytes per ring block, multiple of the page size */
+#define RXRING_BLOCKS		16			/**< blocks in the ring */
+#define RXRING_FRAME_SIZE	2048		/**< nominal frame size, V3 packs packets tighter */
+#define RXRING_BLOCK_TOV_MS	4			/**< a partly filled block is handed over after this */
+
+/**
+ * @brief AF_PACKET TPACKET_V3 receive ring (--packet-ring)
+ * The kernel fills whole blocks of packets in a shared mapping and hands
+ * each one over at once; packets are read in place and the block goes
+ * back to the kernel when its last packet has been consumed.
+ * - fd: packet socket, bound to the IPv4 or IPv6 ethertype, SOCK_DGRAM so
+ *   packets start at the network header
+ * - map / mapLen: the ring mapping
+ * - block: index of the block being read (or waited for)
+ * - held: block is owned by us, left packets remain, next is the next one
+ * - offsetNs: CLOCK_REALTIME - CLOCK_MONOTONIC, sampled per block
+ * - packets / blocks: packets and blocks consumed
+ */
+typedef struct sRxRing
+{
+	int				fd;
+	uint8_t			*map;
+	size_t			mapLen;
+	unsigned int	block;
+	tBool			held;
+	uint32_t		left;
+	const uint8_t	*next;
+	int64_t			offsetNs;
+	uint64_t		packets;
+	uint64_t		blocks;
+} tRxRing;
+
+/**
+ * @brief One packet read in place from the ring
+ * - data / len: network header onwards, valid until the next rxRingNext
+ * - arrivalNs: kernel receive timestamp on the CLOCK_MONOTONIC scale
+ */
+typedef struct sRxPacket
+{
+	const uint8_t	*data;
+	uint32_t		len;
+	uint64_t		arrivalNs;
+} tRxPacket;
+
+/**
+ * @brief Open a ring receiving the ICMP replies and errors of one family
+ * A BPF filter lets through echo replies carrying ident and the error
+ * types a raw ICMP socket would accept; looped back outgoing packets
+ * are skipped.
+ * @param ring - ring to initialize
+ * @param family - AF_INET or AF_INET6
+ * @param ident - ICMP identifier of our echo requests
+ * @return 0 on success, -1 with a message on error
+ */
+int		rxRingOpen(tRxRing *ring, int family, uint16_t ident);
+
+/**
+ * @brief Make the ring one member of a PACKET_FANOUT group
+ * The kernel hands each packet to a single member of the group, picked
+ * by mode; the ring must be open (bound) first.
+ * @param ring - open ring
+ * @param group - group id, 0 to create a group: set to the id the kernel chose
+ * @param mode - PACKET_FANOUT_HASH...
+ * @return 0 on success, -1 with a message on error
+ */
+int		rxRingFanout(tRxRing *ring, uint16_t *group, int mode);
+
+/**
+ * @brief Take the next packet, giving back the previous block once it is consumed
+ * @param ring - open ring
+ * @param pkt - filled with the packet
+ * @return TRUE if a packet was taken, FALSE if the ring is empty
+ */
+tBool	rxRingNext(tRxRing *ring, tRxPacket *pkt);
+
+/**
+ * @brief Tell whether rxRingNext would return a packet, without a syscall
+ * @param ring - open ring
+ * @return TRUE if a packet is waiting
+ */
+tBool	rxRingReady(const tRxRing *ring);
+
+/**
+ * @brief Stop a socket from queueing what the ring now receives
+ * @param fd - raw ICMP socket kept for sending
+ * @return 0 on success, -1 on error
+ */
+int		rxRingMuteSocket(int fd);
+
+/**
+ * @brief Unmap the ring and close its socket
+ * @param ring - ring, may be unopened (fd -1)
+ * @param verbose - print packet, block and kernel drop counts
+ */
+void	rxRingClose(tRxRing *ring, int verbose);
+
+#endif /* HAJPING_RXRING_H */
@@ -5,6 +5,10 @@
 
 # include "parser.h"
 
+#if defined(HAJ)
+# define SOCKET_USER_RATE	1000	/**< default probes per second of unprivileged sockets */
+#endif
+
 /**
  * @brief Enumeration describing the privilege level available
  * - SOCKET_PRIV_USER: unprivileged user
@@ -84,6 +88,20 @@ int					sockValidatePrivileges(
 						const tPingOptions	*opts,
 						tSocketPrivilege	privilege);
 
+#if defined(HAJ)
+/**
+ * @brief Send rate ceiling in effect for a socket
+ * Unprivileged sockets may flood and preload, but never faster than
+ * --rate (SOCKET_USER_RATE by default).
+ * @param opts - parsed ping options
+ * @param privilege - privilege level of the socket
+ * @return probes per second, 0 for no ceiling
+ */
+unsigned int		sockRateLimit(
+						const tPingOptions	*opts,
+						tSocketPrivilege	privilege);
+#endif
+
 /**
  * @brief Create the socket according to the initialized context
  * @param ctx - socket context
@@ -119,4 +137,24 @@ int					socketApplyCommonOptions(tPingSocket *ctx, const tPingOptions *opts);
  */
 int					socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts);
 
+/**
+ * @brief Prepare the socket for path MTU probing
+ * - IPv4: IP_MTU_DISCOVER = IP_PMTUDISC_PROBE (DF set, cached PMTU ignored)
+ * - IPv6: IPV6_MTU_DISCOVER = IPV6_PMTUDISC_PROBE and IPV6_DONTFRAG
+ * - IP_RECVERR / IPV6_RECVERR so that "fragmentation needed" and
+ *   "packet too big" errors are queued with the reported MTU
+ * @param ctx - socket context
+ * @return 0 on success, -1 on error
+ */
+int					socketApplyPmtuOptions(tPingSocket *ctx);
+
+/**
+ * @brief Get the MTU of the route towards a destination
+ * Uses a temporary connected UDP socket and IP_MTU / IPV6_MTU.
+ * @param dst - destination address
+ * @param dstLen - length of dst
+ * @return route MTU in bytes, 0 if unknown
+ */
+int					socketRouteMtu(const struct sockaddr_storage *dst, socklen_t dstLen);
+
 #endif
@@ -0,0 +1,143 @@
+#ifndef HAJPING_STATS_H
+# define HAJPING_STATS_H
+
+#include <stddef.h>
+
+#define RTT_HIST_BUCKETS	32	/**< log2 buckets in microseconds: [0,1), [1,2), [2,4) ... */
+
+/**
+ * @brief Ping statistics
+ * - sent: number of packets sent
+ * - received: number of packets received
+ * - lost: number of lost packets
+ * - rttMin: minimum round-trip time (ms)
+ * - rttMax: maximum round-trip time (ms)
+ * - rttSum: sum of RTTs (for average)
+ * - rttSumSq: sum of squares of RTTs (for stddev)
+ * - rttCount: number of RTT samples accumulated
+ * - corrupted: echo replies whose payload differs from the one sent
+ */
+typedef struct sPingStats
+{
+	unsigned int	sent;		/* number of packets sent */
+	unsigned int	received;	/* number of packets received */
+	unsigned int	lost;		/* number of lost packets */
+	unsigned int	errors;		/* number of errors (e.g., invalid ICMP replies) */
+	unsigned int	duplicates;	/* number of duplicate replies */
+	double			rttMin;		/* minimum round-trip time (ms) */
+	double			rttMax;		/* maximum round-trip time (ms) */
+	double			rttSum;		/* sum of RTTs (for average) */
+	double			rttSumSq;	/* sum of squares of RTTs (for stddev) */
+	unsigned int	rttCount;	/* number of RTT samples in rttSum */
+	unsigned int	corrupted;	/* replies with a corrupted payload */
+} tPingStats;
+
+/**
+ * @brief Fixed-size RTT histogram
+ * Bucket i counts samples in [2^(i-1), 2^i) microseconds (bucket 0 is < 1us),
+ * so memory stays bounded whatever the run length.
+ */
+typedef struct sRttHistogram
+{
+	unsigned int	buckets[RTT_HIST_BUCKETS];
+	unsigned int	total;
+} tRttHistogram;
+
+/**
+ * @brief Inter-arrival jitter estimator (RFC 3550 section 6.4.1)
+ * - lastRtt: previous RTT sample (ms)
+ * - jitter: smoothed mean deviation between consecutive RTTs (ms)
+ * - primed: whether lastRtt holds a sample
+ * - firstRtt / updates: first sample and samples after it, to continue an
+ *   estimator that ran on the samples before (rttJitterMerge)
+ */
+typedef struct sRttJitter
+{
+	double			lastRtt;
+	double			jitter;
+	int				primed;
+	double			firstRtt;
+	unsigned int	updates;
+} tRttJitter;
+
+/**
+ * @brief Reset all counters of a statistics accumulator
+ * @param stats - statistics to reset
+ */
+void	pingStatsReset(tPingStats *stats);
+
+/**
+ * @brief Accumulate one RTT sample (min/max/sum/sum of squares)
+ * @param stats - statistics to update
+ * @param ms - round-trip time in milliseconds
+ */
+void	pingStatsAddRtt(tPingStats *stats, double ms);
+
+/**
+ * @brief Add the counters and RTT samples of one accumulator to another
+ * @param dst - statistics to update
+ * @param src - statistics added, kept apart until now (other thread, other file)
+ */
+void	pingStatsMerge(tPingStats *dst, const tPingStats *src);
+
+/**
+ * @brief Mean RTT over accumulated samples
+ * @param stats - statistics
+ * @return average RTT in ms, 0 if no sample
+ */
+double	pingStatsAvg(const tPingStats *stats);
+
+/**
+ * @brief Standard deviation of accumulated RTT samples
+ * @param stats - statistics
+ * @return standard deviation in ms, 0 if less than two samples
+ */
+double	pingStatsStddev(const tPingStats *stats);
+
+/**
+ * @brief Loss percentage, duplicates excluded from the received count
+ * @param stats - statistics
+ * @return loss in percent (0 when nothing was sent)
+ */
+double	pingStatsLoss(const tPingStats *stats);
+
+/**
+ * @brief Add one RTT sample to a histogram
+ * @param hist - histogram to update
+ * @param ms - round-trip time in milliseconds
+ */
+void	rttHistAdd(tRttHistogram *hist, double ms);
+
+/**
+ * @brief Add every sample of one histogram to another
+ * @param dst - histogram to update
+ * @param src - histogram added
+ */
+void	rttHistMerge(tRttHistogram *dst, const tRttHistogram *src);
+
+/**
+ * @brief Estimate a percentile from the histogram (upper bucket bound)
+ * @param hist - histogram
+ * @param percentile - percentile in [0, 100]
+ * @return estimated RTT in ms, 0 if empty
+ */
+double	rttHistPercentile(const tRttHistogram *hist, double percentile);
+
+/**
+ * @brief Feed one RTT sample to the jitter estimator
+ * @param jit - jitter state
+ * @param ms - round-trip time in milliseconds
+ */
+void	rttJitterAdd(tRttJitter *jit, double ms);
+
+/**
+ * @brief Continue an estimator with the samples another one saw next
+ * src ran from a zero jitter, so its start decays by 15/16 per update:
+ * the result is what one estimator fed both runs in order would hold,
+ * up to rounding.
+ * @param dst - estimator of the earlier samples, updated
+ * @param src - estimator of the samples that followed
+ */
+void	rttJitterMerge(tRttJitter *dst, const tRttJitter *src);
+
+#endif /* HAJPING_STATS_H */
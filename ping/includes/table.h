@@ -0,0 +1,200 @@
+#ifndef HAJPING_TABLE_H
+# define HAJPING_TABLE_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "../../common/includes/utils.h"
+#include "arena.h"
+#include "stats.h"
+
+#define TABLE_INITIAL_CAP	64				/**< first allocation of every array */
+#define TABLE_NONE			((size_t)-1)	/**< "no target" index */
+#define TABLE_WINDOW		64				/**< replies tracked per target for duplicates, probes in flight */
+#define TABLE_RECORD_SLAB	1024			/**< probe records allocated at once */
+
+/**
+ * @brief Reply demultiplexing key
+ * - addr: peer address, IPv4 in the first 4 bytes
+ * - ident: ICMP identifier the probes carry (0 when the kernel already
+ *   demultiplexes by identifier, DGRAM sockets)
+ * - family: AF_INET or AF_INET6
+ */
+typedef struct sTargetKey
+{
+	uint8_t		addr[16];
+	uint16_t	ident;
+	uint8_t		family;
+	uint8_t		reserved;
+} tTargetKey;
+
+/**
+ * @brief Probe sent and not settled yet (answered or timed out)
+ * - next: next probe of the same target
+ * - sentNs: monotonic send time, the timeout runs from it
+ */
+typedef struct sProbeRecord
+{
+	struct sProbeRecord	*next;
+	uint64_t			sentNs;
+} tProbeRecord;
+
+/**
+ * @brief Outcome of recording a reply in the duplicate window
+ * - REPLY_NEW: first reply for this sequence
+ * - REPLY_DUP: sequence already answered
+ * - REPLY_STALE: older than the window, cannot be told apart from a duplicate
+ */
+typedef enum eReplyMark
+{
+	REPLY_NEW = 0,
+	REPLY_DUP,
+	REPLY_STALE
+} tReplyMark;
+
+/**
+ * @brief Every probed address, one array per field
+ * Sending and receiving only touch the hot arrays, so the working set of
+ * 100k targets is a few megabytes instead of one context per target.
+ * Targets are found from a reply through an open-addressing index.
+ * - count / cap: targets stored, allocated size of every array
+ * hot:
+ * - stats: per-target counters and RTT sums
+ * - seq: next sequence number to send
+ * - top / window: highest answered sequence, bit n set when top - n was
+ *   answered (window 0 = no reply yet)
+ * - nextNs: scheduled time of the next probe (monotonic nanoseconds)
+ * - oldest / unacked: first sequence still awaiting its reply or timeout,
+ *   bit n set while probe oldest + n is unanswered
+ * - first / last: records of the probes from oldest on, oldest first
+ * index:
+ * - keys: demultiplexing key of each target
+ * - slots / slotCap: (hash tag << 32) | (index + 1), 0 for a free slot;
+ *   slotCap is a power of two kept at least twice count
+ * cold:
+ * - scope: IPv6 scope id for sendto
+ * - ip: printable address (in names)
+ * - host / aliases / aliasCount: names resolving to the address (the names
+ *   are not owned, the alias arrays live in names)
+ * - hist / jitter: RTT percentiles and jitter, read for the summary
+ * storage:
+ * - names: arena of the per-target strings and alias arrays
+ * - records: pool of the probe records, reused at the probe rate
+ */
+typedef struct sTargetTable
+{
+	size_t			count;
+	size_t			cap;
+	tPingStats		*stats;
+	uint32_t		*seq;
+	uint32_t		*top;
+	uint64_t		*window;
+	uint64_t		*nextNs;
+	uint32_t		*oldest;
+	uint64_t		*unacked;
+	tProbeRecord	**first;
+	tProbeRecord	**last;
+	tTargetKey		*keys;
+	uint64_t		*slots;
+	size_t			slotCap;
+	uint32_t		*scope;
+	const char		**ip;
+	const char		**host;
+	const char		***aliases;
+	uint32_t		*aliasCount;
+	tRttHistogram	*hist;
+	tRttJitter		*jitter;
+	tArena			names;
+	tPool			records;
+} tTargetTable;
+
+/**
+ * @brief Start an empty table
+ * @param table - table to initialize
+ */
+void		targetTableInit(tTargetTable *table);
+
+/**
+ * @brief Build the key of an address
+ * @param key - key to fill
+ * @param addr - AF_INET or AF_INET6 address
+ * @param ident - ICMP identifier
+ * @return 0 on success, -1 for another family
+ */
+int			targetTableKey(tTargetKey *key, const struct sockaddr_storage *addr, uint16_t ident);
+
+/**
+ * @brief Hash a key: 64-bit multiply / xorshift over its five words
+ * The high half tags the slot, the low half picks the bucket.
+ */
+uint64_t	targetTableHash(const tTargetKey *key);
+
+/**
+ * @brief Find the target of a key in O(1)
+ * @return target index, TABLE_NONE if unknown
+ */
+size_t		targetTableFind(const tTargetTable *table, const tTargetKey *key);
+
+/**
+ * @brief Append a target (the caller checked it is not there yet)
+ * @param table - table
+ * @param key - demultiplexing key
+ * @param scope - IPv6 scope id
+ * @param host - name the address was resolved from, must outlive the table
+ * @return new index, TABLE_NONE on allocation failure
+ */
+size_t		targetTableAdd(tTargetTable *table, const tTargetKey *key, uint32_t scope, const char *host);
+
+/**
+ * @brief Record one more name for a target
+ * @return 0 on success (or name already known), -1 on allocation failure
+ */
+int			targetTableAddAlias(tTargetTable *table, size_t i, const char *host);
+
+/**
+ * @brief Destination address of a target for sendto
+ * @param out - sockaddr to fill
+ * @return length of the address
+ */
+socklen_t	targetTableSockaddr(const tTargetTable *table, size_t i, struct sockaddr_storage *out);
+
+/**
+ * @brief Record probe seq[i] of a target as sent
+ * @param sentNs - monotonic send time
+ * @return 0 on success, -1 on allocation failure
+ */
+int			targetTableProbe(tTargetTable *table, size_t i, uint64_t sentNs);
+
+/**
+ * @brief Settle the oldest probe of a target and release its record
+ * @return TRUE if it was never answered
+ */
+tBool		targetTableRetire(tTargetTable *table, size_t i);
+
+/**
+ * @brief Clear the in-flight bit of an answered probe
+ * @param seq - extended sequence number of the reply
+ * @return TRUE if the probe was in flight
+ */
+tBool		targetTableAck(tTargetTable *table, size_t i, uint32_t seq);
+
+/**
+ * @brief Bytes held by the table: arrays, index, names and probe records
+ */
+size_t		targetTableMemory(const tTargetTable *table);
+
+/**
+ * @brief Record a reply sequence in the target duplicate window
+ * @param seq - extended sequence number of the reply
+ */
+tReplyMark	targetTableMark(tTargetTable *table, size_t i, uint32_t seq);
+
+/**
+ * @brief Release every array
+ * @param table - table
+ */
+void		targetTableFree(tTargetTable *table);
+
+#endif /* HAJPING_TABLE_H */
@@ -0,0 +1,61 @@
+#ifndef HAJPING_TARGETS_H
+# define HAJPING_TARGETS_H
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "ping.h"
+
+#define TARGET_NAME_MAX		255			/**< longest host name accepted */
+#define TARGET_READ_SIZE	(64 << 10)	/**< read() size for pipes */
+#define TARGET_INITIAL_CAP	64			/**< first allocation of hosts */
+
+/**
+ * @brief De-duplicated host names from the command line and target lists
+ * - hosts / count / cap: names in input order, argv strings or copies in names
+ * - names: storage of the names read from lists
+ * - slots / slotCap: open-addressing set of host indexes + 1 (0 = free),
+ *   slotCap is a power of two kept at least twice count
+ */
+typedef struct sTargetList
+{
+	char			**hosts;
+	size_t			count;
+	size_t			cap;
+	tArena			names;
+	size_t			*slots;
+	size_t			slotCap;
+} tTargetList;
+
+/**
+ * @brief Start an empty list
+ * @param list - list to initialize
+ */
+void	targetListInit(tTargetList *list);
+
+/**
+ * @brief Add command line hosts, referenced in place
+ * @param list - target list
+ * @param hosts - argv strings
+ * @param count - number of hosts
+ * @return 0 on success, -1 on allocation failure
+ */
+int		targetListAddArgs(tTargetList *list, char **hosts, size_t count);
+
+/**
+ * @brief Stream a target list: one host per line, '#' starts a comment
+ * Regular files are mapped and scanned in place, anything else (a pipe,
+ * "-" for stdin) is read in blocks. Names already listed are skipped.
+ * @param list - target list
+ * @param path - file name, "-" for stdin
+ * @return 0 on success, -1 on failure (reported)
+ */
+int		targetListRead(tTargetList *list, const char *path);
+
+/**
+ * @brief Release the list and every stored name
+ * @param list - target list
+ */
+void	targetListFree(tTargetList *list);
+
+#endif /* HAJPING_TARGETS_H */
@@ -0,0 +1,106 @@
+#ifndef HAJPING_WHEEL_H
+# define HAJPING_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/utils.h"
+
+#define WHEEL_TICK_SHIFT	16					/**< tick of 2^16 ns (65.5 us) */
+#define WHEEL_SLOT_BITS		6
+#define WHEEL_SLOTS			(1 << WHEEL_SLOT_BITS)	/**< slots per level, one bitmap word */
+#define WHEEL_LEVELS		6					/**< 2^36 ticks: about 52 days */
+#define WHEEL_NIL			UINT32_MAX			/**< end of a slot list */
+#define WHEEL_UNARMED		UINT16_MAX			/**< timer in no slot */
+
+/**
+ * @brief Hierarchical timing wheel
+ * Level L holds the timers whose tick first differs from the current tick
+ * in its L-th group of WHEEL_SLOT_BITS bits, in the slot given by that
+ * group. Arming and cancelling are O(1); a level is cascaded into the
+ * lower ones when the current tick reaches its slot. Occupancy bitmaps
+ * give the next non-empty slot with one ctz per level, so idle time is
+ * skipped instead of walked tick by tick.
+ * Timers are small integers chosen by the caller (0 .. capacity - 1).
+ * - originNs: monotonic time of tick 0
+ * - now: first tick not processed yet
+ * - heads / occupied: slot lists and their occupancy bitmaps
+ * - next / prev / expires / where: per timer list links, expiry tick and
+ *   slot (level * WHEEL_SLOTS + slot, WHEEL_UNARMED if not armed)
+ * - cap: timers allocated
+ * - armed: timers currently armed
+ */
+typedef struct sWheel
+{
+	uint64_t	originNs;
+	uint64_t	now;
+	uint32_t	heads[WHEEL_LEVELS][WHEEL_SLOTS];
+	uint64_t	occupied[WHEEL_LEVELS];
+	uint32_t	*next;
+	uint32_t	*prev;
+	uint64_t	*expires;
+	uint16_t	*where;
+	size_t		cap;
+	size_t		armed;
+} tWheel;
+
+/**
+ * @brief Start an empty wheel
+ * @param wheel - wheel to initialize
+ * @param nowNs - current monotonic time, becomes tick 0
+ */
+void		wheelInit(tWheel *wheel, uint64_t nowNs);
+
+/**
+ * @brief Make timers 0 .. count - 1 usable
+ * @return 0 on success, -1 on allocation failure
+ */
+int			wheelReserve(tWheel *wheel, size_t count);
+
+/**
+ * @brief Arm (or re-arm) a timer
+ * A time already past expires on the next wheelExpire().
+ * @param wheel - wheel
+ * @param id - timer
+ * @param whenNs - monotonic expiry time
+ */
+void		wheelArm(tWheel *wheel, uint32_t id, uint64_t whenNs);
+
+/**
+ * @brief Disarm a timer (no-op if not armed)
+ */
+void		wheelCancel(tWheel *wheel, uint32_t id);
+
+/**
+ * @brief Whether a timer is armed
+ */
+tBool		wheelArmed(const tWheel *wheel, uint32_t id);
+
+/**
+ * @brief Collect the timers due at nowNs, oldest tick first
+ * Expired timers are disarmed before they are returned.
+ * @param wheel - wheel
+ * @param nowNs - current monotonic time
+ * @param out - expired timers
+ * @param max - capacity of out
+ * @return number of timers stored in out, max means more may be due
+ */
+size_t		wheelExpire(tWheel *wheel, uint64_t nowNs, uint32_t *out, size_t max);
+
+/**
+ * @brief Monotonic time of the next non-empty slot (expiry or cascade)
+ * @return time, UINT64_MAX when no timer is armed
+ */
+uint64_t	wheelNextNs(const tWheel *wheel);
+
+/**
+ * @brief Bytes held by the timer arrays
+ */
+size_t		wheelMemory(const tWheel *wheel);
+
+/**
+ * @brief Release the timer arrays
+ */
+void		wheelFree(tWheel *wheel);
+
+#endif /* HAJPING_WHEEL_H */
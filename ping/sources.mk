@@ -15,10 +15,27 @@ SRC			= $(SRC_DIR)/main.c \
 			  $(SRC_DIR)/ping.c \
 			  $(SRC_DIR)/pingUtils.c \
 			  $(SRC_DIR)/utils.c \
-			  $(SRC_DIR)/usage.c
+			  $(SRC_DIR)/usage.c \
+			  $(SRC_DIR)/stats.c \
+			  $(SRC_DIR)/buffer.c
 
-HAJ_SRC		= 
+HAJ_SRC		= $(HAJ_DIR)/arena.c \
+			  $(HAJ_DIR)/capture.c \
+			  $(HAJ_DIR)/dnscache.c \
+			  $(HAJ_DIR)/monitor.c \
+			  $(HAJ_DIR)/multi.c \
+			  $(HAJ_DIR)/output.c \
+			  $(HAJ_DIR)/pcap.c \
+			  $(HAJ_DIR)/plog.c \
+			  $(HAJ_DIR)/pmtu.c \
+			  $(HAJ_DIR)/replay.c \
+			  $(HAJ_DIR)/resolver.c \
+			  $(HAJ_DIR)/rxpool.c \
+			  $(HAJ_DIR)/rxring.c \
+			  $(HAJ_DIR)/table.c \
+			  $(HAJ_DIR)/targets.c \
+			  $(HAJ_DIR)/wheel.c
 
 # Objects
 OBJ			= $(addprefix $(BUILD_DIR)/, $(notdir $(SRC:.c=.o)))
-HAJ_OBJ		= $(addprefix $(BUILD_DIR)/haj/, $(notdir $(SRC:.c=.o)))
+HAJ_OBJ		= $(addprefix $(BUILD_DIR)/haj/, $(notdir $(SRC:.c=.o) $(HAJ_SRC:.c=.o)))
@@ -0,0 +1,150 @@
+#include <stdlib.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/arena.h"
+
+void
+arenaInit(tArena *arena)
+{
+	ft_bzero(arena, sizeof(*arena));
+}
+
+void *
+arenaAlloc(tArena *arena, size_t size)
+{
+	tArenaChunk	*chunk = arena->chunks;
+	size_t		blockSize;
+	void		*ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (!chunk || chunk->used + size > chunk->size)
+	{
+		/* oversized requests get a block of their own */
+		blockSize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+		chunk = malloc(sizeof(*chunk) + blockSize);
+		if (!chunk)
+			return (NULL);
+		chunk->size = blockSize;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->reserved += sizeof(*chunk) + blockSize;
+	}
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	arena->used += size;
+	return (ptr);
+}
+
+char *
+arenaStrndup(tArena *arena, const char *str, size_t len)
+{
+	char	*copy = arenaAlloc(arena, len + 1);
+
+	if (!copy)
+		return (NULL);
+	ft_memcpy(copy, str, len);
+	copy[len] = '\0';
+	return (copy);
+}
+
+void
+arenaFree(tArena *arena)
+{
+	tArenaChunk	*next;
+
+	if (!arena)
+		return;
+	while (arena->chunks)
+	{
+		next = arena->chunks->next;
+		free(arena->chunks);
+		arena->chunks = next;
+	}
+	ft_bzero(arena, sizeof(*arena));
+}
+
+void
+poolInit(tPool *pool, size_t objSize, size_t perSlab)
+{
+	ft_bzero(pool, sizeof(*pool));
+	if (objSize < sizeof(tPoolFree))
+		objSize = sizeof(tPoolFree);
+	pool->objSize = (objSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+	pool->perSlab = perSlab ? perSlab : 1;
+}
+
+/**
+ * @brief Add one slab and thread its objects on the free list
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+poolGrow(tPool *pool)
+{
+	tPoolSlab	*slab;
+
+	slab = malloc(sizeof(*slab) + pool->objSize * pool->perSlab);
+	if (!slab)
+		return (-1);
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->slabCount++;
+	/* last object first so the list hands them out in address order */
+	for (size_t i = pool->perSlab; i > 0; i--)
+	{
+		tPoolFree	*obj = (tPoolFree *)(slab->data + (i - 1) * pool->objSize);
+
+		obj->next = pool->freeList;
+		pool->freeList = obj;
+	}
+	return (0);
+}
+
+void *
+poolAlloc(tPool *pool)
+{
+	tPoolFree	*obj;
+
+	if (!pool->freeList && poolGrow(pool) != 0)
+		return (NULL);
+	obj = pool->freeList;
+	pool->freeList = obj->next;
+	if (++pool->live > pool->peak)
+		pool->peak = pool->live;
+	return (obj);
+}
+
+void
+poolRelease(tPool *pool, void *obj)
+{
+	tPoolFree	*node = obj;
+
+	if (!obj)
+		return;
+	node->next = pool->freeList;
+	pool->freeList = node;
+	pool->live--;
+}
+
+size_t
+poolReserved(const tPool *pool)
+{
+	return (pool->slabCount * (sizeof(tPoolSlab) + pool->objSize * pool->perSlab));
+}
+
+void
+poolFree(tPool *pool)
+{
+	tPoolSlab	*next;
+
+	if (!pool)
+		return;
+	while (pool->slabs)
+	{
+		next = pool->slabs->next;
+		free(pool->slabs);
+		pool->slabs = next;
+	}
+	ft_bzero(pool, sizeof(*pool));
+}
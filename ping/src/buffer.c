@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../../common/includes/probe.h"
+#include "../includes/buffer.h"
+#include "../includes/ping.h"
+#include "../includes/pingUtils.h"
+
+/**
+ * @brief Round n up to a multiple of align (power of two)
+ */
+static size_t
+alignUp(size_t n, size_t align)
+{
+	return ((n + align - 1) & ~(align - 1));
+}
+
+/**
+ * @brief Fill dst with the repeated pattern
+ * Writes one period then doubles the filled prefix with memcpy, so a 64k
+ * payload costs a handful of copies instead of a byte loop.
+ * @param dst - destination
+ * @param len - bytes to fill
+ * @param pattern - pattern bytes (NULL or empty for zeros)
+ * @param patternLen - pattern length
+ */
+static void
+fillPattern(unsigned char *dst, size_t len, const char *pattern, size_t patternLen)
+{
+	size_t	done;
+	size_t	chunk;
+
+	if (len == 0)
+		return;
+	if (!pattern || patternLen == 0)
+	{
+		ft_bzero(dst, len);
+		return;
+	}
+	done = patternLen < len ? patternLen : len;
+	ft_memcpy(dst, pattern, done);
+	while (done < len)
+	{
+		chunk = done < len - done ? done : len - done;
+		ft_memcpy(dst + done, dst, chunk);
+		done += chunk;
+	}
+}
+
+/**
+ * @brief Map len bytes, with explicit huge pages if requested and available
+ * @param bufs - buffers (base, mapLen and huge are set)
+ * @param len - bytes needed
+ * @param wantHuge - try MAP_HUGETLB first
+ * @return 0 on success, -1 on failure
+ */
+static int
+mapBuffers(tPingBuffers *bufs, size_t len, tBool wantHuge)
+{
+	void	*mem;
+
+#if defined(MAP_HUGETLB)
+	if (wantHuge)
+	{
+		bufs->mapLen = alignUp(len, PING_HUGEPAGE_SIZE);
+		mem = mmap(NULL, bufs->mapLen, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mem != MAP_FAILED)
+		{
+			bufs->base = mem;
+			bufs->huge = TRUE;
+			return (0);
+		}
+	}
+#else
+	(void)wantHuge;
+#endif
+	bufs->mapLen = alignUp(len, (size_t)sysconf(_SC_PAGESIZE));
+	mem = mmap(NULL, bufs->mapLen, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+	{
+		ft_dprintf(STDERR_FILENO, "mmap failed: %s\n", strerror(errno));
+		return (-1);
+	}
+#if defined(MADV_HUGEPAGE)
+	if (bufs->mapLen >= PING_HUGEPAGE_SIZE)
+		madvise(mem, bufs->mapLen, MADV_HUGEPAGE);
+#endif
+	bufs->base = mem;
+	bufs->huge = FALSE;
+	return (0);
+}
+
+int
+pingBuffersInit(tPingBuffers *bufs, const tPingOptions *opts)
+{
+	unsigned char	*payload;
+	size_t			sendSize;
+	size_t			recvSize;
+	tBool			wantHuge = FALSE;
+
+	if (!bufs || !opts)
+		return (-1);
+	ft_bzero(bufs, sizeof(*bufs));
+	bufs->payloadLen = computeUserPayloadSize(opts);
+
+	/* the send side also holds a timestamp request, the receive side any
+	 * reply up to the echo size plus the largest IPv4 header */
+	sendSize = ICMP4_HDR_LEN + bufs->payloadLen;
+	if (sendSize < sizeof(tIcmp4Timestamp))
+		sendSize = sizeof(tIcmp4Timestamp);
+	recvSize = PING_BUF_IP_MAX + ICMP4_HDR_LEN + bufs->payloadLen;
+	if (recvSize < PING_MAX_PACKET_SIZE)
+		recvSize = PING_MAX_PACKET_SIZE;
+	bufs->sendSize = alignUp(sendSize, PING_BUF_ALIGN);
+	bufs->recvSize = alignUp(recvSize, PING_BUF_ALIGN);
+
+#if defined(HAJ)
+	wantHuge = opts->hugepages;
+#endif
+	if (mapBuffers(bufs, bufs->sendSize + bufs->recvSize, wantHuge) != 0)
+		return (-1);
+	bufs->send = bufs->base;
+	bufs->recv = bufs->base + bufs->sendSize;
+
+	/* per-probe header first, then the pattern restarting right after it;
+	 * ft_ping keeps the inetutils struct timeval layout */
+#if defined(HAJ)
+	bufs->stampLen = probeHeaderLen(bufs->payloadLen);
+#else
+	bufs->stampLen = bufs->payloadLen >= sizeof(struct timeval) ? sizeof(struct timeval) : 0;
+#endif
+	payload = bufs->send + ICMP4_HDR_LEN;
+	fillPattern(payload + bufs->stampLen, bufs->payloadLen - bufs->stampLen,
+		opts->pattBytes, opts->patternLen);
+	bufs->tailSum = icmpChecksumAdd(0, payload + bufs->stampLen,
+		bufs->payloadLen - bufs->stampLen);
+	return (0);
+}
+
+void
+pingBuffersFree(tPingBuffers *bufs)
+{
+	if (!bufs || !bufs->base)
+		return;
+	munmap(bufs->base, bufs->mapLen);
+	ft_bzero(bufs, sizeof(*bufs));
+}
+
+uint32_t
+pingBuffersBuildEcho(
+	tPingBuffers			*bufs,
+	uint8_t					type,
+	uint16_t				id,
+	uint16_t				seq,
+	const void				*stamp,
+	uint32_t				pseudoSum,
+	int						doChecksum)
+{
+	tIcmp4Echo	*echo;
+	uint32_t	sum;
+	uint32_t	len;
+
+	if (!bufs || !bufs->send)
+		return (0);
+	echo = (tIcmp4Echo *)bufs->send;
+	len = ICMP4_HDR_LEN + bufs->payloadLen;
+	echo->hdr.type = type;
+	echo->hdr.code = 0;
+	echo->hdr.checksum = 0;
+	echo->id = ipHtons(id);
+	echo->sequence = ipHtons(seq);
+	if (bufs->stampLen && stamp)
+		ft_memcpy(echo->data, stamp, bufs->stampLen);
+	if (!doChecksum)
+		return (len);
+	/* header and stamp lengths are even: the tail sum lines up */
+	sum = icmpChecksumAdd(pseudoSum, echo, ICMP4_HDR_LEN + bufs->stampLen);
+	echo->hdr.checksum = icmpChecksumFinish(sum + bufs->tailSum);
+	return (len);
+}
@@ -0,0 +1,438 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/capture.h"
+#include "../includes/pcap.h"
+#include "../includes/ping.h"
+
+#define CAPTURE_MASK		((uint64_t)CAPTURE_RING_SIZE - 1)
+#define CAPTURE_EPB_FIXED	32	/**< block header, packet fields and trailing length */
+#define CAPTURE_OPT_COMMENT	1
+#define CAPTURE_OPT_FLAGS	2	/**< epb_flags: bits 0-1 are the direction */
+#define CAPTURE_INBOUND		1
+#define CAPTURE_OUTBOUND	2
+#define CAPTURE_REJECT_MAX	64	/**< longest comment of a rejected packet */
+#define CAPTURE_FILE_HDR	92	/**< section header + two interface blocks */
+
+_Static_assert((CAPTURE_RING_SIZE & (CAPTURE_RING_SIZE - 1)) == 0, "capture ring must be a power of two");
+
+/**
+ * @brief Copy into the ring at pos, wrapping at its end
+ * @return position after the copy
+ */
+static uint64_t
+ringPut(tCapture *cap, uint64_t pos, const void *data, size_t len)
+{
+	size_t	off = (size_t)(pos & CAPTURE_MASK);
+	size_t	first = CAPTURE_RING_SIZE - off;
+
+	if (first > len)
+		first = len;
+	ft_memcpy(cap->ring + off, data, first);
+	if (len > first)
+		ft_memcpy(cap->ring, (const uint8_t *)data + first, len - first);
+	return (pos + len);
+}
+
+static uint64_t
+ringPut32(tCapture *cap, uint64_t pos, uint32_t v)
+{
+	return (ringPut(cap, pos, &v, sizeof(v)));
+}
+
+/**
+ * @brief Write the whole buffer, retrying short writes
+ * @return 0 on success, -1 on error
+ */
+static int
+captureWrite(int fd, struct iovec *iov, int count)
+{
+	ssize_t	n;
+
+	while (count > 0)
+	{
+		n = writev(fd, iov, count);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return (-1);
+		while (count > 0 && (size_t)n >= iov->iov_len)
+		{
+			n -= (ssize_t)iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0)
+		{
+			iov->iov_base = (uint8_t *)iov->iov_base + n;
+			iov->iov_len -= (size_t)n;
+		}
+	}
+	return (0);
+}
+
+/**
+ * @brief Open the next file and write its section and interface blocks
+ * @return 0 on success, -1 with a message on error
+ */
+static int
+captureNextFile(tCapture *cap)
+{
+	char		name[PATH_MAX + 16];
+	uint32_t	hdr[CAPTURE_FILE_HDR / 4];
+	uint32_t	*p = hdr;
+	struct iovec	iov;
+
+	if (cap->fd >= 0)
+		close(cap->fd);
+	if (cap->fileIndex == 0)
+		snprintf(name, sizeof(name), "%s", cap->path);
+	else
+		snprintf(name, sizeof(name), "%s.%u", cap->path, cap->fileIndex);
+	cap->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (cap->fd < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", name, strerror(errno));
+		return (-1);
+	}
+	/* section header: byte order magic, version 1.0, unknown section length */
+	*p++ = PCAPNG_SHB;
+	*p++ = 28;
+	*p++ = PCAPNG_BOM;
+	*p++ = 1;
+	*p++ = 0xFFFFFFFF;
+	*p++ = 0xFFFFFFFF;
+	*p++ = 28;
+	/* one interface per family, nanosecond timestamps (if_tsresol 9) */
+	for (int i = 0; i < 2; i++)
+	{
+		*p++ = PCAPNG_IDB;
+		*p++ = 32;
+		*p++ = i == CAPTURE_IFACE_V6 ? LINKTYPE_IPV6 : LINKTYPE_IPV4;
+		*p++ = CAPTURE_SNAPLEN;
+		*p++ = PCAPNG_OPT_TSRESOL | 1 << 16;
+		*p++ = 9;
+		*p++ = 0;
+		*p++ = 32;
+	}
+	iov.iov_base = hdr;
+	iov.iov_len = sizeof(hdr);
+	if (captureWrite(cap->fd, &iov, 1) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", name, strerror(errno));
+		return (-1);
+	}
+	cap->fileBytes = sizeof(hdr);
+	cap->fileIndex++;
+	cap->files++;
+	return (0);
+}
+
+/**
+ * @brief Write out the finished blocks, starting new files at the size limit
+ * Files are cut between blocks: each one can be read on its own.
+ */
+static void
+captureDrain(tCapture *cap)
+{
+	uint64_t		head = atomic_load_explicit(&cap->head, memory_order_acquire);
+	uint64_t		tail = atomic_load_explicit(&cap->tail, memory_order_relaxed);
+	uint64_t		end;
+	uint32_t		blockLen;
+	struct iovec	iov[2];
+	size_t			off;
+	int				count;
+
+	while (tail != head)
+	{
+		end = head;
+		if (cap->rotateBytes > 0)
+		{
+			/* blocks are 4-byte aligned, their length never wraps */
+			for (end = tail; end != head; end += blockLen)
+			{
+				ft_memcpy(&blockLen, cap->ring + ((end + 4) & CAPTURE_MASK), sizeof(blockLen));
+				if (cap->fileBytes + (end - tail) + blockLen > cap->rotateBytes
+					&& (end != tail || cap->fileBytes > CAPTURE_FILE_HDR))
+					break;
+			}
+		}
+		if (end != tail && !cap->failed)
+		{
+			off = (size_t)(tail & CAPTURE_MASK);
+			iov[0].iov_base = cap->ring + off;
+			iov[0].iov_len = end - tail;
+			count = 1;
+			if (off + (end - tail) > CAPTURE_RING_SIZE)
+			{
+				iov[0].iov_len = CAPTURE_RING_SIZE - off;
+				iov[1].iov_base = cap->ring;
+				iov[1].iov_len = (end - tail) - iov[0].iov_len;
+				count = 2;
+			}
+			if (captureWrite(cap->fd, iov, count) != 0)
+			{
+				ft_dprintf(STDERR_FILENO, PROG_NAME ": capture: %s, capture stopped\n", strerror(errno));
+				cap->failed = TRUE;
+			}
+			cap->fileBytes += end - tail;
+		}
+		tail = end;
+		atomic_store_explicit(&cap->tail, tail, memory_order_release);
+		if (tail != head && !cap->failed && captureNextFile(cap) != 0)
+			cap->failed = TRUE;
+	}
+}
+
+/**
+ * @brief Writer thread: drain the ring every CAPTURE_FLUSH_MS or when woken
+ */
+static void *
+captureThread(void *arg)
+{
+	tCapture		*cap = arg;
+	struct timespec	deadline;
+	tBool			stop = FALSE;
+
+	while (!stop)
+	{
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += CAPTURE_FLUSH_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_mutex_lock(&cap->lock);
+		if (!cap->stop)
+			pthread_cond_timedwait(&cap->wake, &cap->lock, &deadline);
+		stop = cap->stop;
+		pthread_mutex_unlock(&cap->lock);
+		captureDrain(cap);
+	}
+	return (NULL);
+}
+
+int
+captureOpen(tCapture *cap, const char *path, uint64_t rotateBytes)
+{
+	ft_bzero(cap, sizeof(*cap));
+	cap->fd = -1;
+	cap->rotateBytes = rotateBytes;
+	ft_strlcpy(cap->path, path, sizeof(cap->path));
+	/* allocated and touched once, the send path never faults a page in */
+	cap->ring = malloc(CAPTURE_RING_SIZE);
+	if (!cap->ring)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return (-1);
+	}
+	ft_bzero(cap->ring, CAPTURE_RING_SIZE);
+	if (captureNextFile(cap) != 0)
+	{
+		free(cap->ring);
+		return (-1);
+	}
+	pthread_mutex_init(&cap->lock, NULL);
+	pthread_cond_init(&cap->wake, NULL);
+	if (pthread_create(&cap->thread, NULL, captureThread, cap) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": capture: cannot start the writer thread\n");
+		close(cap->fd);
+		free(cap->ring);
+		return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Reserve a block in the ring
+ * @param len - total block length, multiple of 4
+ * @param pos - filled with the block position
+ * @return 0 if it fits, -1 if the writer is too far behind
+ */
+static int
+captureReserve(tCapture *cap, uint32_t len, uint64_t *pos)
+{
+	uint64_t	head = atomic_load_explicit(&cap->head, memory_order_relaxed);
+	uint64_t	tail = atomic_load_explicit(&cap->tail, memory_order_acquire);
+
+	if (CAPTURE_RING_SIZE - (head - tail) < len)
+	{
+		cap->dropped++;
+		return (-1);
+	}
+	/* past half full the writer is woken instead of waiting for its period */
+	if (head - tail + len > CAPTURE_RING_SIZE / 2 && head - tail <= CAPTURE_RING_SIZE / 2)
+		pthread_cond_signal(&cap->wake);
+	*pos = head;
+	return (0);
+}
+
+/**
+ * @brief Append an enhanced packet block: header, IP header, ICMP, options
+ * @param hdr / hdrLen - rebuilt IP header (hdrLen 0 if pkt has its own)
+ * @param dir - CAPTURE_INBOUND or CAPTURE_OUTBOUND
+ */
+static void
+capturePacket(
+	tCapture		*cap,
+	uint32_t		iface,
+	const void		*hdr,
+	size_t			hdrLen,
+	const void		*pkt,
+	size_t			len,
+	uint32_t		dir,
+	const char		*reject)
+{
+	static const uint8_t	pad[4] = {0};
+	char					comment[CAPTURE_REJECT_MAX];
+	size_t					commentLen = 0;
+	struct timespec			ts;
+	uint64_t				ns;
+	uint64_t				pos;
+	uint32_t				capLen = (uint32_t)(hdrLen + len);
+	uint32_t				blockLen;
+
+	if (capLen > CAPTURE_SNAPLEN)
+		return;
+	if (reject)
+		commentLen = (size_t)snprintf(comment, sizeof(comment), "rejected: %s", reject);
+	if (commentLen >= sizeof(comment))
+		commentLen = sizeof(comment) - 1;
+	blockLen = CAPTURE_EPB_FIXED + ((capLen + 3) & ~3U) + 8 + 4
+		+ (commentLen ? 4 + (((uint32_t)commentLen + 3) & ~3U) : 0);
+	if (captureReserve(cap, blockLen, &pos) != 0)
+		return;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ns = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+	pos = ringPut32(cap, pos, PCAPNG_EPB);
+	pos = ringPut32(cap, pos, blockLen);
+	pos = ringPut32(cap, pos, iface);
+	pos = ringPut32(cap, pos, (uint32_t)(ns >> 32));
+	pos = ringPut32(cap, pos, (uint32_t)ns);
+	pos = ringPut32(cap, pos, capLen);
+	pos = ringPut32(cap, pos, capLen);
+	if (hdrLen > 0)
+		pos = ringPut(cap, pos, hdr, hdrLen);
+	pos = ringPut(cap, pos, pkt, len);
+	pos = ringPut(cap, pos, pad, (4 - (capLen & 3)) & 3);
+	pos = ringPut32(cap, pos, CAPTURE_OPT_FLAGS | 4 << 16);
+	pos = ringPut32(cap, pos, dir);
+	if (commentLen > 0)
+	{
+		pos = ringPut32(cap, pos, CAPTURE_OPT_COMMENT | (uint32_t)commentLen << 16);
+		pos = ringPut(cap, pos, comment, commentLen);
+		pos = ringPut(cap, pos, pad, (4 - (commentLen & 3)) & 3);
+	}
+	pos = ringPut32(cap, pos, 0);
+	pos = ringPut32(cap, pos, blockLen);
+	cap->packets++;
+	atomic_store_explicit(&cap->head, pos, memory_order_release);
+}
+
+/**
+ * @brief Rebuild the IP header of an ICMP message read or sent without one
+ * @param toAddr - TRUE when addr is the destination (sent packet)
+ * @return header length
+ */
+static size_t
+captureIpHeader(
+	uint8_t							*hdr,
+	const struct sockaddr_storage	*addr,
+	tBool							toAddr,
+	uint8_t							ttl,
+	size_t							len)
+{
+	if (addr->ss_family == AF_INET6)
+	{
+		ft_bzero(hdr, PING_IP6_HDR_LEN);
+		hdr[0] = 0x60;
+		hdr[4] = (uint8_t)(len >> 8);
+		hdr[5] = (uint8_t)len;
+		hdr[6] = IPPROTO_ICMPV6;
+		hdr[7] = ttl;
+		ft_memcpy(hdr + (toAddr ? 24 : 8), &((const struct sockaddr_in6 *)addr)->sin6_addr, 16);
+		return (PING_IP6_HDR_LEN);
+	}
+	ft_bzero(hdr, 20);
+	hdr[0] = 0x45;
+	hdr[2] = (uint8_t)((len + 20) >> 8);
+	hdr[3] = (uint8_t)(len + 20);
+	hdr[8] = ttl;
+	hdr[9] = IPPROTO_ICMP;
+	ft_memcpy(hdr + (toAddr ? 16 : 12), &((const struct sockaddr_in *)addr)->sin_addr, 4);
+	return (20);
+}
+
+void
+captureSent(
+	tCapture						*cap,
+	const struct sockaddr_storage	*dst,
+	uint8_t							ttl,
+	const void						*icmp,
+	size_t							len)
+{
+	uint8_t	hdr[PING_IP6_HDR_LEN];
+	size_t	hdrLen;
+
+	if (!cap)
+		return;
+	hdrLen = captureIpHeader(hdr, dst, TRUE, ttl, len);
+	capturePacket(cap, dst->ss_family == AF_INET6 ? CAPTURE_IFACE_V6 : CAPTURE_IFACE_V4,
+		hdr, hdrLen, icmp, len, CAPTURE_OUTBOUND, NULL);
+}
+
+void
+captureReceived(
+	tCapture						*cap,
+	const struct sockaddr_storage	*from,
+	uint8_t							ttl,
+	const void						*pkt,
+	size_t							len,
+	size_t							ipLen,
+	const char						*reject)
+{
+	uint8_t	hdr[PING_IP6_HDR_LEN];
+	size_t	hdrLen = 0;
+
+	if (!cap)
+		return;
+	if (ipLen == 0)
+		hdrLen = captureIpHeader(hdr, from, FALSE, ttl, len);
+	capturePacket(cap, from->ss_family == AF_INET6 ? CAPTURE_IFACE_V6 : CAPTURE_IFACE_V4,
+		hdr, hdrLen, pkt, len, CAPTURE_INBOUND, reject);
+}
+
+void
+captureClose(tCapture *cap, int verbose)
+{
+	if (!cap)
+		return;
+	pthread_mutex_lock(&cap->lock);
+	cap->stop = TRUE;
+	pthread_cond_signal(&cap->wake);
+	pthread_mutex_unlock(&cap->lock);
+	pthread_join(cap->thread, NULL);
+	if (cap->fd >= 0)
+		close(cap->fd);
+	if (cap->dropped > 0)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": capture: %lu packets dropped, the writer fell behind\n",
+			cap->dropped);
+	if (verbose > 0)
+		printf("capture: %lu packets in %u file%s (%s%s)\n", cap->packets, cap->files,
+			cap->files > 1 ? "s" : "", cap->path, cap->files > 1 ? ".N" : "");
+	pthread_mutex_destroy(&cap->lock);
+	pthread_cond_destroy(&cap->wake);
+	free(cap->ring);
+	cap->ring = NULL;
+}
@@ -0,0 +1,563 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/dnscache.h"
+#include "../includes/resolve.h"
+
+_Static_assert(sizeof(tDnsCacheHeader) == 64, "cache header must stay 64 bytes");
+_Static_assert(sizeof(tDnsCacheEntry) % 64 == 0, "cache entries must stay cache line sized");
+
+#define DNS_CACHE_READ_TRIES	8	/**< seqlock retries before giving up on a slot */
+
+/**
+ * @brief FNV-1a over a key, continuing from h
+ */
+static uint64_t
+dnsCacheHash(uint64_t h, const void *data, size_t len)
+{
+	const uint8_t	*p = data;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return (h);
+}
+
+static tBool
+dnsCacheIsOpen(const tDnsCache *cache)
+{
+	return (cache && cache->fd >= 0);
+}
+
+static int
+dnsCacheFamily(tIpType ipMode)
+{
+	if (ipMode == IP_TYPE_V4)
+		return (AF_INET);
+	if (ipMode == IP_TYPE_V6)
+		return (AF_INET6);
+	return (AF_UNSPEC);
+}
+
+/**
+ * @brief Convert a sockaddr to the cache address layout
+ * @return 0 on success, -1 for a family the cache does not know
+ */
+static int
+dnsCacheFromSockaddr(tDnsCacheAddr *out, const struct sockaddr *sa)
+{
+	ft_bzero(out, sizeof(*out));
+	out->family = sa->sa_family;
+	if (sa->sa_family == AF_INET)
+		ft_memcpy(out->addr, &((const struct sockaddr_in *)sa)->sin_addr, 4);
+	else if (sa->sa_family == AF_INET6)
+	{
+		ft_memcpy(out->addr, &((const struct sockaddr_in6 *)sa)->sin6_addr, 16);
+		out->scope = ((const struct sockaddr_in6 *)sa)->sin6_scope_id;
+	}
+	else
+		return (-1);
+	return (0);
+}
+
+/**
+ * @brief Build the key of a forward entry
+ * @return 0 on success, -1 if the host is an IP literal or too long
+ */
+static int
+dnsCacheHostKey(tDnsCacheEntry *key, const char *host, tIpType ipMode)
+{
+	unsigned char	tmp[sizeof(struct in6_addr)];
+	size_t			len;
+
+	if (!host)
+		return (-1);
+	len = ft_strlen(host);
+	/* literals never reach the network, caching them only costs slots */
+	if (len == 0 || len >= DNS_CACHE_NAME_LEN || strchr(host, '%')
+		|| inet_pton(AF_INET, host, tmp) == 1 || inet_pton(AF_INET6, host, tmp) == 1)
+		return (-1);
+	ft_bzero(key, sizeof(*key));
+	key->kind = DNS_CACHE_FORWARD;
+	key->family = dnsCacheFamily(ipMode);
+	ft_memcpy(key->name, host, len);
+	key->hash = dnsCacheHash(0xcbf29ce484222325ULL, &key->kind, 2);
+	key->hash = dnsCacheHash(key->hash, host, len);
+	return (0);
+}
+
+/**
+ * @brief Build the key of a reverse entry
+ * @return 0 on success, -1 for an unknown family
+ */
+static int
+dnsCachePeerKey(tDnsCacheEntry *key, const struct sockaddr_storage *addr)
+{
+	ft_bzero(key, sizeof(*key));
+	if (dnsCacheFromSockaddr(&key->addrs[0], (const struct sockaddr *)addr) != 0)
+		return (-1);
+	key->kind = DNS_CACHE_REVERSE;
+	key->family = addr->ss_family;
+	key->count = 1;
+	key->hash = dnsCacheHash(0xcbf29ce484222325ULL, &key->kind, 2);
+	key->hash = dnsCacheHash(key->hash, &key->addrs[0], sizeof(key->addrs[0]));
+	return (0);
+}
+
+static tBool
+dnsCacheSameKey(const tDnsCacheEntry *a, const tDnsCacheEntry *b)
+{
+	if (a->kind != b->kind || a->family != b->family || a->hash != b->hash)
+		return (FALSE);
+	if (a->kind == DNS_CACHE_FORWARD)
+		return (ft_strcmp(a->name, b->name) == 0);
+	return (ft_memcmp(&a->addrs[0], &b->addrs[0], sizeof(a->addrs[0])) == 0);
+}
+
+/**
+ * @brief Consistent copy of a slot another process may be writing
+ * @return TRUE if out holds a complete entry
+ */
+static tBool
+dnsCacheReadSlot(const tDnsCacheEntry *slot, tDnsCacheEntry *out)
+{
+	uint32_t	seq;
+
+	for (int tries = 0; tries < DNS_CACHE_READ_TRIES; tries++)
+	{
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		ft_memcpy(out, slot, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return (TRUE);
+	}
+	return (FALSE);
+}
+
+/**
+ * @brief Find the entry matching key
+ * @param cache - open cache
+ * @param key - entry key
+ * @param out - copy of the entry
+ * @return hit kind, from the entry age
+ */
+static tDnsCacheHit
+dnsCacheLoad(const tDnsCache *cache, const tDnsCacheEntry *key, tDnsCacheEntry *out)
+{
+	const size_t	mask = DNS_CACHE_SLOTS - 1;
+	int64_t			now = time(NULL);
+
+	for (size_t i = 0; i < DNS_CACHE_PROBE; i++)
+	{
+		const tDnsCacheEntry	*slot = &cache->entries[(key->hash + i) & mask];
+
+		if (slot->hash != key->hash || !dnsCacheReadSlot(slot, out)
+			|| !dnsCacheSameKey(out, key))
+			continue;
+		if (now < out->expiresAt && now >= out->storedAt)
+			return (DNS_CACHE_FRESH);
+		if (now < out->expiresAt + DNS_CACHE_STALE_SEC)
+			return (DNS_CACHE_STALE);
+		return (DNS_CACHE_MISS);
+	}
+	return (DNS_CACHE_MISS);
+}
+
+/**
+ * @brief Write an entry, replacing its key, a free slot or the oldest one
+ * @param cache - open cache
+ * @param entry - complete entry (key and value), seq ignored
+ */
+static void
+dnsCacheStore(tDnsCache *cache, tDnsCacheEntry *entry)
+{
+	const size_t	mask = DNS_CACHE_SLOTS - 1;
+	tDnsCacheEntry	*victim = NULL;
+	uint32_t		seq;
+
+	entry->storedAt = time(NULL);
+	entry->expiresAt = entry->storedAt + cache->ttl;
+	pthread_mutex_lock(&cache->lock);
+	flock(cache->fd, LOCK_EX);
+	for (size_t i = 0; i < DNS_CACHE_PROBE; i++)
+	{
+		tDnsCacheEntry	*slot = &cache->entries[(entry->hash + i) & mask];
+
+		if (dnsCacheSameKey(slot, entry))
+		{
+			victim = slot;
+			break;
+		}
+		if (!victim || (victim->kind != DNS_CACHE_EMPTY
+				&& (slot->kind == DNS_CACHE_EMPTY || slot->expiresAt < victim->expiresAt)))
+			victim = slot;
+	}
+	/* odd while writing; "| 1" also recovers a slot left odd by a crash */
+	seq = victim->seq | 1;
+	__atomic_store_n(&victim->seq, seq, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	ft_memcpy((char *)victim + sizeof(victim->seq), (const char *)entry + sizeof(entry->seq),
+		sizeof(*entry) - sizeof(entry->seq));
+	__atomic_store_n(&victim->seq, seq + 1, __ATOMIC_RELEASE);
+	flock(cache->fd, LOCK_UN);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * @brief Rebuild an addrinfo list from a forward entry
+ * Every node comes from a numeric getaddrinfo so the list is released
+ * with freeaddrinfo() like a real lookup.
+ * @return list, NULL on failure
+ */
+static struct addrinfo *
+dnsCacheBuildList(const tDnsCacheEntry *entry)
+{
+	struct addrinfo	hints;
+	struct addrinfo	*head = NULL;
+	struct addrinfo	**tail = &head;
+	struct addrinfo	*one;
+	char			ip[INET6_ADDRSTRLEN];
+	char			literal[INET6_ADDRSTRLEN + 16];
+
+	ft_bzero(&hints, sizeof(hints));
+	hints.ai_socktype = SOCK_RAW;
+	hints.ai_flags = AI_NUMERICHOST;
+	for (size_t i = 0; i < entry->count && i < DNS_CACHE_ADDRS; i++)
+	{
+		const tDnsCacheAddr	*a = &entry->addrs[i];
+
+		if (!inet_ntop(a->family, a->addr, ip, sizeof(ip)))
+			continue;
+		if (a->family == AF_INET6 && a->scope)
+			snprintf(literal, sizeof(literal), "%s%%%u", ip, a->scope);
+		else
+			ft_strlcpy(literal, ip, sizeof(literal));
+		hints.ai_family = a->family;
+		if (getaddrinfo(literal, NULL, &hints, &one) != 0)
+			continue;
+		*tail = one;
+		while (*tail)
+			tail = &(*tail)->ai_next;
+	}
+	if (head && entry->canon[0])
+	{
+		free(head->ai_canonname);
+		head->ai_canonname = strdup(entry->canon);
+	}
+	return (head);
+}
+
+/**
+ * @brief Reverse lookup stored in the cache
+ * A missing PTR is cached as an empty name, a transient failure is not.
+ * @param name - PTR name, empty when there is none
+ */
+static void
+dnsCacheLookupPeer(
+	tDnsCache						*cache,
+	const struct sockaddr_storage	*addr,
+	socklen_t						addrLen,
+	char							*name,
+	size_t							nameSize)
+{
+	tDnsCacheEntry	entry;
+	int				ret;
+
+	ret = getnameinfo((const struct sockaddr *)addr, addrLen, name, nameSize,
+		NULL, 0, NI_NAMEREQD);
+	if (ret != 0)
+		name[0] = '\0';
+	if ((ret == 0 || ret == EAI_NONAME) && dnsCachePeerKey(&entry, addr) == 0)
+	{
+		ft_strlcpy(entry.name, name, sizeof(entry.name));
+		dnsCacheStore(cache, &entry);
+	}
+}
+
+/**
+ * @brief Background refresh: resolve every queued stale entry
+ */
+static void *
+dnsCacheWorker(void *arg)
+{
+	tDnsCache	*cache = arg;
+	tDnsRefresh	job;
+
+	pthread_mutex_lock(&cache->lock);
+	for (;;)
+	{
+		while (cache->queued == 0 && !cache->stop)
+			pthread_cond_wait(&cache->wake, &cache->lock);
+		if (cache->queued == 0)
+			break;
+		job = cache->queue[--cache->queued];
+		pthread_mutex_unlock(&cache->lock);
+		if (job.kind == DNS_CACHE_FORWARD)
+		{
+			struct sockaddr_storage	addr;
+			socklen_t				addrLen;
+			struct addrinfo			*list = NULL;
+
+			/* a failed refresh keeps serving the stale entry */
+			if (resolveHost(job.host, &addr, &addrLen, &list, job.ipMode) == 0)
+			{
+				dnsCachePutHost(cache, job.host, job.ipMode, list);
+				freeaddrinfo(list);
+			}
+		}
+		else
+		{
+			char	name[NI_MAXHOST];
+
+			dnsCacheLookupPeer(cache, &job.addr, job.addrLen, name, sizeof(name));
+		}
+		pthread_mutex_lock(&cache->lock);
+	}
+	pthread_mutex_unlock(&cache->lock);
+	return (NULL);
+}
+
+/**
+ * @brief Queue a refresh for a stale entry, starting the worker on first use
+ */
+static void
+dnsCacheSchedule(tDnsCache *cache, const tDnsRefresh *job)
+{
+	pthread_mutex_lock(&cache->lock);
+	for (size_t i = 0; i < cache->queued; i++)
+	{
+		if (cache->queue[i].kind == job->kind && cache->queue[i].ipMode == job->ipMode
+			&& ft_strcmp(cache->queue[i].host, job->host) == 0
+			&& ft_memcmp(&cache->queue[i].addr, &job->addr, sizeof(job->addr)) == 0)
+		{
+			pthread_mutex_unlock(&cache->lock);
+			return;
+		}
+	}
+	if (cache->queued == cache->queueCap)
+	{
+		size_t		cap = cache->queueCap ? cache->queueCap * 2 : 8;
+		tDnsRefresh	*grown = realloc(cache->queue, cap * sizeof(*grown));
+
+		if (!grown)
+		{
+			pthread_mutex_unlock(&cache->lock);
+			return;
+		}
+		cache->queue = grown;
+		cache->queueCap = cap;
+	}
+	cache->queue[cache->queued++] = *job;
+	if (!cache->workerStarted)
+		cache->workerStarted = pthread_create(&cache->worker, NULL, dnsCacheWorker, cache) == 0;
+	pthread_cond_signal(&cache->wake);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+int
+dnsCacheOpen(tDnsCache *cache, const char *path, int ttlSec)
+{
+	struct stat	st;
+	void		*map;
+
+	if (!cache || !path)
+		return (-1);
+	ft_bzero(cache, sizeof(*cache));
+	cache->ttl = ttlSec > 0 ? ttlSec : DNS_CACHE_DEFAULT_TTL;
+	cache->mapLen = sizeof(tDnsCacheHeader) + DNS_CACHE_SLOTS * sizeof(tDnsCacheEntry);
+	cache->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (cache->fd < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": DNS cache %s: %s\n", path, strerror(errno));
+		return (-1);
+	}
+	flock(cache->fd, LOCK_EX);
+	map = MAP_FAILED;
+	if (fstat(cache->fd, &st) == 0
+		&& ((size_t)st.st_size == cache->mapLen
+			|| (ftruncate(cache->fd, 0) == 0 && ftruncate(cache->fd, cache->mapLen) == 0)))
+		map = mmap(NULL, cache->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, cache->fd, 0);
+	if (map == MAP_FAILED)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": DNS cache %s: %s\n", path, strerror(errno));
+		close(cache->fd);
+		cache->fd = -1;
+		return (-1);
+	}
+	cache->hdr = map;
+	cache->entries = (tDnsCacheEntry *)(cache->hdr + 1);
+	if (cache->hdr->magic != DNS_CACHE_MAGIC || cache->hdr->version != DNS_CACHE_VERSION
+		|| cache->hdr->slots != DNS_CACHE_SLOTS || cache->hdr->entrySize != sizeof(tDnsCacheEntry))
+	{
+		ft_bzero(map, cache->mapLen);
+		cache->hdr->version = DNS_CACHE_VERSION;
+		cache->hdr->slots = DNS_CACHE_SLOTS;
+		cache->hdr->entrySize = sizeof(tDnsCacheEntry);
+		__atomic_store_n(&cache->hdr->magic, DNS_CACHE_MAGIC, __ATOMIC_RELEASE);
+	}
+	flock(cache->fd, LOCK_UN);
+	pthread_mutex_init(&cache->lock, NULL);
+	pthread_cond_init(&cache->wake, NULL);
+	return (0);
+}
+
+tDnsCacheHit
+dnsCacheGetHost(tDnsCache *cache, const char *host, tIpType ipMode, struct addrinfo **outList)
+{
+	tDnsCacheEntry	key;
+	tDnsCacheEntry	entry;
+	tDnsCacheHit	hit;
+	tDnsRefresh		job;
+
+	if (!dnsCacheIsOpen(cache) || !outList || dnsCacheHostKey(&key, host, ipMode) != 0)
+		return (DNS_CACHE_MISS);
+	hit = dnsCacheLoad(cache, &key, &entry);
+	if (hit == DNS_CACHE_MISS)
+		return (DNS_CACHE_MISS);
+	*outList = dnsCacheBuildList(&entry);
+	if (!*outList)
+		return (DNS_CACHE_MISS);
+	if (hit == DNS_CACHE_STALE)
+	{
+		ft_bzero(&job, sizeof(job));
+		job.kind = DNS_CACHE_FORWARD;
+		job.ipMode = ipMode;
+		ft_strlcpy(job.host, host, sizeof(job.host));
+		dnsCacheSchedule(cache, &job);
+	}
+	return (hit);
+}
+
+void
+dnsCachePutHost(tDnsCache *cache, const char *host, tIpType ipMode, const struct addrinfo *list)
+{
+	tDnsCacheEntry	entry;
+
+	if (!dnsCacheIsOpen(cache) || !list || dnsCacheHostKey(&entry, host, ipMode) != 0)
+		return;
+	if (list->ai_canonname)
+		ft_strlcpy(entry.canon, list->ai_canonname, sizeof(entry.canon));
+	for (const struct addrinfo *cur = list; cur && entry.count < DNS_CACHE_ADDRS; cur = cur->ai_next)
+		if (dnsCacheFromSockaddr(&entry.addrs[entry.count], cur->ai_addr) == 0)
+			entry.count++;
+	if (entry.count > 0)
+		dnsCacheStore(cache, &entry);
+}
+
+int
+dnsCacheResolveHost(
+	tDnsCache				*cache,
+	const char				*host,
+	struct sockaddr_storage	*outAddr,
+	socklen_t				*outLen,
+	struct addrinfo			**outList,
+	tIpType					ipMode)
+{
+	struct addrinfo	*list = NULL;
+	int				ret;
+
+	if (!host || !outAddr || !outLen)
+		return (EAI_FAIL);
+	if (dnsCacheGetHost(cache, host, ipMode, &list) == DNS_CACHE_MISS)
+	{
+		ret = resolveHost(host, outAddr, outLen, &list, ipMode);
+		if (ret != 0)
+			return (ret);
+		dnsCachePutHost(cache, host, ipMode, list);
+	}
+	else
+	{
+		/* the rebuilt list only holds usable addresses */
+		ft_memcpy(outAddr, list->ai_addr, list->ai_addrlen);
+		*outLen = list->ai_addrlen;
+	}
+	if (outList)
+		*outList = list;
+	else
+		freeaddrinfo(list);
+	return (0);
+}
+
+int
+dnsCacheResolvePeer(
+	tDnsCache						*cache,
+	const struct sockaddr_storage	*addr,
+	socklen_t						addrLen,
+	const char						*canonName,
+	char							*out,
+	size_t							outSize)
+{
+	tDnsCacheEntry	key;
+	tDnsCacheEntry	entry;
+	tDnsCacheHit	hit = DNS_CACHE_MISS;
+	char			name[NI_MAXHOST];
+
+	if (!addr || !out || outSize == 0)
+		return (-1);
+	if (!dnsCacheIsOpen(cache) || dnsCachePeerKey(&key, addr) != 0)
+		return (resolvePeerName(addr, addrLen, canonName, out, outSize));
+	out[0] = '\0';
+	hit = dnsCacheLoad(cache, &key, &entry);
+	if (hit != DNS_CACHE_MISS)
+	{
+		ft_strlcpy(name, entry.name, sizeof(name));
+		if (hit == DNS_CACHE_STALE)
+		{
+			tDnsRefresh	job;
+
+			ft_bzero(&job, sizeof(job));
+			job.kind = DNS_CACHE_REVERSE;
+			ft_memcpy(&job.addr, addr, addrLen);
+			job.addrLen = addrLen;
+			dnsCacheSchedule(cache, &job);
+		}
+	}
+	else
+		dnsCacheLookupPeer(cache, addr, addrLen, name, sizeof(name));
+	if (name[0])
+	{
+		ft_strlcpy(out, name, outSize);
+		return (0);
+	}
+	if (canonName && canonName[0])
+	{
+		ft_strlcpy(out, canonName, outSize);
+		return (0);
+	}
+	return (-1);
+}
+
+void
+dnsCacheClose(tDnsCache *cache)
+{
+	if (!dnsCacheIsOpen(cache))
+		return;
+	pthread_mutex_lock(&cache->lock);
+	cache->stop = TRUE;
+	pthread_cond_signal(&cache->wake);
+	pthread_mutex_unlock(&cache->lock);
+	if (cache->workerStarted)
+		pthread_join(cache->worker, NULL);
+	free(cache->queue);
+	cache->queue = NULL;
+	munmap(cache->hdr, cache->mapLen);
+	close(cache->fd);
+	cache->fd = -1;
+	pthread_mutex_destroy(&cache->lock);
+	pthread_cond_destroy(&cache->wake);
+}
@@ -1,6 +1,8 @@
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <stdio.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 #include "../../hajlib/include/hstring.h"
 #include "../../hajlib/include/hprintf.h"
@@ -11,6 +13,14 @@
 #include "../includes/utils.h"
 
 #include "../includes/ping.h"
+#if defined(HAJ)
+#include "../includes/dnscache.h"
+#include "../includes/monitor.h"
+#include "../includes/multi.h"
+#include "../includes/pmtu.h"
+#include "../includes/replay.h"
+#include "../includes/targets.h"
+#endif
 
 /**
  * @brief Print all resolved IP addresses from addrinfo list
@@ -132,6 +142,18 @@ main(int argc, char **argv)
 	tParseResult				parseRes;
 	int							ret;
 	int							i;
+	int							exitCode = EXIT_SUCCESS;
+#if defined(HAJ)
+	tDnsCache					cacheStore;
+	tDnsCache					*cache = NULL;
+	tTargetList					targets;
+	tCapture					captureStore;
+	tCapture					*capture = NULL;
+	tOutput						outputStore;
+	tOutput						*output = NULL;
+	tPlog						plogStore;
+	tPlog						*plog = NULL;
+#endif
 
 	ret = parseArgs(argc, argv, &parseRes);
 	if (ret == PARSE_HELP)
@@ -139,7 +161,32 @@ main(int argc, char **argv)
 	if (ret == PARSE_USAGE)
 		return (printUsage(argv[0]), EXIT_SUCCESS);
 
-	if (parseRes.posCount == 0)
+#if defined(HAJ)
+	if (parseRes.options.replay)
+	{
+		if (parseRes.posCount > 0 || parseRes.options.parallel)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --replay reads its packets from the file, no host is probed\n", argv[0]);
+			return (EXIT_FAILURE);
+		}
+		if (parseRes.options.outputFormat != OUTPUT_TEXT)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --output records live probes, not --replay\n", argv[0]);
+			return (EXIT_FAILURE);
+		}
+		if (parseRes.options.probeLog)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --probe-log records live probes, not --replay\n", argv[0]);
+			return (EXIT_FAILURE);
+		}
+		return (runReplay(&parseRes.options, parseRes.options.replay) != 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+#endif
+	if (parseRes.posCount == 0
+#if defined(HAJ)
+		&& !parseRes.options.targetList
+#endif
+		)
 	{
 		printMissingHost(argv[0]);
 		return (EXIT_MISSING_HOST);
@@ -150,6 +197,125 @@ main(int argc, char **argv)
 		ft_dprintf(STDERR_FILENO, "%s: -f and -i incompatible options\n", argv[0]);
 		return (EXIT_FAILURE);
 	}
+#if defined(HAJ)
+	if (parseRes.options.allAddresses
+		&& (parseRes.options.monitor || parseRes.options.pmtu
+			|| parseRes.options.timestamp || parseRes.options.address))
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --all-addresses only sends echo requests\n", argv[0]);
+		return (EXIT_FAILURE);
+	}
+	if (parseRes.options.outputFormat != OUTPUT_TEXT)
+	{
+		if (parseRes.options.monitor || parseRes.options.pmtu)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --output only records echo probes\n", argv[0]);
+			return (EXIT_FAILURE);
+		}
+		/* the records keep stdout, the text goes to stderr */
+		fflush(stdout);
+		if (outputOpen(&outputStore, parseRes.options.outputFormat, dup(STDOUT_FILENO)) != 0)
+			return (EXIT_FAILURE);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+		output = &outputStore;
+	}
+	if (parseRes.options.probeLog)
+	{
+		if (parseRes.options.monitor || parseRes.options.pmtu)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --probe-log only records echo probes\n", argv[0]);
+			exitCode = EXIT_FAILURE;
+			goto closeRecords;
+		}
+		if (plogOpen(&plogStore, parseRes.options.probeLog) != 0)
+		{
+			exitCode = EXIT_FAILURE;
+			goto closeRecords;
+		}
+		plog = &plogStore;
+	}
+	if (parseRes.options.capture)
+	{
+		if (parseRes.options.monitor || parseRes.options.pmtu)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --capture only records echo probes\n", argv[0]);
+			exitCode = EXIT_FAILURE;
+			goto closeRecords;
+		}
+		if (captureOpen(&captureStore, parseRes.options.capture,
+				(uint64_t)parseRes.options.captureSize << 20) != 0)
+		{
+			exitCode = EXIT_FAILURE;
+			goto closeRecords;
+		}
+		capture = &captureStore;
+	}
+	if (parseRes.options.packetRing
+		&& (parseRes.options.monitor || parseRes.options.pmtu || parseRes.options.parallel
+			|| parseRes.options.allAddresses || parseRes.options.timestamp || parseRes.options.address))
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --packet-ring only receives the echo replies of one target\n", argv[0]);
+		exitCode = EXIT_FAILURE;
+		goto closeRecords;
+	}
+	if (parseRes.options.rxWorkers > 0
+		&& !parseRes.options.parallel && !parseRes.options.allAddresses)
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --rx-workers needs --parallel or --all-addresses\n", argv[0]);
+		exitCode = EXIT_FAILURE;
+		goto closeRecords;
+	}
+	/* the capture ring has a single producer, the probing thread */
+	if (parseRes.options.rxWorkers > 0 && capture)
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --capture cannot record the replies of --rx-workers\n", argv[0]);
+		exitCode = EXIT_FAILURE;
+		goto closeRecords;
+	}
+	if (parseRes.options.rxWorkers > 0 && plog)
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --probe-log cannot record the replies of --rx-workers\n", argv[0]);
+		exitCode = EXIT_FAILURE;
+		goto closeRecords;
+	}
+	if (parseRes.options.rxWorkers > 0 && output)
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --output cannot record the replies of --rx-workers\n", argv[0]);
+		exitCode = EXIT_FAILURE;
+		goto closeRecords;
+	}
+	if (parseRes.options.parallel
+		&& (parseRes.options.monitor || parseRes.options.pmtu
+			|| parseRes.options.timestamp || parseRes.options.address))
+	{
+		ft_dprintf(STDERR_FILENO, "%s: --parallel only sends echo requests\n", argv[0]);
+		exitCode = EXIT_FAILURE;
+		goto closeRecords;
+	}
+	/* an unusable cache file only costs the speedup */
+	if (parseRes.options.dnsCache
+		&& dnsCacheOpen(&cacheStore, parseRes.options.dnsCache, parseRes.options.dnsCacheTtl) == 0)
+		cache = &cacheStore;
+	if (parseRes.options.parallel)
+	{
+		targetListInit(&targets);
+		ret = targetListAddArgs(&targets, parseRes.positionals, parseRes.posCount);
+		if (ret == 0 && parseRes.options.targetList)
+			ret = targetListRead(&targets, parseRes.options.targetList);
+		if (ret == 0 && targets.count == 0)
+		{
+			printMissingHost(argv[0]);
+			targetListFree(&targets);
+			exitCode = EXIT_MISSING_HOST;
+			goto closeRecords;
+		}
+		if (ret == 0)
+			ret = runParallelHosts(&parseRes.options, targets.hosts, targets.count, cache, capture, output, plog);
+		targetListFree(&targets);
+		exitCode = ret != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+		goto closeRecords;
+	}
+#endif
 
 	for (i = 0; i < parseRes.posCount; i++)
 	{
@@ -160,6 +326,9 @@ main(int argc, char **argv)
 		tPingSocket					sockCtx;
 		tPingContext				ctx;
 		tIpType						ipMode;
+#if defined(HAJ)
+		tRxRing						ringStore;
+#endif
 
 		host = parseRes.positionals[i];
 		addrList = NULL;
@@ -173,15 +342,25 @@ main(int argc, char **argv)
 			ipMode = IP_TYPE_V6;
 #endif
 
+#if defined(HAJ)
+		ret = dnsCacheResolveHost(cache,
+								  host,
+								  &targetAddr,
+								  &addrLen,
+								  &addrList,
+								  ipMode);
+#else
 		ret = resolveHost(host,
 						  &targetAddr,
 						  &addrLen,
 						  &addrList,
 						  ipMode);
+#endif
 		if (ret != 0)
 		{
 			ft_dprintf(STDERR_FILENO, "%s: unknown host\n", argv[0]);
-			exit(EXIT_FAILURE);
+			exitCode = EXIT_FAILURE;
+			break;
 		}
 
 		if (parseRes.options.verbose > 1)
@@ -189,12 +368,28 @@ main(int argc, char **argv)
 		if (parseRes.options.verbose > 2 && addrList)
 			printAllResolvedIPs(addrList, host);
 
+#if defined(HAJ)
+		if (parseRes.options.allAddresses)
+		{
+			ret = runMultiHost(&parseRes.options, host, addrList, capture, output, plog);
+			freeaddrinfo(addrList);
+			if (ret != 0)
+			{
+				exitCode = EXIT_FAILURE;
+				break;
+			}
+			ft_printf("\n");
+			continue;
+		}
+#endif
+
 		if (setupPingSocket(&sockCtx,
 							&parseRes.options,
 							&targetAddr) != 0)
 		{
 			freeaddrinfo(addrList);
-			exit(EXIT_FAILURE);
+			exitCode = EXIT_FAILURE;
+			break;
 		}
 
 		ft_bzero(&ctx, sizeof(ctx));
@@ -204,6 +399,46 @@ main(int argc, char **argv)
 		ctx.addrLen = addrLen;
 		ctx.pid = getpid() & 0xFFFF;
 		ft_strlcpy(ctx.targetHost, host, sizeof(ctx.targetHost) - 1);
+		if (pingBuffersInit(&ctx.bufs, &ctx.opts) != 0)
+		{
+			pingSocketClose(&ctx.sock);
+			freeaddrinfo(addrList);
+			exitCode = EXIT_FAILURE;
+			break;
+		}
+#if defined(HAJ)
+		ctx.capture = capture;
+		ctx.output = output;
+		ctx.plog = plog;
+		ret = probeKeyGenerate(ctx.probeKey);
+		if (ret != 0)
+			ft_dprintf(STDERR_FILENO, "%s: cannot generate probe key\n", argv[0]);
+		if (ret == 0 && ctx.opts.verbose > 1)
+			ft_printf("Packet buffers: %zu bytes%s\n", ctx.bufs.mapLen,
+				ctx.bufs.huge ? " (huge pages)" : "");
+		if (ret == 0 && ctx.opts.packetRing && ctx.sock.privilege != SOCKET_PRIV_RAW)
+		{
+			ft_dprintf(STDERR_FILENO, "%s: --packet-ring needs raw socket privileges\n", argv[0]);
+			ret = -1;
+		}
+		if (ret == 0 && ctx.opts.packetRing)
+			ret = rxRingOpen(&ringStore, ctx.sock.family, (uint16_t)ctx.pid);
+		if (ret != 0)
+		{
+			pingBuffersFree(&ctx.bufs);
+			pingSocketClose(&ctx.sock);
+			freeaddrinfo(addrList);
+			exitCode = EXIT_FAILURE;
+			break;
+		}
+		if (ctx.opts.packetRing)
+		{
+			/* the raw socket only sends from now on */
+			if (rxRingMuteSocket(ctx.sock.fd) != 0 && ctx.opts.verbose > 1)
+				ft_dprintf(STDERR_FILENO, "%s: raw socket keeps queueing replies\n", argv[0]);
+			ctx.ring = &ringStore;
+		}
+#endif
 
 #if defined(HAJ)
 		{
@@ -218,11 +453,12 @@ main(int argc, char **argv)
 				tmpCanon[sizeof(tmpCanon) - 1] = '\0';
 			}
 
-			resolvePeerName(&targetAddr,
-							addrLen,
-							tmpCanon,
-							ctx.canonicalName,
-							sizeof(ctx.canonicalName));
+			dnsCacheResolvePeer(cache,
+								&targetAddr,
+								addrLen,
+								tmpCanon,
+								ctx.canonicalName,
+								sizeof(ctx.canonicalName));
 		}
 #endif
 
@@ -237,11 +473,32 @@ main(int argc, char **argv)
 					  ctx.resolvedIp,
 					  sizeof(ctx.resolvedIp));
 
-		runPingLoop(&ctx);
+#if defined(HAJ)
+		if (ctx.opts.pmtu)
+			runPmtuDiscovery(&ctx);
+		else if (ctx.opts.monitor)
+			runMonitorLoop(&ctx);
+		else
+#endif
+			runPingLoop(&ctx);
 
+		pingBuffersFree(&ctx.bufs);
 		pingSocketClose(&ctx.sock);
 		freeaddrinfo(addrList);
 		ft_printf("\n");
+#if defined(HAJ)
+		if (ctx.ring)
+			rxRingClose(ctx.ring, ctx.opts.verbose);
+#endif
 	}
-	return (EXIT_SUCCESS);
+#if defined(HAJ)
+	/* every exit once the records are open ends here, a failed target
+	   stops the run: what was recorded is still flushed */
+closeRecords:
+	dnsCacheClose(cache);
+	captureClose(capture, parseRes.options.verbose);
+	outputClose(output);
+	plogClose(plog, parseRes.options.verbose);
+#endif
+	return (exitCode);
 }
@@ -0,0 +1,532 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/monitor.h"
+#include "../includes/pingUtils.h"
+#include "../includes/resolve.h"
+#include "../includes/utils.h"
+
+#define MONITOR_CLEAR_SCREEN "\033[H\033[2J"
+
+/**
+ * @brief Milliseconds elapsed between two timevals
+ */
+static double
+tvDiffMs(const struct timeval *end, const struct timeval *start)
+{
+	return ((end->tv_sec - start->tv_sec) * 1000.0
+		+ (end->tv_usec - start->tv_usec) / 1000.0);
+}
+
+/**
+ * @brief Number of hops probed each round (stops at the target once found)
+ */
+static int
+monitorHopLimit(const tMonitor *mon)
+{
+	if (mon->destHop > 0)
+		return (mon->destHop);
+	return (mon->maxHops);
+}
+
+/**
+ * @brief Set the TTL / hop limit used by the next probe
+ * @return 0 on success, -1 on failure
+ */
+static int
+monitorSetTtl(tPingContext *ctx, int ttl)
+{
+	if (ctx->sock.family == AF_INET6)
+		return (setsockopt(ctx->sock.fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &ttl, sizeof(ttl)));
+	return (setsockopt(ctx->sock.fd, IPPROTO_IP, IP_TTL, &ttl, sizeof(ttl)));
+}
+
+/**
+ * @brief Send one echo request with the given TTL and register it in the ring
+ * @param mon - monitor state
+ * @param hop - TTL to use (1-based)
+ */
+static void
+monitorSendProbe(tMonitor *mon, int hop)
+{
+	tPingContext	*ctx = mon->ctx;
+	uint32_t		packetLen;
+	uint16_t		seq;
+	tMonitorProbe	*probe;
+	ssize_t			sent;
+	struct timeval	now;
+	uint8_t			stamp[PROBE_HDR_LEN];
+
+	seq = (uint16_t)ctx->seq;
+	gettimeofday(&now, NULL);
+	probeStamp(ctx, ctx->seq, stamp);
+	/* the kernel fills the ICMPv6 checksum */
+	if (ctx->sock.family == AF_INET6)
+		packetLen = pingBuffersBuildEcho(&ctx->bufs, ICMP6_ECHO_REQUEST,
+			(uint16_t)ctx->pid, seq, stamp, 0, 0);
+	else
+		packetLen = pingBuffersBuildEcho(&ctx->bufs, ICMP4_ECHO_REQUEST,
+			(uint16_t)ctx->pid, seq, stamp, 0, 1);
+	if (packetLen == 0 || monitorSetTtl(ctx, hop) != 0)
+		return;
+
+	probe = &mon->probes[seq % MONITOR_INFLIGHT];
+	probe->seq = seq;
+	probe->hop = (uint8_t)hop;
+	probe->pending = TRUE;
+	probe->sentAt = now;
+
+	if (ctx->sock.privilege == SOCKET_PRIV_USER)
+		sent = send(ctx->sock.fd, ctx->bufs.send, packetLen, 0);
+	else
+		sent = sendto(ctx->sock.fd, ctx->bufs.send, packetLen, 0,
+			(struct sockaddr *)&ctx->targetAddr, ctx->addrLen);
+	ctx->seq++;
+	if (sent < 0)
+	{
+		probe->pending = FALSE;
+		if (ctx->opts.verbose > 1)
+			ft_dprintf(STDERR_FILENO, "sendto failed: %s (%d)\n", strerror(errno), errno);
+		return;
+	}
+	mon->hops[hop - 1].stats.sent++;
+	ctx->stats.sent++;
+}
+
+/**
+ * @brief Name of a hop address, from the cache or looked up and cached
+ * @param mon - monitor state
+ * @param from - hop address
+ * @param len - bytes of the address compared and passed to the lookup
+ * @param ip - address text, the name when the lookup gives none
+ * @param host - filled with the name
+ * @param hostLen - size of host
+ */
+static void
+monitorHopName(tMonitor *mon, const struct sockaddr_storage *from, socklen_t len,
+			   const char *ip, char *host, size_t hostLen)
+{
+	tMonitorName	*name;
+
+	for (unsigned int i = 0; i < mon->nameCount; i++)
+	{
+		if (mon->names[i].addr.ss_family == from->ss_family
+			&& ft_memcmp(&mon->names[i].addr, from, len) == 0)
+		{
+			ft_strlcpy(host, mon->names[i].host, hostLen);
+			return;
+		}
+	}
+	ft_strlcpy(host, ip, hostLen);
+	resolvePeerName(from, len, NULL, host, hostLen);
+	if (!host[0])
+		ft_strlcpy(host, ip, hostLen);
+	if (mon->nameCount < MONITOR_NAMES)
+		name = &mon->names[mon->nameCount++];
+	else
+	{
+		name = &mon->names[mon->nameNext];
+		mon->nameNext = (mon->nameNext + 1) % MONITOR_NAMES;
+	}
+	name->addr = *from;
+	ft_strlcpy(name->host, host, sizeof(name->host));
+}
+
+/**
+ * @brief Remember which address answered for a hop (its name looked up once
+ * per address)
+ */
+static void
+monitorSetHopAddr(tMonitor *mon, tHopStats *hop, const struct sockaddr_storage *from)
+{
+	socklen_t	len;
+	const void	*raw;
+
+	if (from->ss_family == AF_INET6)
+	{
+		raw = &((const struct sockaddr_in6 *)from)->sin6_addr;
+		len = sizeof(struct sockaddr_in6);
+	}
+	else
+	{
+		raw = &((const struct sockaddr_in *)from)->sin_addr;
+		len = sizeof(struct sockaddr_in);
+	}
+	if (hop->haveAddr && hop->addr.ss_family == from->ss_family
+		&& ft_memcmp(&hop->addr, from, len) == 0)
+		return;
+	hop->addr = *from;
+	hop->haveAddr = TRUE;
+	inet_ntop(from->ss_family, raw, hop->ip, sizeof(hop->ip));
+	if (mon->ctx->opts.numeric)
+		ft_strlcpy(hop->host, hop->ip, sizeof(hop->host));
+	else
+		monitorHopName(mon, from, len, hop->ip, hop->host, sizeof(hop->host));
+}
+
+/**
+ * @brief Account a matched reply (echo reply or ICMP error) to its hop
+ * @param mon - monitor state
+ * @param seq - sequence number of the original probe
+ * @param from - responder address
+ * @param reached - TRUE if the target itself answered
+ */
+static void
+monitorMatch(tMonitor *mon, uint16_t seq, const struct sockaddr_storage *from, tBool reached)
+{
+	tMonitorProbe	*probe;
+	tHopStats		*hop;
+	struct timeval	now;
+	double			ms;
+
+	probe = &mon->probes[seq % MONITOR_INFLIGHT];
+	if (probe->seq != seq || probe->hop == 0)
+		return;
+	hop = &mon->hops[probe->hop - 1];
+	if (!probe->pending)
+	{
+		hop->stats.duplicates++;
+		hop->stats.received++;
+		return;
+	}
+	probe->pending = FALSE;
+
+	gettimeofday(&now, NULL);
+	ms = tvDiffMs(&now, &probe->sentAt);
+	hop->stats.received++;
+	hop->lastRtt = ms;
+	pingStatsAddRtt(&hop->stats, ms);
+	rttHistAdd(&hop->hist, ms);
+	rttJitterAdd(&hop->jitter, ms);
+	monitorSetHopAddr(mon, hop, from);
+	mon->ctx->stats.received++;
+
+	if (reached && (mon->destHop == 0 || probe->hop < mon->destHop))
+		mon->destHop = probe->hop;
+}
+
+/**
+ * @brief Extract id/seq of our echo request quoted inside an ICMP error
+ * @param quoted - start of the quoted IP header
+ * @param len - bytes available
+ * @param family - address family of the quoted packet
+ * @param id - output identifier (host order)
+ * @param seq - output sequence (host order)
+ * @return 0 if an echo request was found, -1 otherwise
+ */
+static int
+monitorParseQuoted(const unsigned char *quoted, size_t len, int family,
+				   uint16_t *id, uint16_t *seq)
+{
+	size_t			hdrLen;
+	tIpHdr			ip4;
+	tIp6Hdr			ip6;
+	uint8_t			echoType;
+
+	if (family == AF_INET6)
+	{
+		/* walk extension headers the probe may have picked up on the way */
+		hdrLen = parseIp6HeaderFromBuffer(quoted, len, &ip6);
+		if (hdrLen == 0 || len < hdrLen + ICMP6_HDR_LEN || ip6.next_header != IP_PROTO_ICMPV6)
+			return (-1);
+		echoType = ICMP6_ECHO_REQUEST;
+	}
+	else
+	{
+		hdrLen = parseIpHeaderFromBuffer(quoted, len, &ip4);
+		if (hdrLen == 0 || len < hdrLen + ICMP4_HDR_LEN || ip4.protocol != IP_PROTO_ICMP)
+			return (-1);
+		echoType = ICMP4_ECHO_REQUEST;
+	}
+	if (quoted[hdrLen] != echoType)
+		return (-1);
+	*id = (uint16_t)((quoted[hdrLen + 4] << 8) | quoted[hdrLen + 5]);
+	*seq = (uint16_t)((quoted[hdrLen + 6] << 8) | quoted[hdrLen + 7]);
+	return (0);
+}
+
+/**
+ * @brief Compare the address part of two sockaddr_storage
+ */
+static tBool
+monitorSameAddr(const struct sockaddr_storage *a, const struct sockaddr_storage *b)
+{
+	if (a->ss_family != b->ss_family)
+		return (FALSE);
+	if (a->ss_family == AF_INET6)
+		return (ft_memcmp(&((const struct sockaddr_in6 *)a)->sin6_addr,
+			&((const struct sockaddr_in6 *)b)->sin6_addr, sizeof(struct in6_addr)) == 0);
+	return (((const struct sockaddr_in *)a)->sin_addr.s_addr
+		== ((const struct sockaddr_in *)b)->sin_addr.s_addr);
+}
+
+/**
+ * @brief Read one packet from the socket and dispatch it
+ * Raw sockets see echo replies and ICMP errors quoting our requests;
+ * DGRAM sockets only see echo replies (errors come from the error queue).
+ * @param mon - monitor state
+ */
+static void
+monitorReceive(tMonitor *mon)
+{
+	tPingContext			*ctx = mon->ctx;
+	unsigned char			*buf = ctx->bufs.recv;
+	struct sockaddr_storage	from;
+	socklen_t				fromLen = sizeof(from);
+	const unsigned char		*icmp;
+	size_t					icmpLen;
+	ssize_t					n;
+	uint16_t				id;
+	uint16_t				seq;
+	tIpHdr					ip4;
+	size_t					ipLen;
+	tBool					isV6 = (ctx->sock.family == AF_INET6);
+
+	n = recvfrom(ctx->sock.fd, buf, ctx->bufs.recvSize, MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen);
+	if (n <= 0)
+		return;
+	icmp = buf;
+	icmpLen = (size_t)n;
+	if (!isV6 && ctx->sock.privilege == SOCKET_PRIV_RAW)
+	{
+		ipLen = parseIpHeaderFromBuffer(buf, (size_t)n, &ip4);
+		if (ipLen == 0)
+			return;
+		icmp += ipLen;
+		icmpLen -= ipLen;
+	}
+	if (icmpLen < ICMP4_HDR_LEN)
+		return;
+
+	if (icmp[0] == (isV6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+	{
+		id = (uint16_t)((icmp[4] << 8) | icmp[5]);
+		seq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+		if (ctx->sock.privilege == SOCKET_PRIV_RAW && id != (uint16_t)ctx->pid)
+			return;
+		if (!monitorSameAddr(&from, &ctx->targetAddr))
+			return;
+		monitorMatch(mon, seq, &from, TRUE);
+		return;
+	}
+	if (ctx->sock.privilege != SOCKET_PRIV_RAW)
+		return;
+	if ((!isV6 && icmp[0] != ICMP4_TIME_EXCEEDED && icmp[0] != ICMP4_DEST_UNREACH)
+		|| (isV6 && icmp[0] != ICMP6_TIME_EXCEEDED && icmp[0] != ICMP6_DEST_UNREACH))
+		return;
+	if (monitorParseQuoted(icmp + 8, icmpLen - 8, ctx->sock.family, &id, &seq) != 0
+		|| id != (uint16_t)ctx->pid)
+		return;
+	monitorMatch(mon, seq, &from, monitorSameAddr(&from, &ctx->targetAddr));
+}
+
+/**
+ * @brief Drain the error queue of a DGRAM socket (time exceeded / unreachable)
+ * The kernel returns the probe we sent as data, so its sequence is at offset 6.
+ * @param mon - monitor state
+ */
+static void
+monitorReceiveErrors(tMonitor *mon)
+{
+	tPingContext				*ctx = mon->ctx;
+	unsigned char				data[64];
+	unsigned char				cmsgbuf[512];
+	struct sockaddr_storage		target;
+	struct msghdr				msg;
+	struct iovec				iov;
+	struct cmsghdr				*c;
+	struct sock_extended_err	*err;
+	struct sockaddr_storage		from;
+	ssize_t						n;
+
+	while (1)
+	{
+		iov.iov_base = data;
+		iov.iov_len = sizeof(data);
+		ft_bzero(&msg, sizeof(msg));
+		msg.msg_name = &target;
+		msg.msg_namelen = sizeof(target);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsgbuf;
+		msg.msg_controllen = sizeof(cmsgbuf);
+		n = recvmsg(ctx->sock.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		if (n < 0)
+			return;
+		if (n < ICMP4_HDR_LEN)
+			continue;
+		for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+		{
+			if (!(c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+				&& !(c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))
+				continue;
+			err = (struct sock_extended_err *)CMSG_DATA(c);
+			if (err->ee_origin != SO_EE_ORIGIN_ICMP && err->ee_origin != SO_EE_ORIGIN_ICMP6)
+				continue;
+			ft_bzero(&from, sizeof(from));
+			if (c->cmsg_level == SOL_IPV6)
+				ft_memcpy(&from, SO_EE_OFFENDER(err), sizeof(struct sockaddr_in6));
+			else
+				ft_memcpy(&from, SO_EE_OFFENDER(err), sizeof(struct sockaddr_in));
+			monitorMatch(mon, (uint16_t)((data[6] << 8) | data[7]), &from,
+				monitorSameAddr(&from, &ctx->targetAddr));
+		}
+	}
+}
+
+/**
+ * @brief Print the refreshed per-hop table
+ * @param mon - monitor state
+ */
+static void
+printMonitorTable(const tMonitor *mon)
+{
+	int		limit = monitorHopLimit(mon);
+
+	if (isatty(STDOUT_FILENO))
+		printf(MONITOR_CLEAR_SCREEN);
+	printf(PROG_NAME " monitor %s (%s), round %u\n",
+		mon->ctx->targetHost, mon->ctx->resolvedIp, mon->rounds);
+	printf("%-4s %-40s %6s %5s %8s %8s %8s %8s %8s %8s\n",
+		"Hop", "Host", "Loss%", "Snt", "Last", "Avg", "Best", "Wrst", "StDev", "Jttr");
+	for (int i = 0; i < limit; i++)
+	{
+		const tHopStats	*hop = &mon->hops[i];
+		char			label[64];
+
+		if (!hop->haveAddr)
+		{
+			printf("%3d. %-40s %5.1f%% %5u\n", i + 1, "???",
+				pingStatsLoss(&hop->stats), hop->stats.sent);
+			continue;
+		}
+		truncateAndMark(label, sizeof(label), hop->host, 40);
+		printf("%3d. %-40s %5.1f%% %5u %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+			i + 1, label,
+			pingStatsLoss(&hop->stats), hop->stats.sent,
+			hop->lastRtt, pingStatsAvg(&hop->stats),
+			hop->stats.rttMin, hop->stats.rttMax,
+			pingStatsStddev(&hop->stats), hop->jitter.jitter);
+	}
+	fflush(stdout);
+}
+
+void
+printMonitorSummary(const tMonitor *mon)
+{
+	int		limit;
+
+	if (!mon)
+		return;
+	limit = monitorHopLimit(mon);
+	printf("\n--- %s " PROG_NAME " monitor statistics ---\n", mon->ctx->targetHost);
+	for (int i = 0; i < limit; i++)
+	{
+		const tHopStats	*hop = &mon->hops[i];
+
+		printf("hop %2d %s", i + 1, hop->haveAddr ? hop->ip : "???");
+		if (hop->haveAddr && ft_strcmp(hop->host, hop->ip) != 0)
+			printf(" (%s)", hop->host);
+		printf(": %u packets transmitted, %u received, %.0f%% packet loss",
+			hop->stats.sent, hop->stats.received, pingStatsLoss(&hop->stats));
+		if (hop->stats.duplicates > 0)
+			printf(" ++%u duplicates", hop->stats.duplicates);
+		printf("\n");
+		if (hop->stats.rttCount == 0)
+			continue;
+		printf("       round-trip min/avg/max/stdev = %.3f/%.3f/%.3f/%.3f ms, jitter %.3f ms\n",
+			hop->stats.rttMin, pingStatsAvg(&hop->stats), hop->stats.rttMax,
+			pingStatsStddev(&hop->stats), hop->jitter.jitter);
+		printf("       p50/p90/p99 <= %.3f/%.3f/%.3f ms\n",
+			rttHistPercentile(&hop->hist, 50.0),
+			rttHistPercentile(&hop->hist, 90.0),
+			rttHistPercentile(&hop->hist, 99.0));
+	}
+	fflush(stdout);
+}
+
+void
+runMonitorLoop(tPingContext *ctx)
+{
+	tMonitor		*mon;
+	fd_set			fdset;
+	struct timeval	start, now, nextSend, wait, gap;
+	double			iv;
+	int				hop;
+
+	if (!ctx)
+		return;
+	mon = calloc(1, sizeof(*mon));
+	if (!mon)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return;
+	}
+	mon->ctx = ctx;
+	mon->maxHops = ctx->opts.maxHops > 0 ? ctx->opts.maxHops : MONITOR_DEFAULT_HOPS;
+	if (mon->maxHops > MONITOR_MAX_HOPS)
+		mon->maxHops = MONITOR_MAX_HOPS;
+	ctx->seq = 0;
+	pingStatsReset(&ctx->stats);
+	signal(SIGINT, handleSigInt);
+
+	/* a round probes every hop once per interval, probes are spread evenly */
+	iv = ctx->opts.interval > 0.0 ? ctx->opts.interval : PING_DEFAULT_INTERVAL;
+	gettimeofday(&start, NULL);
+	nextSend = start;
+	hop = 1;
+
+	while (!g_pingInterrupted)
+	{
+		gettimeofday(&now, NULL);
+		if (ctx->opts.timeout > 0 && now.tv_sec - start.tv_sec >= ctx->opts.timeout)
+			break;
+		if (!timercmp(&now, &nextSend, <))
+		{
+			if (hop > monitorHopLimit(mon))
+			{
+				mon->rounds++;
+				if (!ctx->opts.quiet)
+					printMonitorTable(mon);
+				if (ctx->opts.count > 0 && mon->rounds >= ctx->opts.count)
+					break;
+				hop = 1;
+			}
+			monitorSendProbe(mon, hop++);
+			timevalFromDouble(&gap, iv / monitorHopLimit(mon));
+			normalizeTimeval(&gap);
+			timeradd(&nextSend, &gap, &nextSend);
+			if (timercmp(&nextSend, &now, <))
+				nextSend = now;
+			continue;
+		}
+
+		timersub(&nextSend, &now, &wait);
+		FD_ZERO(&fdset);
+		FD_SET(ctx->sock.fd, &fdset);
+		if (select(ctx->sock.fd + 1, &fdset, NULL, NULL, &wait) < 0)
+		{
+			if (errno == EINTR)
+				break;
+			ft_dprintf(STDERR_FILENO, "select failed: %s\n", strerror(errno));
+			break;
+		}
+		if (FD_ISSET(ctx->sock.fd, &fdset))
+		{
+			if (ctx->sock.privilege == SOCKET_PRIV_USER)
+				monitorReceiveErrors(mon);
+			monitorReceive(mon);
+		}
+	}
+
+	printMonitorSummary(mon);
+	free(mon);
+}
@@ -0,0 +1,1152 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/multi.h"
+#include "../includes/pingUtils.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Index of the shared socket used for a family
+ */
+static int
+multiSockIndex(int family)
+{
+	return (family == AF_INET6 ? 1 : 0);
+}
+
+/**
+ * @brief ICMP identifier carried by the probes of a family
+ * DGRAM sockets rewrite it and only deliver their own replies, the kernel
+ * has already demultiplexed by identifier: those targets are keyed with 0.
+ */
+static uint16_t
+multiIdent(const tMulti *multi, int family)
+{
+	if (multi->socks[multiSockIndex(family)].privilege == SOCKET_PRIV_RAW)
+		return ((uint16_t)multi->pid);
+	return (0);
+}
+
+/**
+ * @brief Find the target probed at an address
+ * @param ident - identifier of the reply (ignored for DGRAM sockets)
+ * @return target index, TABLE_NONE if the address is not one of ours
+ */
+static size_t
+multiFind(const tMulti *multi, const struct sockaddr_storage *addr, uint16_t ident)
+{
+	tTargetKey	key;
+
+	if (multiIdent(multi, addr->ss_family) == 0)
+		ident = 0;
+	if (targetTableKey(&key, addr, ident) != 0)
+		return (TABLE_NONE);
+	return (targetTableFind(&multi->table, &key));
+}
+
+/**
+ * @brief Create and configure the shared socket of a family
+ * The socket has no target address so DGRAM sockets stay unconnected.
+ * @param multi - engine
+ * @param family - AF_INET or AF_INET6
+ * @return 0 on success, -1 on failure
+ */
+static int
+multiOpenSocket(tMulti *multi, int family)
+{
+	tPingSocket			*sock = &multi->socks[multiSockIndex(family)];
+	tSocketPrivilege	priv;
+
+	priv = sockDetectPrivilege();
+	if (sockValidatePrivileges(&multi->opts, priv) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, "Some options require root privileges.\n");
+		return (-1);
+	}
+	socketInit(sock, family, PING_SOCKET_ECHO, priv);
+	if (pingSocketCreate(sock) != 0)
+		return (-1);
+	if (socketApplyCommonOptions(sock, &multi->opts) != 0
+		|| socketApplyOptions(sock, &multi->opts) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, "Failed to apply socket options.\n");
+		pingSocketClose(sock);
+		return (-1);
+	}
+	/* a timer batch sends MULTI_BATCH probes back to back, raw sockets also
+	   see their own requests on loopback: make room for several batches */
+	setsockopt(sock->fd, SOL_SOCKET, SO_RCVBUF, &(int){MULTI_RCVBUF}, sizeof(int));
+	/* with receive workers the socket only sends */
+	if (multi->rxPool && rxRingMuteSocket(sock->fd) != 0 && multi->opts.verbose > 1)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": raw socket keeps queueing replies\n");
+	if (multi->opts.verbose > 1)
+		ft_printf("Socket fd %d created (family=%s, priv=%s), shared\n",
+			sock->fd, family == AF_INET ? "AF_INET" : "AF_INET6",
+			sock->privilege == SOCKET_PRIV_RAW ? "RAW" : "USER");
+	return (0);
+}
+
+/**
+ * @brief Whether name is worth printing next to the address of target i
+ */
+static tBool
+multiShowName(const tMulti *multi, const char *name, size_t i)
+{
+	return (ft_strcmp(name, multi->label) != 0 && ft_strcmp(name, multi->table.ip[i]) != 0);
+}
+
+/**
+ * @brief Announce a target name in the header list: "address" or "host (address)"
+ */
+static void
+multiPrintTarget(const tMulti *multi, const char *name, size_t i)
+{
+	if (multiShowName(multi, name, i))
+		ft_printf("  %s (%s)\n", name, multi->table.ip[i]);
+	else
+		ft_printf("  %s\n", multi->table.ip[i]);
+}
+
+/**
+ * @brief Write the record of a probe outcome of target i (--output,
+ * --probe-log)
+ * @param seq - ICMP sequence of the probe
+ * @param status - outcome
+ * @param ttl / rttNs / size - reply or error fields, negative if absent
+ * @param icmp - ICMP error (type and code), NULL for other outcomes
+ */
+static void
+multiOutput(tMulti *multi, size_t i, uint16_t seq, tOutputStatus status,
+			int ttl, int64_t rttNs, int64_t size, const unsigned char *icmp)
+{
+	tOutputProbe	rec;
+
+	if (!multi->output && !multi->plog)
+		return;
+	rec.target = multi->table.host[i];
+	rec.addr = multi->table.ip[i];
+	rec.seq = seq;
+	rec.status = status;
+	rec.ttl = ttl;
+	rec.rttNs = rttNs;
+	rec.size = size;
+	rec.errType = icmp ? icmp[0] : -1;
+	rec.errCode = icmp ? icmp[1] : -1;
+	outputProbe(multi->output, &rec);
+	plogProbe(multi->plog, &rec);
+}
+
+int
+multiInit(tMulti *multi, const tPingOptions *opts, const char *label)
+{
+	if (!multi || !opts || !label)
+		return (-1);
+	ft_bzero(multi, sizeof(*multi));
+	multi->opts = *opts;
+	multi->socks[0].fd = -1;
+	multi->socks[1].fd = -1;
+	multi->pid = getpid() & 0xFFFF;
+	targetTableInit(&multi->table);
+	wheelInit(&multi->wheel, monotonicNs());
+	ft_strlcpy(multi->label, label, sizeof(multi->label));
+	if (pingBuffersInit(&multi->bufs, &multi->opts) != 0)
+		return (-1);
+	if (probeKeyGenerate(multi->probeKey) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": cannot generate probe key\n");
+		pingBuffersFree(&multi->bufs);
+		return (-1);
+	}
+	return (0);
+}
+
+int
+multiAddTarget(
+	tMulti							*multi,
+	const char						*host,
+	const struct sockaddr_storage	*addr,
+	socklen_t						addrLen)
+{
+	tPingSocket	*sock;
+	tTargetKey	key;
+	size_t		i;
+
+	(void)addrLen;
+	if (!multi || !host || !addr || (addr->ss_family != AF_INET && addr->ss_family != AF_INET6))
+		return (-1);
+	sock = &multi->socks[multiSockIndex(addr->ss_family)];
+	if (sock->fd < 0 && multiOpenSocket(multi, addr->ss_family) != 0)
+		return (-1);
+	targetTableKey(&key, addr, multiIdent(multi, addr->ss_family));
+	i = targetTableFind(&multi->table, &key);
+	if (i != TABLE_NONE)
+	{
+		uint32_t	before = multi->table.aliasCount[i];
+
+		if (targetTableAddAlias(&multi->table, i, host) != 0)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+			return (-1);
+		}
+		if (multi->running && multi->table.aliasCount[i] != before)
+			multiPrintTarget(multi, host, i);
+		return (0);
+	}
+	if (wheelReserve(&multi->wheel, (multi->table.count + 1) * MULTI_TIMERS) == 0)
+		i = targetTableAdd(&multi->table, &key, addr->ss_family == AF_INET6
+			? ((const struct sockaddr_in6 *)addr)->sin6_scope_id : 0, host);
+	if (i == TABLE_NONE)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return (-1);
+	}
+	multi->pending++;
+	if (multi->running)
+	{
+		multiPrintTarget(multi, host, i);
+		multi->table.nextNs[i] = monotonicNs();
+		wheelArm(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_SEND), multi->table.nextNs[i]);
+	}
+	return (0);
+}
+
+size_t
+multiAddHost(tMulti *multi, const char *host, const struct addrinfo *list)
+{
+	size_t	added = 0;
+
+	if (!multi || !host)
+		return (0);
+	for (const struct addrinfo *cur = list; cur; cur = cur->ai_next)
+	{
+		struct sockaddr_storage	addr;
+
+		if (cur->ai_family != AF_INET && cur->ai_family != AF_INET6)
+			continue;
+		ft_bzero(&addr, sizeof(addr));
+		ft_memcpy(&addr, cur->ai_addr, cur->ai_addrlen);
+		if (multiAddTarget(multi, host, &addr, cur->ai_addrlen) == 0)
+			added++;
+		if (!multi->opts.allAddresses)
+			break;
+	}
+	return (added);
+}
+
+void
+multiFree(tMulti *multi)
+{
+	if (!multi)
+		return;
+	if (multi->rxPool)
+		rxPoolClose(multi->rxPool, multi->opts.verbose);
+	targetTableFree(&multi->table);
+	wheelFree(&multi->wheel);
+	for (int i = 0; i < 2; i++)
+		if (multi->socks[i].fd >= 0)
+			pingSocketClose(&multi->socks[i]);
+	pingBuffersFree(&multi->bufs);
+}
+
+/**
+ * @brief Send the next echo request to one target
+ * The shared sockets are unconnected, so every probe goes through sendto.
+ * The caller keeps fewer than TABLE_WINDOW probes of the target in flight
+ * and has recorded the probe (targetTableProbe).
+ * @param multi - engine
+ * @param i - target index
+ * @param nowNs - monotonic send time
+ */
+static void
+multiSendProbe(tMulti *multi, size_t i, uint64_t nowNs)
+{
+	tTargetTable			*t = &multi->table;
+	const tTargetKey		*key = &t->keys[i];
+	struct sockaddr_storage	dst;
+	socklen_t				dstLen;
+	uint8_t					stamp[PROBE_HDR_LEN];
+	uint32_t				seq = t->seq[i]++;
+	uint32_t				packetLen;
+	ssize_t					sent;
+
+	if (multi->bufs.stampLen > 0)
+		probeHeaderWrite(stamp, multi->bufs.stampLen, multi->probeKey, seq, nowNs,
+			key->addr, key->family == AF_INET6 ? 16 : 4);
+	/* the kernel fills the ICMPv6 checksum */
+	if (key->family == AF_INET6)
+		packetLen = pingBuffersBuildEcho(&multi->bufs, ICMP6_ECHO_REQUEST,
+			(uint16_t)multi->pid, (uint16_t)seq, stamp, 0, 0);
+	else
+		packetLen = pingBuffersBuildEcho(&multi->bufs, ICMP4_ECHO_REQUEST,
+			(uint16_t)multi->pid, (uint16_t)seq, stamp, 0, 1);
+	if (packetLen == 0)
+		return;
+	dstLen = targetTableSockaddr(t, i, &dst);
+	sent = sendto(multi->socks[multiSockIndex(key->family)].fd, multi->bufs.send, packetLen, 0,
+		(struct sockaddr *)&dst, dstLen);
+	if (sent < 0)
+	{
+		if (multi->opts.verbose > 1)
+			ft_dprintf(STDERR_FILENO, "sendto %s failed: %s (%d)\n",
+				t->ip[i], strerror(errno), errno);
+		return;
+	}
+	captureSent(multi->capture, &dst, (uint8_t)(multi->opts.ttl > 0 ? multi->opts.ttl : 64),
+		multi->bufs.send, packetLen);
+	t->stats[i].sent++;
+	multi->sentTotal++;
+	multi->lastSendNs = nowNs;
+	/* receive workers account the reply, the probe is not tracked here */
+	if (multi->rxPool)
+		return;
+	t->unacked[i] |= 1ULL << (seq - t->oldest[i]);
+	multi->inflight++;
+}
+
+/**
+ * @brief Account and print an authenticated echo reply
+ * @param multi - engine
+ * @param i - index of the target that answered
+ * @param icmp - ICMP echo reply
+ * @param icmpLen - length of icmp
+ * @param ttl - TTL / hop limit of the reply
+ * @return why the reply was not accounted, NULL if it was
+ */
+static const char *
+multiHandleReply(tMulti *multi, size_t i, const unsigned char *icmp,
+				 size_t icmpLen, uint8_t ttl)
+{
+	tTargetTable	*t = &multi->table;
+	tProbeInfo		probe;
+	tReplyMark		mark;
+	uint16_t		seq;
+	uint32_t		ext;
+	tBool			haveRtt = FALSE;
+	double			ms = 0.0;
+
+	seq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+	if (multi->bufs.stampLen > 0)
+	{
+		/* foreign or forged echo replies are dropped before any stats work */
+		if (probeHeaderRead(icmp + ICMP4_HDR_LEN, (uint32_t)(icmpLen - ICMP4_HDR_LEN),
+				multi->bufs.stampLen, multi->probeKey, seq, t->keys[i].addr,
+				t->keys[i].family == AF_INET6 ? 16 : 4, monotonicNs(), &probe) != 0)
+		{
+			if (multi->opts.verbose > 1)
+				ft_printf("Ignoring unauthenticated echo reply from %s: icmp_seq=%u\n",
+					t->ip[i], seq);
+			return ("unauthenticated");
+		}
+		ms = (double)probe.rttNs / 1000000.0;
+		haveRtt = TRUE;
+	}
+	/* the wire sequence is 16 bits: extend it around the last one sent */
+	ext = t->seq[i] + (uint32_t)(int32_t)(int16_t)(seq - (uint16_t)t->seq[i]);
+	mark = targetTableMark(t, i, ext);
+	if (mark == REPLY_STALE)
+	{
+		if (multi->opts.verbose > 1)
+			ft_printf("Ignoring late echo reply from %s: icmp_seq=%u\n", t->ip[i], seq);
+		return ("late");
+	}
+	t->stats[i].received++;
+	/* answered before its timeout: no longer in flight */
+	if (mark == REPLY_NEW && targetTableAck(t, i, ext))
+		multi->inflight--;
+	if (mark == REPLY_DUP)
+		t->stats[i].duplicates++;
+	else if (haveRtt)
+	{
+		pingStatsAddRtt(&t->stats[i], ms);
+		rttHistAdd(&t->hist[i], ms);
+		rttJitterAdd(&t->jitter[i], ms);
+	}
+	multiOutput(multi, i, seq, mark == REPLY_DUP ? OUTPUT_DUPLICATE : OUTPUT_REPLY, ttl,
+		haveRtt ? (int64_t)probe.rttNs : -1, (int64_t)icmpLen, NULL);
+	if (multi->opts.quiet || multi->opts.flood)
+		return (NULL);
+	ft_printf("%u bytes from %s: icmp_seq=%u ttl=%u",
+		(unsigned int)icmpLen, t->ip[i], seq, ttl);
+	if (haveRtt)
+		ft_printf(" time=%.3f ms", ms);
+	if (mark == REPLY_DUP)
+		ft_printf(" (DUP!)");
+	ft_printf("\n");
+	return (NULL);
+}
+
+/**
+ * @brief Find the target of an ICMP error quoting one of our requests (raw sockets)
+ * @param multi - engine
+ * @param quoted - start of the quoted IP header
+ * @param len - bytes available
+ * @param family - address family of the quoted packet
+ * @param seq - set to the ICMP sequence of the quoted request
+ * @return index of the target the quoted request was sent to, TABLE_NONE if not ours
+ */
+static size_t
+multiQuotedTarget(tMulti *multi, const unsigned char *quoted, size_t len, int family,
+				  uint16_t *seq)
+{
+	struct sockaddr_storage	dst;
+	tIpHdr					ip4;
+	tIp6Hdr					ip6;
+	size_t					hdrLen;
+
+	ft_bzero(&dst, sizeof(dst));
+	dst.ss_family = family;
+	if (family == AF_INET6)
+	{
+		hdrLen = parseIp6HeaderFromBuffer(quoted, len, &ip6);
+		if (hdrLen == 0 || len < hdrLen + ICMP6_HDR_LEN || ip6.next_header != IP_PROTO_ICMPV6
+			|| quoted[hdrLen] != ICMP6_ECHO_REQUEST)
+			return (TABLE_NONE);
+		ft_memcpy(&((struct sockaddr_in6 *)&dst)->sin6_addr, ip6.daddr, sizeof(ip6.daddr));
+	}
+	else
+	{
+		hdrLen = parseIpHeaderFromBuffer(quoted, len, &ip4);
+		if (hdrLen == 0 || len < hdrLen + ICMP4_HDR_LEN || ip4.protocol != IP_PROTO_ICMP
+			|| quoted[hdrLen] != ICMP4_ECHO_REQUEST)
+			return (TABLE_NONE);
+		((struct sockaddr_in *)&dst)->sin_addr.s_addr = ip4.daddr;
+	}
+	*seq = (uint16_t)((quoted[hdrLen + 6] << 8) | quoted[hdrLen + 7]);
+	return (multiFind(multi, &dst, (uint16_t)((quoted[hdrLen + 4] << 8) | quoted[hdrLen + 5])));
+}
+
+/**
+ * @brief Drain the error queue of an unconnected DGRAM socket
+ * msg_name holds the destination of the probe that failed.
+ * @param multi - engine
+ * @param sock - shared socket
+ */
+static void
+multiReceiveErrors(tMulti *multi, const tPingSocket *sock)
+{
+	unsigned char				data[64];
+	unsigned char				cmsgbuf[512];
+	unsigned char				icmp[2];
+	struct sockaddr_storage		dst;
+	struct sockaddr_storage		from;
+	struct msghdr				msg;
+	struct iovec				iov;
+	struct sock_extended_err	*err;
+	size_t						target;
+	ssize_t						n;
+
+	while (1)
+	{
+		iov.iov_base = data;
+		iov.iov_len = sizeof(data);
+		ft_bzero(&msg, sizeof(msg));
+		ft_bzero(&dst, sizeof(dst));
+		msg.msg_name = &dst;
+		msg.msg_namelen = sizeof(dst);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsgbuf;
+		msg.msg_controllen = sizeof(cmsgbuf);
+		n = recvmsg(sock->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		if (n < 0)
+			return;
+		target = multiFind(multi, &dst, 0);
+		if (target == TABLE_NONE)
+			continue;
+		for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+		{
+			if (!(c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+				&& !(c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))
+				continue;
+			err = (struct sock_extended_err *)CMSG_DATA(c);
+			if (err->ee_origin != SO_EE_ORIGIN_ICMP && err->ee_origin != SO_EE_ORIGIN_ICMP6)
+				continue;
+			multi->table.stats[target].errors++;
+			icmp[0] = err->ee_type;
+			icmp[1] = err->ee_code;
+			/* the failed probe comes back with the error */
+			multiOutput(multi, target, (uint16_t)(n >= ICMP4_HDR_LEN
+				? data[6] << 8 | data[7] : 0), OUTPUT_ERROR, -1, -1, -1, icmp);
+			if (multi->opts.quiet)
+				continue;
+			ft_bzero(&from, sizeof(from));
+			ft_memcpy(&from, SO_EE_OFFENDER(err), c->cmsg_level == SOL_IPV6
+				? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in));
+			printInvalidIcmpError(&from, icmp, sizeof(icmp), multi->opts.numeric);
+		}
+	}
+}
+
+/**
+ * @brief Read one packet from a shared socket and dispatch it to its target
+ * @param multi - engine
+ * @param sock - readable shared socket
+ * @return TRUE if a packet was read, FALSE once the socket is drained
+ */
+static tBool
+multiReceive(tMulti *multi, const tPingSocket *sock)
+{
+	unsigned char			*buf = multi->bufs.recv;
+	char					cmsgbuf[PING_CMSG_SPACE];
+	struct sockaddr_storage	from;
+	struct msghdr			msg;
+	struct iovec			iov;
+	const unsigned char		*icmp;
+	size_t					icmpLen;
+	tIpHdr					ip4;
+	size_t					ipLen = 0;
+	ssize_t					n;
+	const char				*reject;
+	int						ttl = 0;
+	tBool					isV6 = (sock->family == AF_INET6);
+	size_t					target;
+	uint16_t				seq;
+
+	iov.iov_base = buf;
+	iov.iov_len = multi->bufs.recvSize;
+	ft_bzero(&msg, sizeof(msg));
+	msg.msg_name = &from;
+	msg.msg_namelen = sizeof(from);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsgbuf;
+	msg.msg_controllen = sizeof(cmsgbuf);
+	n = recvmsg(sock->fd, &msg, MSG_DONTWAIT);
+	if (n <= 0)
+		return (FALSE);
+	for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+	{
+		if ((c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_TTL)
+			|| (c->cmsg_level == IPPROTO_IPV6 && c->cmsg_type == IPV6_HOPLIMIT))
+			if (c->cmsg_len >= CMSG_LEN(sizeof(int)))
+				ft_memcpy(&ttl, CMSG_DATA(c), sizeof(int));
+	}
+	icmp = buf;
+	icmpLen = (size_t)n;
+	if (!isV6 && sock->privilege == SOCKET_PRIV_RAW)
+	{
+		ipLen = parseIpHeaderFromBuffer(buf, (size_t)n, &ip4);
+		if (ipLen == 0)
+			return (TRUE);
+		ttl = ip4.ttl;
+		icmp += ipLen;
+		icmpLen -= ipLen;
+	}
+	if (icmpLen < ICMP4_HDR_LEN)
+		return (TRUE);
+
+	if (icmp[0] == (isV6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+	{
+		target = multiFind(multi, &from, (uint16_t)((icmp[4] << 8) | icmp[5]));
+		if (target == TABLE_NONE)
+			return (TRUE);
+		reject = multiHandleReply(multi, target, icmp, icmpLen, (uint8_t)ttl);
+		captureReceived(multi->capture, &from, (uint8_t)ttl, buf, (size_t)n, ipLen, reject);
+		return (TRUE);
+	}
+	if (sock->privilege != SOCKET_PRIV_RAW)
+		return (TRUE);
+	if ((!isV6 && icmp[0] != ICMP4_TIME_EXCEEDED && icmp[0] != ICMP4_DEST_UNREACH)
+		|| (isV6 && icmp[0] != ICMP6_TIME_EXCEEDED && icmp[0] != ICMP6_DEST_UNREACH
+			&& icmp[0] != ICMP6_PACKET_TOO_BIG))
+		return (TRUE);
+	target = multiQuotedTarget(multi, icmp + 8, icmpLen - 8, sock->family, &seq);
+	if (target == TABLE_NONE)
+		return (TRUE);
+	multi->table.stats[target].errors++;
+	multiOutput(multi, target, seq, OUTPUT_ERROR, ttl, -1, (int64_t)icmpLen, icmp);
+	captureReceived(multi->capture, &from, (uint8_t)ttl, buf, (size_t)n, ipLen, NULL);
+	if (!multi->opts.quiet)
+		printInvalidIcmpError(&from, icmp, icmpLen, multi->opts.numeric);
+	return (TRUE);
+}
+
+/**
+ * @brief Whether a target still has probes to send
+ */
+static tBool
+multiPending(const tMulti *multi, size_t i)
+{
+	return (multi->opts.count == 0 || multi->table.seq[i] < multi->opts.count);
+}
+
+/**
+ * @brief Settle the oldest probe of target i: lost if still unanswered
+ */
+static void
+multiRetire(tMulti *multi, size_t i)
+{
+	tTargetTable	*t = &multi->table;
+	uint32_t		seq = t->oldest[i];
+
+	if (!targetTableRetire(t, i))
+		return;
+	t->stats[i].lost++;
+	multi->inflight--;
+	multiOutput(multi, i, (uint16_t)seq, OUTPUT_LOST, -1, -1, -1, NULL);
+	if (multi->opts.verbose > 1)
+		ft_printf("No reply from %s: icmp_seq=%u\n", t->ip[i], (uint16_t)seq);
+}
+
+/**
+ * @brief Arm the timeout of the oldest probe of target i still in flight
+ */
+static void
+multiArmWait(tMulti *multi, size_t i)
+{
+	tTargetTable	*t = &multi->table;
+
+	while (t->oldest[i] != t->seq[i] && !(t->unacked[i] & 1))
+		multiRetire(multi, i);
+	if (t->oldest[i] == t->seq[i])
+		wheelCancel(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_WAIT));
+	else
+		wheelArm(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_WAIT),
+			t->first[i]->sentNs + multi->waitNs);
+}
+
+/**
+ * @brief Send timer of target i: probe, then schedule the next one
+ * Under a rate ceiling every probe takes the next free slot; a probe whose
+ * slot is in the future is re-armed as a paced timer for it. A target
+ * falling behind (ceiling, loop overloaded) resumes from now instead of
+ * sending a burst to catch up.
+ * @param paced - the slot was reserved already
+ */
+static void
+multiOnSend(tMulti *multi, size_t i, uint64_t nowNs, tBool paced)
+{
+	tTargetTable	*t = &multi->table;
+	tBool			retired = FALSE;
+	uint64_t		sentNs;
+
+	if (!paced && multi->ratePeriodNs > 0)
+	{
+		uint64_t	slot = multi->rateNextNs > nowNs ? multi->rateNextNs : nowNs;
+
+		multi->rateNextNs = slot + multi->ratePeriodNs;
+		if (slot > nowNs)
+		{
+			wheelArm(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_PACED), slot);
+			return;
+		}
+	}
+
+	/* the window is full: the oldest probe is given up early */
+	while (!multi->rxPool && t->seq[i] - t->oldest[i] >= TABLE_WINDOW)
+	{
+		multiRetire(multi, i);
+		retired = TRUE;
+	}
+	/* timers of a batch share nowNs, the probe is stamped when it leaves */
+	sentNs = monotonicNs();
+	if (!multi->rxPool && targetTableProbe(t, i, sentNs) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory, %s no longer probed\n", t->ip[i]);
+		multi->pending--;
+		return;
+	}
+	multiSendProbe(multi, i, sentNs);
+	/* -l: the first probes follow each other without waiting */
+	if (t->seq[i] >= multi->opts.preload || t->seq[i] >= TABLE_WINDOW)
+		t->nextNs[i] += multi->ivNs;
+	if (t->nextNs[i] < nowNs)
+		t->nextNs[i] = nowNs;
+	if (multiPending(multi, i))
+		wheelArm(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_SEND), t->nextNs[i]);
+	else
+		multi->pending--;
+	if (!multi->rxPool && (retired || !wheelArmed(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_WAIT))))
+		multiArmWait(multi, i);
+}
+
+/**
+ * @brief Timeout timer of target i: settle every probe whose wait is over
+ */
+static void
+multiOnWait(tMulti *multi, size_t i, uint64_t nowNs)
+{
+	tTargetTable	*t = &multi->table;
+
+	while (t->oldest[i] != t->seq[i]
+		&& t->first[i]->sentNs + multi->waitNs <= nowNs)
+		multiRetire(multi, i);
+	multiArmWait(multi, i);
+}
+
+/**
+ * @brief Resolver callback: the host joins the probed targets right away
+ */
+static void
+multiOnResolved(void *arg, const char *host, const struct addrinfo *list, int err)
+{
+	tMulti	*multi = arg;
+
+	if (err == 0 && multi->dnsCache)
+		dnsCachePutHost(multi->dnsCache, host,
+			multi->opts.v4 ? IP_TYPE_V4 : multi->opts.v6 ? IP_TYPE_V6 : IP_TYPE_UNSPEC, list);
+	if (err == 0 && multiAddHost(multi, host, list) > 0)
+		return;
+	multi->unresolved++;
+	ft_dprintf(STDERR_FILENO, PROG_NAME ": unknown host %s (%s)\n", host,
+		err == RESOLVE_ERR_TIMEOUT ? "lookup timed out"
+		: err != 0 ? gai_strerror(err) : "no usable address");
+}
+
+/**
+ * @brief Run the timers due at nowNs
+ * @return TRUE if the batch was full and more timers may be due
+ */
+static tBool
+multiRunTimers(tMulti *multi, uint64_t nowNs)
+{
+	uint32_t	batch[MULTI_BATCH];
+	size_t		n;
+
+	n = wheelExpire(&multi->wheel, nowNs, batch, MULTI_BATCH);
+	for (size_t k = 0; k < n; k++)
+	{
+		size_t	i = batch[k] / MULTI_TIMERS;
+
+		if (batch[k] % MULTI_TIMERS == MULTI_TIMER_WAIT)
+			multiOnWait(multi, i, nowNs);
+		else
+			multiOnSend(multi, i, nowNs, batch[k] % MULTI_TIMERS == MULTI_TIMER_PACED);
+	}
+	return (n == MULTI_BATCH);
+}
+
+/**
+ * @brief Whether every probe sent is answered or timed out
+ * Receive workers only count their replies: the probes are settled once
+ * each has one or the last probe sent has waited its full timeout.
+ */
+static tBool
+multiSettled(const tMulti *multi, uint64_t nowNs)
+{
+	if (!multi->rxPool)
+		return (multi->inflight == 0);
+	return (rxPoolReplies(multi->rxPool) >= multi->sentTotal
+		|| nowNs >= multi->lastSendNs + multi->waitNs);
+}
+
+void
+runMultiLoop(tMulti *multi)
+{
+	fd_set			fdset;
+	struct timeval	wait;
+	double			iv;
+	double			tail;
+	unsigned int	rate;
+	uint64_t		startNs;
+	uint64_t		nowNs;
+	uint64_t		waitNs;
+	uint64_t		nextNs;
+	tBool			resolving;
+	tBool			busy;
+	int				maxFd;
+	int				fd;
+
+	if (!multi || (multi->table.count == 0 && !multi->resolver))
+		return;
+	rate = sockRateLimit(&multi->opts, sockDetectPrivilege());
+	ft_printf(PROG_NAME " %s: %u data bytes", multi->label, multi->bufs.payloadLen);
+	if (multi->opts.verbose > 0)
+		ft_printf(", id 0x%04x = %u", multi->pid, multi->pid);
+	if (multi->opts.verbose > 0 && rate > 0)
+		ft_printf(", at most %u packets/s", rate);
+	ft_printf("\n");
+	for (size_t i = 0; i < multi->table.count; i++)
+	{
+		multiPrintTarget(multi, multi->table.host[i], i);
+		for (uint32_t j = 0; j < multi->table.aliasCount[i]; j++)
+			multiPrintTarget(multi, multi->table.aliases[i][j], i);
+	}
+	multi->running = TRUE;
+	signal(SIGINT, handleSigInt);
+
+	/* every target is probed once per interval, probes are spread evenly */
+	iv = multi->opts.interval;
+	if (multi->opts.flood && iv <= 0.0)
+		iv = 0.01;
+	else if (iv <= 0.0)
+		iv = PING_DEFAULT_INTERVAL;
+	tail = multi->opts.linger > iv ? multi->opts.linger : iv;
+	multi->ivNs = (uint64_t)(iv * 1e9);
+	multi->waitNs = (uint64_t)(tail * 1e9);
+	multi->ratePeriodNs = rate > 0 ? 1000000000ULL / rate : 0;
+	startNs = monotonicNs();
+	multi->rateNextNs = startNs;
+	for (size_t i = 0; i < multi->table.count; i++)
+	{
+		multi->table.nextNs[i] = startNs + multi->ivNs / multi->table.count * i;
+		wheelArm(&multi->wheel, MULTI_TIMER(i, MULTI_TIMER_SEND), multi->table.nextNs[i]);
+	}
+
+	while (!g_pingInterrupted)
+	{
+		if (multi->resolver)
+			resolverPoll(multi->resolver, multiOnResolved, multi);
+		resolving = (multi->resolver && !resolverFinished(multi->resolver));
+		nowNs = monotonicNs();
+		if (multi->opts.timeout > 0 && nowNs - startNs >= (uint64_t)multi->opts.timeout * 1000000000ULL)
+			break;
+		busy = multiRunTimers(multi, nowNs);
+		/* every probe answered or timed out */
+		if (multi->pending == 0 && !resolving && multiSettled(multi, nowNs))
+			break;
+
+		/* sleep until the next non-empty slot, the -w deadline or a lookup deadline */
+		waitNs = 1000000000ULL;
+		nextNs = wheelNextNs(&multi->wheel);
+		if (busy)
+			waitNs = 0;
+		else if (nextNs != UINT64_MAX)
+			waitNs = nextNs > nowNs ? nextNs - nowNs : 0;
+		if (multi->opts.timeout > 0
+			&& startNs + (uint64_t)multi->opts.timeout * 1000000000ULL - nowNs < waitNs)
+			waitNs = startNs + (uint64_t)multi->opts.timeout * 1000000000ULL - nowNs;
+		if (resolving && resolverNextDeadline(multi->resolver) < waitNs)
+			waitNs = resolverNextDeadline(multi->resolver);
+		if (multi->rxPool && waitNs > MULTI_RX_CHECK_MS * 1000000ULL)
+			waitNs = MULTI_RX_CHECK_MS * 1000000ULL;
+		wait.tv_sec = (time_t)(waitNs / 1000000000ULL);
+		wait.tv_usec = (suseconds_t)((waitNs % 1000000000ULL + 999) / 1000);
+		FD_ZERO(&fdset);
+		maxFd = -1;
+		for (int i = 0; i < 2; i++)
+		{
+			if (multi->socks[i].fd < 0 || multi->rxPool)
+				continue;
+			FD_SET(multi->socks[i].fd, &fdset);
+			if (multi->socks[i].fd > maxFd)
+				maxFd = multi->socks[i].fd;
+		}
+		fd = resolving ? resolverFd(multi->resolver) : -1;
+		if (fd >= 0)
+		{
+			FD_SET(fd, &fdset);
+			if (fd > maxFd)
+				maxFd = fd;
+		}
+		if (select(maxFd + 1, &fdset, NULL, NULL, &wait) < 0)
+		{
+			if (errno == EINTR)
+				break;
+			ft_dprintf(STDERR_FILENO, "select failed: %s\n", strerror(errno));
+			break;
+		}
+		for (int i = 0; i < 2; i++)
+		{
+			if (multi->socks[i].fd < 0 || !FD_ISSET(multi->socks[i].fd, &fdset))
+				continue;
+			if (multi->socks[i].privilege == SOCKET_PRIV_USER)
+				multiReceiveErrors(multi, &multi->socks[i]);
+			for (int k = 0; k < 4 * MULTI_BATCH && multiReceive(multi, &multi->socks[i]); k++)
+				;
+		}
+		fflush(stdout);
+	}
+	if (multi->rxPool)
+	{
+		rxPoolStop(multi->rxPool);
+		rxPoolMerge(multi->rxPool, &multi->table, multi->opts.verbose);
+	}
+}
+
+/**
+ * @brief Print the loss / RTT totals of every target of one family
+ * @param multi - engine
+ * @param family - AF_INET or AF_INET6
+ */
+static void
+printMultiFamily(const tMulti *multi, int family)
+{
+	tPingStats	total;
+	size_t		addrs = 0;
+
+	pingStatsReset(&total);
+	for (size_t i = 0; i < multi->table.count; i++)
+	{
+		const tPingStats	*s = &multi->table.stats[i];
+
+		if (multi->table.keys[i].family != family)
+			continue;
+		addrs++;
+		total.sent += s->sent;
+		total.received += s->received;
+		total.duplicates += s->duplicates;
+		total.rttSum += s->rttSum;
+		total.rttCount += s->rttCount;
+	}
+	if (addrs == 0)
+		return;
+	printf("%s: %zu address%s, %.0f%% packet loss",
+		family == AF_INET6 ? "IPv6" : "IPv4", addrs, addrs > 1 ? "es" : "",
+		pingStatsLoss(&total));
+	if (total.rttCount > 0)
+		printf(", avg %.3f ms", pingStatsAvg(&total));
+	printf("\n");
+}
+
+/**
+ * @brief Whether target a is a better choice than b
+ * Lower loss wins; equal loss falls back to the lower average RTT.
+ */
+static tBool
+multiBetter(const tPingStats *a, const tPingStats *b)
+{
+	double	lossA = pingStatsLoss(a);
+	double	lossB = pingStatsLoss(b);
+
+	if (lossA != lossB)
+		return (lossA < lossB);
+	return (pingStatsAvg(a) < pingStatsAvg(b));
+}
+
+/**
+ * @brief Print the statistics of a target under one of its names
+ */
+static void
+printMultiTarget(const tMulti *multi, const char *name, size_t i)
+{
+	const tPingStats	*s = &multi->table.stats[i];
+
+	if (multiShowName(multi, name, i))
+		printf("%s (%s)", name, multi->table.ip[i]);
+	else
+		printf("%s", multi->table.ip[i]);
+	printf(": %u packets transmitted, %u received, %.0f%% packet loss",
+		s->sent, s->received, pingStatsLoss(s));
+	if (s->errors > 0)
+		printf(" +%u errors", s->errors);
+	if (s->duplicates > 0)
+		printf(" ++%u duplicates", s->duplicates);
+	printf("\n");
+	if (s->rttCount > 0)
+		printf("    round-trip min/avg/max/stdev = %.3f/%.3f/%.3f/%.3f ms, jitter %.3f ms, p90 <= %.3f ms\n",
+			s->rttMin, pingStatsAvg(s), s->rttMax, pingStatsStddev(s),
+			multi->table.jitter[i].jitter, rttHistPercentile(&multi->table.hist[i], 90.0));
+}
+
+/**
+ * @brief Print what the targets cost in memory (-v)
+ */
+static void
+printMultiMemory(const tMulti *multi)
+{
+	const tTargetTable	*t = &multi->table;
+	size_t				names = t->names.reserved;
+	size_t				records = poolReserved(&t->records);
+	size_t				timers = wheelMemory(&multi->wheel);
+	size_t				state = targetTableMemory(t) - names - records;
+	size_t				total = state + names + records + timers;
+
+	printf("memory: %zu bytes per address, %zu KiB (state %zu KiB, names %zu KiB, "
+		"timers %zu KiB, probe records %zu KiB for %zu in flight at peak)\n",
+		total / t->count, total >> 10, state >> 10, names >> 10, timers >> 10,
+		records >> 10, t->records.peak);
+}
+
+void
+printMultiSummary(const tMulti *multi)
+{
+	const tTargetTable	*t;
+	size_t				best = TABLE_NONE;
+
+	if (!multi)
+		return;
+	t = &multi->table;
+	printf("\n--- %s " PROG_NAME " statistics, %zu address%s ---\n",
+		multi->label, t->count, t->count > 1 ? "es" : "");
+	for (size_t i = 0; i < t->count; i++)
+	{
+		printMultiTarget(multi, t->host[i], i);
+		for (uint32_t j = 0; j < t->aliasCount[i]; j++)
+			printMultiTarget(multi, t->aliases[i][j], i);
+		if (t->stats[i].rttCount > 0
+			&& (best == TABLE_NONE || multiBetter(&t->stats[i], &t->stats[best])))
+			best = i;
+	}
+	printMultiFamily(multi, AF_INET);
+	printMultiFamily(multi, AF_INET6);
+	if (multi->unresolved > 0)
+		printf("%zu host%s could not be resolved\n",
+			multi->unresolved, multi->unresolved > 1 ? "s" : "");
+	if (best != TABLE_NONE)
+		printf("best address: %s (%s), %.0f%% packet loss, avg %.3f ms\n",
+			t->ip[best], t->keys[best].family == AF_INET6 ? "IPv6" : "IPv4",
+			pingStatsLoss(&t->stats[best]), pingStatsAvg(&t->stats[best]));
+	else
+		printf("best address: none answered\n");
+	if (multi->opts.verbose > 0 && t->count > 0)
+		printMultiMemory(multi);
+	fflush(stdout);
+	for (size_t i = 0; i < t->count; i++)
+		outputSummary(multi->output, t->host[i], t->ip[i], &t->stats[i], &t->hist[i], &t->jitter[i]);
+}
+
+/**
+ * @brief Start the receive workers (--rx-workers) before any socket is opened
+ * @param multi - initialized engine without targets
+ * @param pool - pool to start, must outlive the engine
+ * @return 0 on success, -1 with a message on error
+ */
+static int
+multiStartWorkers(tMulti *multi, tRxPool *pool)
+{
+	unsigned int	families = 0;
+
+	if (sockDetectPrivilege() != SOCKET_PRIV_RAW)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": --rx-workers needs raw socket privileges\n");
+		return (-1);
+	}
+	if (!multi->opts.v6)
+		families |= 1U << multiSockIndex(AF_INET);
+	if (!multi->opts.v4)
+		families |= 1U << multiSockIndex(AF_INET6);
+	if (rxPoolStart(pool, (unsigned int)multi->opts.rxWorkers, families,
+			(uint16_t)multi->pid, multi->probeKey, multi->bufs.stampLen) != 0)
+		return (-1);
+	multi->rxPool = pool;
+	return (0);
+}
+
+int
+runMultiHost(
+	const tPingOptions		*opts,
+	const char				*host,
+	const struct addrinfo	*list,
+	tCapture				*capture,
+	tOutput					*output,
+	tPlog					*plog)
+{
+	tMulti	*multi;
+	tRxPool	pool;
+
+	multi = calloc(1, sizeof(*multi));
+	if (!multi)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return (-1);
+	}
+	if (multiInit(multi, opts, host) != 0)
+	{
+		free(multi);
+		return (-1);
+	}
+	if (opts->rxWorkers > 0 && multiStartWorkers(multi, &pool) != 0)
+	{
+		multiFree(multi);
+		free(multi);
+		return (-1);
+	}
+	multi->capture = capture;
+	multi->output = output;
+	multi->plog = plog;
+	if (multiAddHost(multi, host, list) == 0)
+	{
+		multiFree(multi);
+		free(multi);
+		return (-1);
+	}
+	runMultiLoop(multi);
+	printMultiSummary(multi);
+	multiFree(multi);
+	free(multi);
+	return (0);
+}
+
+int
+runParallelHosts(
+	const tPingOptions	*opts,
+	char				**hosts,
+	size_t				count,
+	tDnsCache			*cache,
+	tCapture			*capture,
+	tOutput				*output,
+	tPlog				*plog)
+{
+	tMulti			*multi;
+	tResolver		resolver;
+	tRxPool			pool;
+	tIpType			ipMode = IP_TYPE_UNSPEC;
+	char			label[64];
+	char			**misses;
+	size_t			missCount = 0;
+	struct addrinfo	*list;
+	int				ret;
+
+	if (opts->v4)
+		ipMode = IP_TYPE_V4;
+	else if (opts->v6)
+		ipMode = IP_TYPE_V6;
+	multi = calloc(1, sizeof(*multi));
+	if (!multi)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return (-1);
+	}
+	snprintf(label, sizeof(label), "%zu host%s", count, count > 1 ? "s" : "");
+	if (multiInit(multi, opts, label) != 0)
+	{
+		free(multi);
+		return (-1);
+	}
+	if (opts->rxWorkers > 0 && multiStartWorkers(multi, &pool) != 0)
+	{
+		multiFree(multi);
+		free(multi);
+		return (-1);
+	}
+	/* cached hosts are probed from the start, only the others are resolved */
+	misses = malloc((count ? count : 1) * sizeof(*misses));
+	if (!misses)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		multiFree(multi);
+		free(multi);
+		return (-1);
+	}
+	multi->dnsCache = cache;
+	multi->capture = capture;
+	multi->output = output;
+	multi->plog = plog;
+	for (size_t i = 0; i < count; i++)
+	{
+		list = NULL;
+		if (dnsCacheGetHost(cache, hosts[i], ipMode, &list) != DNS_CACHE_MISS
+			&& multiAddHost(multi, hosts[i], list) > 0)
+		{
+			freeaddrinfo(list);
+			continue;
+		}
+		if (list)
+			freeaddrinfo(list);
+		misses[missCount++] = hosts[i];
+	}
+	if (resolverInit(&resolver, misses, missCount, ipMode, opts->dnsLimit, opts->dnsTimeout) != 0)
+	{
+		free(misses);
+		multiFree(multi);
+		free(multi);
+		return (-1);
+	}
+	multi->resolver = &resolver;
+	runMultiLoop(multi);
+	printMultiSummary(multi);
+	ret = multi->table.count > 0 ? 0 : -1;
+	multiFree(multi);
+	free(multi);
+	resolverFree(&resolver);
+	free(misses);
+	return (ret);
+}
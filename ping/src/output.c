@@ -0,0 +1,303 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/output.h"
+#include "../includes/ping.h"
+#include "../includes/pingUtils.h"
+
+/* CSV columns: probe records leave the summary ones empty and conversely */
+#define OUTPUT_CSV_HEADER	"type,ts_ns,target,addr,seq,status,ttl,rtt_ns,size,err_type,err_code," \
+	"sent,received,duplicates,errors,loss_pct,rtt_min_ns,rtt_avg_ns,rtt_max_ns," \
+	"rtt_stddev_ns,rtt_p90_ns,jitter_ns\n"
+#define OUTPUT_PROBE_COLS	7	/**< seq to err_code */
+#define OUTPUT_SUMMARY_COLS	11	/**< sent to jitter_ns */
+
+static const char	*g_outputStatus[] = {"reply", "duplicate", "lost", "error"};
+
+/**
+ * @brief Append raw bytes (the caller kept OUTPUT_LINE_MAX free)
+ */
+static void
+outputPut(tOutput *out, const char *s, size_t len)
+{
+	ft_memcpy(out->buf + out->len, s, len);
+	out->len += len;
+}
+
+/**
+ * @brief Append an unsigned number in decimal
+ */
+static void
+outputPutU64(tOutput *out, uint64_t v)
+{
+	char	digits[20];
+	size_t	n = 0;
+
+	do
+	{
+		digits[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v > 0);
+	while (n > 0)
+		out->buf[out->len++] = digits[--n];
+}
+
+/**
+ * @brief Append a string, escaped for the format and cut at OUTPUT_NAME_MAX
+ */
+static void
+outputPutStr(tOutput *out, const char *s)
+{
+	static const char	hex[] = "0123456789abcdef";
+	size_t				n = 0;
+	tBool				quote = FALSE;
+
+	if (out->format == OUTPUT_CSV)
+	{
+		for (size_t i = 0; s[i] && i < OUTPUT_NAME_MAX; i++)
+			if (s[i] == ',' || s[i] == '"' || s[i] == '\n' || s[i] == '\r')
+				quote = TRUE;
+		if (!quote)
+		{
+			while (s[n] && n < OUTPUT_NAME_MAX)
+				n++;
+			outputPut(out, s, n);
+			return;
+		}
+	}
+	out->buf[out->len++] = '"';
+	for (; s[n] && n < OUTPUT_NAME_MAX; n++)
+	{
+		unsigned char	c = (unsigned char)s[n];
+
+		if (out->format == OUTPUT_CSV)
+		{
+			if (c == '"')
+				out->buf[out->len++] = '"';
+			out->buf[out->len++] = (char)c;
+		}
+		else if (c == '"' || c == '\\')
+		{
+			out->buf[out->len++] = '\\';
+			out->buf[out->len++] = (char)c;
+		}
+		else if (c < 0x20)
+		{
+			outputPut(out, "\\u00", 4);
+			out->buf[out->len++] = hex[c >> 4];
+			out->buf[out->len++] = hex[c & 0x0F];
+		}
+		else
+			out->buf[out->len++] = (char)c;
+	}
+	out->buf[out->len++] = '"';
+}
+
+/**
+ * @brief Start a field: separator and, in JSON, its key
+ */
+static void
+outputKey(tOutput *out, const char *key)
+{
+	if (out->format == OUTPUT_CSV)
+	{
+		if (out->fields++ > 0)
+			out->buf[out->len++] = ',';
+		return;
+	}
+	out->buf[out->len++] = out->fields++ > 0 ? ',' : '{';
+	out->buf[out->len++] = '"';
+	outputPut(out, key, ft_strlen(key));
+	outputPut(out, "\":", 2);
+}
+
+/**
+ * @brief Write a number field, null (JSON) or empty (CSV) when negative
+ */
+static void
+outputNumber(tOutput *out, const char *key, int64_t v)
+{
+	outputKey(out, key);
+	if (v >= 0)
+		outputPutU64(out, (uint64_t)v);
+	else if (out->format == OUTPUT_JSONL)
+		outputPut(out, "null", 4);
+}
+
+/**
+ * @brief Write a string field
+ */
+static void
+outputString(tOutput *out, const char *key, const char *s)
+{
+	outputKey(out, key);
+	outputPutStr(out, s ? s : "");
+}
+
+/**
+ * @brief Leave CSV columns of the other record type empty
+ */
+static void
+outputSkip(tOutput *out, unsigned int cols)
+{
+	if (out->format != OUTPUT_CSV)
+		return;
+	while (cols-- > 0)
+		out->buf[out->len++] = ',';
+}
+
+/**
+ * @brief Start a record: type, wall clock time, target and address
+ */
+static void
+outputBegin(tOutput *out, const char *type, const char *target, const char *addr)
+{
+	struct timespec	now;
+
+	if (out->len > OUTPUT_BUF_SIZE - OUTPUT_LINE_MAX)
+		outputFlush(out);
+	clock_gettime(CLOCK_REALTIME, &now);
+	out->fields = 0;
+	outputString(out, "type", type);
+	outputNumber(out, "ts_ns", (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec);
+	outputString(out, "target", target);
+	outputString(out, "addr", addr);
+}
+
+/**
+ * @brief End a record, written out if the buffer is full or has waited long enough
+ */
+static void
+outputEnd(tOutput *out)
+{
+	if (out->format == OUTPUT_JSONL)
+		out->buf[out->len++] = '}';
+	out->buf[out->len++] = '\n';
+	out->records++;
+	if (out->len > OUTPUT_BUF_SIZE - OUTPUT_LINE_MAX
+		|| monotonicNs() - out->flushNs >= OUTPUT_FLUSH_MS * 1000000ULL)
+		outputFlush(out);
+}
+
+/**
+ * @brief Milliseconds to whole nanoseconds
+ */
+static int64_t
+outputMsToNs(double ms)
+{
+	return (ms > 0.0 ? (int64_t)(ms * 1e6 + 0.5) : 0);
+}
+
+int
+outputOpen(tOutput *out, tOutputFormat format, int fd)
+{
+	ft_bzero(out, sizeof(*out));
+	out->fd = fd;
+	out->format = format;
+	if (fd < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": output: %s\n", strerror(errno));
+		return (-1);
+	}
+	if (format == OUTPUT_CSV)
+		outputPut(out, OUTPUT_CSV_HEADER, sizeof(OUTPUT_CSV_HEADER) - 1);
+	out->flushNs = monotonicNs();
+	return (0);
+}
+
+void
+outputProbe(tOutput *out, const tOutputProbe *probe)
+{
+	if (!out || out->failed)
+		return;
+	outputBegin(out, "probe", probe->target, probe->addr);
+	outputNumber(out, "seq", probe->seq);
+	outputString(out, "status", g_outputStatus[probe->status]);
+	outputNumber(out, "ttl", probe->ttl);
+	outputNumber(out, "rtt_ns", probe->rttNs);
+	outputNumber(out, "size", probe->size);
+	outputNumber(out, "err_type", probe->errType);
+	outputNumber(out, "err_code", probe->errCode);
+	outputSkip(out, OUTPUT_SUMMARY_COLS);
+	outputEnd(out);
+}
+
+void
+outputSummary(
+	tOutput					*out,
+	const char				*target,
+	const char				*addr,
+	const tPingStats		*stats,
+	const tRttHistogram		*hist,
+	const tRttJitter		*jitter)
+{
+	int64_t	loss;
+	tBool	rtt;
+
+	if (!out || out->failed)
+		return;
+	/* thousandths of a percent, printed with three decimals */
+	loss = (int64_t)(pingStatsLoss(stats) * 1000.0 + 0.5);
+	rtt = stats->rttCount > 0;
+	outputBegin(out, "summary", target, addr);
+	outputSkip(out, OUTPUT_PROBE_COLS);
+	outputNumber(out, "sent", stats->sent);
+	outputNumber(out, "received", stats->received);
+	outputNumber(out, "duplicates", stats->duplicates);
+	outputNumber(out, "errors", stats->errors);
+	outputNumber(out, "loss_pct", loss / 1000);
+	out->buf[out->len++] = '.';
+	out->buf[out->len++] = (char)('0' + loss / 100 % 10);
+	out->buf[out->len++] = (char)('0' + loss / 10 % 10);
+	out->buf[out->len++] = (char)('0' + loss % 10);
+	outputNumber(out, "rtt_min_ns", rtt ? outputMsToNs(stats->rttMin) : -1);
+	outputNumber(out, "rtt_avg_ns", rtt ? outputMsToNs(pingStatsAvg(stats)) : -1);
+	outputNumber(out, "rtt_max_ns", rtt ? outputMsToNs(stats->rttMax) : -1);
+	outputNumber(out, "rtt_stddev_ns", rtt ? outputMsToNs(pingStatsStddev(stats)) : -1);
+	outputNumber(out, "rtt_p90_ns", rtt && hist
+		? outputMsToNs(rttHistPercentile(hist, 90.0)) : -1);
+	outputNumber(out, "jitter_ns", rtt && jitter ? outputMsToNs(jitter->jitter) : -1);
+	outputEnd(out);
+	/* a summary ends a run: nothing waits for the next one */
+	outputFlush(out);
+}
+
+void
+outputFlush(tOutput *out)
+{
+	size_t	off = 0;
+	ssize_t	n;
+
+	if (!out)
+		return;
+	while (off < out->len && !out->failed)
+	{
+		n = write(out->fd, out->buf + off, out->len - off);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": output: %s\n",
+				n < 0 ? strerror(errno) : "short write");
+			out->failed = TRUE;
+			break;
+		}
+		off += (size_t)n;
+	}
+	out->len = 0;
+	out->flushNs = monotonicNs();
+}
+
+void
+outputClose(tOutput *out)
+{
+	if (!out || out->fd < 0)
+		return;
+	outputFlush(out);
+	close(out->fd);
+	out->fd = -1;
+}
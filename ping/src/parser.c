@@ -3,6 +3,11 @@
 #include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
 
 #include "../../hajlib/include/hgetopt.h"
+#if defined(HAJ)
+#include "../includes/monitor.h"
+#include "../includes/output.h"
+#include "../includes/rxpool.h"
+#endif
 #include "../includes/parser.h"
 #include "../includes/usage.h"
 #include "../includes/utils.h"
@@ -42,6 +47,27 @@ typedef enum eLongOption {
 	OPT_HELP			= '?',
 #endif
 	OPT_USAGE			= 261,
+#if defined(HAJ)
+	OPT_MONITOR			= 262,
+	OPT_MAX_HOPS		= 263,
+	OPT_PMTU			= 264,
+	OPT_HUGEPAGES		= 265,
+	OPT_ALL_ADDRESSES	= 266,
+	OPT_PARALLEL		= 267,
+	OPT_DNS_LIMIT		= 268,
+	OPT_DNS_TIMEOUT		= 269,
+	OPT_DNS_CACHE		= 270,
+	OPT_DNS_CACHE_TTL	= 271,
+	OPT_TARGET_LIST		= 272,
+	OPT_RATE			= 273,
+	OPT_REPLAY			= 274,
+	OPT_CAPTURE			= 275,
+	OPT_CAPTURE_SIZE	= 276,
+	OPT_PACKET_RING		= 277,
+	OPT_RX_WORKERS		= 278,
+	OPT_OUTPUT			= 279,
+	OPT_PROBE_LOG		= 280,
+#endif
 	OPT_VERSION			= 'V'
 } tLongOption;
 
@@ -66,6 +92,25 @@ static const tFtLongOption g_longOptions[] = {
 #if defined(HAJ)
 	{"ipv4",			FT_GETOPT_NO_ARGUMENT,		 OPT_V4},
 	{"ipv6",			FT_GETOPT_NO_ARGUMENT,		 OPT_V6},
+	{"monitor",			FT_GETOPT_NO_ARGUMENT,		 OPT_MONITOR},
+	{"max-hops",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_MAX_HOPS},
+	{"pmtu",			FT_GETOPT_NO_ARGUMENT,		 OPT_PMTU},
+	{"hugepages",		FT_GETOPT_NO_ARGUMENT,		 OPT_HUGEPAGES},
+	{"all-addresses",	FT_GETOPT_NO_ARGUMENT,		 OPT_ALL_ADDRESSES},
+	{"parallel",		FT_GETOPT_NO_ARGUMENT,		 OPT_PARALLEL},
+	{"dns-limit",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_DNS_LIMIT},
+	{"dns-timeout",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_DNS_TIMEOUT},
+	{"dns-cache",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_DNS_CACHE},
+	{"dns-cache-ttl",	FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_DNS_CACHE_TTL},
+	{"target-list",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_TARGET_LIST},
+	{"rate",			FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_RATE},
+	{"replay",			FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_REPLAY},
+	{"capture",			FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_CAPTURE},
+	{"capture-size",	FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_CAPTURE_SIZE},
+	{"packet-ring",		FT_GETOPT_NO_ARGUMENT,		 OPT_PACKET_RING},
+	{"rx-workers",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_RX_WORKERS},
+	{"output",			FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_OUTPUT},
+	{"probe-log",		FT_GETOPT_REQUIRED_ARGUMENT,	 OPT_PROBE_LOG},
 #endif
 
 	{"flood",			FT_GETOPT_NO_ARGUMENT,		 OPT_FLOOD},
@@ -136,6 +181,24 @@ parseIpTsValue(const char *optArg, const char *progName, tIpTsType *outType)
 	}
 }
 
+#if defined(HAJ)
+static void
+parseOutputValue(const char *optArg, const char *progName, int *outFormat)
+{
+	if (ft_strcmp(optArg, "text") == 0)
+		*outFormat = OUTPUT_TEXT;
+	else if (ft_strcmp(optArg, "jsonl") == 0 || ft_strcmp(optArg, "json") == 0)
+		*outFormat = OUTPUT_JSONL;
+	else if (ft_strcmp(optArg, "csv") == 0)
+		*outFormat = OUTPUT_CSV;
+	else
+	{
+		ft_dprintf(STDERR_FILENO, "%s: unsupported output format: %s\n", progName, optArg);
+		exit(EXIT_FAILURE);
+	}
+}
+#endif
+
 static void
 handlePreloadOption(const char *optArg, const char *progName, unsigned int *outPreload)
 {
@@ -231,6 +294,36 @@ int parseArgs(int argc, char **argv, tParseResult *result)
 #if defined(HAJ)
 			case OPT_V4: result->options.v4 = TRUE; break;
 			case OPT_V6: result->options.v6 = TRUE; break;
+			case OPT_MONITOR: result->options.monitor = TRUE; break;
+			case OPT_MAX_HOPS: result->options.maxHops =
+				convertNumberOption(state.optArg, MONITOR_MAX_HOPS, 0, argv[0]); break;
+			case OPT_PMTU: result->options.pmtu = TRUE; break;
+			case OPT_HUGEPAGES: result->options.hugepages = TRUE; break;
+			case OPT_ALL_ADDRESSES: result->options.allAddresses = TRUE; break;
+			case OPT_PARALLEL: result->options.parallel = TRUE; break;
+			case OPT_DNS_LIMIT: result->options.dnsLimit =
+				convertNumberOption(state.optArg, INT_MAX, 0, argv[0]); break;
+			case OPT_DNS_TIMEOUT: result->options.dnsTimeout =
+				convertNumberOption(state.optArg, INT_MAX, 0, argv[0]); break;
+			case OPT_DNS_CACHE: result->options.dnsCache = state.optArg; break;
+			case OPT_DNS_CACHE_TTL: result->options.dnsCacheTtl =
+				convertNumberOption(state.optArg, INT_MAX, 0, argv[0]); break;
+			case OPT_TARGET_LIST:
+				result->options.targetList = state.optArg;
+				result->options.parallel = TRUE;
+				break;
+			case OPT_RATE: result->options.rate =
+				convertNumberOption(state.optArg, INT_MAX, 0, argv[0]); break;
+			case OPT_REPLAY: result->options.replay = state.optArg; break;
+			case OPT_CAPTURE: result->options.capture = state.optArg; break;
+			case OPT_CAPTURE_SIZE: result->options.captureSize =
+				convertNumberOption(state.optArg, INT_MAX, 0, argv[0]); break;
+			case OPT_PACKET_RING: result->options.packetRing = TRUE; break;
+			case OPT_RX_WORKERS: result->options.rxWorkers =
+				convertNumberOption(state.optArg, RXPOOL_MAX_WORKERS, 0, argv[0]); break;
+			case OPT_OUTPUT:
+				parseOutputValue(state.optArg, argv[0], &result->options.outputFormat); break;
+			case OPT_PROBE_LOG: result->options.probeLog = state.optArg; break;
 #endif
 
 			case OPT_FLOOD: result->options.flood = TRUE; break;
@@ -249,7 +342,7 @@ int parseArgs(int argc, char **argv, tParseResult *result)
 			case OPT_QUIET: result->options.quiet = TRUE; break;
 			case OPT_RECORD_ROUTE: result->options.recordRoute = TRUE; break;
 			case OPT_PACKET_SIZE: result->options.packetSize =
-				convertNumberOption(state.optArg, 65399, 1, argv[0]); break;
+				convertNumberOption(state.optArg, PING_MAX_PAYLOAD, 1, argv[0]); break;
 
 			case OPT_HELP:
 				return (PARSE_HELP);
@@ -260,8 +353,8 @@ int parseArgs(int argc, char **argv, tParseResult *result)
 		}
 	}
 
-	while (state.index < argc)
-		result->positionals[result->posCount++] = argv[state.index++];
+	result->positionals = argv + state.index;
+	result->posCount = argc - state.index;
 
 	return (PARSE_OK);
 }
@@ -0,0 +1,349 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/pcap.h"
+#include "../includes/ping.h"
+
+/**
+ * @brief 32-bit field of the file in its byte order
+ */
+static uint32_t
+pcapU32(const tPcapReader *rd, const uint8_t *p)
+{
+	uint32_t	v;
+
+	ft_memcpy(&v, p, sizeof(v));
+	return (rd->swap ? __builtin_bswap32(v) : v);
+}
+
+static uint16_t
+pcapU16(const tPcapReader *rd, const uint8_t *p)
+{
+	uint16_t	v;
+
+	ft_memcpy(&v, p, sizeof(v));
+	return (rd->swap ? __builtin_bswap16(v) : v);
+}
+
+/**
+ * @brief Nanoseconds of a pcapng timestamp in if_tsresol units
+ */
+static uint64_t
+pcapngTsNs(const tPcapIface *iface, uint64_t ts)
+{
+	uint8_t		n = iface->tsResol & 0x7F;
+	uint64_t	scale = 1;
+
+	if (iface->tsResol & 0x80)
+	{
+		if (n >= 64)
+			return (iface->tsOffsetNs);
+		return ((ts >> n) * 1000000000ULL
+			+ (((ts & ((1ULL << n) - 1)) * 1000000000ULL) >> n) + iface->tsOffsetNs);
+	}
+	if (n <= 9)
+	{
+		while (n++ < 9)
+			scale *= 10;
+		return (ts * scale + iface->tsOffsetNs);
+	}
+	while (n-- > 9 && scale < 1000000000000000000ULL)
+		scale *= 10;
+	return (ts / scale + iface->tsOffsetNs);
+}
+
+/**
+ * @brief Read the header of a pcapng section at rd->off
+ * @return 0 on success, -1 if it is malformed
+ */
+static int
+pcapngSection(tPcapReader *rd)
+{
+	uint32_t	bom;
+
+	if (rd->size - rd->off < 28)
+		return (-1);
+	ft_memcpy(&bom, rd->map + rd->off + 8, sizeof(bom));
+	if (bom == PCAPNG_BOM)
+		rd->swap = FALSE;
+	else if (__builtin_bswap32(bom) == PCAPNG_BOM)
+		rd->swap = TRUE;
+	else
+		return (-1);
+	rd->ifaceCount = 0;
+	return (0);
+}
+
+/**
+ * @brief Record an interface description block
+ * @param body / len - block body, after type and length
+ */
+static void
+pcapngIface(tPcapReader *rd, const uint8_t *body, uint32_t len)
+{
+	tPcapIface	*iface;
+	uint32_t	off = 8;
+
+	if (rd->ifaceCount == PCAP_MAX_IFACES || len < 8)
+		return;
+	iface = &rd->ifaces[rd->ifaceCount++];
+	iface->linkType = pcapU16(rd, body);
+	iface->tsResol = 6;
+	iface->tsOffsetNs = 0;
+	while (off + 4 <= len)
+	{
+		uint16_t	code = pcapU16(rd, body + off);
+		uint16_t	optLen = pcapU16(rd, body + off + 2);
+
+		if (code == 0 || off + 4 + optLen > len)
+			break;
+		if (code == PCAPNG_OPT_TSRESOL && optLen >= 1)
+			iface->tsResol = body[off + 4];
+		else if (code == PCAPNG_OPT_TSOFFSET && optLen >= 8)
+		{
+			uint64_t	sec;
+
+			ft_memcpy(&sec, body + off + 4, sizeof(sec));
+			iface->tsOffsetNs = (rd->swap ? __builtin_bswap64(sec) : sec) * 1000000000ULL;
+		}
+		off += 4 + ((optLen + 3u) & ~3u);
+	}
+}
+
+int
+pcapOpen(tPcapReader *rd, const char *path)
+{
+	struct stat	st;
+	uint32_t	magic;
+	void		*map;
+	int			fd;
+
+	ft_bzero(rd, sizeof(*rd));
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return (-1);
+	}
+	if (!S_ISREG(st.st_mode) || st.st_size < PCAP_HDR_LEN)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: not a capture file\n", path);
+		close(fd);
+		return (-1);
+	}
+	map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", path, strerror(errno));
+		return (-1);
+	}
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL | MADV_WILLNEED);
+	rd->map = map;
+	rd->size = (size_t)st.st_size;
+	ft_memcpy(&magic, rd->map, sizeof(magic));
+	if (magic == PCAPNG_SHB)
+	{
+		rd->ng = TRUE;
+		if (pcapngSection(rd) == 0)
+			return (0);
+	}
+	else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS
+		|| __builtin_bswap32(magic) == PCAP_MAGIC_US || __builtin_bswap32(magic) == PCAP_MAGIC_NS)
+	{
+		rd->swap = (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS);
+		rd->nanos = (pcapU32(rd, rd->map) == PCAP_MAGIC_NS);
+		rd->snapLen = pcapU32(rd, rd->map + 16);
+		rd->linkType = (uint16_t)pcapU32(rd, rd->map + 20);
+		rd->off = PCAP_HDR_LEN;
+		return (0);
+	}
+	ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: not a pcap or pcapng file\n", path);
+	pcapClose(rd);
+	return (-1);
+}
+
+/**
+ * @brief Next record of a classic pcap file
+ */
+static int
+pcapNextClassic(tPcapReader *rd, tPcapPacket *pkt)
+{
+	const uint8_t	*rec = rd->map + rd->off;
+	uint32_t		sub;
+
+	if (rd->size - rd->off < PCAP_REC_LEN)
+		return (rd->off == rd->size ? 0 : -1);
+	pkt->capLen = pcapU32(rd, rec + 8);
+	pkt->origLen = pcapU32(rd, rec + 12);
+	if (pkt->capLen > rd->size - rd->off - PCAP_REC_LEN)
+		return (-1);
+	sub = pcapU32(rd, rec + 4);
+	pkt->tsNs = (uint64_t)pcapU32(rd, rec) * 1000000000ULL
+		+ (rd->nanos ? sub : (uint64_t)sub * 1000);
+	pkt->data = rec + PCAP_REC_LEN;
+	pkt->linkType = rd->linkType;
+	rd->off += PCAP_REC_LEN + pkt->capLen;
+	return (1);
+}
+
+/**
+ * @brief Next packet block of a pcapng file
+ */
+static int
+pcapNextNg(tPcapReader *rd, tPcapPacket *pkt)
+{
+	const uint8_t	*blk;
+	const uint8_t	*body;
+	uint32_t		type;
+	uint32_t		len;
+
+	while (rd->size - rd->off >= 12)
+	{
+		blk = rd->map + rd->off;
+		ft_memcpy(&type, blk, sizeof(type));
+		/* a new section may switch the byte order */
+		if (type == PCAPNG_SHB && pcapngSection(rd) != 0)
+			return (-1);
+		type = pcapU32(rd, blk);
+		len = pcapU32(rd, blk + 4);
+		if (len < 12 || (len & 3) || len > rd->size - rd->off)
+			return (-1);
+		rd->off += len;
+		body = blk + 8;
+		len -= 12;
+		if (type == PCAPNG_IDB)
+			pcapngIface(rd, body, len);
+		else if (type == PCAPNG_EPB && len >= 20)
+		{
+			uint32_t	ifc = pcapU32(rd, body);
+
+			pkt->capLen = pcapU32(rd, body + 12);
+			pkt->origLen = pcapU32(rd, body + 16);
+			if (ifc >= rd->ifaceCount || pkt->capLen > len - 20)
+				continue;
+			pkt->tsNs = pcapngTsNs(&rd->ifaces[ifc],
+				(uint64_t)pcapU32(rd, body + 4) << 32 | pcapU32(rd, body + 8));
+			pkt->data = body + 20;
+			pkt->linkType = rd->ifaces[ifc].linkType;
+			return (1);
+		}
+		else if (type == PCAPNG_SPB && len >= 4 && rd->ifaceCount > 0)
+		{
+			/* no timestamp: the packet keeps the time of the previous one */
+			pkt->origLen = pcapU32(rd, body);
+			pkt->capLen = pkt->origLen < len - 4 ? pkt->origLen : len - 4;
+			pkt->data = body + 4;
+			pkt->linkType = rd->ifaces[0].linkType;
+			return (1);
+		}
+	}
+	return (rd->off == rd->size ? 0 : -1);
+}
+
+int
+pcapNext(tPcapReader *rd, tPcapPacket *pkt)
+{
+	if (rd->ng)
+		return (pcapNextNg(rd, pkt));
+	return (pcapNextClassic(rd, pkt));
+}
+
+/**
+ * @brief Skip to the IP header behind an ethertype
+ * @param p / len - packet from the ethertype on, len updated
+ * @return IP header, NULL if it is not IPv4 or IPv6
+ */
+static const uint8_t *
+pcapEthertype(const uint8_t *p, uint32_t *len)
+{
+	uint16_t	type;
+
+	while (*len >= 2)
+	{
+		type = (uint16_t)(p[0] << 8 | p[1]);
+		/* 802.1Q / 802.1ad tags: 2 bytes of tag control, then the inner type */
+		if ((type == 0x8100 || type == 0x88A8) && *len >= 6)
+		{
+			p += 4;
+			*len -= 4;
+			continue;
+		}
+		if (type != 0x0800 && type != 0x86DD)
+			return (NULL);
+		*len -= 2;
+		return (p + 2);
+	}
+	return (NULL);
+}
+
+const uint8_t *
+pcapNetwork(const tPcapPacket *pkt, uint32_t *len)
+{
+	const uint8_t	*p = pkt->data;
+	const uint8_t	*ip = NULL;
+	uint32_t		n = pkt->capLen;
+
+	switch (pkt->linkType)
+	{
+		case LINKTYPE_ETHERNET:
+			if (n >= 14)
+			{
+				n -= 12;
+				ip = pcapEthertype(p + 12, &n);
+			}
+			break;
+		case LINKTYPE_LINUX_SLL:
+			if (n >= 16)
+			{
+				n -= 14;
+				ip = pcapEthertype(p + 14, &n);
+			}
+			break;
+		case LINKTYPE_LINUX_SLL2:
+			/* the protocol type comes first */
+			if (n >= 20 && ((p[0] << 8 | p[1]) == 0x0800 || (p[0] << 8 | p[1]) == 0x86DD))
+			{
+				n -= 20;
+				ip = p + 20;
+			}
+			break;
+		case LINKTYPE_NULL:
+		case LINKTYPE_LOOP:
+			/* the family is only checked through the IP version below */
+			if (n >= 4)
+			{
+				n -= 4;
+				ip = p + 4;
+			}
+			break;
+		case LINKTYPE_RAW:
+		case LINKTYPE_IPV4:
+		case LINKTYPE_IPV6:
+			ip = p;
+			break;
+		default:
+			return (NULL);
+	}
+	if (!ip || n < 20 || ((ip[0] >> 4) != 4 && (ip[0] >> 4) != 6))
+		return (NULL);
+	*len = n;
+	return (ip);
+}
+
+void
+pcapClose(tPcapReader *rd)
+{
+	if (rd->map)
+		munmap((void *)rd->map, rd->size);
+	rd->map = NULL;
+	rd->size = 0;
+}
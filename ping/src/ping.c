@@ -3,7 +3,9 @@
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
 
@@ -15,14 +17,54 @@
 /* global flag set on SIGINT */
 volatile sig_atomic_t g_pingInterrupted = 0;
 
-/* SIGINT handler */
-static void
+void
 handleSigInt(int sig)
 {
 	(void)sig;
 	g_pingInterrupted = 1;
 }
 
+#if defined(HAJ)
+/**
+ * @brief Write the record of every probe whose wait is over and left
+ * unanswered (--output, --probe-log), as multiRetire does for --parallel
+ * A probe still waiting when its slot is needed again is given up early.
+ * @param ctx - ping context
+ * @param all - end of the run: every probe sent is settled
+ */
+static void
+outputExpired(tPingContext *ctx, tBool all)
+{
+	tOutputProbe	rec;
+	uint64_t		nowNs;
+	unsigned int	slot;
+
+	if (!ctx->sentNs)
+		return;
+	nowNs = monotonicNs();
+	rec.target = ctx->targetHost;
+	rec.addr = ctx->resolvedIp;
+	rec.status = OUTPUT_LOST;
+	rec.ttl = -1;
+	rec.rttNs = -1;
+	rec.size = -1;
+	rec.errType = -1;
+	rec.errCode = -1;
+	for (; ctx->settled < ctx->seq; ctx->settled++)
+	{
+		slot = ctx->settled % MAX_SEQ;
+		if (!all && ctx->sentNs[slot] + ctx->waitNs > nowNs && ctx->seq - ctx->settled < MAX_SEQ)
+			break;
+		/* answered, or never sent */
+		if (ctx->seqReceived[slot] || ctx->sentNs[slot] == 0)
+			continue;
+		rec.seq = (uint16_t)ctx->settled;
+		outputProbe(ctx->output, &rec);
+		plogProbe(ctx->plog, &rec);
+	}
+}
+#endif
+
 /**
  * @brief Send one ICMP Echo Request packet
  * @param ctx - ping context
@@ -31,54 +73,32 @@ handleSigInt(int sig)
 static int
 sendIcmpPacket(tPingContext *ctx)
 {
-	unsigned char	packet[PING_MAX_PACKET_SIZE];
-	unsigned char	payload[PING_MAX_PACKET_SIZE];
-	struct timeval	tv;
-	uint32_t		userPayload;
-	uint32_t		payloadLen;
+	unsigned char	*packet;
 	uint32_t		packetLen;
 	ssize_t			sent;
+#if defined(HAJ)
+	uint8_t			stamp[PROBE_HDR_LEN];
+#else
+	struct timeval	stamp;
+#endif
 
-	if (!ctx)
+	if (!ctx || !ctx->bufs.send)
 		return (-1);
+#if defined(HAJ)
+	outputExpired(ctx, FALSE);
+	if (ctx->sentNs)
+		ctx->sentNs[ctx->seq % MAX_SEQ] = 0;
+#endif
+	/* a wrapped sequence reuses the slot of the probe MAX_SEQ before it */
+	ctx->seqReceived[ctx->seq % MAX_SEQ] = FALSE;
 
-	/* compute user payload and bound it */
-	userPayload = computeUserPayloadSize(&ctx->opts);
-	if (userPayload > (PING_MAX_PACKET_SIZE - sizeof(tIcmp4Hdr) - 4))
-		userPayload = PING_MAX_PACKET_SIZE - sizeof(tIcmp4Hdr) - 4;
-
-	payloadLen = userPayload;
-
-	if (payloadLen > 0)
-	{
-		unsigned int	i;
-		unsigned int	tvSize;
-		unsigned int	patternLen;
-		unsigned char	pattern[256];
-
-		tvSize = sizeof(tv);
-		patternLen = ctx->opts.patternLen;
-
-		if (payloadLen >= tvSize)
-		{
-			gettimeofday(&tv, NULL);
-			ft_memcpy(payload, &tv, tvSize);
-		}
-		else
-			tvSize = 0;
-
-		if (patternLen > 0)
-		{
-			ft_memcpy(pattern, ctx->opts.pattBytes, patternLen);
-			for (i = tvSize; i < payloadLen; i++)
-				payload[i] = pattern[(i - tvSize) % patternLen];
-		}
-		else
-		{
-			for (i = tvSize; i < payloadLen; i++)
-				payload[i] = 0;
-		}
-	}
+	/* payload pattern is prefilled, only header and stamp change */
+	packet = ctx->bufs.send;
+#if defined(HAJ)
+	probeStamp(ctx, ctx->seq, stamp);
+#else
+	gettimeofday(&stamp, NULL);
+#endif
 
 	if (ctx->targetAddr.ss_family == AF_INET)
 	{
@@ -87,7 +107,7 @@ sendIcmpPacket(tPingContext *ctx)
 			/* build ICMP Timestamp request if raw socket and timestamp option */
 			packetLen = buildIcmpv4TimestampRequest(
 				(tIcmp4Timestamp *)packet,
-				sizeof(tIcmp4Timestamp),
+				ctx->bufs.sendSize,
 				(uint16_t)ctx->pid,
 				(uint16_t)ctx->seq,
 				msSinceMidnight()
@@ -97,13 +117,14 @@ sendIcmpPacket(tPingContext *ctx)
 		else
 		{
 			/* default Echo request */
-			packetLen = buildIcmpv4EchoRequest(
-				(tIcmp4Echo *)packet,
-				sizeof(packet),
+			packetLen = pingBuffersBuildEcho(
+				&ctx->bufs,
+				ICMP4_ECHO_REQUEST,
 				(uint16_t)ctx->pid,
 				(uint16_t)ctx->seq,
-				(payloadLen ? payload : NULL),
-				payloadLen
+				&stamp,
+				0,
+				1
 			);
 		}
 	}
@@ -112,6 +133,7 @@ sendIcmpPacket(tPingContext *ctx)
 	{
 		const struct sockaddr_in6 *dst6 = (const struct sockaddr_in6 *)&ctx->targetAddr;
 		struct in6_addr src6;
+		uint32_t pseudoSum = 0;
 		int doChecksum = (ctx->sock.privilege == SOCKET_PRIV_RAW);
 		/* try to get local src addr for checksum when RAW */
 		if (doChecksum)
@@ -123,16 +145,16 @@ sendIcmpPacket(tPingContext *ctx)
 				src6 = ((struct sockaddr_in6 *)&local)->sin6_addr;
 			else
 				src6 = in6addr_any;
+			pseudoSum = icmpv6PseudoSum(&src6, &dst6->sin6_addr,
+				ICMP6_HDR_LEN + ctx->bufs.payloadLen);
 		}
-		packetLen = buildIcmpv6EchoRequest(
-			(tIcmp6Echo *)packet,
-			sizeof(packet),
+		packetLen = pingBuffersBuildEcho(
+			&ctx->bufs,
+			ICMP6_ECHO_REQUEST,
 			(uint16_t)ctx->pid,
 			(uint16_t)ctx->seq,
-			(payloadLen ? payload : NULL),
-			payloadLen,
-			(doChecksum ? &src6 : NULL),
-			&dst6->sin6_addr,
+			&stamp,
+			pseudoSum,
 			doChecksum
 		);
 	}
@@ -171,7 +193,15 @@ sendIcmpPacket(tPingContext *ctx)
 
 	if (ctx->opts.verbose > 2)
 		ft_printf("Sent ICMP Echo Request: seq=%u bytes=%zd\n", ctx->seq, sent);
+#if defined(HAJ)
+	captureSent(ctx->capture, &ctx->targetAddr,
+		(uint8_t)(ctx->opts.ttl > 0 ? ctx->opts.ttl : 64), packet, packetLen);
+#endif
 
+#if defined(HAJ)
+	if (ctx->sentNs)
+		ctx->sentNs[ctx->seq % MAX_SEQ] = monotonicNs();
+#endif
 	ctx->stats.sent++;
 	return (0);
 }
@@ -253,6 +283,79 @@ recvIcmpDgram(
 	return (0);
 }
 
+/**
+ * @brief Rebuild the IPv6 header of a raw ICMPv6 reply from ancillary data
+ * Hop limit, traffic class and destination come from IPV6_HOPLIMIT,
+ * IPV6_TCLASS and IPV6_PKTINFO. Extension headers delivered as
+ * IPV6_HOPOPTS / IPV6_DSTOPTS / IPV6_RTHDR are chained behind the base header
+ * and walked with parseIp6HeaderFromBuffer, which also checks them.
+ * @param msg - received message with its control data
+ * @param from - source address
+ * @param icmpLen - length of the ICMPv6 message
+ * @param hdr - header to fill
+ * @return 0 if at least the hop limit was present, -1 otherwise
+ */
+static int
+recvIp6Header(
+	struct msghdr					*msg,
+	const struct sockaddr_storage	*from,
+	size_t							icmpLen,
+	tIp6Hdr							*hdr)
+{
+	unsigned char	pkt[PING_IP6_HDR_LEN + PING_CMSG_SPACE];
+	size_t			extLen = 0;
+	uint8_t			firstExt = IP_PROTO_ICMPV6;
+	tBool			haveHops = FALSE;
+	int				value;
+
+	ft_bzero(pkt, PING_IP6_HDR_LEN);
+	for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c))
+	{
+		size_t	dataLen;
+
+		if (c->cmsg_level != IPPROTO_IPV6)
+			continue;
+		dataLen = c->cmsg_len - CMSG_LEN(0);
+		if (c->cmsg_type == IPV6_HOPLIMIT && dataLen >= sizeof(int))
+		{
+			ft_memcpy(&value, CMSG_DATA(c), sizeof(int));
+			pkt[7] = (uint8_t)value;
+			haveHops = TRUE;
+		}
+		else if (c->cmsg_type == IPV6_TCLASS && dataLen >= sizeof(int))
+		{
+			ft_memcpy(&value, CMSG_DATA(c), sizeof(int));
+			pkt[0] = (uint8_t)(0x60 | ((value >> 4) & 0x0F));
+			pkt[1] = (uint8_t)((value & 0x0F) << 4);
+		}
+		else if (c->cmsg_type == IPV6_PKTINFO && dataLen >= sizeof(struct in6_addr))
+			ft_memcpy(pkt + 24, CMSG_DATA(c), sizeof(struct in6_addr)); /* ipi6_addr comes first */
+		else if ((c->cmsg_type == IPV6_HOPOPTS || c->cmsg_type == IPV6_DSTOPTS
+				|| c->cmsg_type == IPV6_RTHDR)
+			&& dataLen >= 2 && extLen + dataLen <= PING_CMSG_SPACE)
+		{
+			/* each extension keeps its own next header byte, only the
+			 * first one has to be linked from the base header */
+			if (extLen == 0)
+				firstExt = c->cmsg_type == IPV6_HOPOPTS ? 0
+					: c->cmsg_type == IPV6_RTHDR ? 43 : 60;
+			ft_memcpy(pkt + PING_IP6_HDR_LEN + extLen, CMSG_DATA(c), dataLen);
+			extLen += dataLen;
+		}
+	}
+	if (!haveHops)
+		return (-1);
+	pkt[0] |= 0x60;
+	pkt[4] = (uint8_t)((extLen + icmpLen) >> 8);
+	pkt[5] = (uint8_t)(extLen + icmpLen);
+	pkt[6] = firstExt;
+	if (from->ss_family == AF_INET6)
+		ft_memcpy(pkt + 8, &((const struct sockaddr_in6 *)from)->sin6_addr, sizeof(struct in6_addr));
+	if (parseIp6HeaderFromBuffer(pkt, PING_IP6_HDR_LEN + extLen, hdr) == 0)
+		return (-1);
+	return (0);
+}
+
 /**
  * @brief Receive ICMP packet on a RAW socket.
  * Parse IP header to locate ICMP payload.
@@ -264,6 +367,7 @@ recvIcmpDgram(
  * @param icmpLen - ICMP packet length output
  * @param ttl - TTL output
  * @param ipHdrOut - parsed IP header output
+ * @param ip6HdrOut - IPv6 header rebuilt from ancillary data output
  * @return 0 on success, -1 on failure
  */
 static int
@@ -274,16 +378,17 @@ recvIcmpRaw(tPingContext *ctx,
 			const unsigned char		**icmp,
 			size_t					*icmpLen,
 			uint8_t					*ttl,
-			const tIpHdr			**ipHdrOut)
+			const tIpHdr			**ipHdrOut,
+			const tIp6Hdr			**ip6HdrOut)
 {
 	ssize_t			n;
 	socklen_t		fromLen = sizeof(*from);
 	int				recvTtl = 0;
 	struct iovec	iov;
 	struct msghdr	msg;
-	char			cmsgbuf[CMSG_SPACE(sizeof(int))];
+	char			cmsgbuf[PING_CMSG_SPACE];
 
-	if (!ctx || !buf || !from || !icmp || !icmpLen || !ttl || !ipHdrOut)
+	if (!ctx || !buf || !from || !icmp || !icmpLen || !ttl || !ipHdrOut || !ip6HdrOut)
 		return (-1);
 
 	iov.iov_base = buf;
@@ -314,6 +419,9 @@ recvIcmpRaw(tPingContext *ctx,
 
 	size_t ipHeaderLen = 0;
 
+	*ipHdrOut = NULL;
+	*ip6HdrOut = NULL;
+
 	if (ctx->sock.family == AF_INET)
 	{
 		static tIpHdr ipHdr;
@@ -327,9 +435,16 @@ recvIcmpRaw(tPingContext *ctx,
 	}
 	else if (ctx->sock.family == AF_INET6)
 	{
-		/* RAW ICMPv6 socket: buffer starts with ICMPv6 header */
+		static tIp6Hdr	ip6Hdr;
+
+		/* RAW ICMPv6 socket: buffer starts with ICMPv6 header, the kernel
+		 * hands the IPv6 header fields over as ancillary data */
 		ipHeaderLen = 0;
-		*ipHdrOut = NULL;
+		if (recvIp6Header(&msg, from, (size_t)n, &ip6Hdr) == 0)
+		{
+			recvTtl = ip6Hdr.hop_limit;
+			*ip6HdrOut = &ip6Hdr;
+		}
 	}
 
 	*icmp = (const unsigned char *)buf + ipHeaderLen;
@@ -339,6 +454,79 @@ recvIcmpRaw(tPingContext *ctx,
 	return (0);
 }
 
+#if defined(HAJ)
+/**
+ * @brief Take the next packet of the packet ring (--packet-ring)
+ * The packet is parsed where the kernel wrote it; it stays valid until
+ * the next call.
+ * @param ctx - ping context with an open ring
+ * @param from - source address output
+ * @param pkt - packet output, IP header included
+ * @param icmp - ICMP packet output
+ * @param icmpLen - ICMP packet length output
+ * @param ttl - TTL / hop limit output
+ * @param ipHdrOut - parsed IPv4 header output
+ * @param ip6HdrOut - parsed IPv6 header output
+ * @param arrivalNs - kernel receive time output (monotonic)
+ * @return 0 on success, -1 if the ring is empty or the packet malformed
+ */
+static int
+recvIcmpRing(tPingContext				*ctx,
+			struct sockaddr_storage	*from,
+			const unsigned char		**pkt,
+			const unsigned char		**icmp,
+			size_t					*icmpLen,
+			uint8_t					*ttl,
+			const tIpHdr			**ipHdrOut,
+			const tIp6Hdr			**ip6HdrOut,
+			uint64_t				*arrivalNs)
+{
+	tRxPacket	rx;
+	size_t		hdrLen;
+	size_t		len;
+
+	if (!rxRingNext(ctx->ring, &rx))
+		return (-1);
+	ft_bzero(from, sizeof(*from));
+	len = rx.len;
+	if (ctx->sock.family == AF_INET6)
+	{
+		static tIp6Hdr	ip6Hdr;
+
+		/* link layer padding is not part of the packet */
+		if (len >= PING_IP6_HDR_LEN && PING_IP6_HDR_LEN + (size_t)(rx.data[4] << 8 | rx.data[5]) < len)
+			len = PING_IP6_HDR_LEN + (size_t)(rx.data[4] << 8 | rx.data[5]);
+		hdrLen = parseIp6HeaderFromBuffer(rx.data, len, &ip6Hdr);
+		if (hdrLen == 0)
+			return (-1);
+		from->ss_family = AF_INET6;
+		ft_memcpy(&((struct sockaddr_in6 *)from)->sin6_addr, ip6Hdr.saddr, sizeof(ip6Hdr.saddr));
+		*ttl = ip6Hdr.hop_limit;
+		*ip6HdrOut = &ip6Hdr;
+	}
+	else
+	{
+		static tIpHdr	ipHdr;
+
+		if (len >= 20 && (size_t)(rx.data[2] << 8 | rx.data[3]) < len)
+			len = (size_t)(rx.data[2] << 8 | rx.data[3]);
+		hdrLen = parseIpHeaderFromBuffer(rx.data, len, &ipHdr);
+		if (hdrLen == 0)
+			return (-1);
+		parseIp4Opts(rx.data, hdrLen, &ipHdr);
+		from->ss_family = AF_INET;
+		((struct sockaddr_in *)from)->sin_addr.s_addr = ipHdr.saddr;
+		*ttl = ipHdr.ttl;
+		*ipHdrOut = &ipHdr;
+	}
+	*pkt = rx.data;
+	*icmp = rx.data + hdrLen;
+	*icmpLen = len - hdrLen;
+	*arrivalNs = rx.arrivalNs;
+	return (0);
+}
+#endif
+
 /**
  * @brief Validate received ICMP reply
  * @param ctx - ping context
@@ -459,6 +647,7 @@ validateIcmpReply(
 	return (0);
 }
 
+#if !defined(HAJ)
 /**
  * @brief Compute ICMP RTT from received packet
  * @param ctx - ping context
@@ -499,7 +688,166 @@ computeIcmpRtt(
 	gettimeofday(&now, NULL);
 	timersub(&now, &sentTv, rtt);
 }
+#endif
+
+
+/**
+ * @brief Check that an echo reply carries back the payload that was sent
+ * The timestamp is skipped; the rest is compared against the prefilled send
+ * buffer. Sets info->badOffset and counts the reply as corrupted on mismatch.
+ * @param ctx - ping context
+ * @param icmp - ICMP packet
+ * @param icmpLen - length of ICMP packet
+ * @param info - reply info to update
+ */
+static void
+verifyIcmpPayload(
+	tPingContext		*ctx,
+	const unsigned char	*icmp,
+	size_t				icmpLen,
+	tIcmpReplyInfo		*info)
+{
+	const tPingBuffers	*bufs = &ctx->bufs;
+	uint32_t			len;
+	uint32_t			off;
+
+	info->badOffset = -1;
+	if (!bufs->send || icmpLen <= ICMP4_HDR_LEN + bufs->stampLen)
+		return;
+	len = (uint32_t)icmpLen - ICMP4_HDR_LEN;
+	if (len > bufs->payloadLen)
+		len = bufs->payloadLen;
+	if (len <= bufs->stampLen)
+		return;
+	off = bufs->stampLen + icmpPayloadDiff(
+		icmp + ICMP4_HDR_LEN + bufs->stampLen,
+		bufs->send + ICMP4_HDR_LEN + bufs->stampLen,
+		len - bufs->stampLen);
+	if (off >= len)
+		return;
+	info->badOffset = (int32_t)off;
+	info->badWant = bufs->send[ICMP4_HDR_LEN + off];
+	info->badGot = icmp[ICMP4_HDR_LEN + off];
+	ctx->stats.corrupted++;
+}
+
+#if defined(HAJ)
+/**
+ * @brief Record a packet turned down by validateIcmpReply (--capture)
+ * ICMP errors were counted and are recorded as accounted. Echo replies
+ * to our identifier from another address are recorded as rejected; other
+ * processes' replies and requests seen on a raw socket are left out.
+ * @param ctx - ping context
+ * @param buf - packet as read, IPv4 header included on raw sockets
+ * @param icmp / icmpLen - ICMP message in buf
+ * @param from - sender
+ * @param ttl - TTL / hop limit of the packet
+ */
+static void
+captureInvalid(
+	tPingContext					*ctx,
+	const void						*buf,
+	const unsigned char				*icmp,
+	size_t							icmpLen,
+	const struct sockaddr_storage	*from,
+	uint8_t							ttl)
+{
+	size_t		ipLen = (size_t)(icmp - (const unsigned char *)buf);
+	tBool		isV6 = (ctx->targetAddr.ss_family == AF_INET6);
+	const char	*reject = NULL;
+
+	if (!ctx->capture || icmpLen < ICMP4_HDR_LEN)
+		return;
+	if (icmp[0] == (isV6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+	{
+		if (ctx->sock.privilege == SOCKET_PRIV_RAW
+			&& (uint16_t)(icmp[4] << 8 | icmp[5]) != (uint16_t)ctx->pid)
+			return;
+		reject = "wrong source";
+	}
+	else if (isV6 ? icmp[0] >= 128
+		: (icmp[0] != ICMP4_DEST_UNREACH && icmp[0] != ICMP4_TIME_EXCEEDED
+			&& icmp[0] != ICMP4_PARAM_PROBLEM && icmp[0] != ICMP4_SOURCE_QUENCH
+			&& icmp[0] != ICMP4_REDIRECT))
+		return;
+	captureReceived(ctx->capture, from, ttl, buf, ipLen + icmpLen, ipLen, reject);
+}
+
+/**
+ * @brief Write the record of an ICMP error about one of our probes (--output,
+ * --probe-log)
+ * The probe is the echo request quoted by the error, with our identifier.
+ * @param ctx - ping context
+ * @param icmp / icmpLen - ICMP message turned down by validateIcmpReply
+ * @param ttl - TTL / hop limit of the error
+ */
+static void
+outputInvalid(tPingContext *ctx, const unsigned char *icmp, size_t icmpLen, uint8_t ttl)
+{
+	const unsigned char	*quoted = icmp + ICMP4_HDR_LEN;
+	size_t				len = icmpLen - ICMP4_HDR_LEN;
+	size_t				hdrLen;
+	tOutputProbe		rec;
+
+	if ((!ctx->output && !ctx->plog) || icmpLen < ICMP4_HDR_LEN)
+		return;
+	if (ctx->targetAddr.ss_family == AF_INET6)
+	{
+		hdrLen = PING_IP6_HDR_LEN;
+		if (icmp[0] >= 128 || len < hdrLen + ICMP6_HDR_LEN || quoted[6] != IPPROTO_ICMPV6
+			|| quoted[hdrLen] != ICMP6_ECHO_REQUEST)
+			return;
+	}
+	else
+	{
+		hdrLen = len >= 20 ? (size_t)(quoted[0] & 0x0F) * 4 : 0;
+		if (icmp[0] == ICMP4_ECHO_REPLY || hdrLen < 20 || len < hdrLen + ICMP4_HDR_LEN
+			|| quoted[9] != IPPROTO_ICMP || quoted[hdrLen] != ICMP4_ECHO_REQUEST)
+			return;
+	}
+	if ((uint16_t)(quoted[hdrLen + 4] << 8 | quoted[hdrLen + 5]) != (uint16_t)ctx->pid)
+		return;
+	rec.target = ctx->targetHost;
+	rec.addr = ctx->resolvedIp;
+	rec.seq = (uint16_t)(quoted[hdrLen + 6] << 8 | quoted[hdrLen + 7]);
+	rec.status = OUTPUT_ERROR;
+	rec.ttl = ttl;
+	rec.rttNs = -1;
+	rec.size = (int64_t)icmpLen;
+	rec.errType = icmp[0];
+	rec.errCode = icmp[1];
+	outputProbe(ctx->output, &rec);
+	plogProbe(ctx->plog, &rec);
+}
 
+/**
+ * @brief Write the record of an echo reply (--output, --probe-log)
+ * @param ctx - ping context
+ * @param info - reply info filled by receiveIcmpReply
+ * @param bytes - size of the reply
+ * @param dup - the sequence was answered already
+ */
+static void
+outputReply(tPingContext *ctx, const tIcmpReplyInfo *info, unsigned int bytes, tBool dup)
+{
+	tOutputProbe	rec;
+
+	if (!ctx->output && !ctx->plog)
+		return;
+	rec.target = ctx->targetHost;
+	rec.addr = ctx->resolvedIp;
+	rec.seq = info->seq;
+	rec.status = dup ? OUTPUT_DUPLICATE : OUTPUT_REPLY;
+	rec.ttl = info->ttl;
+	rec.rttNs = info->haveRtt ? (int64_t)info->rttNs : -1;
+	rec.size = bytes;
+	rec.errType = -1;
+	rec.errCode = -1;
+	outputProbe(ctx->output, &rec);
+	plogProbe(ctx->plog, &rec);
+}
+
+#endif
 
 /*
  * Top-level receive: choose RAW vs DGRAM helpers, validate, compute rtt.
@@ -517,13 +865,27 @@ receiveIcmpReply(
 	const unsigned char		*icmp;
 	size_t					icmpLen;
 	const tIpHdr			*ipHdr = NULL;
+	const tIp6Hdr			*ip6Hdr = NULL;
+#if defined(HAJ)
+	const unsigned char		*pkt = buf;
+	uint64_t				arrivalNs = 0;
+	size_t					ipLen;
+#endif
 
 	if (!ctx || !buf || !info)
 		return (-1);
 
+#if defined(HAJ)
+	if (ctx->ring)
+	{
+		if (recvIcmpRing(ctx, &from, &pkt, &icmp, &icmpLen, &info->ttl, &ipHdr, &ip6Hdr, &arrivalNs) != 0)
+			return (-1);
+	}
+	else
+#endif
 	if (ctx->sock.privilege == SOCKET_PRIV_RAW)
 	{
-		if (recvIcmpRaw(ctx, buf, bufLen, &from, &icmp, &icmpLen, &info->ttl, &ipHdr) != 0)
+		if (recvIcmpRaw(ctx, buf, bufLen, &from, &icmp, &icmpLen, &info->ttl, &ipHdr, &ip6Hdr) != 0)
 			return (-1);
 	}
 	else
@@ -534,15 +896,53 @@ receiveIcmpReply(
 
 	/* validate and extract seq (also filters unrelated replies) */
 	if (validateIcmpReply(ctx, icmp, icmpLen, &from, &info->seq) != 0)
+	{
+#if defined(HAJ)
+		captureInvalid(ctx, pkt, icmp, icmpLen, &from, info->ttl);
+		outputInvalid(ctx, icmp, icmpLen, info->ttl);
+#endif
 		return (-1);
+	}
 
 	info->type = icmp[0];
 	info->code = icmp[1];
 
 	/* compute RTT if available */
+#if defined(HAJ)
+	ipLen = (size_t)(icmp - pkt);
+	/* foreign or forged echo replies are dropped before any stats work */
+	ft_memset(&info->rtt, 0, sizeof(info->rtt));
+	info->haveRtt = FALSE;
+	if (ctx->bufs.stampLen > 0
+		&& info->type == (ctx->targetAddr.ss_family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+	{
+		tProbeInfo	probe;
+
+		if (probeCheck(ctx, icmp, icmpLen, arrivalNs, &probe) != 0)
+		{
+			if (ctx->opts.verbose > 1)
+				ft_printf("Ignoring unauthenticated echo reply: icmp_seq=%u\n", info->seq);
+			captureReceived(ctx->capture, &from, info->ttl, pkt,
+				ipLen + icmpLen, ipLen, "unauthenticated");
+			return (-1);
+		}
+		info->rttNs = probe.rttNs;
+		info->rtt.tv_sec = (time_t)(probe.rttNs / 1000000000ULL);
+		info->rtt.tv_usec = (suseconds_t)((probe.rttNs % 1000000000ULL) / 1000);
+		info->haveRtt = TRUE;
+	}
+#else
 	computeIcmpRtt(ctx, icmp, icmpLen, &info->rtt);
+	info->haveRtt = (ctx->bufs.stampLen > 0
+		&& (info->rtt.tv_sec != 0 || info->rtt.tv_usec != 0));
+#endif
 
-	*ipHdrOut = ipHdr;
+	info->badOffset = -1;
+	if (info->type == (ctx->targetAddr.ss_family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+		verifyIcmpPayload(ctx, icmp, icmpLen, info);
+
+	if (ipHdrOut)
+		*ipHdrOut = ipHdr;
 
 	/* verbose: if RAW, also print parsed IP header */
 	if (ctx->opts.verbose > 4 && ipHdr)
@@ -550,6 +950,11 @@ receiveIcmpReply(
 		ft_printf("Received IPv4 Header:\n");
 		printIpv4Header(ipHdr);
 	}
+	if (ctx->opts.verbose > 4 && ip6Hdr)
+	{
+		ft_printf("Received IPv6 Header:\n");
+		printIpv6Header(ip6Hdr);
+	}
 
 	if (ctx->opts.verbose > 3)
 	{
@@ -558,9 +963,27 @@ receiveIcmpReply(
 	}
 
 	ctx->stats.received++;
+#if defined(HAJ)
+	captureReceived(ctx->capture, &from, info->ttl, pkt, ipLen + icmpLen, ipLen, NULL);
+#endif
 	return (0);
 }
 
+#if defined(HAJ)
+/**
+ * @brief Report the first corrupted byte of a reply, if any
+ * @param info - reply info filled by receiveIcmpReply
+ */
+static void
+printPayloadMismatch(const tIcmpReplyInfo *info)
+{
+	if (info->badOffset < 0)
+		return;
+	ft_printf("wrong data byte #%d should be 0x%02x but was 0x%02x\n",
+		info->badOffset, info->badWant, info->badGot);
+}
+#endif
+
 static void
 pingLoopInit(
 	tPingContext	*ctx,
@@ -605,15 +1028,11 @@ pingLoopInit(
 	gettimeofday(lastSend, NULL);
 
 	ctx->seq = 0;
-	ctx->stats.sent = 0;
-	ctx->stats.received = 0;
-	ctx->stats.lost = 0;
-	ctx->stats.errors = 0;
-	ctx->stats.duplicates = 0;
-	ctx->stats.rttMin = 0.0;
-	ctx->stats.rttMax = 0.0;
-	ctx->stats.rttSum = 0.0;
-	ctx->stats.rttSumSq = 0.0;
+	pingStatsReset(&ctx->stats);
+#if defined(HAJ)
+	ft_bzero(&ctx->rttHist, sizeof(ctx->rttHist));
+	ft_bzero(&ctx->rttJitter, sizeof(ctx->rttJitter));
+#endif
 }
 
 /**
@@ -634,12 +1053,20 @@ handleLinger(tPingContext *ctx,
 
 	fd_set fdset;
 	struct timeval lingerTv, startTv, nowTv;
-	unsigned char buf[PING_MAX_PACKET_SIZE];
+	int rxFd = ctx->sock.fd;
+
+#if defined(HAJ)
+	if (ctx->ring)
+		rxFd = ctx->ring->fd;
+#endif
 
 	gettimeofday(&startTv, NULL);
 
 	while (!g_pingInterrupted)
 	{
+#if defined(HAJ)
+		outputExpired(ctx, FALSE);
+#endif
 		/* Check if all sent packets are already received */
 		if (ctx->stats.received >= sentCount)
 			break;
@@ -656,9 +1083,16 @@ handleLinger(tPingContext *ctx,
 		lingerTv.tv_usec = remainingUs % 1000000L;
 
 		FD_ZERO(&fdset);
-		FD_SET(ctx->sock.fd, &fdset);
+		FD_SET(rxFd, &fdset);
 
-		int sel = select(ctx->sock.fd + 1, &fdset, NULL, NULL, &lingerTv);
+		int sel;
+#if defined(HAJ)
+		/* replies already in the ring need no wakeup */
+		if (ctx->ring && rxRingReady(ctx->ring))
+			sel = 1;
+		else
+#endif
+			sel = select(rxFd + 1, &fdset, NULL, NULL, &lingerTv);
 		if (sel < 0)
 		{
 			if (errno == EINTR)
@@ -670,39 +1104,90 @@ handleLinger(tPingContext *ctx,
 		else if (sel == 0)
 			break;	/* timeout expired, stop linger */
 
-		if (FD_ISSET(ctx->sock.fd, &fdset))
+		if (FD_ISSET(rxFd, &fdset))
 		{
 			tIcmpReplyInfo replyInfo;
-			if (receiveIcmpReply(ctx, buf, sizeof(buf), &replyInfo, NULL) != 0)
+			if (receiveIcmpReply(ctx, ctx->bufs.recv, ctx->bufs.recvSize, &replyInfo, NULL) != 0)
 				continue;
 
 			double ms = 0.0;
-			if (userPayload >= sizeof(struct timeval) &&
-					(replyInfo.rtt.tv_sec != 0 || replyInfo.rtt.tv_usec != 0))
+			if (replyInfo.haveRtt)
 				ms = replyInfo.rtt.tv_sec * 1000.0
 				   + replyInfo.rtt.tv_usec / 1000.0;
 
 			unsigned int replyBytes = onWireHeader + userPayload;
+#if defined(HAJ)
+			outputReply(ctx, &replyInfo, replyBytes, ctx->seqReceived[replyInfo.seq]);
+#endif
+			ctx->seqReceived[replyInfo.seq] = TRUE;
 			if (!ctx->opts.flood)
 				printf("%u bytes from %s: icmp_seq=%u ttl=%u time=%.3f ms\n",
 					   replyBytes, ctx->resolvedIp, replyInfo.seq, replyInfo.ttl, ms);
+#if defined(HAJ)
+			if (!ctx->opts.flood)
+			{
+				fflush(stdout);
+				printPayloadMismatch(&replyInfo);
+			}
+#endif
 		}
 	}
 }
 
+/**
+ * @brief Interval between two probes, in seconds
+ * @param ctx - ping context
+ * @param rateLimit - probes per second ceiling (hajping), 0 for none
+ */
+static double
+probeInterval(const tPingContext *ctx, unsigned int rateLimit)
+{
+	double	iv = ctx->opts.interval;
+
+	if (ctx->opts.flood && iv <= 0.0)
+		iv = 0.01;
+	else if (iv <= 0.0)
+		iv = PING_DEFAULT_INTERVAL;
+#if defined(HAJ)
+	if (rateLimit > 0 && iv < 1.0 / rateLimit)
+		iv = 1.0 / rateLimit;
+#else
+	(void)rateLimit;
+#endif
+	return (iv);
+}
+
 void
 runPingLoop(tPingContext *ctx)
 {
 	fd_set			fdset;
 	struct timeval	lastSend, interval, now, respTime, startTime;
-	unsigned char	buf[PING_MAX_PACKET_SIZE];
 	unsigned int	sentCount = 0;
 	uint32_t		userPayload;
 	uint32_t		onWireHeader;
 	char			oldRoute[512];
+	int				rxFd;
+	unsigned int	rateLimit = 0;
+#if defined(HAJ)
+	double			tail;
+#endif
 
 	if (!ctx)
 		return;
+	rxFd = ctx->sock.fd;
+#if defined(HAJ)
+	rateLimit = sockRateLimit(&ctx->opts, ctx->sock.privilege);
+	if (ctx->ring)
+		rxFd = ctx->ring->fd;
+	/* a probe is lost once its wait is over, as with --parallel */
+	tail = probeInterval(ctx, rateLimit);
+	if (ctx->opts.linger > tail)
+		tail = ctx->opts.linger;
+	ctx->waitNs = (uint64_t)(tail * 1e9);
+	ctx->settled = 0;
+	if ((ctx->output || ctx->plog) && !(ctx->sentNs = calloc(MAX_SEQ, sizeof(*ctx->sentNs))))
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory, lost probes are not recorded\n");
+#endif
 
 	/* call initialization */
 	pingLoopInit(ctx, &lastSend, &interval, &userPayload, &onWireHeader);
@@ -723,6 +1208,11 @@ runPingLoop(tPingContext *ctx)
 
 		while (i < max && !g_pingInterrupted)
 		{
+#if defined(HAJ)
+			/* as fast as possible, within the ceiling */
+			if (rateLimit > 0 && i > 0)
+				nanosleep(&(struct timespec){0, (long)(1000000000UL / rateLimit)}, NULL);
+#endif
 			if (sendIcmpPacket(ctx) == 0)
 			{
 				sentCount++;
@@ -753,8 +1243,11 @@ runPingLoop(tPingContext *ctx)
 		/* wait for replies until next interval */
 		while (!g_pingInterrupted)
 		{
+#if defined(HAJ)
+			outputExpired(ctx, FALSE);
+#endif
 			FD_ZERO(&fdset);
-			FD_SET(ctx->sock.fd, &fdset);
+			FD_SET(rxFd, &fdset);
 
 			gettimeofday(&now, NULL);
 			/* compute remaining time until next send */
@@ -763,7 +1256,14 @@ runPingLoop(tPingContext *ctx)
 			normalizeTimeval(&respTime);
 			if (respTime.tv_sec < 0) { respTime.tv_sec = 0; respTime.tv_usec = 0; }
 
-			int sel = select(ctx->sock.fd + 1, &fdset, NULL, NULL, &respTime);
+			int sel;
+#if defined(HAJ)
+			/* replies already in the ring need no wakeup */
+			if (ctx->ring && rxRingReady(ctx->ring))
+				sel = 1;
+			else
+#endif
+				sel = select(rxFd + 1, &fdset, NULL, NULL, &respTime);
 			if (sel < 0)
 			{
 				if (errno == EINTR)	/* interrupted by signal, exit gracefully */
@@ -774,35 +1274,47 @@ runPingLoop(tPingContext *ctx)
 
 			if (sel == 0)
 				break; /* timeout, send next packet */
-			if (FD_ISSET(ctx->sock.fd, &fdset))
+			if (FD_ISSET(rxFd, &fdset))
 			{
 				tIcmpReplyInfo	replyInfo;
 				double			ms;
 				int				haveRtt;
+				tBool			dup;
 				unsigned int	replyBytes;
 				const tIpHdr	*ipHdr = NULL;
 
-				if (receiveIcmpReply(ctx, buf, sizeof(buf), &replyInfo, &ipHdr) != 0)
+				if (receiveIcmpReply(ctx, ctx->bufs.recv, ctx->bufs.recvSize, &replyInfo, &ipHdr) != 0)
 					continue;
 
-				haveRtt = (userPayload >= sizeof(struct timeval) &&
-						   (replyInfo.rtt.tv_sec != 0 || replyInfo.rtt.tv_usec != 0));
+				haveRtt = replyInfo.haveRtt;
 
 				ms = 0.0;
+#if defined(HAJ)
+				/* full ns precision, as the concurrent engine and the probe log */
+				if (haveRtt)
+					ms = (double)replyInfo.rttNs / 1000000.0;
+#else
 				ms = replyInfo.rtt.tv_sec * 1000.0
 				   + replyInfo.rtt.tv_usec / 1000.0;
-				if (haveRtt && !ctx->seqReceived[replyInfo.seq])
+#endif
+				/* duplicates are told apart whatever is printed (-q, -f) */
+				dup = ctx->seqReceived[replyInfo.seq];
+				if (haveRtt && !dup)
 				{
-					if (ctx->stats.received == 1 || ms < ctx->stats.rttMin)
-						ctx->stats.rttMin = ms;
-					if (ms > ctx->stats.rttMax)
-						ctx->stats.rttMax = ms;
-
-					ctx->stats.rttSum += ms;
-					ctx->stats.rttSumSq += ms * ms;
+					pingStatsAddRtt(&ctx->stats, ms);
+#if defined(HAJ)
+					rttHistAdd(&ctx->rttHist, ms);
+					rttJitterAdd(&ctx->rttJitter, ms);
+#endif
 				}
+				if (dup)
+					ctx->stats.duplicates++;
+				ctx->seqReceived[replyInfo.seq] = TRUE;
 
 				replyBytes = onWireHeader + userPayload;
+#if defined(HAJ)
+				outputReply(ctx, &replyInfo, replyBytes, dup);
+#endif
 
 				if (!ctx->opts.flood && !ctx->opts.quiet)
 				{
@@ -824,13 +1336,8 @@ runPingLoop(tPingContext *ctx)
 					if (haveRtt)
 						ft_printf(" time=%.3f ms", ms);
 
-					if (ctx->seqReceived[replyInfo.seq])
-					{
-						ctx->stats.duplicates++;
+					if (dup)
 						ft_printf(" (DUP!)");
-					}
-					else
-						ctx->seqReceived[replyInfo.seq] = TRUE;
 
 					if (ipHdr)
 					{
@@ -851,8 +1358,11 @@ runPingLoop(tPingContext *ctx)
 					} else
 						ft_putchar_fd('\n', STDOUT_FILENO);
 
+#if defined(HAJ)
+					printPayloadMismatch(&replyInfo);
+#endif
 					if (ctx->opts.timestamp && replyInfo.type == ICMP4_TIMESTAMP_REPLY)
-						printIcmpv4TimestampReply((const tIcmp4Echo *)buf);
+						printIcmpv4TimestampReply((const tIcmp4Echo *)ctx->bufs.recv);
 					fflush(stdout);
 				}
 			}
@@ -861,12 +1371,7 @@ runPingLoop(tPingContext *ctx)
 		ctx->seq++;
 
 		/* recalc interval for next send */
-		double iv = ctx->opts.interval;
-		if (ctx->opts.flood && iv <= 0.0)
-			iv = 0.01;
-		else if (iv <= 0.0)
-			iv = PING_DEFAULT_INTERVAL;
-		timevalFromDouble(&interval, iv);
+		timevalFromDouble(&interval, probeInterval(ctx, rateLimit));
 		normalizeTimeval(&interval);
 	}
 
@@ -874,5 +1379,14 @@ runPingLoop(tPingContext *ctx)
 	if (ctx->opts.linger > 0)
 		handleLinger(ctx, sentCount, onWireHeader, userPayload);
 
+#if defined(HAJ)
+	outputExpired(ctx, TRUE);
+	free(ctx->sentNs);
+	ctx->sentNs = NULL;
+#endif
 	printPingSummary(ctx);
+#if defined(HAJ)
+	outputSummary(ctx->output, ctx->targetHost, ctx->resolvedIp, &ctx->stats,
+		&ctx->rttHist, &ctx->rttJitter);
+#endif
 }
@@ -53,6 +53,69 @@ computeUserPayloadSize(const tPingOptions *opts)
 	return (userPayload);
 }
 
+uint64_t
+monotonicNs(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+#if defined(HAJ)
+/**
+ * @brief Address bytes of the target, bound into the probe tag
+ * @param ctx - ping context
+ * @param len - address length output (4 or 16)
+ * @return pointer to the address bytes
+ */
+static const void
+*probePeer(const tPingContext *ctx, uint32_t *len)
+{
+	if (ctx->targetAddr.ss_family == AF_INET6)
+	{
+		*len = sizeof(struct in6_addr);
+		return (&((const struct sockaddr_in6 *)&ctx->targetAddr)->sin6_addr);
+	}
+	*len = sizeof(struct in_addr);
+	return (&((const struct sockaddr_in *)&ctx->targetAddr)->sin_addr);
+}
+
+uint32_t
+probeStamp(const tPingContext *ctx, uint32_t seq, uint8_t *hdr)
+{
+	const void	*peer;
+	uint32_t	peerLen;
+
+	if (!ctx || !hdr || ctx->bufs.stampLen == 0)
+		return (0);
+	peer = probePeer(ctx, &peerLen);
+	return (probeHeaderWrite(hdr, ctx->bufs.stampLen, ctx->probeKey,
+		seq, monotonicNs(), peer, peerLen));
+}
+
+int
+probeCheck(
+	const tPingContext *ctx,
+	const unsigned char *icmp,
+	size_t icmpLen,
+	uint64_t arrivalNs,
+	tProbeInfo *out)
+{
+	const void	*peer;
+	uint32_t	peerLen;
+	uint16_t	wireSeq;
+
+	if (!ctx || !icmp || !out || icmpLen < ICMP4_HDR_LEN)
+		return (-1);
+	peer = probePeer(ctx, &peerLen);
+	wireSeq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+	return (probeHeaderRead(icmp + ICMP4_HDR_LEN, (uint32_t)(icmpLen - ICMP4_HDR_LEN),
+		ctx->bufs.stampLen, ctx->probeKey, wireSeq, peer, peerLen,
+		arrivalNs ? arrivalNs : monotonicNs(), out));
+}
+#endif
+
 uint32_t
 msSinceMidnight(void)
 {
@@ -0,0 +1,406 @@
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/plog.h"
+#include "../includes/ping.h"
+
+_Static_assert(sizeof(tPlogHeader) == 64, "probe log header layout");
+_Static_assert(sizeof(tPlogBlock) == PLOG_BLOCK_HDR_SIZE, "probe log block header layout");
+_Static_assert(sizeof(tPlogEntry) == 320, "probe log dictionary entry layout");
+_Static_assert(sizeof(tPlogRecord) == 32, "probe log record layout");
+
+/**
+ * @brief Bytes of s kept in a field of max bytes (NUL included)
+ */
+static size_t
+plogKeyLen(const char *s, size_t max)
+{
+	size_t	n = 0;
+
+	while (n < max - 1 && s[n])
+		n++;
+	return (n);
+}
+
+/**
+ * @brief Dictionary index slot of a target: its key, or the free slot
+ * where it belongs
+ */
+static tPlogKey *
+plogFind(const tPlog *log, uint64_t hash, const char *name, size_t nameLen,
+		const char *addr, size_t addrLen)
+{
+	size_t		mask = log->keyCap - 1;
+	tPlogKey	*k;
+
+	for (size_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		k = &log->keys[i];
+		if (!k->key)
+			return (k);
+		if (k->hash == hash && ft_memcmp(k->key, name, nameLen) == 0 && k->key[nameLen] == '\0'
+			&& ft_memcmp(k->key + nameLen + 1, addr, addrLen) == 0 && k->key[nameLen + 1 + addrLen] == '\0')
+			return (k);
+	}
+}
+
+/**
+ * @brief Double the dictionary index
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+plogGrow(tPlog *log)
+{
+	size_t		cap = log->keyCap ? log->keyCap * 2 : PLOG_KEYS_INITIAL;
+	tPlogKey	*keys = calloc(cap, sizeof(*keys));
+	tPlogKey	*old = log->keys;
+	size_t		oldCap = log->keyCap;
+
+	if (!keys)
+		return (-1);
+	log->keys = keys;
+	log->keyCap = cap;
+	for (size_t i = 0; i < oldCap; i++)
+	{
+		if (!old[i].key)
+			continue;
+		for (size_t j = old[i].hash & (cap - 1);; j = (j + 1) & (cap - 1))
+		{
+			if (!keys[j].key)
+			{
+				keys[j] = old[i];
+				break;
+			}
+		}
+	}
+	free(old);
+	return (0);
+}
+
+/**
+ * @brief Add a target to the dictionary index
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+plogKeyAdd(tPlog *log, uint32_t index, const char *name, size_t nameLen,
+		const char *addr, size_t addrLen)
+{
+	uint64_t	hash = plogHash(name, nameLen, addr, addrLen);
+	tPlogKey	*k;
+	char		*key;
+
+	if ((log->keyCount + 1) * 2 > log->keyCap && plogGrow(log) != 0)
+		return (-1);
+	k = plogFind(log, hash, name, nameLen, addr, addrLen);
+	if (k->key)
+		return (0);
+	key = malloc(nameLen + addrLen + 2);
+	if (!key)
+		return (-1);
+	ft_memcpy(key, name, nameLen);
+	key[nameLen] = '\0';
+	ft_memcpy(key + nameLen + 1, addr, addrLen);
+	key[nameLen + 1 + addrLen] = '\0';
+	k->hash = hash;
+	k->index = index;
+	k->key = key;
+	log->keyCount++;
+	return (0);
+}
+
+/**
+ * @brief Allocate, map and publish the next block
+ * @return the mapped block, NULL with a message (the log failed)
+ */
+static tPlogBlock *
+plogAddBlock(tPlog *log, tPlogBlockType type)
+{
+	uint32_t	b = le32toh(__atomic_load_n(&log->hdr->blocks, __ATOMIC_RELAXED));
+	tPlogBlock	*blk;
+	int			err;
+
+	err = posix_fallocate(log->fd, plogBlockOffset(b), PLOG_BLOCK_SIZE);
+	blk = MAP_FAILED;
+	if (err == 0)
+		blk = mmap(NULL, PLOG_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, plogBlockOffset(b));
+	else
+		errno = err;
+	if (blk == MAP_FAILED)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log: %s\n", strerror(errno));
+		log->failed = TRUE;
+		return (NULL);
+	}
+	/* a block left by a crashed run may hold anything */
+	ft_bzero(blk, PLOG_BLOCK_HDR_SIZE);
+	blk->type = (uint8_t)type;
+	blk->index = htole32(b);
+	blk->magic = htole32(PLOG_BLOCK_MAGIC);
+	__atomic_store_n(&log->hdr->blocks, htole32(b + 1), __ATOMIC_RELEASE);
+	return (blk);
+}
+
+/**
+ * @brief Start writing out a block and unmap it
+ */
+static void
+plogUnmap(tPlogBlock *blk, int flags)
+{
+	if (!blk)
+		return;
+	msync(blk, PLOG_BLOCK_SIZE, flags);
+	munmap(blk, PLOG_BLOCK_SIZE);
+}
+
+/**
+ * @brief Dictionary index of a target, adding its entry the first time
+ * @return the index, -1 with a message on error
+ */
+static int64_t
+plogTarget(tPlog *log, const char *name, const char *addr)
+{
+	size_t		nameLen;
+	size_t		addrLen;
+	uint32_t	n;
+	tPlogKey	*k;
+	tPlogEntry	*e;
+
+	nameLen = plogKeyLen(name, PLOG_NAME_LEN);
+	addrLen = plogKeyLen(addr, PLOG_ADDR_LEN);
+	if (log->keyCap > 0)
+	{
+		k = plogFind(log, plogHash(name, nameLen, addr, addrLen), name, nameLen, addr, addrLen);
+		if (k->key)
+			return (k->index);
+	}
+	if (!log->dict || le32toh(log->dict->count) == PLOG_ENTRIES_PER_BLOCK)
+	{
+		plogUnmap(log->dict, MS_ASYNC);
+		log->dict = plogAddBlock(log, PLOG_BLOCK_DICT);
+		if (!log->dict)
+			return (-1);
+	}
+	if (plogKeyAdd(log, log->entries, name, nameLen, addr, addrLen) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log: %s\n", strerror(ENOMEM));
+		return (-1);
+	}
+	n = le32toh(log->dict->count);
+	e = (tPlogEntry *)((uint8_t *)log->dict + PLOG_BLOCK_HDR_SIZE) + n;
+	ft_bzero(e, sizeof(*e));
+	e->index = htole32(log->entries);
+	ft_memcpy(e->name, name, nameLen);
+	ft_memcpy(e->addr, addr, addrLen);
+	__atomic_store_n(&e->commit, PLOG_COMMIT, __ATOMIC_RELEASE);
+	__atomic_store_n(&log->dict->count, htole32(n + 1), __ATOMIC_RELEASE);
+	return (log->entries++);
+}
+
+/**
+ * @brief Index the dictionary entries already in the file
+ * Entries without their commit byte keep their index but are not found.
+ * @param size - file size
+ * @return 0 on success, -1 with a message on error
+ */
+static int
+plogLoad(tPlog *log, off_t size)
+{
+	uint32_t			blocks = le32toh(log->hdr->blocks);
+	const tPlogBlock	*blk;
+	const tPlogEntry	*e;
+	uint32_t			count;
+
+	if (size > 0 && size < plogBlockOffset(blocks))
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log: file truncated\n");
+		return (-1);
+	}
+	for (uint32_t b = 0; b < blocks; b++)
+	{
+		blk = mmap(NULL, PLOG_BLOCK_SIZE, PROT_READ, MAP_SHARED, log->fd, plogBlockOffset(b));
+		if (blk == MAP_FAILED)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log: %s\n", strerror(errno));
+			return (-1);
+		}
+		if (plogBlockValid(blk, b) && blk->type == PLOG_BLOCK_DICT)
+		{
+			count = plogBlockCount(blk);
+			e = plogBlockEntries(blk);
+			for (uint32_t i = 0; i < count; i++, log->entries++)
+			{
+				if (!plogCommitted(&e[i].commit) || le32toh(e[i].index) != log->entries)
+					continue;
+				if (plogKeyAdd(log, log->entries, e[i].name, plogKeyLen(e[i].name, PLOG_NAME_LEN),
+						e[i].addr, plogKeyLen(e[i].addr, PLOG_ADDR_LEN)) != 0)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log: %s\n", strerror(ENOMEM));
+					munmap((void *)blk, PLOG_BLOCK_SIZE);
+					return (-1);
+				}
+			}
+		}
+		munmap((void *)blk, PLOG_BLOCK_SIZE);
+	}
+	return (0);
+}
+
+/**
+ * @brief Write the header of a new file, the magic last
+ */
+static void
+plogInitHeader(tPlogHeader *hdr)
+{
+	struct timespec	now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	ft_bzero(hdr, PLOG_HEADER_SIZE);
+	hdr->version = htole32(PLOG_VERSION);
+	hdr->headerSize = htole32(PLOG_HEADER_SIZE);
+	hdr->blockSize = htole32(PLOG_BLOCK_SIZE);
+	hdr->recordSize = htole32(sizeof(tPlogRecord));
+	hdr->entrySize = htole32(sizeof(tPlogEntry));
+	hdr->createdNs = htole64((uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec);
+	__atomic_store_n(&hdr->magic, htole32(PLOG_MAGIC), __ATOMIC_RELEASE);
+}
+
+int
+plogOpen(tPlog *log, const char *path)
+{
+	struct stat	st;
+	void		*map;
+	int			err;
+
+	ft_bzero(log, sizeof(*log));
+	log->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (log->fd < 0 || flock(log->fd, LOCK_EX | LOCK_NB) != 0 || fstat(log->fd, &st) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log %s: %s\n", path,
+			errno == EWOULDBLOCK ? "in use by another run" : strerror(errno));
+		if (log->fd >= 0)
+			close(log->fd);
+		log->fd = -1;
+		return (-1);
+	}
+	map = MAP_FAILED;
+	err = st.st_size == 0 ? posix_fallocate(log->fd, 0, PLOG_HEADER_SIZE) : 0;
+	if (err == 0)
+		map = mmap(NULL, PLOG_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, log->fd, 0);
+	else
+		errno = err;
+	if (map == MAP_FAILED || (st.st_size > 0
+		&& (st.st_size < PLOG_HEADER_SIZE || !plogHeaderMatches(map))))
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": probe log %s: %s\n", path,
+			map == MAP_FAILED ? strerror(errno) : "not a probe log of version 1");
+		if (map != MAP_FAILED)
+			munmap(map, PLOG_HEADER_SIZE);
+		close(log->fd);
+		log->fd = -1;
+		return (-1);
+	}
+	log->hdr = map;
+	if (st.st_size == 0)
+		plogInitHeader(log->hdr);
+	if (plogLoad(log, st.st_size) != 0)
+	{
+		plogClose(log, 0);
+		return (-1);
+	}
+	return (0);
+}
+
+void
+plogProbe(tPlog *log, const tOutputProbe *probe)
+{
+	struct timespec	now;
+	uint64_t		ts;
+	int64_t			target;
+	uint32_t		n;
+	tPlogRecord		*rec;
+
+	if (!log || log->failed)
+		return;
+	target = plogTarget(log, probe->target ? probe->target : "", probe->addr ? probe->addr : "");
+	if (target < 0)
+	{
+		log->failed = TRUE;
+		return;
+	}
+	if (!log->recs || le32toh(log->recs->count) == PLOG_RECORDS_PER_BLOCK)
+	{
+		plogUnmap(log->recs, MS_ASYNC);
+		log->recs = plogAddBlock(log, PLOG_BLOCK_RECORDS);
+		if (!log->recs)
+			return;
+	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	ts = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	n = le32toh(log->recs->count);
+	rec = (tPlogRecord *)((uint8_t *)log->recs + PLOG_BLOCK_HDR_SIZE) + n;
+	ft_bzero(rec, sizeof(*rec));
+	rec->tsNs = htole64(ts);
+	rec->target = htole32((uint32_t)target);
+	rec->seq = htole16((uint16_t)probe->seq);
+	rec->status = (uint8_t)probe->status;
+	if (probe->rttNs >= 0)
+	{
+		rec->rttNs = htole64((uint64_t)probe->rttNs);
+		rec->flags |= PLOG_HAVE_RTT;
+	}
+	if (probe->ttl >= 0)
+	{
+		rec->ttl = (uint8_t)probe->ttl;
+		rec->flags |= PLOG_HAVE_TTL;
+	}
+	if (probe->size >= 0)
+	{
+		rec->size = htole16(probe->size > UINT16_MAX ? UINT16_MAX : (uint16_t)probe->size);
+		rec->flags |= PLOG_HAVE_SIZE;
+	}
+	if (probe->errType >= 0)
+	{
+		rec->errType = (uint8_t)probe->errType;
+		rec->errCode = (uint8_t)probe->errCode;
+		rec->flags |= PLOG_HAVE_ERROR;
+	}
+	__atomic_store_n(&rec->commit, PLOG_COMMIT, __ATOMIC_RELEASE);
+	if (n == 0)
+		log->recs->firstNs = htole64(ts);
+	log->recs->lastNs = htole64(ts);
+	__atomic_store_n(&log->recs->count, htole32(n + 1), __ATOMIC_RELEASE);
+	log->records++;
+}
+
+void
+plogClose(tPlog *log, int verbose)
+{
+	if (!log || log->fd < 0)
+		return;
+	plogUnmap(log->dict, MS_SYNC);
+	plogUnmap(log->recs, MS_SYNC);
+	if (log->hdr)
+	{
+		msync(log->hdr, PLOG_HEADER_SIZE, MS_SYNC);
+		munmap(log->hdr, PLOG_HEADER_SIZE);
+	}
+	if (verbose > 0)
+		printf("probe log: %lu records, %u targets\n", log->records, log->entries);
+	for (size_t i = 0; i < log->keyCap; i++)
+		free(log->keys[i].key);
+	free(log->keys);
+	close(log->fd);
+	ft_bzero(log, sizeof(*log));
+	log->fd = -1;
+}
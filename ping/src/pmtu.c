@@ -0,0 +1,424 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/pingUtils.h"
+#include "../includes/pmtu.h"
+#include "../includes/socket.h"
+
+/**
+ * @brief Search state shared by the helpers below
+ * - ctx: ping context
+ * - packet: heap buffer large enough for PMTU_MAX_SIZE
+ * - probes / count: probes of the current round
+ * - ipHdrLen: IP header size (20 or 40) subtracted from probe sizes
+ * - srttMs: smoothed RTT, used to size the round wait (0 until known)
+ * - res: result being built
+ */
+typedef struct sPmtuSearch
+{
+	tPingContext	*ctx;
+	unsigned char	*packet;
+	tPmtuProbe		probes[PMTU_PROBES_PER_ROUND + 1];
+	int				count;
+	uint32_t		ipHdrLen;
+	double			srttMs;
+	tPmtuResult		res;
+} tPmtuSearch;
+
+static tPmtuProbe
+*pmtuFindProbe(tPmtuSearch *search, uint16_t seq)
+{
+	for (int i = 0; i < search->count; i++)
+		if (search->probes[i].seq == seq)
+			return (&search->probes[i]);
+	return (NULL);
+}
+
+/**
+ * @brief Drain the error queue: frag-needed / packet-too-big and local EMSGSIZE
+ * @param search - search state
+ * @param localFail - probe whose send just failed with EMSGSIZE (may be NULL)
+ */
+static void
+pmtuReadErrors(tPmtuSearch *search, tPmtuProbe *localFail)
+{
+	tPingContext				*ctx = search->ctx;
+	unsigned char				data[128];
+	unsigned char				cmsgbuf[512];
+	struct sockaddr_storage		name;
+	struct msghdr				msg;
+	struct iovec				iov;
+	struct cmsghdr				*c;
+	struct sock_extended_err	*err;
+	const unsigned char			*icmp;
+	tPmtuProbe					*probe;
+	ssize_t						n;
+
+	while (1)
+	{
+		iov.iov_base = data;
+		iov.iov_len = sizeof(data);
+		ft_bzero(&msg, sizeof(msg));
+		msg.msg_name = &name;
+		msg.msg_namelen = sizeof(name);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsgbuf;
+		msg.msg_controllen = sizeof(cmsgbuf);
+		n = recvmsg(ctx->sock.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+		if (n < 0)
+			return;
+		for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+		{
+			if (!(c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+				&& !(c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))
+				continue;
+			err = (struct sock_extended_err *)CMSG_DATA(c);
+			if (err->ee_origin == SO_EE_ORIGIN_LOCAL)
+			{
+				if (err->ee_errno == EMSGSIZE && localFail)
+					localFail->reportedMtu = err->ee_info;
+				continue;
+			}
+			if (err->ee_origin != SO_EE_ORIGIN_ICMP && err->ee_origin != SO_EE_ORIGIN_ICMP6)
+				continue;
+			if (!(err->ee_origin == SO_EE_ORIGIN_ICMP
+					&& err->ee_type == ICMP4_DEST_UNREACH && err->ee_code == ICMP4_FRAG_NEEDED)
+				&& !(err->ee_origin == SO_EE_ORIGIN_ICMP6 && err->ee_type == ICMP6_PACKET_TOO_BIG))
+				continue;
+			/* the quoted probe starts with its ICMP header (IP header for hdrincl raw sockets) */
+			icmp = data;
+			if (ctx->sock.family == AF_INET && n >= 20 && (data[0] >> 4) == 4)
+				icmp = data + (data[0] & 0x0F) * 4;
+			if (icmp + ICMP4_HDR_LEN > data + n)
+				continue;
+			probe = pmtuFindProbe(search, (uint16_t)((icmp[6] << 8) | icmp[7]));
+			if (!probe)
+				continue;
+			probe->state = PMTU_PROBE_TOO_BIG;
+			probe->reportedMtu = err->ee_info;
+			if (c->cmsg_level == SOL_IPV6)
+				ft_memcpy(&search->res.reporter, SO_EE_OFFENDER(err), sizeof(struct sockaddr_in6));
+			else
+				ft_memcpy(&search->res.reporter, SO_EE_OFFENDER(err), sizeof(struct sockaddr_in));
+			search->res.haveReporter = TRUE;
+		}
+	}
+}
+
+/**
+ * @brief Send one DF echo request whose IP packet is exactly probe->size bytes
+ * @param search - search state
+ * @param probe - probe to send (size set by the caller)
+ */
+static void
+pmtuSendProbe(tPmtuSearch *search, tPmtuProbe *probe)
+{
+	tPingContext	*ctx = search->ctx;
+	uint32_t		payloadLen;
+	uint32_t		packetLen;
+	unsigned char	*payload;
+	ssize_t			sent;
+
+	payloadLen = probe->size - search->ipHdrLen - ICMP4_HDR_LEN;
+	payload = search->packet + PMTU_MAX_SIZE;
+	probe->seq = (uint16_t)ctx->seq++;
+	probe->state = PMTU_PROBE_PENDING;
+	probe->reportedMtu = 0;
+
+	if (ctx->sock.family == AF_INET6)
+		packetLen = buildIcmpv6EchoRequest((tIcmp6Echo *)search->packet, PMTU_MAX_SIZE,
+			(uint16_t)ctx->pid, probe->seq, payload, payloadLen,
+			NULL, &((struct sockaddr_in6 *)&ctx->targetAddr)->sin6_addr, 0);
+	else
+		packetLen = buildIcmpv4EchoRequest((tIcmp4Echo *)search->packet, PMTU_MAX_SIZE,
+			(uint16_t)ctx->pid, probe->seq, payload, payloadLen);
+	if (packetLen == 0)
+	{
+		probe->state = PMTU_PROBE_TOO_BIG;
+		return;
+	}
+
+	gettimeofday(&probe->sentAt, NULL);
+	if (ctx->sock.privilege == SOCKET_PRIV_USER)
+		sent = send(ctx->sock.fd, search->packet, packetLen, 0);
+	else
+		sent = sendto(ctx->sock.fd, search->packet, packetLen, 0,
+			(struct sockaddr *)&ctx->targetAddr, ctx->addrLen);
+	search->res.probes++;
+	ctx->stats.sent++;
+	if (sent >= 0)
+		return;
+	if (errno == EMSGSIZE)
+	{
+		/* larger than the local route MTU: the kernel queues the MTU as a local error */
+		probe->state = PMTU_PROBE_TOO_BIG;
+		pmtuReadErrors(search, probe);
+		return;
+	}
+	probe->state = PMTU_PROBE_LOST;
+	if (ctx->opts.verbose > 1)
+		ft_dprintf(STDERR_FILENO, "sendto failed: %s (%d)\n", strerror(errno), errno);
+}
+
+/**
+ * @brief Read one echo reply and settle the matching probe
+ * @param search - search state
+ */
+static void
+pmtuReceive(tPmtuSearch *search)
+{
+	tPingContext			*ctx = search->ctx;
+	struct sockaddr_storage	from;
+	socklen_t				fromLen = sizeof(from);
+	const unsigned char		*icmp;
+	unsigned char			*buf;
+	tPmtuProbe				*probe;
+	struct timeval			now;
+	tIpHdr					ip4;
+	size_t					ipLen;
+	ssize_t					n;
+	double					ms;
+
+	/* the send buffer is free while waiting, reuse it to receive */
+	buf = search->packet;
+	n = recvfrom(ctx->sock.fd, buf, PMTU_MAX_SIZE, MSG_DONTWAIT, (struct sockaddr *)&from, &fromLen);
+	if (n <= 0)
+		return;
+	icmp = buf;
+	if (ctx->sock.family == AF_INET && ctx->sock.privilege == SOCKET_PRIV_RAW)
+	{
+		ipLen = parseIpHeaderFromBuffer(buf, (size_t)n, &ip4);
+		if (ipLen == 0)
+			return;
+		icmp += ipLen;
+		n -= ipLen;
+	}
+	if (n < ICMP4_HDR_LEN)
+		return;
+	if (icmp[0] != (ctx->sock.family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+		return;
+	if (ctx->sock.privilege == SOCKET_PRIV_RAW
+		&& (uint16_t)((icmp[4] << 8) | icmp[5]) != (uint16_t)ctx->pid)
+		return;
+	probe = pmtuFindProbe(search, (uint16_t)((icmp[6] << 8) | icmp[7]));
+	if (!probe || probe->state != PMTU_PROBE_PENDING)
+		return;
+	probe->state = PMTU_PROBE_OK;
+	ctx->stats.received++;
+
+	gettimeofday(&now, NULL);
+	ms = (now.tv_sec - probe->sentAt.tv_sec) * 1000.0
+		+ (now.tv_usec - probe->sentAt.tv_usec) / 1000.0;
+	if (search->srttMs == 0.0)
+		search->srttMs = ms;
+	else
+		search->srttMs += (ms - search->srttMs) / 8.0;
+}
+
+/**
+ * @brief Wait until every probe of the round settled or the round deadline passed
+ * @param search - search state
+ * @param waitMs - maximum wait in milliseconds
+ */
+static void
+pmtuWaitRound(tPmtuSearch *search, double waitMs)
+{
+	tPingContext	*ctx = search->ctx;
+	struct timeval	deadline, now, wait, span;
+	fd_set			fdset;
+	int				pending;
+
+	gettimeofday(&now, NULL);
+	timevalFromDouble(&span, waitMs / 1000.0);
+	timeradd(&now, &span, &deadline);
+	while (!g_pingInterrupted)
+	{
+		pending = 0;
+		for (int i = 0; i < search->count; i++)
+			if (search->probes[i].state == PMTU_PROBE_PENDING)
+				pending++;
+		if (pending == 0)
+			return;
+		gettimeofday(&now, NULL);
+		if (!timercmp(&now, &deadline, <))
+			break;
+		timersub(&deadline, &now, &wait);
+		FD_ZERO(&fdset);
+		FD_SET(ctx->sock.fd, &fdset);
+		if (select(ctx->sock.fd + 1, &fdset, NULL, NULL, &wait) < 0)
+		{
+			if (errno == EINTR)
+				break;
+			ft_dprintf(STDERR_FILENO, "select failed: %s\n", strerror(errno));
+			break;
+		}
+		if (FD_ISSET(ctx->sock.fd, &fdset))
+		{
+			pmtuReadErrors(search, NULL);
+			pmtuReceive(search);
+		}
+	}
+	for (int i = 0; i < search->count; i++)
+		if (search->probes[i].state == PMTU_PROBE_PENDING)
+			search->probes[i].state = PMTU_PROBE_LOST;
+}
+
+/**
+ * @brief Fold the round outcome into the [lo, hi] bounds
+ * @param search - search state
+ */
+static void
+pmtuUpdateBounds(tPmtuSearch *search)
+{
+	tPmtuResult	*res = &search->res;
+	uint32_t	bound;
+
+	for (int i = 0; i < search->count; i++)
+	{
+		tPmtuProbe	*probe = &search->probes[i];
+
+		if (probe->state == PMTU_PROBE_OK)
+		{
+			if (probe->size > res->mtu)
+				res->mtu = probe->size;
+			if (probe->size > res->lo)
+				res->lo = probe->size;
+			continue;
+		}
+		bound = probe->size - 1;
+		if (probe->state == PMTU_PROBE_TOO_BIG
+			&& probe->reportedMtu > 0 && probe->reportedMtu < probe->size)
+			bound = probe->reportedMtu;
+		if (bound < res->hi)
+		{
+			res->hi = bound;
+			res->blackHole = (probe->state == PMTU_PROBE_LOST);
+		}
+	}
+	if (res->hi < res->lo)
+		res->hi = res->lo;
+}
+
+static void
+pmtuPrintRound(const tPmtuSearch *search)
+{
+	static const char	*names[] = {"pending", "ok", "too big", "lost"};
+
+	ft_printf("round %u:", search->res.rounds);
+	for (int i = 0; i < search->count; i++)
+	{
+		ft_printf(" %u(%s", search->probes[i].size, names[search->probes[i].state]);
+		if (search->probes[i].reportedMtu)
+			ft_printf(", mtu %u", search->probes[i].reportedMtu);
+		ft_printf(")");
+	}
+	ft_printf(" -> [%u, %u]\n", search->res.lo, search->res.hi);
+}
+
+static void
+pmtuPrintResult(const tPmtuSearch *search)
+{
+	const tPmtuResult	*res = &search->res;
+	char				ip[INET6_ADDRSTRLEN];
+
+	ft_printf("\n--- %s " PROG_NAME " path MTU ---\n", search->ctx->targetHost);
+	if (res->mtu == 0)
+	{
+		ft_printf("no echo reply received, path MTU unknown (%u probes)\n", res->probes);
+		return;
+	}
+	ft_printf("path MTU %u bytes (%u data bytes), %u rounds, %u probes\n",
+		res->mtu, res->mtu - search->ipHdrLen - ICMP4_HDR_LEN, res->rounds, res->probes);
+	if (res->haveReporter)
+	{
+		if (res->reporter.ss_family == AF_INET6)
+			inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&res->reporter)->sin6_addr, ip, sizeof(ip));
+		else
+			inet_ntop(AF_INET, &((struct sockaddr_in *)&res->reporter)->sin_addr, ip, sizeof(ip));
+		ft_printf("%s reported by %s\n",
+			res->reporter.ss_family == AF_INET6 ? "packet too big" : "fragmentation needed", ip);
+	}
+	if (res->blackHole && res->mtu == res->hi)
+		ft_printf("larger probes were dropped silently: possible PMTU black hole above %u bytes\n",
+			res->mtu);
+}
+
+void
+runPmtuDiscovery(tPingContext *ctx)
+{
+	tPmtuSearch	search;
+	uint32_t	minMtu;
+	uint32_t	span;
+	int			routeMtu;
+	int			k;
+	double		waitMs;
+
+	if (!ctx)
+		return;
+	if (socketApplyPmtuOptions(&ctx->sock) != 0)
+		return;
+	ft_bzero(&search, sizeof(search));
+	search.ctx = ctx;
+	/* packet buffer followed by a pattern-filled payload template */
+	search.packet = malloc(PMTU_MAX_SIZE * 2);
+	if (!search.packet)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return;
+	}
+	for (uint32_t i = 0; i < PMTU_MAX_SIZE; i++)
+		search.packet[PMTU_MAX_SIZE + i] = ctx->opts.patternLen > 0
+			? (unsigned char)ctx->opts.pattBytes[i % ctx->opts.patternLen] : 0;
+
+	search.ipHdrLen = ctx->sock.family == AF_INET6 ? 40 : 20;
+	minMtu = ctx->sock.family == AF_INET6 ? PMTU_MIN_V6 : PMTU_MIN_V4;
+	routeMtu = socketRouteMtu(&ctx->targetAddr, ctx->addrLen);
+	search.res.lo = minMtu;
+	search.res.hi = routeMtu > (int)minMtu ? (uint32_t)routeMtu : PMTU_MAX_SIZE;
+	if (search.res.hi > PMTU_MAX_SIZE)
+		search.res.hi = PMTU_MAX_SIZE;
+	ctx->seq = 0;
+	pingStatsReset(&ctx->stats);
+	signal(SIGINT, handleSigInt);
+
+	ft_printf(PROG_NAME " %s (%s): path MTU discovery, %u..%u bytes, DF set\n",
+		ctx->targetHost, ctx->resolvedIp, search.res.lo, search.res.hi);
+
+	waitMs = (ctx->opts.linger > 0 ? ctx->opts.linger : 1) * 1000.0;
+	while (!g_pingInterrupted && search.res.rounds < PMTU_MAX_ROUNDS
+		&& (search.res.mtu == 0 || search.res.lo < search.res.hi))
+	{
+		search.count = 0;
+		/* the first round also confirms the minimum size gets through */
+		if (search.res.mtu == 0)
+			search.probes[search.count++].size = search.res.lo;
+		span = search.res.hi - search.res.lo;
+		k = span < PMTU_PROBES_PER_ROUND ? (int)span : PMTU_PROBES_PER_ROUND;
+		for (int i = 1; i <= k; i++)
+			search.probes[search.count++].size = search.res.lo + (span * i + k - 1) / k;
+
+		for (int i = 0; i < search.count; i++)
+			pmtuSendProbe(&search, &search.probes[i]);
+		pmtuWaitRound(&search, waitMs);
+		search.res.rounds++;
+		pmtuUpdateBounds(&search);
+		if (ctx->opts.verbose > 0)
+			pmtuPrintRound(&search);
+		if (search.res.mtu == 0)
+			break;
+		/* once the path answers, a round only needs a few RTTs */
+		waitMs = search.srttMs * 4.0;
+		if (waitMs < PMTU_MIN_WAIT_MS)
+			waitMs = PMTU_MIN_WAIT_MS;
+	}
+	pmtuPrintResult(&search);
+	free(search.packet);
+}
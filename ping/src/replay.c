@@ -0,0 +1,466 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/ping.h"
+#include "../includes/pingUtils.h"
+#include "../includes/replay.h"
+
+/**
+ * @brief Key of a responder: address and the identifier of its requests
+ */
+static void
+replayKey(tTargetKey *key, int family, const uint8_t *addr, const uint8_t *icmp)
+{
+	ft_bzero(key, sizeof(*key));
+	ft_memcpy(key->addr, addr, family == AF_INET6 ? 16 : 4);
+	key->family = (uint8_t)family;
+	key->ident = (uint16_t)((icmp[4] << 8) | icmp[5]);
+}
+
+/**
+ * @brief Settle the oldest request of responder i: lost if still unanswered
+ */
+static void
+replayRetire(tReplay *rp, size_t i)
+{
+	tTargetTable	*t = &rp->table;
+	uint32_t		seq = t->oldest[i];
+
+	if (!targetTableRetire(t, i))
+		return;
+	t->stats[i].lost++;
+	rp->inflight--;
+	if (rp->opts->verbose > 1)
+		ft_printf("No reply from %s: icmp_seq=%u\n", t->ip[i], (uint16_t)seq);
+}
+
+/**
+ * @brief Settle the requests of responder i answered or timed out by nowNs
+ */
+static void
+replayExpire(tReplay *rp, size_t i, uint64_t nowNs)
+{
+	tTargetTable	*t = &rp->table;
+
+	while (t->oldest[i] != t->seq[i]
+		&& (!(t->unacked[i] & 1) || t->first[i]->sentNs + rp->waitNs <= nowNs))
+		replayRetire(rp, i);
+}
+
+/**
+ * @brief An echo request: one more probe sent to its destination
+ * Sequences missing from the capture hold a record that is never
+ * counted, so that records stay aligned on the sequence numbers.
+ */
+static void
+replayRequest(tReplay *rp, int family, const uint8_t *dst, const uint8_t *icmp, uint64_t nowNs)
+{
+	tTargetTable	*t = &rp->table;
+	tTargetKey		key;
+	uint16_t		seq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+	uint32_t		ext;
+	size_t			i;
+
+	replayKey(&key, family, dst, icmp);
+	i = targetTableFind(t, &key);
+	if (i == TABLE_NONE)
+	{
+		i = targetTableAdd(t, &key, 0, NULL);
+		if (i == TABLE_NONE)
+		{
+			rp->skipped++;
+			return;
+		}
+		t->seq[i] = seq;
+		t->oldest[i] = seq;
+	}
+	ext = t->seq[i] + (uint32_t)(int32_t)(int16_t)(seq - (uint16_t)t->seq[i]);
+	/* retransmitted or reordered by the capture: already counted */
+	if ((int32_t)(ext - t->seq[i]) < 0)
+	{
+		rp->skipped++;
+		return;
+	}
+	replayExpire(rp, i, nowNs);
+	if (ext - t->seq[i] >= TABLE_WINDOW)
+	{
+		while (t->oldest[i] != t->seq[i])
+			replayRetire(rp, i);
+		t->seq[i] = ext;
+		t->oldest[i] = ext;
+	}
+	while (t->seq[i] != ext)
+	{
+		if (targetTableProbe(t, i, 0) != 0)
+			return;
+		t->seq[i]++;
+	}
+	while (t->seq[i] - t->oldest[i] >= TABLE_WINDOW)
+		replayRetire(rp, i);
+	if (targetTableProbe(t, i, nowNs) != 0)
+		return;
+	t->unacked[i] |= 1ULL << (t->seq[i] - t->oldest[i]);
+	t->seq[i]++;
+	t->stats[i].sent++;
+	rp->inflight++;
+}
+
+/**
+ * @brief An echo reply: matched to its responder, timed against its request
+ * @param ok - the checksum is right (or the packet was truncated by the capture)
+ */
+static void
+replayReply(
+	tReplay			*rp,
+	int				family,
+	const uint8_t	*src,
+	const uint8_t	*icmp,
+	size_t			icmpLen,
+	uint8_t			ttl,
+	uint64_t		nowNs,
+	tBool			ok)
+{
+	tTargetTable	*t = &rp->table;
+	tTargetKey		key;
+	tReplyMark		mark;
+	uint16_t		seq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+	uint32_t		ext;
+	tBool			haveRtt = FALSE;
+	double			ms = 0.0;
+	size_t			i;
+
+	replayKey(&key, family, src, icmp);
+	i = targetTableFind(t, &key);
+	if (i == TABLE_NONE)
+	{
+		rp->unmatched++;
+		return;
+	}
+	if (!ok)
+	{
+		t->stats[i].corrupted++;
+		if (rp->opts->verbose > 1)
+			ft_printf("Ignoring corrupted echo reply from %s: icmp_seq=%u\n", t->ip[i], seq);
+		return;
+	}
+	/* a reply later than -W finds its request lost, as it would live */
+	replayExpire(rp, i, nowNs);
+	ext = t->seq[i] + (uint32_t)(int32_t)(int16_t)(seq - (uint16_t)t->seq[i]);
+	mark = targetTableMark(t, i, ext);
+	if (mark == REPLY_STALE)
+	{
+		if (rp->opts->verbose > 1)
+			ft_printf("Ignoring late echo reply from %s: icmp_seq=%u\n", t->ip[i], seq);
+		return;
+	}
+	t->stats[i].received++;
+	if (mark == REPLY_NEW && ext - t->oldest[i] < TABLE_WINDOW
+		&& (t->unacked[i] & (1ULL << (ext - t->oldest[i]))))
+	{
+		tProbeRecord	*rec = t->first[i];
+
+		for (uint32_t n = ext - t->oldest[i]; n > 0; n--)
+			rec = rec->next;
+		ms = nowNs > rec->sentNs ? (double)(nowNs - rec->sentNs) / 1000000.0 : 0.0;
+		haveRtt = TRUE;
+		targetTableAck(t, i, ext);
+		rp->inflight--;
+	}
+	if (mark == REPLY_DUP)
+		t->stats[i].duplicates++;
+	else if (haveRtt)
+	{
+		pingStatsAddRtt(&t->stats[i], ms);
+		rttHistAdd(&t->hist[i], ms);
+		rttJitterAdd(&t->jitter[i], ms);
+	}
+	if (rp->opts->quiet || rp->opts->flood)
+		return;
+	ft_printf("%u bytes from %s: icmp_seq=%u ttl=%u",
+		(unsigned int)icmpLen, t->ip[i], seq, ttl);
+	if (haveRtt)
+		ft_printf(" time=%.3f ms", ms);
+	if (mark == REPLY_DUP)
+		ft_printf(" (DUP!)");
+	ft_printf("\n");
+}
+
+/**
+ * @brief An ICMP error quoting a captured request: charged to its destination
+ * @param from - address of the router or host that sent the error
+ */
+static void
+replayError(
+	tReplay			*rp,
+	int				family,
+	const uint8_t	*from,
+	const uint8_t	*icmp,
+	size_t			icmpLen)
+{
+	const uint8_t			*quoted = icmp + 8;
+	size_t					len = icmpLen - 8;
+	struct sockaddr_storage	sender;
+	tTargetKey				key;
+	tIpHdr					ip4;
+	tIp6Hdr					ip6;
+	size_t					hdrLen;
+	uint16_t				seq;
+	uint32_t				ext;
+	size_t					i;
+
+	if (family == AF_INET6)
+	{
+		hdrLen = parseIp6HeaderFromBuffer(quoted, len, &ip6);
+		if (hdrLen == 0 || len < hdrLen + ICMP6_HDR_LEN || ip6.next_header != IP_PROTO_ICMPV6
+			|| quoted[hdrLen] != ICMP6_ECHO_REQUEST)
+			return;
+		replayKey(&key, family, quoted + 24, quoted + hdrLen);
+	}
+	else
+	{
+		hdrLen = parseIpHeaderFromBuffer(quoted, len, &ip4);
+		if (hdrLen == 0 || len < hdrLen + ICMP4_HDR_LEN || ip4.protocol != IP_PROTO_ICMP
+			|| quoted[hdrLen] != ICMP4_ECHO_REQUEST)
+			return;
+		replayKey(&key, family, quoted + 16, quoted + hdrLen);
+	}
+	i = targetTableFind(&rp->table, &key);
+	if (i == TABLE_NONE)
+	{
+		rp->unmatched++;
+		return;
+	}
+	rp->table.stats[i].errors++;
+	/* no reply will come: the request is lost now rather than after -W */
+	seq = (uint16_t)((quoted[hdrLen + 6] << 8) | quoted[hdrLen + 7]);
+	ext = rp->table.seq[i] + (uint32_t)(int32_t)(int16_t)(seq - (uint16_t)rp->table.seq[i]);
+	if (targetTableAck(&rp->table, i, ext))
+	{
+		rp->table.stats[i].lost++;
+		rp->inflight--;
+	}
+	if (rp->opts->quiet)
+		return;
+	ft_bzero(&sender, sizeof(sender));
+	sender.ss_family = (sa_family_t)family;
+	if (family == AF_INET6)
+		ft_memcpy(&((struct sockaddr_in6 *)&sender)->sin6_addr, from, 16);
+	else
+		ft_memcpy(&((struct sockaddr_in *)&sender)->sin_addr, from, 4);
+	printInvalidIcmpError(&sender, icmp, icmpLen, TRUE);
+}
+
+/**
+ * @brief Whether an ICMP type is an error that quotes the request
+ */
+static tBool
+replayIsError(int family, uint8_t type)
+{
+	if (family == AF_INET6)
+		return (type == ICMP6_DEST_UNREACH || type == ICMP6_TIME_EXCEEDED
+			|| type == ICMP6_PACKET_TOO_BIG);
+	return (type == ICMP4_DEST_UNREACH || type == ICMP4_TIME_EXCEEDED);
+}
+
+/**
+ * @brief Parse one captured packet and hand its ICMP message on
+ */
+static void
+replayPacket(tReplay *rp, const tPcapPacket *pkt)
+{
+	const uint8_t	*ip;
+	const uint8_t	*icmp;
+	const uint8_t	*src;
+	const uint8_t	*dst;
+	uint32_t		len;
+	size_t			hdrLen;
+	size_t			icmpLen;
+	uint8_t			ttl;
+	int				family;
+	tBool			ok;
+	tIpHdr			ip4;
+	tIp6Hdr			ip6;
+
+	ip = pcapNetwork(pkt, &len);
+	if (!ip)
+	{
+		rp->skipped++;
+		return;
+	}
+	if ((ip[0] >> 4) == 4)
+	{
+		hdrLen = parseIpHeaderFromBuffer(ip, len, &ip4);
+		/* fragments: the reassembled message is not in the capture */
+		if (rp->opts->v6 || hdrLen == 0 || ip4.protocol != IP_PROTO_ICMP
+			|| ((ip[6] << 8 | ip[7]) & 0x3FFF) != 0)
+		{
+			rp->skipped++;
+			return;
+		}
+		/* Ethernet pads short frames: the IP length is the real end */
+		if ((uint32_t)(ip[2] << 8 | ip[3]) >= hdrLen && (uint32_t)(ip[2] << 8 | ip[3]) < len)
+			len = (uint32_t)(ip[2] << 8 | ip[3]);
+		family = AF_INET;
+		src = ip + 12;
+		dst = ip + 16;
+		ttl = ip4.ttl;
+	}
+	else
+	{
+		hdrLen = parseIp6HeaderFromBuffer(ip, len, &ip6);
+		if (rp->opts->v4 || hdrLen == 0 || ip6.next_header != IP_PROTO_ICMPV6)
+		{
+			rp->skipped++;
+			return;
+		}
+		if (PING_IP6_HDR_LEN + (uint32_t)ip6.payload_len < len)
+			len = PING_IP6_HDR_LEN + ip6.payload_len;
+		family = AF_INET6;
+		src = ip + 8;
+		dst = ip + 24;
+		ttl = ip6.hop_limit;
+	}
+	if (len < hdrLen + ICMP4_HDR_LEN)
+	{
+		rp->skipped++;
+		return;
+	}
+	icmp = ip + hdrLen;
+	icmpLen = len - hdrLen;
+	if (icmp[0] != (family == AF_INET6 ? ICMP6_ECHO_REQUEST : ICMP4_ECHO_REQUEST)
+		&& icmp[0] != (family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY)
+		&& !replayIsError(family, icmp[0]))
+	{
+		rp->skipped++;
+		return;
+	}
+	rp->icmp++;
+	if (icmp[0] == (family == AF_INET6 ? ICMP6_ECHO_REQUEST : ICMP4_ECHO_REQUEST))
+		replayRequest(rp, family, dst, icmp, pkt->tsNs);
+	else if (icmp[0] == (family == AF_INET6 ? ICMP6_ECHO_REPLY : ICMP4_ECHO_REPLY))
+	{
+		/* a truncated capture cannot be checked */
+		ok = pkt->capLen < pkt->origLen;
+		if (!ok && family == AF_INET6)
+			ok = icmpv6Checksum((const struct in6_addr *)src, (const struct in6_addr *)dst,
+				icmp, (uint32_t)icmpLen) == 0;
+		else if (!ok)
+			ok = icmpChecksum(icmp, (uint32_t)icmpLen) == 0;
+		replayReply(rp, family, src, icmp, icmpLen, ttl, pkt->tsNs, ok);
+	}
+	else
+		replayError(rp, family, src, icmp, icmpLen);
+}
+
+/**
+ * @brief Settle what is left once the capture ends
+ * Requests still within -W of the last packet may have been answered
+ * after the capture stopped: they are not counted as sent.
+ */
+static void
+replayFinish(tReplay *rp)
+{
+	tTargetTable	*t = &rp->table;
+
+	for (size_t i = 0; i < t->count; i++)
+	{
+		replayExpire(rp, i, rp->lastNs);
+		for (uint32_t n = 0; n < t->seq[i] - t->oldest[i]; n++)
+		{
+			if (t->unacked[i] & (1ULL << n))
+				t->stats[i].sent--;
+		}
+	}
+}
+
+/**
+ * @brief Print the statistics of responder i
+ */
+static void
+printReplayTarget(const tReplay *rp, size_t i)
+{
+	const tPingStats	*s = &rp->table.stats[i];
+
+	printf("%s id 0x%04x: %u packets transmitted, %u received, %.0f%% packet loss",
+		rp->table.ip[i], rp->table.keys[i].ident, s->sent, s->received, pingStatsLoss(s));
+	if (s->errors > 0)
+		printf(" +%u errors", s->errors);
+	if (s->duplicates > 0)
+		printf(" ++%u duplicates", s->duplicates);
+	if (s->corrupted > 0)
+		printf(", %u corrupted", s->corrupted);
+	printf("\n");
+	if (s->rttCount > 0)
+		printf("    round-trip min/avg/max/stdev = %.3f/%.3f/%.3f/%.3f ms, jitter %.3f ms, p90 <= %.3f ms\n",
+			s->rttMin, pingStatsAvg(s), s->rttMax, pingStatsStddev(s),
+			rp->table.jitter[i].jitter, rttHistPercentile(&rp->table.hist[i], 90.0));
+}
+
+/**
+ * @brief Per-responder statistics and what the replay cost
+ * @param elapsedNs - wall time spent reading and parsing the file
+ */
+static void
+printReplaySummary(const tReplay *rp, uint64_t elapsedNs)
+{
+	const tTargetTable	*t = &rp->table;
+	double				sec = (double)elapsedNs / 1e9;
+
+	printf("\n--- %s " PROG_NAME " replay statistics, %zu address%s ---\n",
+		rp->path, t->count, t->count == 1 ? "" : "es");
+	for (size_t i = 0; i < t->count; i++)
+		printReplayTarget(rp, i);
+	if (rp->unmatched > 0 || rp->inflight > 0)
+		printf("%lu replies and errors without a captured request, "
+			"%lu requests waiting for their reply when the capture ends\n",
+			rp->unmatched, rp->inflight);
+	printf("%lu packets (%lu ICMP, %lu skipped), %.3f s of capture replayed in %.3f s",
+		rp->packets, rp->icmp, rp->skipped,
+		rp->packets > 0 ? (double)(rp->lastNs - rp->firstNs) / 1e9 : 0.0, sec);
+	if (sec > 0.0)
+		printf(", %.0f packets/s, %.1f MB/s", (double)rp->packets / sec, (double)rp->bytes / sec / 1e6);
+	printf("\n");
+	if (rp->opts->verbose > 0 && t->count > 0)
+		printf("memory: %zu KiB for %zu responders, %zu probe records at peak\n",
+			targetTableMemory(t) >> 10, t->count, t->records.peak);
+	fflush(stdout);
+}
+
+int
+runReplay(const tPingOptions *opts, const char *path)
+{
+	tReplay		rp;
+	tPcapReader	rd;
+	tPcapPacket	pkt;
+	uint64_t	startNs;
+	int			ret;
+
+	if (pcapOpen(&rd, path) != 0)
+		return (-1);
+	ft_bzero(&rp, sizeof(rp));
+	ft_bzero(&pkt, sizeof(pkt));
+	rp.opts = opts;
+	rp.path = path;
+	rp.waitNs = (uint64_t)(opts->linger > 0 ? opts->linger : REPLAY_WAIT_DEFAULT) * 1000000000ULL;
+	targetTableInit(&rp.table);
+	ft_printf(PROG_NAME " %s: %s, %zu bytes\n", path, rd.ng ? "pcapng" : "pcap", rd.size);
+	startNs = monotonicNs();
+	while ((ret = pcapNext(&rd, &pkt)) > 0)
+	{
+		if (rp.packets++ == 0)
+			rp.firstNs = pkt.tsNs;
+		rp.lastNs = pkt.tsNs;
+		rp.bytes += pkt.capLen;
+		replayPacket(&rp, &pkt);
+	}
+	if (ret < 0)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: malformed record at offset %zu, replay stops\n",
+			path, rd.off);
+	replayFinish(&rp);
+	printReplaySummary(&rp, monotonicNs() - startNs);
+	targetTableFree(&rp.table);
+	pcapClose(&rd);
+	return (0);
+}
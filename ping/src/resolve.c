@@ -47,18 +47,11 @@ resolveHost(const char				*host,
 	hints.ai_family = AF_INET; // default to IPv4
 #endif
 
-	// If host is an IP literal, getaddrinfo will skip DNS resolution
-	hints.ai_flags |= AI_NUMERICHOST;
-
-	// Attempt resolution
+	// A single lookup: getaddrinfo parses IP literals itself and never
+	// sends them to DNS, a separate AI_NUMERICHOST attempt only costs time
 	ret = getaddrinfo(host, NULL, &hints, &res);
-	if (ret != 0) {
-		// Retry without AI_NUMERICHOST in case it's a hostname
-		hints.ai_flags &= ~AI_NUMERICHOST;
-		ret = getaddrinfo(host, NULL, &hints, &res);
-		if (ret != 0)
-			return ret;
-	}
+	if (ret != 0)
+		return ret;
 
 	// Pick first usable address
 	struct addrinfo *firstUsable = NULL;
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/pingUtils.h"
+#include "../includes/resolver.h"
+
+/**
+ * @brief One asynchronous lookup
+ * - cb: request handed to getaddrinfo_a, must not move while running
+ * - hints: lookup hints referenced by cb
+ * - host: name given by the caller, reported to the callback
+ * - deadlineNs: monotonic time after which the lookup is cancelled
+ * - state: see tResolveState
+ */
+struct sResolveJob
+{
+	struct gaicb	cb;
+	struct addrinfo	hints;
+	const char		*host;
+	uint64_t		deadlineNs;
+	tResolveState	state;
+};
+
+/**
+ * @brief getaddrinfo_a completion thread: wake up the caller's select()
+ */
+static void
+resolverNotify(union sigval value)
+{
+	char	byte = 0;
+
+	(void)!write(value.sival_int, &byte, 1);
+}
+
+int
+resolverInit(
+	tResolver	*res,
+	char		**hosts,
+	size_t		count,
+	tIpType		ipMode,
+	int			limit,
+	int			timeoutSec)
+{
+	size_t	namesLen;
+	char	*name;
+
+	if (!res || (!hosts && count > 0))
+		return (-1);
+	ft_bzero(res, sizeof(*res));
+	res->notify[0] = -1;
+	res->notify[1] = -1;
+	res->limit = limit > 0 ? limit : RESOLVER_DEFAULT_LIMIT;
+	res->timeoutNs = (uint64_t)(timeoutSec > 0 ? timeoutSec : RESOLVER_DEFAULT_TIMEOUT) * 1000000000ULL;
+	res->count = count;
+	namesLen = 1;
+	for (size_t i = 0; i < count; i++)
+		namesLen += ft_strlen(hosts[i]) + 1;
+	res->names = malloc(namesLen);
+	res->jobs = calloc(count ? count : 1, sizeof(*res->jobs));
+	res->active = calloc((size_t)res->limit, sizeof(*res->active));
+	if (!res->names || !res->jobs || !res->active || pipe(res->notify) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": resolver setup failed\n");
+		resolverFree(res);
+		return (-1);
+	}
+	fcntl(res->notify[0], F_SETFL, O_NONBLOCK);
+	fcntl(res->notify[1], F_SETFL, O_NONBLOCK);
+	name = res->names;
+	for (size_t i = 0; i < count; i++)
+	{
+		tResolveJob	*job = &res->jobs[i];
+		size_t		len = ft_strlen(hosts[i]) + 1;
+
+		job->host = hosts[i];
+		ft_memcpy(name, hosts[i], len);
+		/* same hints as resolveHost, a single lookup per host: numeric
+		 * literals never reach the network anyway */
+		job->hints.ai_socktype = SOCK_RAW;
+		job->hints.ai_flags = AI_ADDRCONFIG | AI_CANONNAME;
+		job->hints.ai_family = ipMode == IP_TYPE_V4 ? AF_INET
+			: ipMode == IP_TYPE_V6 ? AF_INET6 : AF_UNSPEC;
+		job->cb.ar_name = name;
+		job->cb.ar_request = &job->hints;
+		name += len;
+	}
+	return (0);
+}
+
+/**
+ * @brief Submit one queued job
+ * @return 0 if submitted, -1 if it failed immediately (already reported)
+ */
+static int
+resolverSubmit(tResolver *res, tResolveJob *job, tResolveCb cb, void *arg)
+{
+	struct gaicb	*list[1];
+	struct sigevent	sev;
+	int				ret;
+
+	list[0] = &job->cb;
+	ft_bzero(&sev, sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD;
+	sev.sigev_notify_function = resolverNotify;
+	sev.sigev_value.sival_int = res->notify[1];
+	job->deadlineNs = monotonicNs() + res->timeoutNs;
+	ret = getaddrinfo_a(GAI_NOWAIT, list, 1, &sev);
+	if (ret != 0)
+	{
+		job->state = RESOLVE_DONE;
+		res->reported++;
+		cb(arg, job->host, NULL, ret);
+		return (-1);
+	}
+	job->state = RESOLVE_RUNNING;
+	return (0);
+}
+
+/**
+ * @brief Check one running job, reporting it if finished or expired
+ * @return TRUE if the job left the running set
+ */
+static tBool
+resolverCheck(tResolver *res, tResolveJob *job, uint64_t now, tResolveCb cb, void *arg)
+{
+	int	err;
+
+	err = gai_error(&job->cb);
+	if (err == EAI_INPROGRESS)
+	{
+		if (now < job->deadlineNs)
+			return (FALSE);
+		/* a lookup already picked by a resolver thread cannot be
+		 * cancelled: report it now and release it when it completes */
+		job->state = gai_cancel(&job->cb) == EAI_CANCELED ? RESOLVE_DONE : RESOLVE_ABANDONED;
+		res->reported++;
+		cb(arg, job->host, NULL, RESOLVE_ERR_TIMEOUT);
+		return (TRUE);
+	}
+	job->state = RESOLVE_DONE;
+	res->reported++;
+	cb(arg, job->host, err == 0 ? job->cb.ar_result : NULL, err);
+	if (job->cb.ar_result)
+		freeaddrinfo(job->cb.ar_result);
+	job->cb.ar_result = NULL;
+	return (TRUE);
+}
+
+size_t
+resolverPoll(tResolver *res, tResolveCb cb, void *arg)
+{
+	char		drain[64];
+	size_t		before;
+	uint64_t	now;
+	size_t		i;
+
+	if (!res || !cb || !res->jobs)
+		return (0);
+	before = res->reported;
+	while (read(res->notify[0], drain, sizeof(drain)) > 0)
+		;
+	now = monotonicNs();
+	i = 0;
+	while (i < res->running)
+	{
+		if (resolverCheck(res, &res->jobs[res->active[i]], now, cb, arg))
+			res->active[i] = res->active[--res->running];
+		else
+			i++;
+	}
+	while (res->next < res->count && res->running < (size_t)res->limit)
+	{
+		size_t	idx = res->next++;
+
+		if (resolverSubmit(res, &res->jobs[idx], cb, arg) == 0)
+			res->active[res->running++] = idx;
+	}
+	return (res->reported - before);
+}
+
+int
+resolverFd(const tResolver *res)
+{
+	return (res ? res->notify[0] : -1);
+}
+
+uint64_t
+resolverNextDeadline(const tResolver *res)
+{
+	uint64_t	now;
+	uint64_t	best = UINT64_MAX;
+
+	if (!res || res->running == 0)
+		return (UINT64_MAX);
+	now = monotonicNs();
+	for (size_t i = 0; i < res->running; i++)
+	{
+		uint64_t	deadline = res->jobs[res->active[i]].deadlineNs;
+		uint64_t	left = deadline > now ? deadline - now : 0;
+
+		if (left < best)
+			best = left;
+	}
+	return (best);
+}
+
+tBool
+resolverFinished(const tResolver *res)
+{
+	return (!res || res->reported >= res->count);
+}
+
+void
+resolverFree(tResolver *res)
+{
+	tBool	busy = FALSE;
+
+	if (!res)
+		return;
+	for (size_t i = 0; res->jobs && i < res->count; i++)
+	{
+		tResolveJob	*job = &res->jobs[i];
+
+		if (job->state == RESOLVE_RUNNING || job->state == RESOLVE_ABANDONED)
+		{
+			if (gai_cancel(&job->cb) != EAI_ALLDONE && gai_error(&job->cb) == EAI_INPROGRESS)
+			{
+				busy = TRUE;
+				continue;
+			}
+		}
+		if (job->cb.ar_result)
+			freeaddrinfo(job->cb.ar_result);
+		job->cb.ar_result = NULL;
+	}
+	free(res->active);
+	res->active = NULL;
+	/* a getaddrinfo_a thread still owns a job and will write to the pipe:
+	 * keep both alive, the process is about to exit anyway */
+	if (busy)
+		return;
+	free(res->jobs);
+	res->jobs = NULL;
+	free(res->names);
+	res->names = NULL;
+	if (res->notify[0] >= 0)
+		close(res->notify[0]);
+	if (res->notify[1] >= 0)
+		close(res->notify[1]);
+	res->notify[0] = -1;
+	res->notify[1] = -1;
+}
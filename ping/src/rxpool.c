@@ -0,0 +1,447 @@
+#include <errno.h>
+#include <linux/if_packet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/ping.h"
+#include "../includes/rxpool.h"
+
+/**
+ * @brief Shard entry of an address, created on first use
+ * @param w - worker owning the shard
+ * @param family - AF_INET or AF_INET6
+ * @param addr - 4 or 16 address bytes
+ * @return entry, NULL if the shard could not grow
+ */
+static tRxShardEntry *
+rxShardEntry(tRxWorker *w, int family, const uint8_t *addr)
+{
+	tTargetKey		key;
+	tRxShardEntry	*entries;
+	size_t			cap;
+	size_t			slot;
+
+	ft_bzero(&key, sizeof(key));
+	ft_memcpy(key.addr, addr, family == AF_INET6 ? 16 : 4);
+	key.ident = w->pool->ident;
+	key.family = (uint8_t)family;
+	for (size_t k = 0; w->cap > 0; k++)
+	{
+		slot = (targetTableHash(&key) + k) & (w->cap - 1);
+		if (w->entries[slot].key.family == 0)
+			break;
+		if (ft_memcmp(&w->entries[slot].key, &key, sizeof(key)) == 0)
+			return (&w->entries[slot]);
+	}
+	if ((w->count + 1) * 2 > w->cap)
+	{
+		cap = w->cap ? w->cap * 2 : RXPOOL_SHARD_INITIAL;
+		entries = calloc(cap, sizeof(*entries));
+		if (!entries)
+			return (NULL);
+		for (size_t i = 0; i < w->cap; i++)
+		{
+			if (w->entries[i].key.family == 0)
+				continue;
+			slot = targetTableHash(&w->entries[i].key) & (cap - 1);
+			while (entries[slot].key.family != 0)
+				slot = (slot + 1) & (cap - 1);
+			entries[slot] = w->entries[i];
+		}
+		free(w->entries);
+		w->entries = entries;
+		w->cap = cap;
+	}
+	slot = targetTableHash(&key) & (w->cap - 1);
+	while (w->entries[slot].key.family != 0)
+		slot = (slot + 1) & (w->cap - 1);
+	w->entries[slot].key = key;
+	w->count++;
+	return (&w->entries[slot]);
+}
+
+/**
+ * @brief Record a reply sequence in the duplicate window of an entry
+ * Same window as targetTableMark.
+ */
+static tReplyMark
+rxShardMark(tRxShardEntry *e, uint32_t seq)
+{
+	int32_t		diff;
+	uint64_t	bit;
+
+	if (e->window == 0)
+	{
+		e->top = seq;
+		e->window = 1;
+		return (REPLY_NEW);
+	}
+	diff = (int32_t)(seq - e->top);
+	if (diff > 0)
+	{
+		e->window = diff >= TABLE_WINDOW ? 1 : (e->window << diff) | 1;
+		e->top = seq;
+		return (REPLY_NEW);
+	}
+	if (-(int64_t)diff >= TABLE_WINDOW)
+		return (REPLY_STALE);
+	bit = 1ULL << -diff;
+	if (e->window & bit)
+		return (REPLY_DUP);
+	e->window |= bit;
+	return (REPLY_NEW);
+}
+
+/**
+ * @brief Authenticate and account an echo reply
+ * @param w - worker
+ * @param family - AF_INET or AF_INET6
+ * @param src - source address bytes of the reply
+ * @param icmp - echo reply (the ring filter checked type and identifier)
+ * @param icmpLen - length of icmp
+ * @param arrivalNs - kernel receive time
+ */
+static void
+rxWorkerReply(tRxWorker *w, int family, const uint8_t *src,
+			  const uint8_t *icmp, size_t icmpLen, uint64_t arrivalNs)
+{
+	const tRxPool	*pool = w->pool;
+	tRxShardEntry	*e;
+	tProbeInfo		probe;
+	uint16_t		seq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+	uint32_t		ext;
+	tBool			haveRtt = FALSE;
+	double			ms = 0.0;
+
+	if (pool->stampLen > 0)
+	{
+		if (probeHeaderRead(icmp + ICMP4_HDR_LEN, (uint32_t)(icmpLen - ICMP4_HDR_LEN),
+				pool->stampLen, pool->probeKey, seq, src, family == AF_INET6 ? 16 : 4,
+				arrivalNs, &probe) != 0)
+		{
+			w->rejected++;
+			return;
+		}
+		ms = (double)probe.rttNs / 1000000.0;
+		haveRtt = TRUE;
+	}
+	e = rxShardEntry(w, family, src);
+	if (!e)
+	{
+		w->dropped++;
+		return;
+	}
+	/* the full header carries the extended sequence, otherwise extend the
+	   wire one around the highest answered */
+	if (pool->stampLen == PROBE_HDR_LEN)
+		ext = probe.seq;
+	else
+		ext = e->top + (uint32_t)(int32_t)(int16_t)(seq - (uint16_t)e->top);
+	switch (rxShardMark(e, ext))
+	{
+		case REPLY_STALE:
+			w->rejected++;
+			return;
+		case REPLY_DUP:
+			e->stats.received++;
+			e->stats.duplicates++;
+			return;
+		default:
+			break;
+	}
+	e->stats.received++;
+	if (haveRtt)
+	{
+		pingStatsAddRtt(&e->stats, ms);
+		rttHistAdd(&e->hist, ms);
+		rttJitterAdd(&e->jitter, ms);
+	}
+	atomic_fetch_add_explicit(&w->replies, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief Account an ICMP error to the target of the request it quotes
+ * @param w - worker
+ * @param family - AF_INET or AF_INET6
+ * @param quoted - start of the quoted IP header
+ * @param len - bytes available
+ */
+static void
+rxWorkerError(tRxWorker *w, int family, const uint8_t *quoted, size_t len)
+{
+	tRxShardEntry	*e;
+	const uint8_t	*dst;
+	size_t			hdrLen;
+
+	if (family == AF_INET6)
+	{
+		hdrLen = PING_IP6_HDR_LEN;
+		if (len < hdrLen + ICMP6_HDR_LEN || quoted[6] != IPPROTO_ICMPV6
+			|| quoted[hdrLen] != ICMP6_ECHO_REQUEST)
+			return;
+		dst = quoted + 24;
+	}
+	else
+	{
+		hdrLen = (size_t)(quoted[0] & 0x0F) * 4;
+		if (len < 20 || hdrLen < 20 || len < hdrLen + ICMP4_HDR_LEN
+			|| quoted[9] != IPPROTO_ICMP || quoted[hdrLen] != ICMP4_ECHO_REQUEST)
+			return;
+		dst = quoted + 16;
+	}
+	if ((uint16_t)((quoted[hdrLen + 4] << 8) | quoted[hdrLen + 5]) != w->pool->ident)
+		return;
+	e = rxShardEntry(w, family, dst);
+	if (e)
+		e->stats.errors++;
+	else
+		w->dropped++;
+}
+
+/**
+ * @brief Dispatch a packet read from a ring of the worker
+ * @param w - worker
+ * @param pkt - packet, network header onwards
+ * @param family - family of the ring
+ */
+static void
+rxWorkerPacket(tRxWorker *w, const tRxPacket *pkt, int family)
+{
+	const uint8_t	*ip = pkt->data;
+	const uint8_t	*icmp;
+	size_t			len = pkt->len;
+	size_t			hdrLen;
+
+	/* link layer padding is not part of the packet */
+	if (family == AF_INET6)
+	{
+		if (len < PING_IP6_HDR_LEN)
+			return;
+		if (PING_IP6_HDR_LEN + (size_t)(ip[4] << 8 | ip[5]) < len)
+			len = PING_IP6_HDR_LEN + (size_t)(ip[4] << 8 | ip[5]);
+		hdrLen = PING_IP6_HDR_LEN;
+	}
+	else
+	{
+		if (len < 20)
+			return;
+		if ((size_t)(ip[2] << 8 | ip[3]) < len)
+			len = (size_t)(ip[2] << 8 | ip[3]);
+		hdrLen = (size_t)(ip[0] & 0x0F) * 4;
+	}
+	if (hdrLen < 20 || len < hdrLen + ICMP4_HDR_LEN)
+		return;
+	icmp = ip + hdrLen;
+	if (family == AF_INET6 ? icmp[0] == ICMP6_ECHO_REPLY : icmp[0] == ICMP4_ECHO_REPLY)
+		rxWorkerReply(w, family, family == AF_INET6 ? ip + 8 : ip + 12,
+			icmp, len - hdrLen, pkt->arrivalNs);
+	else if (family == AF_INET6
+		? icmp[0] == ICMP6_TIME_EXCEEDED || icmp[0] == ICMP6_DEST_UNREACH
+			|| icmp[0] == ICMP6_PACKET_TOO_BIG
+		: icmp[0] == ICMP4_TIME_EXCEEDED || icmp[0] == ICMP4_DEST_UNREACH)
+		rxWorkerError(w, family, icmp + ICMP4_HDR_LEN, len - hdrLen - ICMP4_HDR_LEN);
+}
+
+/**
+ * @brief Read up to RXPOOL_BATCH packets from each ring of the worker
+ * @return TRUE if a packet was read
+ */
+static tBool
+rxWorkerDrain(tRxWorker *w)
+{
+	tRxPacket	pkt;
+	tBool		busy = FALSE;
+
+	for (int f = 0; f < 2; f++)
+	{
+		if (w->rings[f].fd < 0)
+			continue;
+		for (int k = 0; k < RXPOOL_BATCH && rxRingNext(&w->rings[f], &pkt); k++)
+		{
+			rxWorkerPacket(w, &pkt, f ? AF_INET6 : AF_INET);
+			busy = TRUE;
+		}
+	}
+	return (busy);
+}
+
+/**
+ * @brief Worker thread: account packets until the pool is stopped
+ */
+static void *
+rxWorkerRun(void *arg)
+{
+	tRxWorker		*w = arg;
+	struct pollfd	fds[2];
+	nfds_t			n = 0;
+
+	for (int f = 0; f < 2; f++)
+	{
+		if (w->rings[f].fd < 0)
+			continue;
+		fds[n].fd = w->rings[f].fd;
+		fds[n].events = POLLIN;
+		n++;
+	}
+	while (!atomic_load_explicit(&w->pool->stop, memory_order_acquire))
+	{
+		if (!rxWorkerDrain(w))
+			poll(fds, n, RXPOOL_POLL_MS);
+	}
+	/* replies already in the rings arrived before the end */
+	while (rxWorkerDrain(w))
+		;
+	return (NULL);
+}
+
+int
+rxPoolStart(
+	tRxPool			*pool,
+	unsigned int	count,
+	unsigned int	families,
+	uint16_t		ident,
+	const uint8_t	*probeKey,
+	uint32_t		stampLen)
+{
+	int	err;
+
+	ft_bzero(pool, sizeof(*pool));
+	if (count == 0 || count > RXPOOL_MAX_WORKERS)
+		return (-1);
+	/* every replies counter on a cache line of its own */
+	pool->workers = aligned_alloc(_Alignof(tRxWorker), count * sizeof(tRxWorker));
+	if (!pool->workers)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+		return (-1);
+	}
+	ft_bzero(pool->workers, count * sizeof(tRxWorker));
+	pool->count = count;
+	pool->ident = ident;
+	pool->stampLen = stampLen;
+	ft_memcpy(pool->probeKey, probeKey, PROBE_KEY_LEN);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		pool->workers[i].pool = pool;
+		pool->workers[i].rings[0].fd = -1;
+		pool->workers[i].rings[1].fd = -1;
+	}
+	for (unsigned int i = 0; i < count; i++)
+	{
+		for (int f = 0; f < 2; f++)
+		{
+			if (!(families & (1U << f)))
+				continue;
+			if (rxRingOpen(&pool->workers[i].rings[f], f ? AF_INET6 : AF_INET, ident) != 0
+				|| rxRingFanout(&pool->workers[i].rings[f], &pool->groups[f],
+					PACKET_FANOUT_HASH) != 0)
+			{
+				rxPoolClose(pool, 0);
+				return (-1);
+			}
+		}
+	}
+	for (unsigned int i = 0; i < count; i++)
+	{
+		err = pthread_create(&pool->workers[i].thread, NULL, rxWorkerRun, &pool->workers[i]);
+		if (err != 0)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": receive worker: %s\n", strerror(err));
+			rxPoolClose(pool, 0);
+			return (-1);
+		}
+		pool->workers[i].started = TRUE;
+	}
+	return (0);
+}
+
+uint64_t
+rxPoolReplies(const tRxPool *pool)
+{
+	uint64_t	total = 0;
+
+	for (unsigned int i = 0; i < pool->count; i++)
+		total += atomic_load_explicit(&pool->workers[i].replies, memory_order_relaxed);
+	return (total);
+}
+
+void
+rxPoolStop(tRxPool *pool)
+{
+	atomic_store_explicit(&pool->stop, 1, memory_order_release);
+	for (unsigned int i = 0; i < pool->count; i++)
+	{
+		if (!pool->workers[i].started)
+			continue;
+		pthread_join(pool->workers[i].thread, NULL);
+		pool->workers[i].started = FALSE;
+	}
+}
+
+void
+rxPoolMerge(const tRxPool *pool, tTargetTable *table, int verbose)
+{
+	uint64_t	unmatched = 0;
+	size_t		i;
+
+	/* the workers are joined: their shards are read as plain memory */
+	for (unsigned int w = 0; w < pool->count; w++)
+	{
+		const tRxWorker	*worker = &pool->workers[w];
+
+		for (size_t k = 0; k < worker->cap; k++)
+		{
+			const tRxShardEntry	*e = &worker->entries[k];
+
+			if (e->key.family == 0)
+				continue;
+			i = targetTableFind(table, &e->key);
+			if (i == TABLE_NONE)
+			{
+				unmatched += e->stats.received + e->stats.errors;
+				continue;
+			}
+			/* one worker saw every reply of the address */
+			rttJitterMerge(&table->jitter[i], &e->jitter);
+			pingStatsMerge(&table->stats[i], &e->stats);
+			rttHistMerge(&table->hist[i], &e->hist);
+		}
+		if (verbose > 0)
+			printf("rx worker %u: %lu replies from %zu addresses, %lu rejected, %lu dropped\n",
+				w, atomic_load_explicit(&worker->replies, memory_order_relaxed),
+				worker->count, worker->rejected, worker->dropped);
+	}
+	/* probes are not tracked one by one: every one not answered is lost */
+	for (i = 0; i < table->count; i++)
+	{
+		tPingStats		*s = &table->stats[i];
+		unsigned int	answered = s->received - s->duplicates;
+
+		s->lost = s->sent > answered ? s->sent - answered : 0;
+	}
+	if (verbose > 0 && unmatched > 0)
+		printf("rx workers: %lu packets from addresses not probed\n", unmatched);
+	fflush(stdout);
+}
+
+void
+rxPoolClose(tRxPool *pool, int verbose)
+{
+	if (!pool->workers)
+		return;
+	rxPoolStop(pool);
+	for (unsigned int i = 0; i < pool->count; i++)
+	{
+		rxRingClose(&pool->workers[i].rings[0], verbose);
+		rxRingClose(&pool->workers[i].rings[1], verbose);
+		free(pool->workers[i].entries);
+	}
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->count = 0;
+}
@@ -0,0 +1,267 @@
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/ping.h"
+#include "../includes/rxring.h"
+
+#define RXRING_SNAPLEN	0xFFFF	/**< accepted packets are kept whole */
+
+/*
+ * IPv4: ICMP, not a trailing fragment, then echo replies with our
+ * identifier and the errors a raw socket hands over (3, 4, 5, 11, 12).
+ */
+static const struct sock_filter	g_rxFilter4[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 9),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMP, 0, 13),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 6),
+	BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 11, 0),
+	BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 0),
+	BPF_STMT(BPF_LD | BPF_B | BPF_IND, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP4_ECHO_REPLY, 5, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP4_DEST_UNREACH, 6, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP4_SOURCE_QUENCH, 5, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP4_REDIRECT, 4, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP4_TIME_EXCEEDED, 3, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP4_PARAM_PROBLEM, 2, 3),
+	BPF_STMT(BPF_LD | BPF_H | BPF_IND, 4),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0 /* identifier */, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, RXRING_SNAPLEN),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+#define RXRING_IDENT4	13	/**< instruction of g_rxFilter4 comparing the identifier */
+
+/*
+ * IPv6: ICMPv6 right after the fixed header, then the types let through
+ * by the ICMP6_FILTER of raw sockets (1 to 4, echo replies with our
+ * identifier).
+ */
+static const struct sock_filter	g_rxFilter6[] = {
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 6),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMPV6, 0, 7),
+	BPF_STMT(BPF_LD | BPF_B | BPF_ABS, PING_IP6_HDR_LEN),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ICMP6_ECHO_REPLY, 2, 0),
+	BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, ICMP6_PARAM_PROBLEM + 1, 4, 0),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 3, 2),
+	BPF_STMT(BPF_LD | BPF_H | BPF_ABS, PING_IP6_HDR_LEN + 4),
+	BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0 /* identifier */, 0, 1),
+	BPF_STMT(BPF_RET | BPF_K, RXRING_SNAPLEN),
+	BPF_STMT(BPF_RET | BPF_K, 0),
+};
+#define RXRING_IDENT6	7	/**< instruction of g_rxFilter6 comparing the identifier */
+
+/**
+ * @brief Descriptor of a ring block
+ */
+static struct tpacket_block_desc *
+rxRingBlock(const tRxRing *ring, unsigned int i)
+{
+	return ((struct tpacket_block_desc *)(ring->map + (size_t)i * RXRING_BLOCK_SIZE));
+}
+
+/**
+ * @brief CLOCK_REALTIME - CLOCK_MONOTONIC, to put kernel timestamps on the probe clock
+ */
+static int64_t
+rxRingClockOffset(void)
+{
+	struct timespec	real;
+	struct timespec	mono;
+
+	clock_gettime(CLOCK_REALTIME, &real);
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	return ((int64_t)(real.tv_sec - mono.tv_sec) * 1000000000LL
+		+ (real.tv_nsec - mono.tv_nsec));
+}
+
+int
+rxRingOpen(tRxRing *ring, int family, uint16_t ident)
+{
+	struct sock_filter	code[sizeof(g_rxFilter4) / sizeof(g_rxFilter4[0])];
+	struct sock_fprog	prog;
+	struct tpacket_req3	req;
+	struct sockaddr_ll	sll;
+	int					version = TPACKET_V3;
+	void				*map;
+
+	ft_bzero(ring, sizeof(*ring));
+	/* bound to no protocol until filter and ring are in place */
+	ring->fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (ring->fd < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": packet socket: %s\n", strerror(errno));
+		return (-1);
+	}
+	if (family == AF_INET6)
+	{
+		ft_memcpy(code, g_rxFilter6, sizeof(g_rxFilter6));
+		code[RXRING_IDENT6].k = ident;
+		prog.len = sizeof(g_rxFilter6) / sizeof(g_rxFilter6[0]);
+	}
+	else
+	{
+		ft_memcpy(code, g_rxFilter4, sizeof(g_rxFilter4));
+		code[RXRING_IDENT4].k = ident;
+		prog.len = sizeof(g_rxFilter4) / sizeof(g_rxFilter4[0]);
+	}
+	prog.filter = code;
+	ft_bzero(&req, sizeof(req));
+	req.tp_block_size = RXRING_BLOCK_SIZE;
+	req.tp_block_nr = RXRING_BLOCKS;
+	req.tp_frame_size = RXRING_FRAME_SIZE;
+	req.tp_frame_nr = RXRING_BLOCK_SIZE / RXRING_FRAME_SIZE * RXRING_BLOCKS;
+	req.tp_retire_blk_tov = RXRING_BLOCK_TOV_MS;
+	if (setsockopt(ring->fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) != 0
+		|| setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) != 0
+		|| setsockopt(ring->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": packet ring: %s\n", strerror(errno));
+		close(ring->fd);
+		ring->fd = -1;
+		return (-1);
+	}
+#if defined(PACKET_IGNORE_OUTGOING)
+	/* looped back requests are also skipped per packet on older kernels */
+	(void)setsockopt(ring->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &(int){1}, sizeof(int));
+#endif
+	ring->mapLen = (size_t)RXRING_BLOCK_SIZE * RXRING_BLOCKS;
+	map = mmap(NULL, ring->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, 0);
+	if (map == MAP_FAILED)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": packet ring: %s\n", strerror(errno));
+		close(ring->fd);
+		ring->fd = -1;
+		return (-1);
+	}
+	ring->map = map;
+	ft_bzero(&sll, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(family == AF_INET6 ? ETH_P_IPV6 : ETH_P_IP);
+	if (bind(ring->fd, (struct sockaddr *)&sll, sizeof(sll)) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": packet ring: %s\n", strerror(errno));
+		rxRingClose(ring, 0);
+		return (-1);
+	}
+	ring->offsetNs = rxRingClockOffset();
+	return (0);
+}
+
+int
+rxRingFanout(tRxRing *ring, uint16_t *group, int mode)
+{
+	int			arg;
+	socklen_t	len = sizeof(arg);
+
+	/* a fresh group gets an id no other process uses, the others join it */
+	if (*group == 0)
+		arg = (mode | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+	else
+		arg = *group | mode << 16;
+	if (setsockopt(ring->fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) != 0
+		|| (*group == 0 && getsockopt(ring->fd, SOL_PACKET, PACKET_FANOUT, &arg, &len) != 0))
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": packet fanout: %s\n", strerror(errno));
+		return (-1);
+	}
+	*group = (uint16_t)arg;
+	return (0);
+}
+
+tBool
+rxRingNext(tRxRing *ring, tRxPacket *pkt)
+{
+	struct tpacket_block_desc	*desc;
+	const struct tpacket3_hdr	*hdr;
+	const struct sockaddr_ll	*sll;
+
+	while (1)
+	{
+		if (ring->held && ring->left == 0)
+		{
+			/* the whole block was consumed: one release for all its packets */
+			__atomic_store_n(&rxRingBlock(ring, ring->block)->hdr.bh1.block_status,
+				TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+			ring->block = (ring->block + 1) % RXRING_BLOCKS;
+			ring->held = FALSE;
+		}
+		if (!ring->held)
+		{
+			desc = rxRingBlock(ring, ring->block);
+			if (!(__atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+				return (FALSE);
+			ring->held = TRUE;
+			ring->left = desc->hdr.bh1.num_pkts;
+			ring->next = (const uint8_t *)desc + desc->hdr.bh1.offset_to_first_pkt;
+			ring->offsetNs = rxRingClockOffset();
+			ring->blocks++;
+			continue;
+		}
+		hdr = (const struct tpacket3_hdr *)ring->next;
+		ring->left--;
+		ring->next += hdr->tp_next_offset;
+		sll = (const struct sockaddr_ll *)((const uint8_t *)hdr
+			+ TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+		if (sll->sll_pkttype == PACKET_OUTGOING)
+			continue;
+		pkt->data = (const uint8_t *)hdr + hdr->tp_net;
+		pkt->len = hdr->tp_snaplen;
+		pkt->arrivalNs = (uint64_t)((int64_t)hdr->tp_sec * 1000000000LL
+			+ hdr->tp_nsec - ring->offsetNs);
+		ring->packets++;
+		return (TRUE);
+	}
+}
+
+tBool
+rxRingReady(const tRxRing *ring)
+{
+	unsigned int	i = ring->block;
+
+	if (ring->held && ring->left > 0)
+		return (TRUE);
+	if (ring->held)
+		i = (i + 1) % RXRING_BLOCKS;
+	return ((__atomic_load_n(&rxRingBlock(ring, i)->hdr.bh1.block_status, __ATOMIC_ACQUIRE)
+		& TP_STATUS_USER) != 0);
+}
+
+int
+rxRingMuteSocket(int fd)
+{
+	struct sock_filter	drop = BPF_STMT(BPF_RET | BPF_K, 0);
+	struct sock_fprog	prog;
+
+	prog.len = 1;
+	prog.filter = &drop;
+	return (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == 0 ? 0 : -1);
+}
+
+void
+rxRingClose(tRxRing *ring, int verbose)
+{
+	struct tpacket_stats_v3	st;
+	socklen_t				len = sizeof(st);
+
+	if (ring->fd < 0)
+		return;
+	if (verbose > 0 && getsockopt(ring->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0)
+		printf("packet ring: %lu packets in %lu blocks, %u dropped by the kernel\n",
+			ring->packets, ring->blocks, st.tp_drops);
+	fflush(stdout);
+	if (ring->map)
+		munmap(ring->map, ring->mapLen);
+	close(ring->fd);
+	ring->map = NULL;
+	ring->fd = -1;
+}
@@ -1,3 +1,4 @@
+#include <arpa/inet.h>
 #include <netinet/ip.h>
 #include <stdlib.h>
 #include <sys/socket.h>
@@ -11,6 +12,9 @@
 #include "../includes/ping.h"
 #include "../includes/utils.h"
 
+/* <netinet/icmp6.h> clashes with the common ICMPv6 enums */
+#define PING_ICMP6_FILTER	1
+
 tSocketPrivilege
 sockDetectPrivilege(void)
 {
@@ -56,13 +60,28 @@ sockValidatePrivileges(
 		return (-1);
 	if (privilege == SOCKET_PRIV_RAW)
 		return (0);
+#if !defined(HAJ)
+	/* hajping lets them through under the rate ceiling (sockRateLimit) */
 	if (opts->flood || opts->preload > 0)
 		return (-1);
+#endif
 	if (opts->recordRoute || opts->ipTsType != IP_TS_NONE)
 		return (-1);
 	return (0);
 }
 
+#if defined(HAJ)
+unsigned int
+sockRateLimit(const tPingOptions *opts, tSocketPrivilege privilege)
+{
+	if (opts->rate > 0)
+		return ((unsigned int)opts->rate);
+	if (privilege == SOCKET_PRIV_USER)
+		return (SOCKET_USER_RATE);
+	return (0);
+}
+#endif
+
 int
 pingSocketCreate(tPingSocket *ctx)
 {
@@ -114,6 +133,10 @@ socketApplyCommonOptions(
 		setsockopt(ctx->fd, SOL_SOCKET, SO_DEBUG, &(int){1}, sizeof(int));
 	if (opts->ignRouting)
 		setsockopt(ctx->fd, SOL_SOCKET, SO_DONTROUTE, &(int){1}, sizeof(int));
+	/* keep room for a few jumbo replies (and their looped-back requests) */
+	if (opts->packetSize > PING_MAX_PACKET_SIZE)
+		setsockopt(ctx->fd, SOL_SOCKET, SO_RCVBUF,
+			&(int){(opts->packetSize + PING_BUF_IP_MAX) * 16}, sizeof(int));
 	return (0);
 }
 
@@ -274,7 +297,9 @@ int socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts)
 				fatalError("setsockopt IP_TOS");
 		}
 
-		if (ctx->privilege == SOCKET_PRIV_USER)
+		/* a DGRAM socket shared by several targets has no targetAddr and
+		 * stays unconnected, errors are then matched by destination */
+		if (ctx->privilege == SOCKET_PRIV_USER && ctx->targetAddr.ss_family == AF_INET)
 		{
 			/* For DGRAM sockets, we need to connect to the target to receive ICMP errors related to that target */
 			struct sockaddr_in dst4;
@@ -290,6 +315,9 @@ int socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts)
 				ctx->fd = -1;
 				return (-1);
 			}
+		}
+		if (ctx->privilege == SOCKET_PRIV_USER)
+		{
 			/* Activate the reception of ICMP errors (for unreachable, time exceeded, etc.) */
 			ret = setsockopt(ctx->fd, SOL_IP, IP_RECVERR, &one, sizeof(one));
 			if (ret < 0)
@@ -314,6 +342,37 @@ int socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts)
 		if (ret < 0)
 			fatalError("setsockopt IPV6_RECVHOPLIMIT");
 
+		if (ctx->privilege == SOCKET_PRIV_RAW)
+		{
+			/* RAW ICMPv6 sockets never see the IPv6 header: have the kernel
+			 * pass destination, traffic class and extension headers along */
+			ret = setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &one, sizeof(one));
+			if (ret < 0)
+				fatalError("setsockopt IPV6_RECVPKTINFO");
+			ret = setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVTCLASS, &one, sizeof(one));
+			if (ret < 0)
+				fatalError("setsockopt IPV6_RECVTCLASS");
+			/* only let echo replies and errors through: no looped back
+			 * requests, no neighbor discovery (struct icmp6_filter: a set
+			 * bit blocks that type) */
+			{
+				static const uint8_t	pass[] = {ICMP6_DEST_UNREACH, ICMP6_PACKET_TOO_BIG,
+					ICMP6_TIME_EXCEEDED, ICMP6_PARAM_PROBLEM, ICMP6_ECHO_REPLY};
+				uint32_t				filter[8];
+
+				ft_memset(filter, 0xFF, sizeof(filter));
+				for (size_t i = 0; i < sizeof(pass); i++)
+					filter[pass[i] >> 5] &= ~(1U << (pass[i] & 31));
+				ret = setsockopt(ctx->fd, IPPROTO_ICMPV6, PING_ICMP6_FILTER, filter, sizeof(filter));
+				if (ret < 0)
+					fatalError("setsockopt ICMP6_FILTER");
+			}
+			/* extension headers are informational, older kernels may refuse */
+			(void)setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVHOPOPTS, &one, sizeof(one));
+			(void)setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVRTHDR, &one, sizeof(one));
+			(void)setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVDSTOPTS, &one, sizeof(one));
+		}
+
 		if (opts->ttl)
 		{
 			ret = setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_UNICAST_HOPS, &opts->ttl, sizeof(opts->ttl));
@@ -327,7 +386,7 @@ int socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts)
 				fatalError("setsockopt IPV6_TCLASS");
 		}
 
-		if (ctx->privilege == SOCKET_PRIV_USER)
+		if (ctx->privilege == SOCKET_PRIV_USER && ctx->targetAddr.ss_family == AF_INET6)
 		{
 			/* For DGRAM sockets, we need to connect to the target to receive ICMP errors related to that target */
 			struct sockaddr_in6 dst6;
@@ -342,6 +401,9 @@ int socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts)
 				ctx->fd = -1;
 				return (-1);
 			}
+		}
+		if (ctx->privilege == SOCKET_PRIV_USER)
+		{
 			/* Activate the reception of ICMP errors (for unreachable, time exceeded, etc.) */
 			ret = setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVERR, &one, sizeof(one));
 			if (ret < 0)
@@ -351,3 +413,70 @@ int socketApplyOptions(tPingSocket *ctx, const tPingOptions *opts)
 
 	return (0);
 }
+
+
+int
+socketApplyPmtuOptions(tPingSocket *ctx)
+{
+	int	one = 1;
+	int	mode;
+	int	rcvbuf;
+
+	if (!ctx || ctx->fd < 0)
+		return (-1);
+	/* a round of near 64k replies does not fit the default receive buffer */
+	rcvbuf = 1 << 20;
+	setsockopt(ctx->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	if (ctx->family == AF_INET6)
+	{
+		mode = IPV6_PMTUDISC_PROBE;
+		if (setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &mode, sizeof(mode)) < 0
+			|| setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_DONTFRAG, &one, sizeof(one)) < 0
+			|| setsockopt(ctx->fd, IPPROTO_IPV6, IPV6_RECVERR, &one, sizeof(one)) < 0)
+		{
+			ft_dprintf(STDERR_FILENO, "setsockopt IPV6_MTU_DISCOVER: %s\n", strerror(errno));
+			return (-1);
+		}
+		return (0);
+	}
+	mode = IP_PMTUDISC_PROBE;
+	if (setsockopt(ctx->fd, IPPROTO_IP, IP_MTU_DISCOVER, &mode, sizeof(mode)) < 0
+		|| setsockopt(ctx->fd, SOL_IP, IP_RECVERR, &one, sizeof(one)) < 0)
+	{
+		ft_dprintf(STDERR_FILENO, "setsockopt IP_MTU_DISCOVER: %s\n", strerror(errno));
+		return (-1);
+	}
+	return (0);
+}
+
+int
+socketRouteMtu(const struct sockaddr_storage *dst, socklen_t dstLen)
+{
+	struct sockaddr_storage	tmp;
+	socklen_t				len;
+	int						fd;
+	int						mtu;
+
+	if (!dst)
+		return (0);
+	fd = socket(dst->ss_family, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return (0);
+	/* any port will do, connect() only performs the route lookup */
+	tmp = *dst;
+	if (tmp.ss_family == AF_INET6)
+		((struct sockaddr_in6 *)&tmp)->sin6_port = htons(9);
+	else
+		((struct sockaddr_in *)&tmp)->sin_port = htons(9);
+	mtu = 0;
+	len = sizeof(mtu);
+	if (connect(fd, (struct sockaddr *)&tmp, dstLen) == 0)
+	{
+		if (tmp.ss_family == AF_INET6)
+			getsockopt(fd, IPPROTO_IPV6, IPV6_MTU, &mtu, &len);
+		else
+			getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len);
+	}
+	close(fd);
+	return (mtu);
+}
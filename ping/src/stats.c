@@ -0,0 +1,191 @@
+#include "../../hajlib/include/hmath.h"
+#include "../../hajlib/include/hmemory.h"
+
+#include "../includes/stats.h"
+
+void
+pingStatsReset(tPingStats *stats)
+{
+	if (!stats)
+		return;
+	ft_bzero(stats, sizeof(*stats));
+}
+
+void
+pingStatsAddRtt(tPingStats *stats, double ms)
+{
+	if (!stats)
+		return;
+	if (stats->rttCount == 0 || ms < stats->rttMin)
+		stats->rttMin = ms;
+	if (ms > stats->rttMax)
+		stats->rttMax = ms;
+	stats->rttSum += ms;
+	stats->rttSumSq += ms * ms;
+	stats->rttCount++;
+}
+
+void
+pingStatsMerge(tPingStats *dst, const tPingStats *src)
+{
+	if (!dst || !src)
+		return;
+	if (src->rttCount > 0)
+	{
+		if (dst->rttCount == 0 || src->rttMin < dst->rttMin)
+			dst->rttMin = src->rttMin;
+		if (src->rttMax > dst->rttMax)
+			dst->rttMax = src->rttMax;
+	}
+	dst->sent += src->sent;
+	dst->received += src->received;
+	dst->lost += src->lost;
+	dst->errors += src->errors;
+	dst->duplicates += src->duplicates;
+	dst->rttSum += src->rttSum;
+	dst->rttSumSq += src->rttSumSq;
+	dst->rttCount += src->rttCount;
+	dst->corrupted += src->corrupted;
+}
+
+double
+pingStatsAvg(const tPingStats *stats)
+{
+	if (!stats || stats->rttCount == 0)
+		return (0.0);
+	return (stats->rttSum / stats->rttCount);
+}
+
+double
+pingStatsStddev(const tPingStats *stats)
+{
+	double	avg;
+	double	variance;
+
+	if (!stats || stats->rttCount < 2)
+		return (0.0);
+	avg = pingStatsAvg(stats);
+	variance = (stats->rttSumSq / stats->rttCount) - (avg * avg);
+	if (variance <= 0.0)
+		return (0.0);
+	return (ft_sqrtNewton(variance));
+}
+
+double
+pingStatsLoss(const tPingStats *stats)
+{
+	unsigned int	actualReceived;
+
+	if (!stats || stats->sent == 0)
+		return (0.0);
+	actualReceived = stats->received - stats->duplicates;
+	if (actualReceived > stats->sent)
+		actualReceived = stats->sent;
+	return ((double)(stats->sent - actualReceived) * 100.0 / (double)stats->sent);
+}
+
+void
+rttHistAdd(tRttHistogram *hist, double ms)
+{
+	unsigned long	us;
+	unsigned int	bucket;
+
+	if (!hist)
+		return;
+	us = ms > 0.0 ? (unsigned long)(ms * 1000.0) : 0;
+	bucket = 0;
+	while (us > 0 && bucket < RTT_HIST_BUCKETS - 1)
+	{
+		us >>= 1;
+		bucket++;
+	}
+	hist->buckets[bucket]++;
+	hist->total++;
+}
+
+void
+rttHistMerge(tRttHistogram *dst, const tRttHistogram *src)
+{
+	if (!dst || !src)
+		return;
+	for (unsigned int i = 0; i < RTT_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->total += src->total;
+}
+
+double
+rttHistPercentile(const tRttHistogram *hist, double percentile)
+{
+	unsigned long	rank;
+	unsigned long	seen;
+	unsigned int	i;
+
+	if (!hist || hist->total == 0)
+		return (0.0);
+	rank = (unsigned long)((percentile / 100.0) * hist->total + 0.5);
+	if (rank == 0)
+		rank = 1;
+	seen = 0;
+	for (i = 0; i < RTT_HIST_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+	if (i >= RTT_HIST_BUCKETS)
+		i = RTT_HIST_BUCKETS - 1;
+	/* upper bound of bucket i is 2^i microseconds */
+	return ((double)(1UL << i) / 1000.0);
+}
+
+void
+rttJitterAdd(tRttJitter *jit, double ms)
+{
+	double	delta;
+
+	if (!jit)
+		return;
+	if (jit->primed)
+	{
+		delta = ms - jit->lastRtt;
+		if (delta < 0)
+			delta = -delta;
+		jit->jitter += (delta - jit->jitter) / 16.0;
+		jit->updates++;
+	}
+	else
+		jit->firstRtt = ms;
+	jit->lastRtt = ms;
+	jit->primed = 1;
+}
+
+void
+rttJitterMerge(tRttJitter *dst, const tRttJitter *src)
+{
+	double			decay = 1.0;
+	double			base = 15.0 / 16.0;
+	double			delta;
+	unsigned int	n;
+
+	if (!dst || !src || !src->primed)
+		return;
+	if (!dst->primed)
+	{
+		*dst = *src;
+		return;
+	}
+	/* the first sample of src follows the last one of dst */
+	delta = src->firstRtt - dst->lastRtt;
+	if (delta < 0)
+		delta = -delta;
+	dst->jitter += (delta - dst->jitter) / 16.0;
+	for (n = src->updates; n > 0; n >>= 1)
+	{
+		if (n & 1)
+			decay *= base;
+		base *= base;
+	}
+	dst->jitter = dst->jitter * decay + src->jitter;
+	dst->lastRtt = src->lastRtt;
+	dst->updates += src->updates + 1;
+}
@@ -0,0 +1,348 @@
+#include <arpa/inet.h>
+#include <stdlib.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/table.h"
+
+uint64_t
+targetTableHash(const tTargetKey *key)
+{
+	uint32_t	w[5];
+	uint64_t	h = 0x9e3779b97f4a7c15ULL;
+
+	ft_memcpy(w, key, sizeof(w));
+	for (int i = 0; i < 5; i++)
+	{
+		h ^= w[i];
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 32;
+	}
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	return (h ^ (h >> 29));
+}
+
+static tBool
+tableSameKey(const tTargetKey *a, const tTargetKey *b)
+{
+	return (a->family == b->family && a->ident == b->ident
+		&& ft_memcmp(a->addr, b->addr, sizeof(a->addr)) == 0);
+}
+
+/**
+ * @brief Insert index i in the slots (no growth, no duplicate check)
+ */
+static void
+tableIndex(tTargetTable *table, size_t i)
+{
+	uint64_t	h = targetTableHash(&table->keys[i]);
+	size_t		mask = table->slotCap - 1;
+	size_t		s = (size_t)h & mask;
+
+	while (table->slots[s] != 0)
+		s = (s + 1) & mask;
+	table->slots[s] = (h & 0xFFFFFFFF00000000ULL) | (uint64_t)(i + 1);
+}
+
+/**
+ * @brief Resize one array of the table
+ * @return 0 on success, -1 on allocation failure (array untouched)
+ */
+static int
+tableResize(void *arrayPtr, size_t elemSize, size_t cap)
+{
+	void	**array = arrayPtr;
+	void	*grown;
+
+	grown = realloc(*array, elemSize * cap);
+	if (!grown)
+		return (-1);
+	*array = grown;
+	return (0);
+}
+
+/**
+ * @brief Make room for one more target in every array and in the index
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+tableGrow(tTargetTable *table)
+{
+	if (table->count == table->cap)
+	{
+		size_t	cap = table->cap ? table->cap * 2 : TABLE_INITIAL_CAP;
+
+		if (tableResize(&table->stats, sizeof(*table->stats), cap) != 0
+			|| tableResize(&table->seq, sizeof(*table->seq), cap) != 0
+			|| tableResize(&table->top, sizeof(*table->top), cap) != 0
+			|| tableResize(&table->window, sizeof(*table->window), cap) != 0
+			|| tableResize(&table->nextNs, sizeof(*table->nextNs), cap) != 0
+			|| tableResize(&table->oldest, sizeof(*table->oldest), cap) != 0
+			|| tableResize(&table->unacked, sizeof(*table->unacked), cap) != 0
+			|| tableResize(&table->first, sizeof(*table->first), cap) != 0
+			|| tableResize(&table->last, sizeof(*table->last), cap) != 0
+			|| tableResize(&table->keys, sizeof(*table->keys), cap) != 0
+			|| tableResize(&table->scope, sizeof(*table->scope), cap) != 0
+			|| tableResize(&table->ip, sizeof(*table->ip), cap) != 0
+			|| tableResize(&table->host, sizeof(*table->host), cap) != 0
+			|| tableResize(&table->aliases, sizeof(*table->aliases), cap) != 0
+			|| tableResize(&table->aliasCount, sizeof(*table->aliasCount), cap) != 0
+			|| tableResize(&table->hist, sizeof(*table->hist), cap) != 0
+			|| tableResize(&table->jitter, sizeof(*table->jitter), cap) != 0)
+			return (-1);
+		table->cap = cap;
+	}
+	if ((table->count + 1) * 2 > table->slotCap)
+	{
+		size_t		slotCap = table->slotCap ? table->slotCap * 2 : TABLE_INITIAL_CAP * 2;
+		uint64_t	*slots = calloc(slotCap, sizeof(*slots));
+
+		if (!slots)
+			return (-1);
+		free(table->slots);
+		table->slots = slots;
+		table->slotCap = slotCap;
+		for (size_t i = 0; i < table->count; i++)
+			tableIndex(table, i);
+	}
+	return (0);
+}
+
+void
+targetTableInit(tTargetTable *table)
+{
+	ft_bzero(table, sizeof(*table));
+	arenaInit(&table->names);
+	poolInit(&table->records, sizeof(tProbeRecord), TABLE_RECORD_SLAB);
+}
+
+int
+targetTableKey(tTargetKey *key, const struct sockaddr_storage *addr, uint16_t ident)
+{
+	ft_bzero(key, sizeof(*key));
+	if (addr->ss_family == AF_INET6)
+		ft_memcpy(key->addr, &((const struct sockaddr_in6 *)addr)->sin6_addr, 16);
+	else if (addr->ss_family == AF_INET)
+		ft_memcpy(key->addr, &((const struct sockaddr_in *)addr)->sin_addr, 4);
+	else
+		return (-1);
+	key->family = (uint8_t)addr->ss_family;
+	key->ident = ident;
+	return (0);
+}
+
+size_t
+targetTableFind(const tTargetTable *table, const tTargetKey *key)
+{
+	uint64_t	h;
+	uint64_t	tag;
+	size_t		mask;
+	size_t		s;
+
+	if (table->slotCap == 0)
+		return (TABLE_NONE);
+	h = targetTableHash(key);
+	tag = h & 0xFFFFFFFF00000000ULL;
+	mask = table->slotCap - 1;
+	/* the tag rejects almost every collision without touching the keys */
+	for (s = (size_t)h & mask; table->slots[s] != 0; s = (s + 1) & mask)
+	{
+		size_t	i = (size_t)(table->slots[s] & 0xFFFFFFFFULL) - 1;
+
+		if ((table->slots[s] & 0xFFFFFFFF00000000ULL) == tag
+			&& tableSameKey(&table->keys[i], key))
+			return (i);
+	}
+	return (TABLE_NONE);
+}
+
+size_t
+targetTableAdd(tTargetTable *table, const tTargetKey *key, uint32_t scope, const char *host)
+{
+	char		ip[INET6_ADDRSTRLEN];
+	const char	*copy;
+	size_t		i;
+
+	if (table->count >= 0xFFFFFFFFUL || tableGrow(table) != 0)
+		return (TABLE_NONE);
+	inet_ntop(key->family, key->addr, ip, sizeof(ip));
+	copy = arenaStrndup(&table->names, ip, ft_strlen(ip));
+	if (!copy)
+		return (TABLE_NONE);
+	i = table->count++;
+	pingStatsReset(&table->stats[i]);
+	table->seq[i] = 0;
+	table->top[i] = 0;
+	table->window[i] = 0;
+	table->nextNs[i] = 0;
+	table->oldest[i] = 0;
+	table->unacked[i] = 0;
+	table->first[i] = NULL;
+	table->last[i] = NULL;
+	table->keys[i] = *key;
+	table->scope[i] = scope;
+	table->ip[i] = copy;
+	table->host[i] = host;
+	table->aliases[i] = NULL;
+	table->aliasCount[i] = 0;
+	ft_bzero(&table->hist[i], sizeof(table->hist[i]));
+	ft_bzero(&table->jitter[i], sizeof(table->jitter[i]));
+	tableIndex(table, i);
+	return (i);
+}
+
+int
+targetTableAddAlias(tTargetTable *table, size_t i, const char *host)
+{
+	uint32_t	n = table->aliasCount[i];
+	const char	**grown;
+
+	if (ft_strcmp(table->host[i], host) == 0)
+		return (0);
+	for (uint32_t j = 0; j < n; j++)
+		if (ft_strcmp(table->aliases[i][j], host) == 0)
+			return (0);
+	/* arrays double at powers of two, the old one stays in the arena */
+	if ((n & (n - 1)) == 0)
+	{
+		grown = arenaAlloc(&table->names, (n ? n * 2 : 1) * sizeof(*grown));
+		if (!grown)
+			return (-1);
+		if (n > 0)
+			ft_memcpy(grown, table->aliases[i], n * sizeof(*grown));
+		table->aliases[i] = grown;
+	}
+	table->aliases[i][table->aliasCount[i]++] = host;
+	return (0);
+}
+
+socklen_t
+targetTableSockaddr(const tTargetTable *table, size_t i, struct sockaddr_storage *out)
+{
+	ft_bzero(out, sizeof(*out));
+	out->ss_family = table->keys[i].family;
+	if (table->keys[i].family == AF_INET6)
+	{
+		struct sockaddr_in6	*sin6 = (struct sockaddr_in6 *)out;
+
+		ft_memcpy(&sin6->sin6_addr, table->keys[i].addr, 16);
+		sin6->sin6_scope_id = table->scope[i];
+		return (sizeof(*sin6));
+	}
+	ft_memcpy(&((struct sockaddr_in *)out)->sin_addr, table->keys[i].addr, 4);
+	return (sizeof(struct sockaddr_in));
+}
+
+int
+targetTableProbe(tTargetTable *table, size_t i, uint64_t sentNs)
+{
+	tProbeRecord	*rec = poolAlloc(&table->records);
+
+	if (!rec)
+		return (-1);
+	rec->next = NULL;
+	rec->sentNs = sentNs;
+	if (table->last[i])
+		table->last[i]->next = rec;
+	else
+		table->first[i] = rec;
+	table->last[i] = rec;
+	return (0);
+}
+
+tBool
+targetTableRetire(tTargetTable *table, size_t i)
+{
+	tProbeRecord	*rec = table->first[i];
+	tBool			lost = (table->unacked[i] & 1) != 0;
+
+	table->first[i] = rec->next;
+	if (!rec->next)
+		table->last[i] = NULL;
+	poolRelease(&table->records, rec);
+	table->unacked[i] >>= 1;
+	table->oldest[i]++;
+	return (lost);
+}
+
+tBool
+targetTableAck(tTargetTable *table, size_t i, uint32_t seq)
+{
+	uint32_t	n = seq - table->oldest[i];
+
+	if (n >= TABLE_WINDOW || !(table->unacked[i] & (1ULL << n)))
+		return (FALSE);
+	table->unacked[i] &= ~(1ULL << n);
+	return (TRUE);
+}
+
+size_t
+targetTableMemory(const tTargetTable *table)
+{
+	size_t	perTarget;
+
+	perTarget = sizeof(*table->stats) + sizeof(*table->seq) + sizeof(*table->top)
+		+ sizeof(*table->window) + sizeof(*table->nextNs) + sizeof(*table->oldest)
+		+ sizeof(*table->unacked) + sizeof(*table->first) + sizeof(*table->last)
+		+ sizeof(*table->keys) + sizeof(*table->scope) + sizeof(*table->ip)
+		+ sizeof(*table->host) + sizeof(*table->aliases) + sizeof(*table->aliasCount)
+		+ sizeof(*table->hist) + sizeof(*table->jitter);
+	return (perTarget * table->cap + sizeof(*table->slots) * table->slotCap
+		+ table->names.reserved + poolReserved(&table->records));
+}
+
+tReplyMark
+targetTableMark(tTargetTable *table, size_t i, uint32_t seq)
+{
+	int32_t		diff;
+	uint64_t	bit;
+
+	if (table->window[i] == 0)
+	{
+		table->top[i] = seq;
+		table->window[i] = 1;
+		return (REPLY_NEW);
+	}
+	diff = (int32_t)(seq - table->top[i]);
+	if (diff > 0)
+	{
+		table->window[i] = diff >= TABLE_WINDOW ? 1 : (table->window[i] << diff) | 1;
+		table->top[i] = seq;
+		return (REPLY_NEW);
+	}
+	if (-(int64_t)diff >= TABLE_WINDOW)
+		return (REPLY_STALE);
+	bit = 1ULL << -diff;
+	if (table->window[i] & bit)
+		return (REPLY_DUP);
+	table->window[i] |= bit;
+	return (REPLY_NEW);
+}
+
+void
+targetTableFree(tTargetTable *table)
+{
+	if (!table)
+		return;
+	free(table->stats);
+	free(table->seq);
+	free(table->top);
+	free(table->window);
+	free(table->nextNs);
+	free(table->oldest);
+	free(table->unacked);
+	free(table->first);
+	free(table->last);
+	free(table->keys);
+	free(table->slots);
+	free(table->scope);
+	free(table->ip);
+	free(table->host);
+	free(table->aliases);
+	free(table->aliasCount);
+	free(table->hist);
+	free(table->jitter);
+	arenaFree(&table->names);
+	poolFree(&table->records);
+	ft_bzero(table, sizeof(*table));
+}
@@ -0,0 +1,313 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/targets.h"
+
+/**
+ * @brief Line assembly state shared by the mapped and the read() paths
+ * - list: destination
+ * - path: reported in warnings
+ * - line / len: current line, bytes past TARGET_NAME_MAX are dropped
+ * - lineNo: current line number
+ * - overlong: current line did not fit
+ */
+typedef struct sTargetReader
+{
+	tTargetList	*list;
+	const char	*path;
+	char		line[TARGET_NAME_MAX + 1];
+	size_t		len;
+	size_t		lineNo;
+	tBool		overlong;
+} tTargetReader;
+
+static uint64_t
+targetHash(const char *name, size_t len)
+{
+	uint64_t	h = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= (unsigned char)name[i];
+		h *= 0x100000001b3ULL;
+	}
+	return (h);
+}
+
+/**
+ * @brief Find the set slot of a name
+ * @return slot holding the name, or the free slot where it belongs
+ */
+static size_t *
+targetSlot(const tTargetList *list, const char *name, size_t len)
+{
+	size_t	mask = list->slotCap - 1;
+	size_t	i = targetHash(name, len) & mask;
+
+	while (list->slots[i] != 0)
+	{
+		const char	*cur = list->hosts[list->slots[i] - 1];
+
+		if (ft_strncmp(cur, name, len) == 0 && cur[len] == '\0')
+			break;
+		i = (i + 1) & mask;
+	}
+	return (&list->slots[i]);
+}
+
+/**
+ * @brief Make room for one more name in hosts and in the set
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+targetGrow(tTargetList *list)
+{
+	if (list->count == list->cap)
+	{
+		size_t	cap = list->cap ? list->cap * 2 : TARGET_INITIAL_CAP;
+		char	**grown = realloc(list->hosts, cap * sizeof(*grown));
+
+		if (!grown)
+			return (-1);
+		list->hosts = grown;
+		list->cap = cap;
+	}
+	if ((list->count + 1) * 2 > list->slotCap)
+	{
+		size_t	*old = list->slots;
+		size_t	oldCap = list->slotCap;
+
+		list->slotCap = oldCap ? oldCap * 2 : TARGET_INITIAL_CAP * 2;
+		list->slots = calloc(list->slotCap, sizeof(*list->slots));
+		if (!list->slots)
+		{
+			list->slots = old;
+			list->slotCap = oldCap;
+			return (-1);
+		}
+		for (size_t i = 0; i < oldCap; i++)
+		{
+			const char	*name;
+
+			if (old[i] == 0)
+				continue;
+			name = list->hosts[old[i] - 1];
+			*targetSlot(list, name, ft_strlen(name)) = old[i];
+		}
+		free(old);
+	}
+	return (0);
+}
+
+/**
+ * @brief Add one name unless it is already listed
+ * @param name - name, not necessarily NUL terminated
+ * @param len - length of name
+ * @param borrowed - NUL terminated string to reference instead of a copy (may be NULL)
+ * @return 0 on success (or duplicate), -1 on allocation failure
+ */
+static int
+targetAdd(tTargetList *list, const char *name, size_t len, char *borrowed)
+{
+	size_t	*slot;
+
+	if (targetGrow(list) != 0)
+		return (-1);
+	slot = targetSlot(list, name, len);
+	if (*slot != 0)
+		return (0);
+	if (!borrowed)
+		borrowed = arenaStrndup(&list->names, name, len);
+	if (!borrowed)
+		return (-1);
+	list->hosts[list->count++] = borrowed;
+	*slot = list->count;
+	return (0);
+}
+
+void
+targetListInit(tTargetList *list)
+{
+	ft_bzero(list, sizeof(*list));
+}
+
+int
+targetListAddArgs(tTargetList *list, char **hosts, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (targetAdd(list, hosts[i], ft_strlen(hosts[i]), hosts[i]) != 0)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": out of memory\n");
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+/**
+ * @brief Handle a complete line: first word, comments and blanks ignored
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+targetReaderLine(tTargetReader *rd)
+{
+	size_t	start = 0;
+	size_t	end;
+
+	rd->lineNo++;
+	if (rd->overlong)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s:%zu: name too long, skipped\n",
+			rd->path, rd->lineNo);
+		rd->overlong = FALSE;
+		rd->len = 0;
+		return (0);
+	}
+	while (start < rd->len && ft_isspace(rd->line[start]))
+		start++;
+	end = start;
+	while (end < rd->len && !ft_isspace(rd->line[end]) && rd->line[end] != '#')
+		end++;
+	rd->len = 0;
+	if (end == start)
+		return (0);
+	return (targetAdd(rd->list, rd->line + start, end - start, NULL));
+}
+
+/**
+ * @brief Feed a block of the list, lines may span blocks
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+targetReaderFeed(tTargetReader *rd, const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		const char	*nl = memchr(data, '\n', size);
+		size_t		seg = nl ? (size_t)(nl - data) : size;
+
+		if (rd->len + seg > TARGET_NAME_MAX)
+			rd->overlong = TRUE;
+		else
+		{
+			ft_memcpy(rd->line + rd->len, data, seg);
+			rd->len += seg;
+		}
+		if (!nl)
+			break;
+		if (targetReaderLine(rd) != 0)
+			return (-1);
+		data = nl + 1;
+		size -= seg + 1;
+	}
+	return (0);
+}
+
+/**
+ * @brief Scan a regular file through a read-only mapping
+ * @return 0 on success, -1 on failure (errno set)
+ */
+static int
+targetReadMapped(tTargetReader *rd, int fd, size_t size)
+{
+	void	*map;
+	int		ret;
+
+	if (size == 0)
+		return (0);
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return (-1);
+	madvise(map, size, MADV_SEQUENTIAL);
+	ret = targetReaderFeed(rd, map, size);
+	munmap(map, size);
+	return (ret);
+}
+
+/**
+ * @brief Read a pipe or terminal in blocks
+ * @return 0 on success, -1 on failure (errno set)
+ */
+static int
+targetReadStream(tTargetReader *rd, int fd)
+{
+	char	*buf;
+	ssize_t	n;
+	int		ret = 0;
+
+	buf = malloc(TARGET_READ_SIZE);
+	if (!buf)
+		return (-1);
+	while (ret == 0)
+	{
+		n = read(fd, buf, TARGET_READ_SIZE);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			ret = n < 0 ? -1 : 0;
+			break;
+		}
+		ret = targetReaderFeed(rd, buf, (size_t)n);
+	}
+	free(buf);
+	return (ret);
+}
+
+int
+targetListRead(tTargetList *list, const char *path)
+{
+	tTargetReader	*rd;
+	struct stat		st;
+	int				fd;
+	int				ret;
+
+	if (!list || !path)
+		return (-1);
+	errno = 0;
+	fd = ft_strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+	rd = calloc(1, sizeof(*rd));
+	if (fd < 0 || !rd || fstat(fd, &st) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", path, strerror(errno));
+		if (fd > STDIN_FILENO)
+			close(fd);
+		free(rd);
+		return (-1);
+	}
+	rd->list = list;
+	rd->path = ft_strcmp(path, "-") == 0 ? "stdin" : path;
+	if (S_ISREG(st.st_mode))
+		ret = targetReadMapped(rd, fd, (size_t)st.st_size);
+	else
+		ret = targetReadStream(rd, fd);
+	/* last line without a newline */
+	if (ret == 0 && (rd->len > 0 || rd->overlong))
+		ret = targetReaderLine(rd);
+	if (ret != 0)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", rd->path,
+			errno ? strerror(errno) : "out of memory");
+	if (fd > STDIN_FILENO)
+		close(fd);
+	free(rd);
+	return (ret);
+}
+
+void
+targetListFree(tTargetList *list)
+{
+	if (!list)
+		return;
+	arenaFree(&list->names);
+	free(list->hosts);
+	free(list->slots);
+	ft_bzero(list, sizeof(*list));
+}
@@ -48,6 +48,19 @@ void printFullHelp(char *progName)
   -w, --timeout=N            stop after N seconds\n\
   -W, --linger=N             number of seconds to wait for response\n\n");
 	ft_printf(" Options valid for --echo requests:\n\n");
+#if defined(HAJ)
+	ft_printf("\
+  -f, --flood                flood ping (capped by --rate without root)\n\
+      --ip-timestamp=FLAG    IP timestamp of type FLAG, which is one of\n\
+                             \"tsonly\" and \"tsaddr\"\n\
+  -l, --preload=NUMBER       send NUMBER packets as fast as possible before\n\
+                             falling into normal mode of behavior (capped by\n\
+                             --rate without root)\n\
+  -p, --pattern=PATTERN      fill ICMP packet with given pattern (hex)\n\
+  -q, --quiet                quiet output\n\
+      --rate=PPS             send at most PPS packets per second (default\n\
+                             1000 without root, unlimited as root)\n");
+#else
 	ft_printf("\
   -f, --flood                flood ping (root only)\n\
       --ip-timestamp=FLAG    IP timestamp of type FLAG, which is one of\n\
@@ -56,14 +69,68 @@ void printFullHelp(char *progName)
                              falling into normal mode of behavior (root only)\n\
   -p, --pattern=PATTERN      fill ICMP packet with given pattern (hex)\n\
   -q, --quiet                quiet output\n");
+#endif
 #if defined(HAJ)
 	ft_printf("\
   -R, --record-route         record route (root only)\n\
-  -s, --packet-size=NUMBER   send NUMBER data octets\n\n");
+  -s, --packet-size=NUMBER   send NUMBER data octets (up to 65507)\n\
+      --hugepages            back packet buffers with huge pages\n\n");
 #else
 	ft_printf("\
   -R, --route                record route\n\
   -s, --size=NUMBER          send NUMBER data octets\n\n");
+#endif
+#if defined(HAJ)
+	ft_printf(" Options for path monitoring:\n\n");
+	ft_printf("\
+      --monitor              probe every hop continuously (mtr-style)\n\
+      --max-hops=N           probe at most N hops (default 30)\n\n");
+	ft_printf(" Options for multi-homed hosts:\n\n");
+	ft_printf("\
+      --all-addresses        probe every resolved address concurrently and\n\
+                             recommend the best one (-4 / -6 restrict)\n\
+      --parallel             resolve every host concurrently and probe each\n\
+                             one as soon as its address is known\n\
+      --dns-limit=N          at most N lookups in flight (default 64)\n\
+      --dns-timeout=N        give up a lookup after N seconds (default 5)\n\
+      --target-list=FILE     also probe the hosts listed in FILE, one per line\n\
+                             (\"-\" for stdin), implies --parallel; hosts\n\
+                             sharing an address are probed once\n\n");
+	ft_printf(" Options for name resolution:\n\n");
+	ft_printf("\
+      --dns-cache=FILE       keep forward and reverse lookups in FILE; stale\n\
+                             entries are used while being refreshed\n\
+      --dns-cache-ttl=N      cached lookups stay fresh N seconds (default 300)\n\n");
+	ft_printf(" Options for path MTU discovery:\n\n");
+	ft_printf("\
+      --pmtu                 discover the path MTU with DF probes\n\n");
+	ft_printf(" Options for offline analysis:\n\n");
+	ft_printf("\
+      --replay=FILE          compute the statistics of the echo requests and\n\
+                             replies captured in FILE (pcap or pcapng), timed\n\
+                             by the capture; -W bounds the wait of a request\n\
+      --capture=FILE         write the probes sent and the replies received\n\
+                             to FILE (pcapng), rejected replies are marked\n\
+      --capture-size=N       start FILE.1, FILE.2, ... every N MB (default:\n\
+                             one file)\n\n");
+	ft_printf(" Options for high reply rates:\n\n");
+	ft_printf("\
+      --packet-ring          read replies in place from a memory-mapped\n\
+                             AF_PACKET ring with kernel timestamps (needs\n\
+                             raw socket privileges)\n\
+      --rx-workers=NUMBER    with --parallel or --all-addresses, account\n\
+                             replies in NUMBER threads sharing a packet\n\
+                             fanout group, replies are not printed (needs\n\
+                             raw socket privileges)\n\n");
+	ft_printf(" Options for machine-readable output:\n\n");
+	ft_printf("\
+      --output=FORMAT        write one record per probe outcome and per\n\
+                             summary to stdout, FORMAT jsonl or csv; the\n\
+                             text output moves to stderr (not with\n\
+                             --rx-workers)\n\
+      --probe-log=FILE       append one fixed-size binary record per probe\n\
+                             outcome to FILE, readable while probing goes on\n\
+                             (not with --rx-workers)\n\n");
 #endif
 	ft_printf("\
   -%s, --help                 give this help list\n\
@@ -149,9 +216,11 @@ printPingSummary(tPingContext *ctx)
 		ft_printf(" +%u errors", ctx->stats.errors);
 	if (ctx->stats.duplicates > 0)
 		ft_printf(" ++%u duplicates", ctx->stats.duplicates);
+	if (ctx->stats.corrupted > 0)
+		ft_printf(", %u corrupted", ctx->stats.corrupted);
 #endif
 	/* Calculate average RTT and standard deviation */
-	if (ctx->stats.received > 0 && (ctx->opts.packetSize == 0 || ctx->opts.packetSize >= (int)sizeof(struct timeval))) /* if the size is smaller than 16 octets we can't fit a timestamp so no rtt srry :/ */
+	if (ctx->stats.received > 0 && (ctx->opts.packetSize == 0 || ctx->bufs.stampLen > 0)) /* no room for a timestamp / probe header means no rtt srry :/ */
 	{
 		double rttAvg = ctx->stats.rttSum / ctx->stats.received;
 		double rttSddev = 0.0;	/* Average deviation of packet relative to mean RTT */
@@ -0,0 +1,285 @@
+#include <stdlib.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/wheel.h"
+
+#define WHEEL_SPAN_BITS	(WHEEL_SLOT_BITS * WHEEL_LEVELS)
+#define WHEEL_SLOT_MASK	((uint64_t)WHEEL_SLOTS - 1)
+
+/**
+ * @brief Level a tick belongs to: highest bit group where it differs from now
+ */
+static unsigned int
+wheelLevel(uint64_t now, uint64_t tick)
+{
+	uint64_t	diff = now ^ tick;
+
+	if (diff <= WHEEL_SLOT_MASK)
+		return (0);
+	return ((unsigned int)(63 - __builtin_clzll(diff)) / WHEEL_SLOT_BITS);
+}
+
+/**
+ * @brief Put an unlinked timer in the slot of its expiry tick
+ * Past ticks go to the current slot; ticks beyond the top level wait at its
+ * last slot and are placed again from there.
+ */
+static void
+wheelInsert(tWheel *wheel, uint32_t id)
+{
+	uint64_t		tick = wheel->expires[id];
+	uint64_t		last = wheel->now | ((1ULL << WHEEL_SPAN_BITS) - 1);
+	unsigned int	level;
+	unsigned int	slot;
+	uint32_t		*head;
+
+	if (tick < wheel->now)
+		tick = wheel->now;
+	else if (tick > last)
+		tick = last;
+	level = wheelLevel(wheel->now, tick);
+	slot = (unsigned int)((tick >> (level * WHEEL_SLOT_BITS)) & WHEEL_SLOT_MASK);
+	head = &wheel->heads[level][slot];
+	wheel->prev[id] = WHEEL_NIL;
+	wheel->next[id] = *head;
+	if (*head != WHEEL_NIL)
+		wheel->prev[*head] = id;
+	*head = id;
+	wheel->occupied[level] |= 1ULL << slot;
+	wheel->where[id] = (uint16_t)(level * WHEEL_SLOTS + slot);
+}
+
+/**
+ * @brief Take an armed timer out of its slot
+ */
+static void
+wheelUnlink(tWheel *wheel, uint32_t id)
+{
+	unsigned int	level = wheel->where[id] / WHEEL_SLOTS;
+	unsigned int	slot = wheel->where[id] % WHEEL_SLOTS;
+
+	if (wheel->prev[id] != WHEEL_NIL)
+		wheel->next[wheel->prev[id]] = wheel->next[id];
+	else
+		wheel->heads[level][slot] = wheel->next[id];
+	if (wheel->next[id] != WHEEL_NIL)
+		wheel->prev[wheel->next[id]] = wheel->prev[id];
+	if (wheel->heads[level][slot] == WHEEL_NIL)
+		wheel->occupied[level] &= ~(1ULL << slot);
+	wheel->where[id] = WHEEL_UNARMED;
+}
+
+/**
+ * @brief First tick at which a slot expires or cascades
+ * @return tick, UINT64_MAX when no timer is armed
+ */
+static uint64_t
+wheelNextTick(const tWheel *wheel)
+{
+	uint64_t	best = UINT64_MAX;
+
+	for (unsigned int level = 0; level < WHEEL_LEVELS; level++)
+	{
+		unsigned int	shift = level * WHEEL_SLOT_BITS;
+		unsigned int	digit = (unsigned int)((wheel->now >> shift) & WHEEL_SLOT_MASK);
+		uint64_t		mask = wheel->occupied[level] & (~0ULL << digit);
+		uint64_t		tick;
+
+		/* slots behind the current digit are empty: they hold later ticks only
+		   once the digit wraps, which happens through a cascade */
+		if (mask == 0)
+			continue;
+		tick = (wheel->now >> (shift + WHEEL_SLOT_BITS) << (shift + WHEEL_SLOT_BITS))
+			| ((uint64_t)__builtin_ctzll(mask) << shift);
+		if (tick < wheel->now)
+			tick = wheel->now;
+		if (tick < best)
+			best = tick;
+	}
+	return (best);
+}
+
+/**
+ * @brief Move the slots the current tick has reached down to lower levels
+ */
+static void
+wheelCascade(tWheel *wheel)
+{
+	for (unsigned int level = WHEEL_LEVELS - 1; level > 0; level--)
+	{
+		unsigned int	shift = level * WHEEL_SLOT_BITS;
+		unsigned int	slot;
+		uint32_t		id;
+
+		if ((wheel->now & ((1ULL << shift) - 1)) != 0)
+			continue;
+		slot = (unsigned int)((wheel->now >> shift) & WHEEL_SLOT_MASK);
+		if (!(wheel->occupied[level] & (1ULL << slot)))
+			continue;
+		id = wheel->heads[level][slot];
+		wheel->heads[level][slot] = WHEEL_NIL;
+		wheel->occupied[level] &= ~(1ULL << slot);
+		while (id != WHEEL_NIL)
+		{
+			uint32_t	next = wheel->next[id];
+
+			wheelInsert(wheel, id);
+			id = next;
+		}
+	}
+}
+
+void
+wheelInit(tWheel *wheel, uint64_t nowNs)
+{
+	ft_bzero(wheel, sizeof(*wheel));
+	ft_memset(wheel->heads, 0xFF, sizeof(wheel->heads));
+	wheel->originNs = nowNs;
+}
+
+int
+wheelReserve(tWheel *wheel, size_t count)
+{
+	size_t		cap = wheel->cap ? wheel->cap : 64;
+	uint32_t	*next;
+	uint32_t	*prev;
+	uint64_t	*expires;
+	uint16_t	*where;
+
+	if (count <= wheel->cap)
+		return (0);
+	if (count >= WHEEL_NIL)
+		return (-1);
+	while (cap < count)
+		cap *= 2;
+	next = realloc(wheel->next, cap * sizeof(*next));
+	if (next)
+		wheel->next = next;
+	prev = realloc(wheel->prev, cap * sizeof(*prev));
+	if (prev)
+		wheel->prev = prev;
+	expires = realloc(wheel->expires, cap * sizeof(*expires));
+	if (expires)
+		wheel->expires = expires;
+	where = realloc(wheel->where, cap * sizeof(*where));
+	if (where)
+		wheel->where = where;
+	if (!next || !prev || !expires || !where)
+		return (-1);
+	for (size_t i = wheel->cap; i < cap; i++)
+		wheel->where[i] = WHEEL_UNARMED;
+	wheel->cap = cap;
+	return (0);
+}
+
+void
+wheelArm(tWheel *wheel, uint32_t id, uint64_t whenNs)
+{
+	uint64_t	tick = 0;
+
+	if (wheel->where[id] != WHEEL_UNARMED)
+		wheelUnlink(wheel, id);
+	else
+		wheel->armed++;
+	/* rounded up: a timer never fires before its time */
+	if (whenNs > wheel->originNs)
+		tick = (whenNs - wheel->originNs + (1ULL << WHEEL_TICK_SHIFT) - 1) >> WHEEL_TICK_SHIFT;
+	wheel->expires[id] = tick;
+	wheelInsert(wheel, id);
+}
+
+void
+wheelCancel(tWheel *wheel, uint32_t id)
+{
+	if (wheel->where[id] == WHEEL_UNARMED)
+		return;
+	wheelUnlink(wheel, id);
+	wheel->armed--;
+}
+
+tBool
+wheelArmed(const tWheel *wheel, uint32_t id)
+{
+	return (wheel->where[id] != WHEEL_UNARMED);
+}
+
+size_t
+wheelExpire(tWheel *wheel, uint64_t nowNs, uint32_t *out, size_t max)
+{
+	uint64_t	target;
+	uint64_t	tick;
+	size_t		n = 0;
+	uint32_t	*head;
+
+	if (nowNs < wheel->originNs)
+		return (0);
+	target = (nowNs - wheel->originNs) >> WHEEL_TICK_SHIFT;
+	while (n < max)
+	{
+		tick = wheelNextTick(wheel);
+		if (tick > target)
+		{
+			/* nothing before target: jump over the idle ticks */
+			if (target >= wheel->now)
+				wheel->now = target + 1;
+			break;
+		}
+		wheel->now = tick;
+		wheelCascade(wheel);
+		head = &wheel->heads[0][tick & WHEEL_SLOT_MASK];
+		while (*head != WHEEL_NIL && n < max)
+		{
+			uint32_t	id = *head;
+
+			wheelUnlink(wheel, id);
+			if (wheel->expires[id] > tick)
+			{
+				/* parked beyond the top level: placed again, fired only if
+				   the span is exhausted and it lands here once more */
+				wheelInsert(wheel, id);
+				if (wheel->where[id] != (uint16_t)(tick & WHEEL_SLOT_MASK))
+					continue;
+				wheelUnlink(wheel, id);
+			}
+			wheel->armed--;
+			out[n++] = id;
+		}
+		if (*head != WHEEL_NIL)
+			break;
+		wheel->now = tick + 1;
+	}
+	return (n);
+}
+
+uint64_t
+wheelNextNs(const tWheel *wheel)
+{
+	uint64_t	tick;
+
+	if (wheel->armed == 0)
+		return (UINT64_MAX);
+	tick = wheelNextTick(wheel);
+	if (tick == UINT64_MAX)
+		return (UINT64_MAX);
+	return (wheel->originNs + (tick << WHEEL_TICK_SHIFT));
+}
+
+size_t
+wheelMemory(const tWheel *wheel)
+{
+	return (wheel->cap * (sizeof(*wheel->next) + sizeof(*wheel->prev)
+		+ sizeof(*wheel->expires) + sizeof(*wheel->where)));
+}
+
+void
+wheelFree(tWheel *wheel)
+{
+	if (!wheel)
+		return;
+	free(wheel->next);
+	free(wheel->prev);
+	free(wheel->expires);
+	free(wheel->where);
+	ft_bzero(wheel, sizeof(*wheel));
+}
@@ -0,0 +1,195 @@
+#ifndef HAJSIM_SIM_H
+# define HAJSIM_SIM_H
+
+#include <net/if.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/utils.h"
+
+#define PROG_NAME		"hajsim"
+#define SIM_DEV_DEFAULT	"hajsim0"
+#define SIM_MTU			65535			/**< no fragmentation up to the largest echo */
+#define SIM_MAX_RULES	64
+#define SIM_BATCH		256				/**< packets read per wakeup */
+#define SIM_TXQLEN		16384			/**< device queue towards the simulator */
+#define SIM_QUEUE_MAX	(1 << 20)		/**< delayed packets held at once */
+#define SIM_TTL			64
+#define SIM_QUOTE4		(576 - 28)		/**< RFC 1812 4.3.2.3: error fits in 576 bytes */
+#define SIM_QUOTE6		(1280 - 48)		/**< RFC 4443 2.4 (c): error fits in the minimum MTU */
+#define SIM_CHANCE_ONE	(1ULL << 32)	/**< probability 1 on the 32-bit scale */
+
+/**
+ * @brief Behaviour of the hosts of one prefix
+ * Probabilities are on a 32-bit scale (SIM_CHANCE_ONE = always).
+ * - family / addr / prefixLen: the prefix, addr in network order
+ * - delayNs / jitterNs: reply delay, uniformly spread by +- jitter
+ * - loss: request dropped
+ * - dup: reply sent twice
+ * - reorder: reply sent at once, ahead of the delayed ones
+ * - corrupt: one bit of the ICMP message flipped after the checksum
+ * - exceed / unreach: time exceeded or unreachable sent instead of a reply
+ * - ttl: TTL / hop limit of what is sent
+ * - matched: requests that fell in the prefix
+ */
+typedef struct sSimRule
+{
+	int			family;
+	uint8_t		addr[16];
+	unsigned int	prefixLen;
+	uint64_t	delayNs;
+	uint64_t	jitterNs;
+	uint64_t	loss;
+	uint64_t	dup;
+	uint64_t	reorder;
+	uint64_t	corrupt;
+	uint64_t	exceed;
+	uint64_t	unreach;
+	uint8_t		ttl;
+	uint64_t	matched;
+} tSimRule;
+
+/**
+ * @brief Packet waiting for its send time
+ * - dueNs: monotonic send time
+ * - order: arrival order, keeps equal times first in first out
+ */
+typedef struct sSimPending
+{
+	uint64_t	dueNs;
+	uint64_t	order;
+	uint8_t		*data;
+	uint32_t	len;
+} tSimPending;
+
+/**
+ * @brief Min-heap of delayed packets on (dueNs, order)
+ */
+typedef struct sSimQueue
+{
+	tSimPending	*heap;
+	size_t		count;
+	size_t		cap;
+	uint64_t	order;
+} tSimQueue;
+
+/**
+ * @brief Counters printed on exit
+ */
+typedef struct sSimStats
+{
+	uint64_t	received;
+	uint64_t	ignored;
+	uint64_t	unmatched;
+	uint64_t	replied;
+	uint64_t	lost;
+	uint64_t	duplicated;
+	uint64_t	reordered;
+	uint64_t	corrupted;
+	uint64_t	exceeded;
+	uint64_t	unreachable;
+	uint64_t	overflow;
+	uint64_t	writeErrors;
+} tSimStats;
+
+/**
+ * @brief Simulator state
+ * - fd / dev / mtu: the TUN device
+ * - rules: prefixes, longest first
+ * - rng: xorshift state of the impairments
+ * - ipId: identification of generated IPv4 errors
+ */
+typedef struct sSim
+{
+	int			fd;
+	char		dev[IFNAMSIZ];
+	int			mtu;
+	int			verbose;
+	tSimRule	rules[SIM_MAX_RULES];
+	size_t		ruleCount;
+	tSimQueue	queue;
+	tSimStats	stats;
+	uint64_t	rng;
+	uint16_t	ipId;
+} tSim;
+
+/* ----------------- rules.c ----------------- */
+
+/**
+ * @brief Parse PREFIX[,key=value...]
+ * Keys: delay, jitter (ns / us / ms / s, default ms), loss, dup, reorder,
+ * corrupt, exceed, unreach (percent) and ttl.
+ * @param rule - rule to fill
+ * @param spec - rule text
+ * @return 0 on success, -1 with a message on error
+ */
+int			simParseRule(tSimRule *rule, const char *spec);
+
+/**
+ * @brief Sort the rules longest prefix first
+ */
+void		simSortRules(tSim *sim);
+
+/**
+ * @brief Most specific rule covering an address
+ * @param family - AF_INET or AF_INET6
+ * @param addr - address in network order
+ * @return rule, NULL if no prefix covers the address
+ */
+tSimRule	*simMatch(tSim *sim, int family, const uint8_t *addr);
+
+/**
+ * @brief Print a rule on one line
+ */
+void		simPrintRule(const tSimRule *rule);
+
+/* ----------------- tun.c ----------------- */
+
+/**
+ * @brief Open (or attach to) a TUN device, set its MTU and bring it up
+ * @param dev - requested name, replaced by the name the kernel gave
+ * @param mtu - MTU to set
+ * @return non-blocking descriptor, -1 with a message on error
+ */
+int			simTunOpen(char *dev, int mtu);
+
+/* ----------------- queue.c ----------------- */
+
+/**
+ * @brief Hold a copy of a packet until dueNs
+ * @return 0 on success, -1 when the queue is full or out of memory
+ */
+int			simQueuePush(tSimQueue *queue, uint64_t dueNs, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Earliest packet, NULL if the queue is empty
+ */
+tSimPending	*simQueuePeek(tSimQueue *queue);
+
+/**
+ * @brief Drop the earliest packet and its copy
+ */
+void		simQueuePop(tSimQueue *queue);
+
+/**
+ * @brief Release every held packet
+ */
+void		simQueueFree(tSimQueue *queue);
+
+/* ----------------- reply.c ----------------- */
+
+/**
+ * @brief Answer one packet read from the TUN device
+ * @param sim - simulator
+ * @param pkt - packet, modified in place
+ * @param len - packet length
+ * @param nowNs - monotonic time of the read
+ */
+void		simHandle(tSim *sim, uint8_t *pkt, size_t len, uint64_t nowNs);
+
+/**
+ * @brief Send the delayed packets that are due
+ */
+void		simFlush(tSim *sim, uint64_t nowNs);
+
+#endif /* HAJSIM_SIM_H */
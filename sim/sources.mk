@@ -0,0 +1,17 @@
+include ../common/sources.mk
+
+SRC_DIR		= src
+BUILD_DIR	= build
+
+COMMON_DIR		= ../common
+COMMON_BUILD	= $(COMMON_DIR)/build
+
+# Sources
+SRC			= $(SRC_DIR)/main.c \
+			  $(SRC_DIR)/queue.c \
+			  $(SRC_DIR)/reply.c \
+			  $(SRC_DIR)/rules.c \
+			  $(SRC_DIR)/tun.c
+
+# Objects
+OBJ			= $(addprefix $(BUILD_DIR)/, $(notdir $(SRC:.c=.o)))
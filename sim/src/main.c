@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+#include "../../hajlib/include/hgetopt.h"
+
+#include "../includes/sim.h"
+
+static volatile sig_atomic_t	g_stop = 0;
+
+static void
+handleStop(int sig)
+{
+	(void)sig;
+	g_stop = 1;
+}
+
+static uint64_t
+monotonicNs(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+}
+
+static void
+printUsage(void)
+{
+	ft_printf(
+		"Usage: " PROG_NAME " [-v] [-d DEVICE] [-m MTU] [-s SEED] PREFIX[,KEY=VALUE...]...\n"
+		"Answer ICMP and ICMPv6 echo requests routed to a TUN device for whole prefixes.\n"
+		"\n"
+		"  -d DEVICE   TUN device to create or attach to (default " SIM_DEV_DEFAULT ")\n"
+		"  -m MTU      device MTU (default %d, large echoes are not fragmented)\n"
+		"  -s SEED     seed of the impairments, for reproducible runs\n"
+		"  -v          print the rules\n"
+		"  -h          print this help\n"
+		"\n"
+		"Rule keys, applied to every address of the prefix:\n"
+		"  delay=TIME    reply delay (ns, us, ms or s, default ms)\n"
+		"  jitter=TIME   delay spread uniformly by +- TIME\n"
+		"  loss=PCT      requests dropped\n"
+		"  dup=PCT       replies sent twice\n"
+		"  reorder=PCT   replies sent without the delay (needs delay)\n"
+		"  corrupt=PCT   one bit of the ICMP message flipped\n"
+		"  exceed=PCT    time exceeded sent instead of a reply\n"
+		"  unreach=PCT   destination unreachable sent instead of a reply\n"
+		"  ttl=N         TTL / hop limit of the answers (default %d)\n"
+		"\n"
+		"The longest matching prefix applies, other destinations are not answered.\n"
+		"Route the prefixes to the device, e.g.\n"
+		"  ip route add 198.18.64.0/18 dev " SIM_DEV_DEFAULT "\n", SIM_MTU, SIM_TTL);
+}
+
+/**
+ * @brief Parse the options and rules
+ * @return 0 to run, 1 when help was printed, -1 on error
+ */
+static int
+parseSimArgs(tSim *sim, int argc, char **argv)
+{
+	static const tFtLongOption	longOpts[] = {{NULL, 0, 0}};
+	tFtGetopt					state;
+	char						*end;
+	int							ret;
+
+	ft_getoptInit(&state, argc, argv);
+	while ((ret = ft_getoptLong(&state, "d:m:s:vh", longOpts)) != FT_GETOPT_END)
+	{
+		if (ret == FT_GETOPT_ERROR)
+		{
+			printUsage();
+			return (-1);
+		}
+		switch (state.opt)
+		{
+			case 'd': ft_strlcpy(sim->dev, state.optArg, sizeof(sim->dev)); break;
+			case 'm':
+				sim->mtu = (int)ft_strtoul(state.optArg, &end, 10);
+				if (*end != '\0' || sim->mtu < 1280 || sim->mtu > SIM_MTU)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid mtu: %s\n", state.optArg);
+					return (-1);
+				}
+				break;
+			case 's':
+				sim->rng = ft_strtoul(state.optArg, &end, 0);
+				if (*end != '\0')
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid seed: %s\n", state.optArg);
+					return (-1);
+				}
+				break;
+			case 'v': sim->verbose++; break;
+			case 'h': printUsage(); return (1);
+		}
+	}
+	if (state.index >= argc)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": missing prefix\n");
+		return (-1);
+	}
+	for (int i = state.index; i < argc; i++)
+	{
+		if (sim->ruleCount == SIM_MAX_RULES)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": at most %d prefixes\n", SIM_MAX_RULES);
+			return (-1);
+		}
+		if (simParseRule(&sim->rules[sim->ruleCount], argv[i]) != 0)
+			return (-1);
+		sim->ruleCount++;
+	}
+	simSortRules(sim);
+	return (0);
+}
+
+/**
+ * @brief Wait for packets or for the next delayed packet
+ */
+static void
+simWait(tSim *sim)
+{
+	struct pollfd	pfd = {.fd = sim->fd, .events = POLLIN};
+	struct timespec	ts;
+	tSimPending		*next = simQueuePeek(&sim->queue);
+	uint64_t		now;
+	uint64_t		wait;
+
+	if (!next)
+	{
+		ppoll(&pfd, 1, NULL, NULL);
+		return;
+	}
+	now = monotonicNs();
+	if (next->dueNs <= now)
+		return;
+	/* ns precision: poll() milliseconds would skew sub-ms delays */
+	wait = next->dueNs - now;
+	ts.tv_sec = (time_t)(wait / 1000000000ULL);
+	ts.tv_nsec = (long)(wait % 1000000000ULL);
+	ppoll(&pfd, 1, &ts, NULL);
+}
+
+static void
+printSimStats(const tSim *sim)
+{
+	const tSimStats	*st = &sim->stats;
+
+	printf("--- %s statistics ---\n", sim->dev);
+	printf("%lu requests received, %lu answered, %lu lost, %lu ignored, %lu outside the prefixes\n",
+		st->received, st->replied, st->lost, st->ignored, st->unmatched);
+	printf("%lu duplicated, %lu reordered, %lu corrupted, %lu time exceeded, %lu unreachable\n",
+		st->duplicated, st->reordered, st->corrupted, st->exceeded, st->unreachable);
+	if (st->overflow || st->writeErrors || sim->queue.count)
+		printf("%lu dropped on a full queue, %lu write errors, %zu still queued\n",
+			st->overflow, st->writeErrors, sim->queue.count);
+	for (size_t i = 0; sim->verbose && i < sim->ruleCount; i++)
+	{
+		char	addr[INET6_ADDRSTRLEN];
+
+		inet_ntop(sim->rules[i].family, sim->rules[i].addr, addr, sizeof(addr));
+		printf("  %s/%u: %lu requests\n", addr, sim->rules[i].prefixLen, sim->rules[i].matched);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	static tSim	sim;
+	static uint8_t	pkt[SIM_MTU];
+	ssize_t		len;
+	int			ret;
+
+	ft_strlcpy(sim.dev, SIM_DEV_DEFAULT, sizeof(sim.dev));
+	sim.mtu = SIM_MTU;
+	sim.rng = (uint64_t)monotonicNs() ^ ((uint64_t)getpid() << 32);
+	ret = parseSimArgs(&sim, argc, argv);
+	if (ret != 0)
+		return (ret < 0 ? 2 : 0);
+	if (sim.rng == 0)
+		sim.rng = 1;
+	sim.fd = simTunOpen(sim.dev, sim.mtu);
+	if (sim.fd < 0)
+		return (1);
+	signal(SIGINT, handleStop);
+	signal(SIGTERM, handleStop);
+	printf(PROG_NAME ": %s up, mtu %d, %zu prefix%s\n", sim.dev, sim.mtu,
+		sim.ruleCount, sim.ruleCount > 1 ? "es" : "");
+	for (size_t i = 0; sim.verbose && i < sim.ruleCount; i++)
+		simPrintRule(&sim.rules[i]);
+	fflush(stdout);
+	while (!g_stop)
+	{
+		simWait(&sim);
+		for (int n = 0; n < SIM_BATCH; n++)
+		{
+			len = read(sim.fd, pkt, sizeof(pkt));
+			if (len < 0)
+			{
+				if (errno != EAGAIN && errno != EINTR)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": read: %s\n", strerror(errno));
+					g_stop = 1;
+				}
+				break;
+			}
+			simHandle(&sim, pkt, (size_t)len, monotonicNs());
+		}
+		simFlush(&sim, monotonicNs());
+	}
+	printSimStats(&sim);
+	simQueueFree(&sim.queue);
+	close(sim.fd);
+	return (0);
+}
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/sim.h"
+
+/**
+ * @brief Whether a is sent before b
+ */
+static tBool
+pendingBefore(const tSimPending *a, const tSimPending *b)
+{
+	if (a->dueNs != b->dueNs)
+		return (a->dueNs < b->dueNs);
+	return (a->order < b->order);
+}
+
+int
+simQueuePush(tSimQueue *queue, uint64_t dueNs, const uint8_t *data, uint32_t len)
+{
+	tSimPending	item;
+	size_t		i;
+
+	if (queue->count == queue->cap)
+	{
+		size_t		cap = queue->cap ? queue->cap * 2 : 1024;
+		tSimPending	*heap;
+
+		if (cap > SIM_QUEUE_MAX)
+			return (-1);
+		heap = realloc(queue->heap, cap * sizeof(*heap));
+		if (!heap)
+			return (-1);
+		queue->heap = heap;
+		queue->cap = cap;
+	}
+	item.data = malloc(len);
+	if (!item.data)
+		return (-1);
+	ft_memcpy(item.data, data, len);
+	item.len = len;
+	item.dueNs = dueNs;
+	item.order = queue->order++;
+	/* sift up */
+	i = queue->count++;
+	while (i > 0 && pendingBefore(&item, &queue->heap[(i - 1) / 2]))
+	{
+		queue->heap[i] = queue->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	queue->heap[i] = item;
+	return (0);
+}
+
+tSimPending *
+simQueuePeek(tSimQueue *queue)
+{
+	if (queue->count == 0)
+		return (NULL);
+	return (&queue->heap[0]);
+}
+
+void
+simQueuePop(tSimQueue *queue)
+{
+	tSimPending	last;
+	size_t		i = 0;
+
+	if (queue->count == 0)
+		return;
+	free(queue->heap[0].data);
+	last = queue->heap[--queue->count];
+	/* sift down */
+	for (;;)
+	{
+		size_t	child = 2 * i + 1;
+
+		if (child >= queue->count)
+			break;
+		if (child + 1 < queue->count
+			&& pendingBefore(&queue->heap[child + 1], &queue->heap[child]))
+			child++;
+		if (!pendingBefore(&queue->heap[child], &last))
+			break;
+		queue->heap[i] = queue->heap[child];
+		i = child;
+	}
+	if (queue->count > 0)
+		queue->heap[i] = last;
+}
+
+void
+simQueueFree(tSimQueue *queue)
+{
+	if (!queue)
+		return;
+	for (size_t i = 0; i < queue->count; i++)
+		free(queue->heap[i].data);
+	free(queue->heap);
+	ft_bzero(queue, sizeof(*queue));
+}
@@ -0,0 +1,374 @@
+#include <arpa/inet.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../../common/includes/icmp.h"
+#include "../../common/includes/ip.h"
+
+#include "../includes/sim.h"
+
+#define IP4_HDR_LEN		20
+#define IP6_HDR_LEN		40
+
+/**
+ * @brief Next value of the xorshift64* generator
+ */
+static uint64_t
+simRandom(tSim *sim)
+{
+	sim->rng ^= sim->rng >> 12;
+	sim->rng ^= sim->rng << 25;
+	sim->rng ^= sim->rng >> 27;
+	return (sim->rng * 0x2545F4914F6CDD1DULL);
+}
+
+/**
+ * @brief Draw an event of probability chance (32-bit scale)
+ */
+static tBool
+simChance(tSim *sim, uint64_t chance)
+{
+	if (chance == 0)
+		return (FALSE);
+	return ((simRandom(sim) >> 32) < chance);
+}
+
+/**
+ * @brief Draw whether a request gets an error instead of a reply
+ * One draw serves both kinds, so unreach + exceed is the error rate.
+ * @param exceed - set to TRUE for time exceeded, FALSE for unreachable
+ * @return TRUE if an error is to be sent
+ */
+static tBool
+simDrawError(tSim *sim, tSimRule *rule, tBool *exceed)
+{
+	uint64_t	draw;
+
+	if (rule->unreach == 0 && rule->exceed == 0)
+		return (FALSE);
+	draw = simRandom(sim) >> 32;
+	if (draw < rule->unreach)
+	{
+		*exceed = FALSE;
+		sim->stats.unreachable++;
+		return (TRUE);
+	}
+	if (draw < rule->unreach + rule->exceed)
+	{
+		*exceed = TRUE;
+		sim->stats.exceeded++;
+		return (TRUE);
+	}
+	return (FALSE);
+}
+
+/**
+ * @brief Update a checksum for one changed 16-bit word (RFC 1624 eqn. 3)
+ * Words are taken in memory order, like the checksum itself.
+ */
+static uint16_t
+checksumReplace(uint16_t check, uint16_t oldWord, uint16_t newWord)
+{
+	uint32_t	sum = (uint16_t)~check + (uint32_t)(uint16_t)~oldWord + newWord;
+
+	return (icmpChecksumFinish(sum));
+}
+
+/**
+ * @brief Turn an echo request into a reply: type byte and checksum
+ * @param icmp - ICMP message
+ * @param type - reply type
+ */
+static void
+setReplyType(uint8_t *icmp, uint8_t type)
+{
+	uint16_t	oldWord;
+	uint16_t	newWord;
+	uint16_t	check;
+
+	ft_memcpy(&oldWord, icmp, 2);
+	icmp[0] = type;
+	ft_memcpy(&newWord, icmp, 2);
+	ft_memcpy(&check, icmp + 2, 2);
+	check = checksumReplace(check, oldWord, newWord);
+	ft_memcpy(icmp + 2, &check, 2);
+}
+
+/**
+ * @brief Write a packet now or hold it for the delay of its rule
+ * Jitter is drawn per packet, so the spread alone may reorder replies as
+ * with netem; reorder sends the packet without the delay.
+ */
+static void
+simEmit(tSim *sim, const tSimRule *rule, const uint8_t *pkt, size_t len, uint64_t nowNs)
+{
+	uint64_t	delay = rule->delayNs;
+
+	if (rule->jitterNs)
+	{
+		uint64_t	span = 2 * rule->jitterNs + 1;
+		uint64_t	offset = simRandom(sim) % span;
+
+		delay = delay + offset > rule->jitterNs ? delay + offset - rule->jitterNs : 0;
+	}
+	if (delay && simChance(sim, rule->reorder))
+	{
+		delay = 0;
+		sim->stats.reordered++;
+	}
+	if (delay == 0)
+	{
+		if (write(sim->fd, pkt, len) < 0)
+			sim->stats.writeErrors++;
+		return;
+	}
+	if (simQueuePush(&sim->queue, nowNs + delay, pkt, (uint32_t)len) != 0)
+		sim->stats.overflow++;
+}
+
+/**
+ * @brief Emit a packet, duplicated and corrupted as its rule asks
+ * @param icmpOff - offset of the ICMP message, where corruption happens
+ */
+static void
+simSend(tSim *sim, const tSimRule *rule, uint8_t *pkt, size_t len, size_t icmpOff, uint64_t nowNs)
+{
+	if (len > icmpOff && simChance(sim, rule->corrupt))
+	{
+		uint64_t	bit = simRandom(sim) % ((len - icmpOff) * 8);
+
+		pkt[icmpOff + bit / 8] ^= (uint8_t)(1 << (bit % 8));
+		sim->stats.corrupted++;
+	}
+	simEmit(sim, rule, pkt, len, nowNs);
+	if (simChance(sim, rule->dup))
+	{
+		simEmit(sim, rule, pkt, len, nowNs);
+		sim->stats.duplicated++;
+	}
+}
+
+/* ----------------- IPv4 ----------------- */
+
+/**
+ * @brief Send time exceeded or destination unreachable for a request
+ * The probed address answers itself, quoting the request.
+ */
+static void
+simError4(tSim *sim, const tSimRule *rule, const uint8_t *req, size_t len, tBool exceed, uint64_t nowNs)
+{
+	uint8_t		out[IP4_HDR_LEN + ICMP4_HDR_LEN + SIM_QUOTE4];
+	size_t		quote = len < SIM_QUOTE4 ? len : SIM_QUOTE4;
+	size_t		total = IP4_HDR_LEN + ICMP4_HDR_LEN + quote;
+	uint8_t		*icmp = out + IP4_HDR_LEN;
+	uint16_t	word;
+
+	ft_bzero(out, IP4_HDR_LEN + ICMP4_HDR_LEN);
+	out[0] = 0x45;
+	out[1] = 0xC0;	/* internetwork control, like router generated errors */
+	word = htons((uint16_t)total);
+	ft_memcpy(out + 2, &word, 2);
+	word = htons(sim->ipId++);
+	ft_memcpy(out + 4, &word, 2);
+	out[8] = rule->ttl;
+	out[9] = IP_PROTO_ICMP;
+	ft_memcpy(out + 12, req + 16, 4);
+	ft_memcpy(out + 16, req + 12, 4);
+	word = icmpChecksum(out, IP4_HDR_LEN);
+	ft_memcpy(out + 10, &word, 2);
+	icmp[0] = exceed ? ICMP4_TIME_EXCEEDED : ICMP4_DEST_UNREACH;
+	icmp[1] = exceed ? 0 : 1;	/* TTL exceeded in transit, host unreachable */
+	ft_memcpy(icmp + ICMP4_HDR_LEN, req, quote);
+	word = icmpChecksum(icmp, (uint32_t)(total - IP4_HDR_LEN));
+	ft_memcpy(icmp + 2, &word, 2);
+	simSend(sim, rule, out, total, IP4_HDR_LEN, nowNs);
+}
+
+static void
+simHandle4(tSim *sim, uint8_t *pkt, size_t len, uint64_t nowNs)
+{
+	size_t		ihl = (size_t)(pkt[0] & 0x0F) * 4;
+	size_t		total;
+	tSimRule	*rule;
+	tBool		exceed;
+	uint8_t		addr[4];
+	uint16_t	word;
+
+	if (len < IP4_HDR_LEN || ihl < IP4_HDR_LEN)
+		goto ignore;
+	total = (size_t)pkt[2] << 8 | pkt[3];
+	/* only whole echo requests: fragments are not reassembled */
+	if (total > len || total < ihl + ICMP4_HDR_LEN || pkt[9] != IP_PROTO_ICMP
+		|| (pkt[6] & 0x3F) != 0 || pkt[7] != 0
+		|| pkt[ihl] != ICMP4_ECHO_REQUEST || pkt[ihl + 1] != 0)
+		goto ignore;
+	rule = simMatch(sim, AF_INET, pkt + 16);
+	if (!rule)
+	{
+		sim->stats.unmatched++;
+		return;
+	}
+	rule->matched++;
+	if (simChance(sim, rule->loss))
+	{
+		sim->stats.lost++;
+		return;
+	}
+	if (simDrawError(sim, rule, &exceed))
+	{
+		simError4(sim, rule, pkt, total, exceed, nowNs);
+		return;
+	}
+	ft_memcpy(addr, pkt + 12, 4);
+	ft_memcpy(pkt + 12, pkt + 16, 4);
+	ft_memcpy(pkt + 16, addr, 4);
+	pkt[8] = rule->ttl;
+	pkt[10] = 0;
+	pkt[11] = 0;
+	word = icmpChecksum(pkt, (uint32_t)ihl);
+	ft_memcpy(pkt + 10, &word, 2);
+	setReplyType(pkt + ihl, ICMP4_ECHO_REPLY);
+	sim->stats.replied++;
+	simSend(sim, rule, pkt, total, ihl, nowNs);
+	return;
+ignore:
+	sim->stats.ignored++;
+}
+
+/* ----------------- IPv6 ----------------- */
+
+/**
+ * @brief ICMPv6 checksum of a packet laid out as base header + message
+ */
+static uint16_t
+checksum6(const uint8_t *pkt, size_t icmpLen)
+{
+	struct in6_addr	src;
+	struct in6_addr	dst;
+
+	ft_memcpy(&src, pkt + 8, 16);
+	ft_memcpy(&dst, pkt + 24, 16);
+	return (icmpv6Checksum(&src, &dst, pkt + IP6_HDR_LEN, (uint32_t)icmpLen));
+}
+
+/**
+ * @brief Send time exceeded or address unreachable for a request
+ */
+static void
+simError6(tSim *sim, const tSimRule *rule, const uint8_t *req, size_t len, tBool exceed, uint64_t nowNs)
+{
+	uint8_t		out[IP6_HDR_LEN + ICMP6_HDR_LEN + SIM_QUOTE6];
+	size_t		quote = len < SIM_QUOTE6 ? len : SIM_QUOTE6;
+	size_t		icmpLen = ICMP6_HDR_LEN + quote;
+	uint8_t		*icmp = out + IP6_HDR_LEN;
+	uint16_t	word;
+
+	ft_bzero(out, IP6_HDR_LEN + ICMP6_HDR_LEN);
+	out[0] = 0x60;
+	word = htons((uint16_t)icmpLen);
+	ft_memcpy(out + 4, &word, 2);
+	out[6] = IP_PROTO_ICMPV6;
+	out[7] = rule->ttl;
+	ft_memcpy(out + 8, req + 24, 16);
+	ft_memcpy(out + 24, req + 8, 16);
+	icmp[0] = exceed ? ICMP6_TIME_EXCEEDED : ICMP6_DEST_UNREACH;
+	icmp[1] = exceed ? 0 : 3;	/* hop limit exceeded, address unreachable */
+	ft_memcpy(icmp + ICMP6_HDR_LEN, req, quote);
+	word = checksum6(out, icmpLen);
+	ft_memcpy(icmp + 2, &word, 2);
+	simSend(sim, rule, out, IP6_HDR_LEN + icmpLen, IP6_HDR_LEN, nowNs);
+}
+
+static void
+simHandle6(tSim *sim, uint8_t *pkt, size_t len, uint64_t nowNs)
+{
+	tIp6Hdr		hdr;
+	size_t		hdrLen;
+	size_t		total;
+	size_t		icmpLen;
+	tSimRule	*rule;
+	tBool		exceed;
+	uint8_t		addr[16];
+	uint16_t	word;
+
+	hdrLen = parseIp6HeaderFromBuffer(pkt, len, &hdr);
+	if (hdrLen == 0)
+		goto ignore;
+	total = IP6_HDR_LEN + (size_t)hdr.payload_len;
+	if (total > len || hdr.next_header != IP_PROTO_ICMPV6
+		|| total < hdrLen + ICMP6_HDR_LEN
+		|| pkt[hdrLen] != ICMP6_ECHO_REQUEST || pkt[hdrLen + 1] != 0)
+		goto ignore;
+	rule = simMatch(sim, AF_INET6, pkt + 24);
+	if (!rule)
+	{
+		sim->stats.unmatched++;
+		return;
+	}
+	rule->matched++;
+	if (simChance(sim, rule->loss))
+	{
+		sim->stats.lost++;
+		return;
+	}
+	if (simDrawError(sim, rule, &exceed))
+	{
+		simError6(sim, rule, pkt, total, exceed, nowNs);
+		return;
+	}
+	icmpLen = total - hdrLen;
+	ft_memcpy(addr, pkt + 8, 16);
+	ft_memcpy(pkt + 8, pkt + 24, 16);
+	ft_memcpy(pkt + 24, addr, 16);
+	pkt[7] = rule->ttl;
+	if (hdrLen == IP6_HDR_LEN)
+	{
+		/* swapping the addresses leaves the pseudo-header sum unchanged */
+		setReplyType(pkt + IP6_HDR_LEN, ICMP6_ECHO_REPLY);
+	}
+	else
+	{
+		/* extension headers are not echoed back */
+		memmove(pkt + IP6_HDR_LEN, pkt + hdrLen, icmpLen);
+		word = htons((uint16_t)icmpLen);
+		ft_memcpy(pkt + 4, &word, 2);
+		pkt[6] = IP_PROTO_ICMPV6;
+		pkt[IP6_HDR_LEN] = ICMP6_ECHO_REPLY;
+		pkt[IP6_HDR_LEN + 2] = 0;
+		pkt[IP6_HDR_LEN + 3] = 0;
+		word = checksum6(pkt, icmpLen);
+		ft_memcpy(pkt + IP6_HDR_LEN + 2, &word, 2);
+	}
+	sim->stats.replied++;
+	simSend(sim, rule, pkt, IP6_HDR_LEN + icmpLen, IP6_HDR_LEN, nowNs);
+	return;
+ignore:
+	sim->stats.ignored++;
+}
+
+void
+simHandle(tSim *sim, uint8_t *pkt, size_t len, uint64_t nowNs)
+{
+	sim->stats.received++;
+	if (len >= 1 && pkt[0] >> 4 == 4)
+		simHandle4(sim, pkt, len, nowNs);
+	else if (len >= 1 && pkt[0] >> 4 == 6)
+		simHandle6(sim, pkt, len, nowNs);
+	else
+		sim->stats.ignored++;
+}
+
+void
+simFlush(tSim *sim, uint64_t nowNs)
+{
+	tSimPending	*next;
+
+	while ((next = simQueuePeek(&sim->queue)) && next->dueNs <= nowNs)
+	{
+		if (write(sim->fd, next->data, next->len) < 0)
+			sim->stats.writeErrors++;
+		simQueuePop(&sim->queue);
+	}
+}
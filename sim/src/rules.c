@@ -0,0 +1,233 @@
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/sim.h"
+
+#define RULE_SPEC_MAX	256
+
+/**
+ * @brief Parse a duration, milliseconds when no unit is given
+ * @return 0 on success, -1 on a malformed value
+ */
+static int
+parseDuration(const char *str, uint64_t *ns)
+{
+	char	*end;
+	double	value = ft_strtod(str, &end);
+	double	scale = 1e6;
+
+	if (end == str || value < 0)
+		return (-1);
+	if (ft_strcmp(end, "ns") == 0)
+		scale = 1;
+	else if (ft_strcmp(end, "us") == 0)
+		scale = 1e3;
+	else if (ft_strcmp(end, "s") == 0)
+		scale = 1e9;
+	else if (*end != '\0' && ft_strcmp(end, "ms") != 0)
+		return (-1);
+	*ns = (uint64_t)(value * scale);
+	return (0);
+}
+
+/**
+ * @brief Parse a percentage (the % sign is optional) on the 32-bit scale
+ * @return 0 on success, -1 on a malformed value
+ */
+static int
+parseChance(const char *str, uint64_t *chance)
+{
+	char	*end;
+	double	value = ft_strtod(str, &end);
+
+	if (end == str || value < 0 || value > 100
+		|| (*end != '\0' && ft_strcmp(end, "%") != 0))
+		return (-1);
+	*chance = (uint64_t)(value / 100.0 * (double)SIM_CHANCE_ONE);
+	return (0);
+}
+
+/**
+ * @brief Parse ADDR[/LEN] and clear the host bits
+ * @return 0 on success, -1 on a malformed prefix
+ */
+static int
+parsePrefix(tSimRule *rule, char *str)
+{
+	char			*slash = strchr(str, '/');
+	unsigned int	maxLen;
+	char			*end;
+
+	if (slash)
+		*slash = '\0';
+	if (inet_pton(AF_INET, str, rule->addr) == 1)
+		rule->family = AF_INET;
+	else if (inet_pton(AF_INET6, str, rule->addr) == 1)
+		rule->family = AF_INET6;
+	else
+		return (-1);
+	maxLen = rule->family == AF_INET ? 32 : 128;
+	rule->prefixLen = maxLen;
+	if (slash)
+	{
+		rule->prefixLen = (unsigned int)ft_strtoul(slash + 1, &end, 10);
+		if (end == slash + 1 || *end != '\0' || rule->prefixLen > maxLen)
+			return (-1);
+	}
+	for (unsigned int bit = rule->prefixLen; bit < maxLen; bit++)
+		rule->addr[bit / 8] &= (uint8_t)~(0x80 >> (bit % 8));
+	return (0);
+}
+
+/**
+ * @brief Apply one key=value setting
+ * @return 0 on success, -1 on an unknown key or a malformed value
+ */
+static int
+parseSetting(tSimRule *rule, const char *key, const char *value)
+{
+	char			*end;
+	unsigned long	ttl;
+
+	if (ft_strcmp(key, "delay") == 0)
+		return (parseDuration(value, &rule->delayNs));
+	if (ft_strcmp(key, "jitter") == 0)
+		return (parseDuration(value, &rule->jitterNs));
+	if (ft_strcmp(key, "loss") == 0)
+		return (parseChance(value, &rule->loss));
+	if (ft_strcmp(key, "dup") == 0)
+		return (parseChance(value, &rule->dup));
+	if (ft_strcmp(key, "reorder") == 0)
+		return (parseChance(value, &rule->reorder));
+	if (ft_strcmp(key, "corrupt") == 0)
+		return (parseChance(value, &rule->corrupt));
+	if (ft_strcmp(key, "exceed") == 0)
+		return (parseChance(value, &rule->exceed));
+	if (ft_strcmp(key, "unreach") == 0)
+		return (parseChance(value, &rule->unreach));
+	if (ft_strcmp(key, "ttl") == 0)
+	{
+		ttl = ft_strtoul(value, &end, 10);
+		if (end == value || *end != '\0' || ttl == 0 || ttl > 255)
+			return (-1);
+		rule->ttl = (uint8_t)ttl;
+		return (0);
+	}
+	return (-1);
+}
+
+int
+simParseRule(tSimRule *rule, const char *spec)
+{
+	char	buf[RULE_SPEC_MAX];
+	char	*field;
+	char	*next;
+	char	*eq;
+
+	ft_bzero(rule, sizeof(*rule));
+	rule->ttl = SIM_TTL;
+	if (ft_strlcpy(buf, spec, sizeof(buf)) >= sizeof(buf))
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": rule too long: %s\n", spec);
+		return (-1);
+	}
+	next = strchr(buf, ',');
+	if (next)
+		*next++ = '\0';
+	if (parsePrefix(rule, buf) != 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid prefix in rule: %s\n", spec);
+		return (-1);
+	}
+	while (next)
+	{
+		field = next;
+		next = strchr(field, ',');
+		if (next)
+			*next++ = '\0';
+		eq = strchr(field, '=');
+		if (!eq)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": expected key=value: %s\n", field);
+			return (-1);
+		}
+		*eq = '\0';
+		if (parseSetting(rule, field, eq + 1) != 0)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid setting %s=%s\n", field, eq + 1);
+			return (-1);
+		}
+	}
+	return (0);
+}
+
+static int
+cmpRule(const void *a, const void *b)
+{
+	const tSimRule	*x = a;
+	const tSimRule	*y = b;
+
+	return ((int)y->prefixLen - (int)x->prefixLen);
+}
+
+void
+simSortRules(tSim *sim)
+{
+	qsort(sim->rules, sim->ruleCount, sizeof(*sim->rules), cmpRule);
+}
+
+/**
+ * @brief Whether the first prefixLen bits of addr match the rule
+ */
+static tBool
+ruleCovers(const tSimRule *rule, const uint8_t *addr)
+{
+	unsigned int	bytes = rule->prefixLen / 8;
+	unsigned int	bits = rule->prefixLen % 8;
+	uint8_t			mask;
+
+	if (ft_memcmp(rule->addr, addr, bytes) != 0)
+		return (FALSE);
+	if (bits == 0)
+		return (TRUE);
+	mask = (uint8_t)(0xFF << (8 - bits));
+	return ((addr[bytes] & mask) == rule->addr[bytes]);
+}
+
+tSimRule *
+simMatch(tSim *sim, int family, const uint8_t *addr)
+{
+	for (size_t i = 0; i < sim->ruleCount; i++)
+	{
+		if (sim->rules[i].family == family && ruleCovers(&sim->rules[i], addr))
+			return (&sim->rules[i]);
+	}
+	return (NULL);
+}
+
+/**
+ * @brief Probability on the 32-bit scale as a percentage
+ */
+static double
+chancePercent(uint64_t chance)
+{
+	return ((double)chance * 100.0 / (double)SIM_CHANCE_ONE);
+}
+
+void
+simPrintRule(const tSimRule *rule)
+{
+	char	addr[INET6_ADDRSTRLEN];
+
+	inet_ntop(rule->family, rule->addr, addr, sizeof(addr));
+	printf("%s/%u: delay %.3f ms +- %.3f ms, loss %.2f%%, dup %.2f%%, reorder %.2f%%,"
+		" corrupt %.2f%%, exceed %.2f%%, unreach %.2f%%, ttl %u\n",
+		addr, rule->prefixLen, rule->delayNs / 1e6, rule->jitterNs / 1e6,
+		chancePercent(rule->loss), chancePercent(rule->dup),
+		chancePercent(rule->reorder), chancePercent(rule->corrupt),
+		chancePercent(rule->exceed), chancePercent(rule->unreach), rule->ttl);
+}
@@ -0,0 +1,81 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/if_tun.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/sim.h"
+
+/**
+ * @brief Set the MTU and queue length of an interface and bring it up
+ * The default queue of 500 packets overflows during flood bursts.
+ * @return 0 on success, -1 with a message on error
+ */
+static int
+tunLinkUp(const char *dev, int mtu)
+{
+	struct ifreq	ifr;
+	int				sock;
+	int				ret = -1;
+
+	sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": socket: %s\n", strerror(errno));
+		return (-1);
+	}
+	ft_bzero(&ifr, sizeof(ifr));
+	ft_strlcpy(ifr.ifr_name, dev, IFNAMSIZ);
+	ifr.ifr_mtu = mtu;
+	if (ioctl(sock, SIOCSIFMTU, &ifr) < 0)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: cannot set mtu %d: %s\n", dev, mtu, strerror(errno));
+	else if ((ifr.ifr_qlen = SIM_TXQLEN) && ioctl(sock, SIOCSIFTXQLEN, &ifr) < 0)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: cannot set txqueuelen: %s\n", dev, strerror(errno));
+	else if (ioctl(sock, SIOCGIFFLAGS, &ifr) < 0)
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", dev, strerror(errno));
+	else
+	{
+		ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+		if (ioctl(sock, SIOCSIFFLAGS, &ifr) < 0)
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: cannot bring up: %s\n", dev, strerror(errno));
+		else
+			ret = 0;
+	}
+	close(sock);
+	return (ret);
+}
+
+int
+simTunOpen(char *dev, int mtu)
+{
+	struct ifreq	ifr;
+	int				fd;
+
+	fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": /dev/net/tun: %s\n", strerror(errno));
+		return (-1);
+	}
+	ft_bzero(&ifr, sizeof(ifr));
+	/* bare IP packets, no packet information prefix */
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+	ft_strlcpy(ifr.ifr_name, dev, IFNAMSIZ);
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", dev, strerror(errno));
+		close(fd);
+		return (-1);
+	}
+	ft_strlcpy(dev, ifr.ifr_name, IFNAMSIZ);
+	if (tunLinkUp(dev, mtu) != 0)
+	{
+		close(fd);
+		return (-1);
+	}
+	return (fd);
+}
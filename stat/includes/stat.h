@@ -0,0 +1,200 @@
+#ifndef HAJSTAT_STAT_H
+# define HAJSTAT_STAT_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../common/includes/utils.h"
+#include "../../ping/includes/plog.h"
+#include "../../ping/includes/stats.h"
+
+#define PROG_NAME			"hajstat"
+#define STAT_MAX_THREADS	64
+#define STAT_WINDOW_DEFAULT	300			/**< seconds of a window */
+#define STAT_PCT_DEFAULT	99.0		/**< percentile reported */
+#define STAT_TABLE_INITIAL	256			/**< first allocation of a table, power of two */
+#define STAT_NO_TARGET		UINT32_MAX	/**< free slot of the target index */
+
+/**
+ * @brief Target, the same name and address in every log
+ * - name / addr: as in the dictionaries
+ * - hash: of the name and address
+ */
+typedef struct sStatTarget
+{
+	char		name[PLOG_NAME_LEN];
+	char		addr[PLOG_ADDR_LEN];
+	uint64_t	hash;
+} tStatTarget;
+
+/**
+ * @brief One probe log, opened read-only
+ * - path / fd: the file
+ * - blocks: blocks started when it was opened, later ones are left out
+ * - targets / entries: global target of each dictionary entry
+ *   (STAT_NO_TARGET for an incomplete entry)
+ */
+typedef struct sStatLog
+{
+	const char	*path;
+	int			fd;
+	uint32_t	blocks;
+	uint32_t	*targets;
+	uint32_t	entries;
+} tStatLog;
+
+/**
+ * @brief Records block to scan
+ * - log: file it belongs to
+ * - index: block number in the file
+ */
+typedef struct sStatBlock
+{
+	const tStatLog	*log;
+	uint32_t		index;
+} tStatBlock;
+
+/**
+ * @brief Statistics of one target in one window, with the live accumulators
+ * - target / window: the key, window the start time divided by the window
+ *   length (0 for a single window); used tells a free slot
+ * - stats / hist / jitter: as hajping keeps them per target
+ */
+typedef struct sStatCell
+{
+	uint32_t		target;
+	tBool			used;
+	uint64_t		window;
+	tPingStats		stats;
+	tRttHistogram	hist;
+	tRttJitter		jitter;
+} tStatCell;
+
+/**
+ * @brief Open-addressing table of cells, cap a power of two kept at least
+ * twice count
+ */
+typedef struct sStatTable
+{
+	tStatCell	*cells;
+	size_t		count;
+	size_t		cap;
+} tStatTable;
+
+/**
+ * @brief Scan thread, owns a contiguous run of records blocks
+ * - stat: analysis it belongs to
+ * - thread / started: the thread, started until joined
+ * - first / last: blocks [first, last) of stat->blocks
+ * - table: partial results, merged in thread order
+ * - records: records accounted
+ * - skipped: records incomplete, out of range or of an unknown target
+ * - failed: a mapping or an allocation failed
+ */
+typedef struct sStatWorker
+{
+	struct sStat	*stat;
+	pthread_t		thread;
+	tBool			started;
+	size_t			first;
+	size_t			last;
+	tStatTable		table;
+	uint64_t		records;
+	uint64_t		skipped;
+	tBool			failed;
+} tStatWorker;
+
+/**
+ * @brief Analysis state
+ * - logs / logCount: the input files
+ * - targets / targetCount / targetCap: targets of every dictionary
+ * - index / indexCap: open addressing on the target hash, power of two
+ *   kept at least twice targetCount
+ * - blocks / blockCount / blockCap: records blocks, in file and block order
+ * - windowNs: window length, 0 for one window over the whole range
+ * - fromNs / toNs: records kept, wall clock ns [fromNs, toNs]
+ * - percentile: reported RTT percentile
+ * - threads: scan threads
+ * - csv / verbose: output format and per-thread counts
+ * - workers: scan threads
+ */
+typedef struct sStat
+{
+	tStatLog		*logs;
+	size_t			logCount;
+	tStatTarget		*targets;
+	size_t			targetCount;
+	size_t			targetCap;
+	uint32_t		*index;
+	size_t			indexCap;
+	tStatBlock		*blocks;
+	size_t			blockCount;
+	size_t			blockCap;
+	uint64_t		windowNs;
+	uint64_t		fromNs;
+	uint64_t		toNs;
+	double			percentile;
+	unsigned int	threads;
+	tBool			csv;
+	int				verbose;
+	tStatWorker		workers[STAT_MAX_THREADS];
+} tStat;
+
+/* ----------------- logs.c ----------------- */
+
+/**
+ * @brief Open a probe log, add its dictionary to the targets and its
+ * records blocks to the scan
+ * @param stat - analysis
+ * @param log - file to open (path set)
+ * @return 0 on success, -1 with a message on error
+ */
+int			statLogOpen(tStat *stat, tStatLog *log);
+
+/**
+ * @brief Close the files and release the targets and blocks
+ */
+void		statLogsFree(tStat *stat);
+
+/* ----------------- table.c ----------------- */
+
+/**
+ * @brief Cell of a target and window, added empty the first time
+ * @return the cell, NULL on allocation failure
+ */
+tStatCell	*statCell(tStatTable *table, uint32_t target, uint64_t window);
+
+/**
+ * @brief Add the samples of a cell that followed those of dst
+ */
+void		statCellMerge(tStatCell *dst, const tStatCell *src);
+
+/**
+ * @brief Release the cells
+ */
+void		statTableFree(tStatTable *table);
+
+/* ----------------- scan.c ----------------- */
+
+/**
+ * @brief Split the blocks over the threads, scan them and merge the
+ * partial results in block order
+ * @param stat - analysis with its logs open
+ * @param out - merged cells
+ * @return 0 on success, -1 with a message on error
+ */
+int			statScan(tStat *stat, tStatTable *out);
+
+/* ----------------- report.c ----------------- */
+
+/**
+ * @brief Print one row per target and window, then one total per target
+ * with its availability (windows with a reply among windows probed)
+ * @param stat - analysis
+ * @param table - merged cells
+ * @return 0 on success, -1 on allocation failure
+ */
+int			statReport(const tStat *stat, const tStatTable *table);
+
+#endif /* HAJSTAT_STAT_H */
@@ -0,0 +1,21 @@
+include ../common/sources.mk
+
+SRC_DIR		= src
+BUILD_DIR	= build
+
+COMMON_DIR		= ../common
+COMMON_BUILD	= $(COMMON_DIR)/build
+
+# The stats accumulators of hajping, so live and offline numbers agree
+PING_DIR	= ../ping/src
+
+# Sources
+SRC			= $(SRC_DIR)/main.c \
+			  $(SRC_DIR)/logs.c \
+			  $(SRC_DIR)/report.c \
+			  $(SRC_DIR)/scan.c \
+			  $(SRC_DIR)/table.c \
+			  $(PING_DIR)/stats.c
+
+# Objects
+OBJ			= $(addprefix $(BUILD_DIR)/, $(notdir $(SRC:.c=.o)))
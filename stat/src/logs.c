@@ -0,0 +1,213 @@
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/stat.h"
+
+/**
+ * @brief Double the target index
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+growIndex(tStat *stat)
+{
+	size_t		cap = stat->indexCap ? stat->indexCap * 2 : STAT_TABLE_INITIAL;
+	uint32_t	*index = malloc(cap * sizeof(*index));
+
+	if (!index)
+		return (-1);
+	ft_memset(index, 0xFF, cap * sizeof(*index));
+	for (size_t t = 0; t < stat->targetCount; t++)
+	{
+		size_t	i = stat->targets[t].hash & (cap - 1);
+
+		while (index[i] != STAT_NO_TARGET)
+			i = (i + 1) & (cap - 1);
+		index[i] = (uint32_t)t;
+	}
+	free(stat->index);
+	stat->index = index;
+	stat->indexCap = cap;
+	return (0);
+}
+
+/**
+ * @brief Global target of a dictionary entry, added the first time
+ * @return the target, STAT_NO_TARGET on allocation failure
+ */
+static uint32_t
+addTarget(tStat *stat, const tPlogEntry *entry)
+{
+	tStatTarget	t;
+	tStatTarget	*grown;
+	size_t		i;
+
+	/* the last byte stays 0 even if the entry is not terminated */
+	ft_bzero(&t, sizeof(t));
+	ft_memcpy(t.name, entry->name, sizeof(t.name) - 1);
+	ft_memcpy(t.addr, entry->addr, sizeof(t.addr) - 1);
+	t.hash = plogHash(t.name, ft_strlen(t.name), t.addr, ft_strlen(t.addr));
+	if ((stat->targetCount + 1) * 2 > stat->indexCap && growIndex(stat) != 0)
+		return (STAT_NO_TARGET);
+	for (i = t.hash & (stat->indexCap - 1); stat->index[i] != STAT_NO_TARGET;
+		i = (i + 1) & (stat->indexCap - 1))
+	{
+		const tStatTarget	*o = &stat->targets[stat->index[i]];
+
+		if (o->hash == t.hash && ft_strcmp(o->name, t.name) == 0 && ft_strcmp(o->addr, t.addr) == 0)
+			return (stat->index[i]);
+	}
+	if (stat->targetCount == stat->targetCap)
+	{
+		grown = realloc(stat->targets, (stat->targetCap ? stat->targetCap * 2 : STAT_TABLE_INITIAL)
+			* sizeof(*grown));
+		if (!grown)
+			return (STAT_NO_TARGET);
+		stat->targets = grown;
+		stat->targetCap = stat->targetCap ? stat->targetCap * 2 : STAT_TABLE_INITIAL;
+	}
+	stat->targets[stat->targetCount] = t;
+	stat->index[i] = (uint32_t)stat->targetCount;
+	return ((uint32_t)stat->targetCount++);
+}
+
+/**
+ * @brief Map the entries of a dictionary block to global targets
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+loadDict(tStat *stat, tStatLog *log, const tPlogBlock *blk)
+{
+	const tPlogEntry	*e = plogBlockEntries(blk);
+	uint32_t			count = plogBlockCount(blk);
+	uint32_t			*grown;
+
+	grown = realloc(log->targets, (log->entries + count + 1) * sizeof(*grown));
+	if (!grown)
+		return (-1);
+	log->targets = grown;
+	for (uint32_t i = 0; i < count; i++, log->entries++)
+	{
+		log->targets[log->entries] = STAT_NO_TARGET;
+		if (!plogCommitted(&e[i].commit)
+			|| le32toh(e[i].index) != log->entries)
+			continue;
+		log->targets[log->entries] = addTarget(stat, &e[i]);
+		if (log->targets[log->entries] == STAT_NO_TARGET)
+			return (-1);
+	}
+	return (0);
+}
+
+/**
+ * @brief Queue records block b for the scan
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+addBlock(tStat *stat, const tStatLog *log, uint32_t b)
+{
+	tStatBlock	*grown;
+
+	if (stat->blockCount == stat->blockCap)
+	{
+		grown = realloc(stat->blocks, (stat->blockCap ? stat->blockCap * 2 : STAT_TABLE_INITIAL)
+			* sizeof(*grown));
+		if (!grown)
+			return (-1);
+		stat->blocks = grown;
+		stat->blockCap = stat->blockCap ? stat->blockCap * 2 : STAT_TABLE_INITIAL;
+	}
+	stat->blocks[stat->blockCount].log = log;
+	stat->blocks[stat->blockCount].index = b;
+	stat->blockCount++;
+	return (0);
+}
+
+/**
+ * @brief Sort every started block: dictionaries are loaded, records
+ * blocks that may hold records in [fromNs, toNs] are queued
+ * @return 0 on success, -1 with a message on error
+ */
+static int
+readBlocks(tStat *stat, tStatLog *log)
+{
+	const tPlogBlock	*blk;
+	int					ret = 0;
+
+	for (uint32_t b = 0; b < log->blocks && ret == 0; b++)
+	{
+		blk = mmap(NULL, PLOG_BLOCK_SIZE, PROT_READ, MAP_SHARED, log->fd, plogBlockOffset(b));
+		if (blk == MAP_FAILED)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", log->path, strerror(errno));
+			return (-1);
+		}
+		if (plogBlockValid(blk, b))
+		{
+			if (blk->type == PLOG_BLOCK_DICT)
+				ret = loadDict(stat, log, blk);
+			/* an empty block has no time range yet */
+			else if (blk->type == PLOG_BLOCK_RECORDS && blk->count != 0
+				&& le64toh(blk->lastNs) >= stat->fromNs && le64toh(blk->firstNs) <= stat->toNs)
+				ret = addBlock(stat, log, b);
+			if (ret != 0)
+				ft_dprintf(STDERR_FILENO, PROG_NAME ": %s\n", strerror(ENOMEM));
+		}
+		munmap((void *)blk, PLOG_BLOCK_SIZE);
+	}
+	return (ret);
+}
+
+int
+statLogOpen(tStat *stat, tStatLog *log)
+{
+	tPlogHeader	hdr;
+	off_t		size;
+
+	log->fd = open(log->path, O_RDONLY | O_CLOEXEC);
+	if (log->fd < 0)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", log->path, strerror(errno));
+		return (-1);
+	}
+	size = lseek(log->fd, 0, SEEK_END);
+	if (pread(log->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || !plogHeaderMatches(&hdr))
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: not a probe log of version %d\n",
+			log->path, PLOG_VERSION);
+		return (-1);
+	}
+	log->blocks = le32toh(hdr.blocks);
+	/* a writer publishes a block only once it is allocated */
+	if (size < plogBlockOffset(log->blocks))
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: file truncated\n", log->path);
+		return (-1);
+	}
+	return (readBlocks(stat, log));
+}
+
+void
+statLogsFree(tStat *stat)
+{
+	for (size_t i = 0; i < stat->logCount; i++)
+	{
+		if (stat->logs[i].fd >= 0)
+			close(stat->logs[i].fd);
+		free(stat->logs[i].targets);
+	}
+	free(stat->logs);
+	free(stat->targets);
+	free(stat->index);
+	free(stat->blocks);
+	stat->logs = NULL;
+	stat->targets = NULL;
+	stat->index = NULL;
+	stat->blocks = NULL;
+}
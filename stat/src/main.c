@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+#include "../../hajlib/include/hgetopt.h"
+
+#include "../includes/stat.h"
+
+static void
+printUsage(void)
+{
+	ft_printf(
+		"Usage: " PROG_NAME " [-cv] [-j THREADS] [-w WINDOW] [-l TIME] [-p PCT] LOG...\n"
+		"Loss, RTT, jitter and availability per target and window from hajping probe logs.\n"
+		"\n"
+		"  -j THREADS  scan threads, one run of blocks each (default: online CPUs)\n"
+		"  -w WINDOW   window length, 0 for a single window (default 5m)\n"
+		"  -l TIME     only the last TIME of records\n"
+		"  -p PCT      RTT percentile reported (default 99)\n"
+		"  -c          CSV output\n"
+		"  -v          print the records scanned by each thread\n"
+		"  -h          print this help\n"
+		"\n"
+		"Durations are seconds, or suffixed s, m, h or d.\n"
+		"Logs are written with hajping --probe-log and may still be growing: the\n"
+		"records committed when " PROG_NAME " starts are read.\n");
+}
+
+/**
+ * @brief Parse a duration, a number of seconds or s, m, h or d suffixed
+ * @return 0 on success, -1 on a malformed value
+ */
+static int
+parseDuration(const char *str, uint64_t *ns)
+{
+	char	*end;
+	double	value = ft_strtod(str, &end);
+	double	scale = 1e9;
+
+	if (end == str || value < 0)
+		return (-1);
+	if (ft_strcmp(end, "m") == 0)
+		scale = 60e9;
+	else if (ft_strcmp(end, "h") == 0)
+		scale = 3600e9;
+	else if (ft_strcmp(end, "d") == 0)
+		scale = 86400e9;
+	else if (*end != '\0' && ft_strcmp(end, "s") != 0)
+		return (-1);
+	*ns = (uint64_t)(value * scale);
+	return (0);
+}
+
+/**
+ * @brief Parse the options, the remaining arguments are the logs
+ * @return the index of the first log, 0 when help was printed, -1 on error
+ */
+static int
+parseStatArgs(tStat *stat, int argc, char **argv)
+{
+	static const tFtLongOption	longOpts[] = {{NULL, 0, 0}};
+	tFtGetopt					state;
+	char						*end;
+	uint64_t					last;
+	int							ret;
+
+	ft_getoptInit(&state, argc, argv);
+	while ((ret = ft_getoptLong(&state, "j:w:l:p:cvh", longOpts)) != FT_GETOPT_END)
+	{
+		if (ret == FT_GETOPT_ERROR)
+		{
+			printUsage();
+			return (-1);
+		}
+		switch (state.opt)
+		{
+			case 'j':
+				stat->threads = (unsigned int)ft_strtoul(state.optArg, &end, 10);
+				if (*end != '\0' || stat->threads < 1 || stat->threads > STAT_MAX_THREADS)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid threads (1-%d): %s\n",
+						STAT_MAX_THREADS, state.optArg);
+					return (-1);
+				}
+				break;
+			case 'w':
+				if (parseDuration(state.optArg, &stat->windowNs) != 0)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid window: %s\n", state.optArg);
+					return (-1);
+				}
+				break;
+			case 'l':
+				if (parseDuration(state.optArg, &last) != 0 || last == 0)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid time: %s\n", state.optArg);
+					return (-1);
+				}
+				stat->fromNs = stat->toNs > last ? stat->toNs - last : 0;
+				break;
+			case 'p':
+				stat->percentile = ft_strtod(state.optArg, &end);
+				if (end == state.optArg || *end != '\0' || stat->percentile <= 0
+					|| stat->percentile > 100)
+				{
+					ft_dprintf(STDERR_FILENO, PROG_NAME ": invalid percentile: %s\n", state.optArg);
+					return (-1);
+				}
+				break;
+			case 'c': stat->csv = TRUE; break;
+			case 'v': stat->verbose++; break;
+			case 'h': printUsage(); return (0);
+		}
+	}
+	if (state.index >= argc)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": missing probe log\n");
+		return (-1);
+	}
+	return (state.index);
+}
+
+int
+main(int argc, char **argv)
+{
+	tStat			stat;
+	tStatTable		table;
+	struct timespec	now;
+	long			cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int				first;
+	int				ret = 0;
+
+	ft_bzero(&stat, sizeof(stat));
+	ft_bzero(&table, sizeof(table));
+	/* the snapshot: a record up to now has its target in the dictionary
+	 * read after, later records are left to the next run */
+	clock_gettime(CLOCK_REALTIME, &now);
+	stat.toNs = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	stat.windowNs = STAT_WINDOW_DEFAULT * 1000000000ULL;
+	stat.percentile = STAT_PCT_DEFAULT;
+	stat.threads = cpus < 1 ? 1 : cpus > STAT_MAX_THREADS ? STAT_MAX_THREADS : (unsigned int)cpus;
+	first = parseStatArgs(&stat, argc, argv);
+	if (first <= 0)
+		return (first == 0 ? 0 : 2);
+	stat.logCount = (size_t)(argc - first);
+	stat.logs = calloc(stat.logCount, sizeof(*stat.logs));
+	if (!stat.logs)
+		return (1);
+	for (size_t i = 0; i < stat.logCount; i++)
+		stat.logs[i].fd = -1;
+	for (size_t i = 0; i < stat.logCount && ret == 0; i++)
+	{
+		stat.logs[i].path = argv[first + (int)i];
+		ret = statLogOpen(&stat, &stat.logs[i]);
+	}
+	if (ret == 0)
+		ret = statScan(&stat, &table);
+	if (ret == 0)
+		ret = statReport(&stat, &table);
+	statTableFree(&table);
+	statLogsFree(&stat);
+	return (ret == 0 ? 0 : 1);
+}
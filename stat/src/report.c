@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/stat.h"
+
+/**
+ * @brief Cells by target, then window
+ */
+static int
+cellCmp(const void *a, const void *b)
+{
+	const tStatCell	*ca = *(const tStatCell *const *)a;
+	const tStatCell	*cb = *(const tStatCell *const *)b;
+
+	if (ca->target != cb->target)
+		return (ca->target < cb->target ? -1 : 1);
+	if (ca->window != cb->window)
+		return (ca->window < cb->window ? -1 : 1);
+	return (0);
+}
+
+/**
+ * @brief UTC start of a window, "all" for a single window
+ */
+static void
+windowStart(const tStat *stat, uint64_t window, char *buf, size_t size)
+{
+	struct tm	tm;
+	time_t		sec;
+
+	if (stat->windowNs == 0)
+	{
+		ft_strlcpy(buf, "all", size);
+		return;
+	}
+	sec = (time_t)(window * stat->windowNs / 1000000000ULL);
+	if (!gmtime_r(&sec, &tm) || strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm) == 0)
+		ft_strlcpy(buf, "?", size);
+}
+
+/**
+ * @brief Whether a window saw a probe settled or an error
+ */
+static tBool
+windowProbed(const tPingStats *s)
+{
+	return (s->sent > 0 || s->errors > 0);
+}
+
+/**
+ * @brief Whether a window had at least one reply
+ */
+static tBool
+windowUp(const tPingStats *s)
+{
+	return (s->received > s->duplicates);
+}
+
+/**
+ * @brief One row: the hajping summary of a target, or a CSV line
+ */
+static void
+printRow(const tStat *stat, const char *type, const char *when, const tStatTarget *t,
+	const tStatCell *c, unsigned int up, unsigned int probed)
+{
+	const tPingStats	*s = &c->stats;
+	double				pct = rttHistPercentile(&c->hist, stat->percentile);
+
+	if (stat->csv)
+	{
+		printf("%s,%s,%s,%s,%u,%u,%u,%u,%.3f", type, when, t->name, t->addr,
+			s->sent, s->received, s->duplicates, s->errors, pingStatsLoss(s));
+		if (s->rttCount > 0)
+			printf(",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f", s->rttMin, pingStatsAvg(s), s->rttMax,
+				pingStatsStddev(s), pct, c->jitter.jitter);
+		else
+			printf(",,,,,,");
+		printf(",%u,%u\n", up, probed);
+		return;
+	}
+	printf("%s: %u packets transmitted, %u received, %.0f%% packet loss",
+		when, s->sent, s->received, pingStatsLoss(s));
+	if (s->errors > 0)
+		printf(" +%u errors", s->errors);
+	if (s->duplicates > 0)
+		printf(" ++%u duplicates", s->duplicates);
+	if (type[0] == 't')
+		printf(", availability %.1f%% (%u/%u windows)",
+			probed ? 100.0 * up / probed : 0.0, up, probed);
+	printf("\n");
+	if (s->rttCount > 0)
+		printf("    round-trip min/avg/max/stdev = %.3f/%.3f/%.3f/%.3f ms, jitter %.3f ms, p%g <= %.3f ms\n",
+			s->rttMin, pingStatsAvg(s), s->rttMax, pingStatsStddev(s),
+			c->jitter.jitter, stat->percentile, pct);
+}
+
+/**
+ * @brief Rows of the windows of one target, then its total
+ * @param cells - the target's cells, in window order
+ */
+static void
+printTarget(const tStat *stat, const tStatCell *const *cells, size_t n)
+{
+	const tStatTarget	*t = &stat->targets[cells[0]->target];
+	tStatCell			total;
+	char				when[32];
+	unsigned int		up = 0;
+	unsigned int		probed = 0;
+
+	ft_bzero(&total, sizeof(total));
+	if (!stat->csv)
+		printf("--- %s (%s) ---\n", t->name, t->addr);
+	for (size_t i = 0; i < n; i++)
+	{
+		tBool	isUp = windowUp(&cells[i]->stats);
+		tBool	isProbed = windowProbed(&cells[i]->stats);
+
+		up += isUp;
+		probed += isProbed;
+		if (stat->windowNs != 0)
+		{
+			windowStart(stat, cells[i]->window, when, sizeof(when));
+			printRow(stat, "window", when, t, cells[i], isUp, isProbed);
+		}
+		statCellMerge(&total, cells[i]);
+	}
+	printRow(stat, "total", "total", t, &total, up, probed);
+}
+
+int
+statReport(const tStat *stat, const tStatTable *table)
+{
+	const tStatCell	**cells;
+	size_t			n = 0;
+	size_t			next;
+
+	if (table->count == 0)
+	{
+		if (!stat->csv)
+			printf("no records\n");
+		return (0);
+	}
+	cells = malloc(table->count * sizeof(*cells));
+	if (!cells)
+		return (-1);
+	for (size_t i = 0; i < table->cap; i++)
+		if (table->cells[i].used)
+			cells[n++] = &table->cells[i];
+	qsort(cells, n, sizeof(*cells), cellCmp);
+	if (stat->csv)
+		printf("type,window_start,target,addr,sent,received,duplicates,errors,loss_pct,"
+			"rtt_min_ms,rtt_avg_ms,rtt_max_ms,rtt_stddev_ms,rtt_p%g_ms,jitter_ms,windows_up,windows\n",
+			stat->percentile);
+	for (size_t i = 0; i < n; i = next)
+	{
+		next = i;
+		while (next < n && cells[next]->target == cells[i]->target)
+			next++;
+		printTarget(stat, cells + i, next - i);
+	}
+	free(cells);
+	return (0);
+}
@@ -0,0 +1,162 @@
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/stat.h"
+
+/**
+ * @brief Account one outcome the way hajping accounted it live
+ * A reply or a loss settles a probe sent; duplicates count as received,
+ * as pingStatsLoss expects.
+ */
+static void
+addRecord(tStatCell *c, const tPlogRecord *rec)
+{
+	double	ms;
+
+	switch (rec->status)
+	{
+		case OUTPUT_REPLY:
+			c->stats.sent++;
+			c->stats.received++;
+			if (!(rec->flags & PLOG_HAVE_RTT))
+				break;
+			ms = (double)le64toh(rec->rttNs) / 1000000.0;
+			pingStatsAddRtt(&c->stats, ms);
+			rttHistAdd(&c->hist, ms);
+			rttJitterAdd(&c->jitter, ms);
+			break;
+		case OUTPUT_DUPLICATE:
+			c->stats.received++;
+			c->stats.duplicates++;
+			break;
+		case OUTPUT_LOST:
+			c->stats.sent++;
+			c->stats.lost++;
+			break;
+		case OUTPUT_ERROR:
+			c->stats.errors++;
+			break;
+	}
+}
+
+/**
+ * @brief Account the committed records of one block
+ * The block is mapped for the scan only: the page cache, not the process,
+ * holds what has been read, so a log larger than memory streams through.
+ * @return 0 on success, -1 with a message on error
+ */
+static int
+scanBlock(tStatWorker *w, const tStatBlock *b)
+{
+	const tStat			*stat = w->stat;
+	const tPlogBlock	*blk;
+	const tPlogRecord	*rec;
+	uint32_t			count;
+	uint32_t			target;
+	uint64_t			ts;
+	tStatCell			*c;
+
+	blk = mmap(NULL, PLOG_BLOCK_SIZE, PROT_READ, MAP_SHARED, b->log->fd,
+		plogBlockOffset(b->index));
+	if (blk == MAP_FAILED)
+	{
+		ft_dprintf(STDERR_FILENO, PROG_NAME ": %s: %s\n", b->log->path, strerror(errno));
+		return (-1);
+	}
+	madvise((void *)blk, PLOG_BLOCK_SIZE, MADV_SEQUENTIAL);
+	count = plogBlockCount(blk);
+	rec = plogBlockRecords(blk);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		target = le32toh(rec[i].target);
+		ts = le64toh(rec[i].tsNs);
+		if (!plogCommitted(&rec[i].commit)
+			|| target >= b->log->entries || b->log->targets[target] == STAT_NO_TARGET
+			|| ts < stat->fromNs || ts > stat->toNs)
+		{
+			w->skipped++;
+			continue;
+		}
+		c = statCell(&w->table, b->log->targets[target], stat->windowNs ? ts / stat->windowNs : 0);
+		if (!c)
+		{
+			ft_dprintf(STDERR_FILENO, PROG_NAME ": %s\n", strerror(ENOMEM));
+			munmap((void *)blk, PLOG_BLOCK_SIZE);
+			return (-1);
+		}
+		addRecord(c, &rec[i]);
+		w->records++;
+	}
+	munmap((void *)blk, PLOG_BLOCK_SIZE);
+	return (0);
+}
+
+/**
+ * @brief Scan thread: the blocks of its chunk, in order
+ */
+static void *
+scanWorker(void *arg)
+{
+	tStatWorker	*w = arg;
+
+	for (size_t b = w->first; b < w->last && !w->failed; b++)
+		if (scanBlock(w, &w->stat->blocks[b]) != 0)
+			w->failed = TRUE;
+	return (NULL);
+}
+
+int
+statScan(tStat *stat, tStatTable *out)
+{
+	unsigned int	threads = stat->threads;
+	tStatWorker		*w;
+	tStatCell		*dst;
+	int				ret = 0;
+
+	if (threads > stat->blockCount)
+		threads = stat->blockCount > 0 ? (unsigned int)stat->blockCount : 1;
+	for (unsigned int t = 0; t < threads; t++)
+	{
+		w = &stat->workers[t];
+		w->stat = stat;
+		w->first = stat->blockCount * t / threads;
+		w->last = stat->blockCount * (t + 1) / threads;
+		w->started = pthread_create(&w->thread, NULL, scanWorker, w) == 0;
+		/* short of threads, the chunk is scanned here */
+		if (!w->started)
+			scanWorker(w);
+	}
+	/* chunks are merged in block order, so are the samples of every cell */
+	for (unsigned int t = 0; t < threads; t++)
+	{
+		w = &stat->workers[t];
+		if (w->started)
+			pthread_join(w->thread, NULL);
+		if (stat->verbose > 0)
+			printf("thread %u: %zu blocks, %lu records, %lu skipped\n",
+				t, w->last - w->first, w->records, w->skipped);
+		for (size_t i = 0; i < w->table.cap && !w->failed && ret == 0; i++)
+		{
+			if (!w->table.cells[i].used)
+				continue;
+			dst = statCell(out, w->table.cells[i].target, w->table.cells[i].window);
+			if (!dst)
+			{
+				ft_dprintf(STDERR_FILENO, PROG_NAME ": %s\n", strerror(ENOMEM));
+				ret = -1;
+				break;
+			}
+			statCellMerge(dst, &w->table.cells[i]);
+		}
+		if (w->failed)
+			ret = -1;
+		statTableFree(&w->table);
+	}
+	return (ret);
+}
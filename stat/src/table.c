@@ -0,0 +1,93 @@
+#include <stdlib.h>
+
+#include "../../hajlib/include/hajlib.h" /* IWYU pragma: keep */
+
+#include "../includes/stat.h"
+
+/**
+ * @brief Slot hash of a target and window
+ */
+static uint64_t
+cellHash(uint32_t target, uint64_t window)
+{
+	uint64_t	h = ((uint64_t)target << 32 ^ window) * 0x9E3779B97F4A7C15ULL;
+
+	return (h ^ h >> 29);
+}
+
+/**
+ * @brief Slot of a key: its cell, or the free slot where it belongs
+ */
+static tStatCell *
+findCell(const tStatTable *table, uint32_t target, uint64_t window)
+{
+	size_t		mask = table->cap - 1;
+	tStatCell	*c;
+
+	for (size_t i = cellHash(target, window) & mask;; i = (i + 1) & mask)
+	{
+		c = &table->cells[i];
+		if (!c->used || (c->target == target && c->window == window))
+			return (c);
+	}
+}
+
+/**
+ * @brief Double the table, cells keep their content
+ * @return 0 on success, -1 on allocation failure
+ */
+static int
+growTable(tStatTable *table)
+{
+	size_t		cap = table->cap ? table->cap * 2 : STAT_TABLE_INITIAL;
+	tStatCell	*old = table->cells;
+	size_t		oldCap = table->cap;
+
+	table->cells = calloc(cap, sizeof(*table->cells));
+	if (!table->cells)
+	{
+		table->cells = old;
+		return (-1);
+	}
+	table->cap = cap;
+	for (size_t i = 0; i < oldCap; i++)
+		if (old[i].used)
+			*findCell(table, old[i].target, old[i].window) = old[i];
+	free(old);
+	return (0);
+}
+
+tStatCell *
+statCell(tStatTable *table, uint32_t target, uint64_t window)
+{
+	tStatCell	*c;
+
+	if ((table->count + 1) * 2 > table->cap && growTable(table) != 0)
+		return (NULL);
+	c = findCell(table, target, window);
+	if (!c->used)
+	{
+		c->used = TRUE;
+		c->target = target;
+		c->window = window;
+		table->count++;
+	}
+	return (c);
+}
+
+void
+statCellMerge(tStatCell *dst, const tStatCell *src)
+{
+	pingStatsMerge(&dst->stats, &src->stats);
+	rttHistMerge(&dst->hist, &src->hist);
+	rttJitterMerge(&dst->jitter, &src->jitter);
+}
+
+void
+statTableFree(tStatTable *table)
+{
+	free(table->cells);
+	table->cells = NULL;
+	table->count = 0;
+	table->cap = 0;
+}